@@ -21,6 +21,7 @@
 
 #include "glad/gl.h"
 #include "utils.h"
+#include "gl_resource.h"
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 
@@ -163,6 +164,8 @@ void xe::Application::run(int verbose)
            Setting it to one as I did set the swap rate to v-sync rate. 
         */
         glfwSwapBuffers(window_);
+        // Objects released during this frame are deleted once the GPU has finished with it.
+        deletion_queue().end_frame();
 
         /* Poll for and process events */
         glfwPollEvents();
@@ -181,6 +184,7 @@ void xe::Application::run(int verbose)
     }
 
     cleanup();
+    deletion_queue().flush();
     glfwTerminate();
 }
 
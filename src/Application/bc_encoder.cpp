@@ -0,0 +1,613 @@
+#include "bc_encoder.h"
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <system_error>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define XE_BC_SSE 1
+#endif
+
+#include "thread_pool.h"
+#include "utils.h"
+
+namespace {
+    constexpr std::uint32_t MAGIC = 0x43424558u; // "XEBC"
+    constexpr std::uint32_t FORMAT_VERSION = 1u;
+    // Blocks per parallel_for chunk.
+    constexpr std::size_t CHUNK_BLOCKS = 1024u;
+    // Largest level 0 side accepted from a file, far above any GL_MAX_TEXTURE_SIZE.
+    constexpr std::uint32_t MAX_SIZE = 1u << 16;
+
+    // S3TC is an extension, glad does not define its enums.
+    constexpr GLenum COMPRESSED_RGBA_S3TC_DXT1 = 0x83F1;
+    constexpr GLenum COMPRESSED_RGBA_S3TC_DXT5 = 0x83F3;
+    constexpr GLenum COMPRESSED_SRGB_ALPHA_S3TC_DXT1 = 0x8C4D;
+    constexpr GLenum COMPRESSED_SRGB_ALPHA_S3TC_DXT5 = 0x8C4F;
+
+    struct header_t {
+        std::uint32_t magic;
+        std::uint32_t version;
+        std::uint64_t key;
+        std::uint32_t format;
+        std::uint32_t srgb;
+        std::uint32_t n_levels;
+        std::uint32_t reserved;
+    };
+
+    struct level_header_t {
+        std::uint32_t width;
+        std::uint32_t height;
+        std::uint64_t size;
+    };
+
+    // Bytes of a level of the given size, in whole blocks.
+    std::size_t level_bytes(GLsizei width, GLsizei height, xe::BCFormat format) {
+        return ((std::size_t(width) + 3u) / 4u) * ((std::size_t(height) + 3u) / 4u) * xe::bc_block_size(format);
+    }
+
+    // Texels of a block by channel, 0-255.
+    struct block_t {
+        alignas(16) float c[4][16];
+    };
+
+    using palette_t = float[16][4];
+
+    void load_block(const xe::image_t &image, std::size_t bx, std::size_t by, block_t &block) {
+        const auto w = std::size_t(image.width);
+        const auto h = std::size_t(image.height);
+        for (std::size_t y = 0; y < 4u; ++y) {
+            auto sy = std::min(4u * by + y, h - 1u);
+            for (std::size_t x = 0; x < 4u; ++x) {
+                auto sx = std::min(4u * bx + x, w - 1u);
+                auto p = image.pixels.data() + (sy * w + sx) * 4u;
+                for (std::size_t c = 0; c < 4u; ++c)
+                    block.c[c][4u * y + x] = float(p[c]);
+            }
+        }
+    }
+
+    // Nearest of the first `n` palette entries for every texel, comparing the first C channels. Returns the
+    // squared error.
+    template<int C>
+    float select_indices(const block_t &block, const palette_t &palette, int n, std::uint8_t idx[16]) {
+        float error = 0.0f;
+#ifdef XE_BC_SSE
+        for (int g = 0; g < 16; g += 4) {
+            __m128 px[C];
+            for (int c = 0; c < C; ++c)
+                px[c] = _mm_load_ps(&block.c[c][g]);
+            auto best = _mm_set1_ps(FLT_MAX);
+            auto best_i = _mm_setzero_ps();
+            for (int p = 0; p < n; ++p) {
+                auto d = _mm_setzero_ps();
+                for (int c = 0; c < C; ++c) {
+                    auto t = _mm_sub_ps(px[c], _mm_set1_ps(palette[p][c]));
+                    d = _mm_add_ps(d, _mm_mul_ps(t, t));
+                }
+                auto less = _mm_cmplt_ps(d, best);
+                best = _mm_min_ps(d, best);
+                best_i = _mm_or_ps(_mm_and_ps(less, _mm_set1_ps(float(p))), _mm_andnot_ps(less, best_i));
+            }
+            alignas(16) float bi[4], be[4];
+            _mm_store_ps(bi, best_i);
+            _mm_store_ps(be, best);
+            for (int k = 0; k < 4; ++k) {
+                idx[g + k] = std::uint8_t(bi[k]);
+                error += be[k];
+            }
+        }
+#else
+        for (int i = 0; i < 16; ++i) {
+            auto best = FLT_MAX;
+            for (int p = 0; p < n; ++p) {
+                auto d = 0.0f;
+                for (int c = 0; c < C; ++c) {
+                    auto t = block.c[c][i] - palette[p][c];
+                    d += t * t;
+                }
+                if (d < best) {
+                    best = d;
+                    idx[i] = std::uint8_t(p);
+                }
+            }
+            error += best;
+        }
+#endif
+        return error;
+    }
+
+    // Endpoints at the extremes of the projections on the principal axis of the block.
+    template<int C>
+    void principal_endpoints(const block_t &block, float lo[4], float hi[4]) {
+        float mean[C], axis[C];
+        for (int c = 0; c < C; ++c) {
+            auto [min, max] = std::minmax_element(block.c[c], block.c[c] + 16);
+            axis[c] = *max - *min;
+            mean[c] = 0.0f;
+            for (int i = 0; i < 16; ++i)
+                mean[c] += block.c[c][i];
+            mean[c] /= 16.0f;
+        }
+
+        float cov[C][C] = {};
+        for (int i = 0; i < 16; ++i)
+            for (int a = 0; a < C; ++a)
+                for (int b = a; b < C; ++b)
+                    cov[a][b] += (block.c[a][i] - mean[a]) * (block.c[b][i] - mean[b]);
+        for (int a = 0; a < C; ++a)
+            for (int b = 0; b < a; ++b)
+                cov[a][b] = cov[b][a];
+
+        // Power iteration, starting from the bounding box diagonal.
+        for (int k = 0; k < 8; ++k) {
+            float v[C] = {};
+            for (int a = 0; a < C; ++a)
+                for (int b = 0; b < C; ++b)
+                    v[a] += cov[a][b] * axis[b];
+            auto m = 0.0f;
+            for (int a = 0; a < C; ++a)
+                m = std::max(m, std::abs(v[a]));
+            if (m == 0.0f)
+                break;
+            for (int a = 0; a < C; ++a)
+                axis[a] = v[a] / m;
+        }
+        auto length = 0.0f;
+        for (int c = 0; c < C; ++c)
+            length += axis[c] * axis[c];
+        if (length == 0.0f) {
+            for (int c = 0; c < C; ++c)
+                lo[c] = hi[c] = mean[c];
+            return;
+        }
+        length = std::sqrt(length);
+        for (int c = 0; c < C; ++c)
+            axis[c] /= length;
+
+        float t_min, t_max;
+#ifdef XE_BC_SSE
+        auto v_min = _mm_set1_ps(FLT_MAX);
+        auto v_max = _mm_set1_ps(-FLT_MAX);
+        for (int g = 0; g < 16; g += 4) {
+            auto t = _mm_setzero_ps();
+            for (int c = 0; c < C; ++c)
+                t = _mm_add_ps(t, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(&block.c[c][g]), _mm_set1_ps(mean[c])),
+                                             _mm_set1_ps(axis[c])));
+            v_min = _mm_min_ps(v_min, t);
+            v_max = _mm_max_ps(v_max, t);
+        }
+        alignas(16) float mins[4], maxs[4];
+        _mm_store_ps(mins, v_min);
+        _mm_store_ps(maxs, v_max);
+        t_min = std::min({mins[0], mins[1], mins[2], mins[3]});
+        t_max = std::max({maxs[0], maxs[1], maxs[2], maxs[3]});
+#else
+        t_min = FLT_MAX;
+        t_max = -FLT_MAX;
+        for (int i = 0; i < 16; ++i) {
+            auto t = 0.0f;
+            for (int c = 0; c < C; ++c)
+                t += (block.c[c][i] - mean[c]) * axis[c];
+            t_min = std::min(t_min, t);
+            t_max = std::max(t_max, t);
+        }
+#endif
+        for (int c = 0; c < C; ++c) {
+            lo[c] = std::clamp(mean[c] + t_min * axis[c], 0.0f, 255.0f);
+            hi[c] = std::clamp(mean[c] + t_max * axis[c], 0.0f, 255.0f);
+        }
+    }
+
+    // Least squares endpoints for the given indices, `weights[i]` is how far palette entry i is from e0 to e1.
+    template<int C>
+    bool refine(const block_t &block, const std::uint8_t idx[16], const float *weights, float e0[4], float e1[4]) {
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        float xa[C] = {}, xb[C] = {};
+        for (int i = 0; i < 16; ++i) {
+            auto w = weights[idx[i]];
+            auto a = 1.0f - w;
+            aa += a * a;
+            ab += a * w;
+            bb += w * w;
+            for (int c = 0; c < C; ++c) {
+                xa[c] += a * block.c[c][i];
+                xb[c] += w * block.c[c][i];
+            }
+        }
+        auto det = aa * bb - ab * ab;
+        if (std::abs(det) < 1e-6f)
+            return false;
+        for (int c = 0; c < C; ++c) {
+            e0[c] = std::clamp((xa[c] * bb - xb[c] * ab) / det, 0.0f, 255.0f);
+            e1[c] = std::clamp((aa * xb[c] - ab * xa[c]) / det, 0.0f, 255.0f);
+        }
+        return true;
+    }
+
+    class bit_writer_t {
+    public:
+        explicit bit_writer_t(std::uint8_t *out) : out_(out) {}
+
+        void put(std::uint32_t value, int bits) {
+            for (int i = 0; i < bits; ++i, ++pos_)
+                if ((value >> i) & 1u)
+                    out_[pos_ >> 3u] |= std::uint8_t(1u << (pos_ & 7u));
+        }
+
+    private:
+        std::uint8_t *out_;
+        std::size_t pos_ = 0;
+    };
+
+    // BC1 ----------------------------------------------------------------------------------------------------
+
+    constexpr float BC1_WEIGHTS[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+
+    std::uint16_t to_565(const float c[4]) {
+        auto r = std::uint16_t(std::lround(c[0] * 31.0f / 255.0f));
+        auto g = std::uint16_t(std::lround(c[1] * 63.0f / 255.0f));
+        auto b = std::uint16_t(std::lround(c[2] * 31.0f / 255.0f));
+        return std::uint16_t((r << 11u) | (g << 5u) | b);
+    }
+
+    void from_565(std::uint16_t v, float c[4]) {
+        auto r = (v >> 11u) & 31u;
+        auto g = (v >> 5u) & 63u;
+        auto b = v & 31u;
+        c[0] = float((r << 3u) | (r >> 2u));
+        c[1] = float((g << 2u) | (g >> 4u));
+        c[2] = float((b << 3u) | (b >> 2u));
+        c[3] = 255.0f;
+    }
+
+    // Always the four color mode, which BC3 requires. Returns the error, leaves the quantized endpoints in e0
+    // and e1 and the indices in idx.
+    float encode_bc1_endpoints(const block_t &block, float e0[4], float e1[4], std::uint8_t idx[16],
+                               std::uint8_t out[8]) {
+        auto c0 = to_565(e0);
+        auto c1 = to_565(e1);
+        if (c0 < c1)
+            std::swap(c0, c1);
+
+        palette_t palette;
+        from_565(c0, palette[0]);
+        from_565(c1, palette[1]);
+        for (int c = 0; c < 3; ++c) {
+            palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+            palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+        }
+        // Equal endpoints would select the three color mode, only index 0 is safe then.
+        auto error = select_indices<3>(block, palette, c0 == c1 ? 1 : 4, idx);
+        std::copy_n(palette[0], 4, e0);
+        std::copy_n(palette[1], 4, e1);
+
+        std::uint32_t bits = 0;
+        for (int i = 0; i < 16; ++i)
+            bits |= std::uint32_t(idx[i]) << (2u * i);
+        out[0] = std::uint8_t(c0);
+        out[1] = std::uint8_t(c0 >> 8u);
+        out[2] = std::uint8_t(c1);
+        out[3] = std::uint8_t(c1 >> 8u);
+        std::memcpy(out + 4, &bits, 4);
+        return error;
+    }
+
+    void encode_bc1(const block_t &block, std::uint8_t out[8]) {
+        float e0[4], e1[4];
+        std::uint8_t idx[16];
+        principal_endpoints<3>(block, e1, e0);
+        auto error = encode_bc1_endpoints(block, e0, e1, idx, out);
+        if (error > 0.0f && refine<3>(block, idx, BC1_WEIGHTS, e0, e1)) {
+            std::uint8_t refined[8];
+            if (encode_bc1_endpoints(block, e0, e1, idx, refined) < error)
+                std::memcpy(out, refined, 8);
+        }
+    }
+
+    // BC4, one channel -----------------------------------------------------------------------------------
+
+    constexpr float BC4_WEIGHTS[8] = {0.0f, 1.0f, 1.0f / 7.0f, 2.0f / 7.0f, 3.0f / 7.0f, 4.0f / 7.0f, 5.0f / 7.0f,
+                                      6.0f / 7.0f};
+
+    // Eight value mode, r0 > r1.
+    float encode_bc4_endpoints(const block_t &block, float &e0, float &e1, std::uint8_t idx[16],
+                               std::uint8_t out[8]) {
+        auto r0 = int(std::lround(e0));
+        auto r1 = int(std::lround(e1));
+        if (r0 < r1)
+            std::swap(r0, r1);
+
+        palette_t palette;
+        palette[0][0] = float(r0);
+        palette[1][0] = float(r1);
+        for (int k = 2; k < 8; ++k)
+            palette[k][0] = float(((8 - k) * r0 + (k - 1) * r1) / 7);
+        auto error = select_indices<1>(block, palette, r0 == r1 ? 1 : 8, idx);
+        e0 = float(r0);
+        e1 = float(r1);
+
+        std::uint64_t bits = 0;
+        for (int i = 0; i < 16; ++i)
+            bits |= std::uint64_t(idx[i]) << (3u * i);
+        out[0] = std::uint8_t(r0);
+        out[1] = std::uint8_t(r1);
+        for (int i = 0; i < 6; ++i)
+            out[2 + i] = std::uint8_t(bits >> (8u * i));
+        return error;
+    }
+
+    void encode_bc4(const block_t &block, int channel, std::uint8_t out[8]) {
+        block_t single;
+        std::copy_n(block.c[channel], 16, single.c[0]);
+        auto [min, max] = std::minmax_element(single.c[0], single.c[0] + 16);
+        float e0 = *max, e1 = *min;
+        std::uint8_t idx[16];
+        auto error = encode_bc4_endpoints(single, e0, e1, idx, out);
+        float r0[4] = {e0}, r1[4] = {e1};
+        if (error > 0.0f && refine<1>(single, idx, BC4_WEIGHTS, r0, r1)) {
+            std::uint8_t refined[8];
+            if (encode_bc4_endpoints(single, r0[0], r1[0], idx, refined) < error)
+                std::memcpy(out, refined, 8);
+        }
+    }
+
+    // BC7 mode 6 -----------------------------------------------------------------------------------------
+
+    constexpr int BC7_WEIGHTS[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    // 7 bit endpoint and the p-bit closest to `e`.
+    void quantize_bc7(const float e[4], std::uint32_t q[4], std::uint32_t &p) {
+        auto best = FLT_MAX;
+        for (std::uint32_t bit = 0; bit < 2u; ++bit) {
+            std::uint32_t t[4];
+            auto error = 0.0f;
+            for (int c = 0; c < 4; ++c) {
+                t[c] = std::uint32_t(std::clamp(std::lround((e[c] - float(bit)) / 2.0f), 0l, 127l));
+                auto d = float((t[c] << 1u) | bit) - e[c];
+                error += d * d;
+            }
+            if (error < best) {
+                best = error;
+                p = bit;
+                std::copy_n(t, 4, q);
+            }
+        }
+    }
+
+    float encode_bc7_endpoints(const block_t &block, float e0[4], float e1[4], std::uint8_t idx[16],
+                               std::uint8_t out[16]) {
+        std::uint32_t q0[4], q1[4], p0, p1;
+        quantize_bc7(e0, q0, p0);
+        quantize_bc7(e1, q1, p1);
+        int v0[4], v1[4];
+        for (int c = 0; c < 4; ++c) {
+            v0[c] = int((q0[c] << 1u) | p0);
+            v1[c] = int((q1[c] << 1u) | p1);
+        }
+
+        palette_t palette;
+        for (int k = 0; k < 16; ++k)
+            for (int c = 0; c < 4; ++c)
+                palette[k][c] = float(((64 - BC7_WEIGHTS[k]) * v0[c] + BC7_WEIGHTS[k] * v1[c] + 32) >> 6);
+        auto error = select_indices<4>(block, palette, 16, idx);
+        for (int c = 0; c < 4; ++c) {
+            e0[c] = float(v0[c]);
+            e1[c] = float(v1[c]);
+        }
+
+        // The anchor index is stored without its top bit.
+        if (idx[0] >= 8u) {
+            std::swap(q0, q1);
+            std::swap(p0, p1);
+            for (int i = 0; i < 16; ++i)
+                idx[i] = std::uint8_t(15u - idx[i]);
+        }
+
+        std::memset(out, 0, 16);
+        bit_writer_t bits(out);
+        bits.put(1u << 6u, 7);
+        for (int c = 0; c < 4; ++c) {
+            bits.put(q0[c], 7);
+            bits.put(q1[c], 7);
+        }
+        bits.put(p0, 1);
+        bits.put(p1, 1);
+        bits.put(idx[0], 3);
+        for (int i = 1; i < 16; ++i)
+            bits.put(idx[i], 4);
+        return error;
+    }
+
+    void encode_bc7(const block_t &block, std::uint8_t out[16]) {
+        static const auto weights = [] {
+            std::array<float, 16> w{};
+            for (int k = 0; k < 16; ++k)
+                w[k] = float(BC7_WEIGHTS[k]) / 64.0f;
+            return w;
+        }();
+
+        float e0[4], e1[4];
+        std::uint8_t idx[16];
+        principal_endpoints<4>(block, e0, e1);
+        auto error = encode_bc7_endpoints(block, e0, e1, idx, out);
+        // After a swap the indices count from e1, the refined endpoints just come out swapped.
+        if (error > 0.0f && refine<4>(block, idx, weights.data(), e0, e1)) {
+            std::uint8_t refined[16];
+            if (encode_bc7_endpoints(block, e0, e1, idx, refined) < error)
+                std::memcpy(out, refined, 16);
+        }
+    }
+
+    void encode_block(xe::BCFormat format, const block_t &block, std::uint8_t *out) {
+        switch (format) {
+            case xe::BCFormat::BC1:
+                encode_bc1(block, out);
+                break;
+            case xe::BCFormat::BC3:
+                encode_bc4(block, 3, out);
+                encode_bc1(block, out + 8);
+                break;
+            case xe::BCFormat::BC5:
+                encode_bc4(block, 0, out);
+                encode_bc4(block, 1, out + 8);
+                break;
+            case xe::BCFormat::BC7:
+                encode_bc7(block, out);
+                break;
+        }
+    }
+}
+
+namespace xe {
+
+    std::size_t bc_block_size(BCFormat format) {
+        return format == BCFormat::BC1 ? 8u : 16u;
+    }
+
+    GLenum bc_gl_format(BCFormat format, bool srgb) {
+        switch (format) {
+            case BCFormat::BC1:
+                return srgb ? COMPRESSED_SRGB_ALPHA_S3TC_DXT1 : COMPRESSED_RGBA_S3TC_DXT1;
+            case BCFormat::BC3:
+                return srgb ? COMPRESSED_SRGB_ALPHA_S3TC_DXT5 : COMPRESSED_RGBA_S3TC_DXT5;
+            case BCFormat::BC5:
+                return GL_COMPRESSED_RG_RGTC2;
+            case BCFormat::BC7:
+#ifdef GL_COMPRESSED_RGBA_BPTC_UNORM
+                return srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+#else
+                break;
+#endif
+        }
+        return GL_NONE;
+    }
+
+    std::size_t compressed_chain_t::size() const {
+        std::size_t bytes = 0;
+        for (auto &&level: levels)
+            bytes += level.data.size();
+        return bytes;
+    }
+
+    bool has_alpha(const image_t &image) {
+        for (std::size_t i = 3; i < image.pixels.size(); i += 4u)
+            if (image.pixels[i] != 255u)
+                return true;
+        return false;
+    }
+
+    compressed_level_t bc_compress(const image_t &image, BCFormat format) {
+        compressed_level_t level;
+        level.width = image.width;
+        level.height = image.height;
+        const auto bw = (std::size_t(image.width) + 3u) / 4u;
+        const auto bh = (std::size_t(image.height) + 3u) / 4u;
+        const auto block_size = bc_block_size(format);
+        level.data.resize(level_bytes(image.width, image.height, format));
+
+        auto chunk = std::max<std::size_t>(1u, CHUNK_BLOCKS / bw);
+        thread_pool().parallel_for(bh, [&](std::size_t begin, std::size_t end) {
+            block_t block;
+            for (auto by = begin; by < end; ++by)
+                for (std::size_t bx = 0; bx < bw; ++bx) {
+                    load_block(image, bx, by, block);
+                    encode_block(format, block, level.data.data() + (by * bw + bx) * block_size);
+                }
+        }, chunk);
+        return level;
+    }
+
+    compressed_chain_t bc_compress(const mip_chain_t &chain, BCFormat format) {
+        compressed_chain_t compressed;
+        compressed.format = format;
+        compressed.srgb = chain.srgb;
+        compressed.levels.reserve(chain.levels.size());
+        for (auto &&level: chain.levels)
+            compressed.levels.push_back(bc_compress(level, format));
+        return compressed;
+    }
+
+    compressed_chain_t read_compressed(const std::filesystem::path &path, std::uint64_t key) {
+        std::ifstream file(path, std::ios::in | std::ios::binary);
+        if (!file)
+            return {};
+
+        header_t header{};
+        file.read(reinterpret_cast<char *>(&header), sizeof(header));
+        if (!file || header.magic != MAGIC || header.version != FORMAT_VERSION || header.key != key)
+            return {};
+
+        // Nothing read from the file is trusted before it is checked against what the encoder would have
+        // written, so a damaged file is a miss rather than a huge allocation.
+        auto format = BCFormat(header.format);
+        if (format != BCFormat::BC1 && format != BCFormat::BC3 && format != BCFormat::BC5 && format != BCFormat::BC7)
+            return {};
+        if (header.n_levels == 0u)
+            return {};
+        std::error_code ec;
+        auto remaining = std::filesystem::file_size(path, ec);
+        if (ec || remaining < sizeof(header))
+            return {};
+        remaining -= sizeof(header);
+
+        compressed_chain_t chain;
+        chain.format = format;
+        chain.srgb = header.srgb != 0u;
+        GLsizei width = 0, height = 0;
+        for (std::uint32_t i = 0; i < header.n_levels; ++i) {
+            level_header_t level_header{};
+            file.read(reinterpret_cast<char *>(&level_header), sizeof(level_header));
+            if (!file)
+                return {};
+            if (i == 0u) {
+                if (level_header.width == 0u || level_header.height == 0u ||
+                    std::max(level_header.width, level_header.height) > MAX_SIZE)
+                    return {};
+                width = GLsizei(level_header.width);
+                height = GLsizei(level_header.height);
+                if (header.n_levels > std::uint32_t(mip_levels(width, height)))
+                    return {};
+            } else {
+                // The same halving as downsample.
+                width = std::max(width / 2, 1);
+                height = std::max(height / 2, 1);
+            }
+            if (level_header.width != std::uint32_t(width) || level_header.height != std::uint32_t(height))
+                return {};
+            auto expected = level_bytes(width, height, format);
+            if (level_header.size != expected || sizeof(level_header) + expected > remaining)
+                return {};
+            remaining -= sizeof(level_header) + expected;
+
+            auto &level = chain.levels.emplace_back();
+            level.width = width;
+            level.height = height;
+            level.data.resize(expected);
+            file.read(reinterpret_cast<char *>(level.data.data()), std::streamsize(level.data.size()));
+            if (!file)
+                return {};
+        }
+        return chain;
+    }
+
+    bool write_compressed(const std::filesystem::path &path, const compressed_chain_t &chain, std::uint64_t key) {
+        return utils::write_file_atomic(path, [&](std::ostream &file) {
+            header_t header{MAGIC, FORMAT_VERSION, key, std::uint32_t(chain.format), chain.srgb ? 1u : 0u,
+                            std::uint32_t(chain.levels.size()), 0u};
+            file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            for (auto &&level: chain.levels) {
+                level_header_t level_header{std::uint32_t(level.width), std::uint32_t(level.height),
+                                            level.data.size()};
+                file.write(reinterpret_cast<const char *>(&level_header), sizeof(level_header));
+                file.write(reinterpret_cast<const char *>(level.data.data()), std::streamsize(level.data.size()));
+            }
+        });
+    }
+}
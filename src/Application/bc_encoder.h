@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include "glad/gl.h"
+
+#include "mip_chain.h"
+
+namespace xe {
+
+    // Block compressed formats, all with 4x4 texel blocks.
+    enum class BCFormat : std::uint32_t {
+        // Opaque RGB, 8 bytes per block.
+        BC1 = 1u,
+        // BC1 color with a separately encoded alpha, 16 bytes.
+        BC3 = 3u,
+        // Red and green encoded separately, for normal maps, 16 bytes.
+        BC5 = 5u,
+        // RGBA, 16 bytes. Only mode 6, a single pair of RGBA endpoints with 16 levels, is used.
+        BC7 = 7u
+    };
+
+    std::size_t bc_block_size(BCFormat format);
+
+    // The BC1 and BC3 formats come from EXT_texture_compression_s3tc, see compression_supported.
+    GLenum bc_gl_format(BCFormat format, bool srgb);
+
+    struct compressed_level_t {
+        GLsizei width = 0;
+        GLsizei height = 0;
+        std::vector<std::uint8_t> data;
+    };
+
+    struct compressed_chain_t {
+        BCFormat format = BCFormat::BC1;
+        bool srgb = true;
+        std::vector<compressed_level_t> levels;
+
+        bool empty() const { return levels.empty(); }
+
+        std::size_t size() const;
+    };
+
+    // Whether any texel is not fully opaque.
+    bool has_alpha(const image_t &image);
+
+    /**
+     * @brief Encodes an RGBA8 image into 4x4 blocks.
+     *
+     * Endpoints start on the principal axis of the block colors and are refined once by least squares on the
+     * chosen indices, the better of both encodings is kept. Indices are picked by the nearest palette entry,
+     * four texels at a time with SSE where it is available. Rows of blocks are encoded in parallel on the
+     * thread pool. Edge blocks repeat the last row and column.
+     */
+    compressed_level_t bc_compress(const image_t &image, BCFormat format);
+
+    compressed_chain_t bc_compress(const mip_chain_t &chain, BCFormat format);
+
+    // Compressed chain files, `key` identifies the source and the encoding settings. Reading returns an empty
+    // chain when the file is missing, damaged or has another key.
+    compressed_chain_t read_compressed(const std::filesystem::path &path, std::uint64_t key);
+
+    bool write_compressed(const std::filesystem::path &path, const compressed_chain_t &chain, std::uint64_t key);
+}
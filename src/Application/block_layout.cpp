@@ -0,0 +1,96 @@
+#include "block_layout.h"
+
+#include <iostream>
+
+namespace {
+    struct reflected_t {
+        bool found = false;
+        GLint offset = 0;
+        GLint array_stride = 0;
+        GLint matrix_stride = 0;
+    };
+
+    reflected_t uniform_member(GLuint program, const std::string &name) {
+        reflected_t r;
+        const char *c_name = name.c_str();
+        GLuint index = GL_INVALID_INDEX;
+        glGetUniformIndices(program, 1, &c_name, &index);
+        if (index == GL_INVALID_INDEX)
+            return r;
+        r.found = true;
+        glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_OFFSET, &r.offset);
+        glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_ARRAY_STRIDE, &r.array_stride);
+        glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_MATRIX_STRIDE, &r.matrix_stride);
+        return r;
+    }
+
+#if (MAJOR >= 4) && (MINOR >= 3)
+
+    reflected_t storage_member(GLuint program, const std::string &name) {
+        reflected_t r;
+        auto index = glGetProgramResourceIndex(program, GL_BUFFER_VARIABLE, name.c_str());
+        if (index == GL_INVALID_INDEX)
+            return r;
+        r.found = true;
+        const GLenum props[] = {GL_OFFSET, GL_ARRAY_STRIDE, GL_MATRIX_STRIDE};
+        GLint values[3];
+        glGetProgramResourceiv(program, GL_BUFFER_VARIABLE, index, 3, props, 3, nullptr, values);
+        r.offset = values[0];
+        r.array_stride = values[1];
+        r.matrix_stride = values[2];
+        return r;
+    }
+
+#endif
+}
+
+namespace xe::layout {
+
+    bool check_block(GLuint program, const std::string &block, Interface interface, std::size_t size,
+                     std::span<const member_t> members) {
+        GLint block_size = 0;
+        reflected_t (*member)(GLuint, const std::string &) = uniform_member;
+        if (interface == Interface::UNIFORM) {
+            auto index = glGetUniformBlockIndex(program, block.c_str());
+            if (index == GL_INVALID_INDEX)
+                return true;
+            glGetActiveUniformBlockiv(program, index, GL_UNIFORM_BLOCK_DATA_SIZE, &block_size);
+        } else {
+#if (MAJOR >= 4) && (MINOR >= 3)
+            auto index = glGetProgramResourceIndex(program, GL_SHADER_STORAGE_BLOCK, block.c_str());
+            if (index == GL_INVALID_INDEX)
+                return true;
+            const GLenum prop = GL_BUFFER_DATA_SIZE;
+            glGetProgramResourceiv(program, GL_SHADER_STORAGE_BLOCK, index, 1, &prop, 1, nullptr, &block_size);
+            member = storage_member;
+#else
+            return true;
+#endif
+        }
+
+        bool ok = true;
+        auto report = [&](const std::string &what, std::size_t expected, GLint actual) {
+            std::cerr << "Block " << block << ": " << what << " is " << actual << ", the C++ layout has "
+                      << expected << std::endl;
+            ok = false;
+        };
+
+        // The shader may declare less than the C++ side writes, but must not read past it. A trailing runtime
+        // sized array is described with one element.
+        if (std::size_t(block_size) > size)
+            report("size", size, block_size);
+
+        for (auto &&m: members) {
+            auto r = member(program, m.name);
+            if (!r.found)
+                continue;
+            if (std::size_t(r.offset) != m.offset)
+                report(m.name + " offset", m.offset, r.offset);
+            if (m.array_stride != 0u && std::size_t(r.array_stride) != m.array_stride)
+                report(m.name + " array stride", m.array_stride, r.array_stride);
+            if (m.matrix_stride != 0u && std::size_t(r.matrix_stride) != m.matrix_stride)
+                report(m.name + " matrix stride", m.matrix_stride, r.matrix_stride);
+        }
+        return ok;
+    }
+}
@@ -0,0 +1,359 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "glad/gl.h"
+#include "glm/glm.hpp"
+
+namespace xe::layout {
+
+    enum class Packing {
+        STD140, STD430
+    };
+
+    // Where a block lives, uniform blocks may only be std140.
+    enum class Interface {
+        UNIFORM, STORAGE
+    };
+
+    // String literal usable as a template argument.
+    template<std::size_t N>
+    struct name_t {
+        char chars[N]{};
+
+        consteval name_t(const char (&s)[N]) { std::copy_n(s, N, chars); }
+
+        constexpr std::string_view view() const { return {chars, N - 1}; }
+    };
+
+    template<name_t Name, typename T>
+    struct field {
+        using type = T;
+
+        static constexpr std::string_view name() { return Name.view(); }
+    };
+
+    // A GLSL struct with the given fields, also the type of a whole block. Arrays are written as T[N].
+    template<typename... Fields>
+    struct struct_t {
+    };
+
+    constexpr std::size_t round_up(std::size_t n, std::size_t alignment) {
+        return (n + alignment - 1) / alignment * alignment;
+    }
+
+    template<typename T>
+    concept glm_matrix = requires {
+        typename T::col_type;
+        typename T::value_type;
+    };
+
+    template<typename T>
+    concept glm_vector = !glm_matrix<T> && requires {
+        typename T::value_type;
+        T::length();
+    };
+
+    template<typename T>
+    concept scalar = std::is_same_v<T, float> || std::is_same_v<T, std::int32_t> ||
+                     std::is_same_v<T, std::uint32_t> || std::is_same_v<T, bool>;
+
+    /**
+     * @brief Size and base alignment of a GLSL type under the given packing rules.
+     *
+     * Arrays and matrices also have the distance between consecutive elements or columns (`stride`), structs
+     * the offsets of their fields. Everything is a compile time constant.
+     */
+    template<Packing P, typename T>
+    struct type_info;
+
+    template<Packing P, scalar T>
+    struct type_info<P, T> {
+        // bool is stored as a 32-bit integer.
+        static constexpr std::size_t size = 4u;
+        static constexpr std::size_t align = 4u;
+    };
+
+    template<Packing P, glm_vector T>
+    struct type_info<P, T> {
+        static_assert(sizeof(typename T::value_type) == 4u, "only 32-bit components are supported");
+        static constexpr std::size_t size = 4u * T::length();
+        // vec3 is aligned like vec4.
+        static constexpr std::size_t align = 4u * (T::length() == 3 ? 4u : T::length());
+    };
+
+    // Column major, each column is laid out like an array element.
+    template<Packing P, glm_matrix T>
+    struct type_info<P, T> {
+        using column = type_info<P, typename T::col_type>;
+        static constexpr std::size_t columns = T::length();
+        static constexpr std::size_t stride = P == Packing::STD140 ? round_up(column::align, 16u) : column::align;
+        static constexpr std::size_t size = columns * stride;
+        static constexpr std::size_t align = stride;
+    };
+
+    template<Packing P, typename T, std::size_t N>
+    struct type_info<P, T[N]> {
+        using element = type_info<P, T>;
+        static constexpr std::size_t length = N;
+        // std140 rounds the element alignment up to that of a vec4.
+        static constexpr std::size_t align = P == Packing::STD140 ? round_up(element::align, 16u) : element::align;
+        static constexpr std::size_t stride = round_up(element::size, align);
+        static constexpr std::size_t size = N * stride;
+    };
+
+    template<Packing P, typename... Fields>
+    struct type_info<P, struct_t<Fields...>> {
+        static constexpr std::size_t count = sizeof...(Fields);
+
+        // Field offsets followed by the end of the last field.
+        static constexpr std::array<std::size_t, count + 1> bounds = [] {
+            std::array<std::size_t, count + 1> result{};
+            std::size_t at = 0u, i = 0u;
+            ((at = round_up(at, type_info<P, typename Fields::type>::align),
+                    result[i++] = at,
+                    at += type_info<P, typename Fields::type>::size), ...);
+            result[count] = at;
+            return result;
+        }();
+
+        static constexpr std::array<std::size_t, count> offsets = [] {
+            std::array<std::size_t, count> result{};
+            std::copy_n(bounds.begin(), count, result.begin());
+            return result;
+        }();
+
+        static constexpr std::size_t align = [] {
+            std::size_t a = std::max({std::size_t(4u), type_info<P, typename Fields::type>::align...});
+            return P == Packing::STD140 ? round_up(a, 16u) : a;
+        }();
+
+        // Rounded up to the alignment, as for an array element or a following member.
+        static constexpr std::size_t size = round_up(bounds[count], align);
+
+        static constexpr std::array<std::string_view, count> names{Fields::name()...};
+
+        // Index of the field called `name`, `count` if there is none.
+        static constexpr std::size_t index(std::string_view name) {
+            for (std::size_t i = 0; i < count; ++i)
+                if (names[i] == name)
+                    return i;
+            return count;
+        }
+
+        template<std::size_t I>
+        using field_type = std::tuple_element_t<I, std::tuple<typename Fields::type...>>;
+    };
+
+    template<Packing P, typename T>
+    constexpr std::size_t size_of = type_info<P, T>::size;
+
+    // Offset of the field `Name` of the struct T.
+    template<Packing P, typename T, name_t Name>
+    constexpr std::size_t offset_of = [] {
+        constexpr auto i = type_info<P, T>::index(Name.view());
+        static_assert(i < type_info<P, T>::count, "no field with this name");
+        return type_info<P, T>::offsets[i];
+    }();
+
+    // Copies one value of GLSL type T to `dst` in the given packing. Arrays take a span of elements.
+    template<Packing P, typename T, typename V>
+    void store(std::byte *dst, const V &value) {
+        if constexpr (std::is_same_v<T, bool>) {
+            std::uint32_t v = value ? 1u : 0u;
+            std::memcpy(dst, &v, sizeof(v));
+        } else if constexpr (scalar<T>) {
+            auto v = static_cast<T>(value);
+            std::memcpy(dst, &v, sizeof(v));
+        } else if constexpr (glm_vector<T>) {
+            T v(value);
+            std::memcpy(dst, &v[0], type_info<P, T>::size);
+        } else if constexpr (glm_matrix<T>) {
+            using info = type_info<P, T>;
+            T m(value);
+            for (std::size_t c = 0; c < info::columns; ++c)
+                std::memcpy(dst + c * info::stride, &m[c][0], info::column::size);
+        } else if constexpr (std::is_array_v<T>) {
+            using info = type_info<P, T>;
+            std::span elements(value);
+            auto n = std::min<std::size_t>(elements.size(), info::length);
+            for (std::size_t i = 0; i < n; ++i)
+                store<P, std::remove_extent_t<T>>(dst + i * info::stride, elements[i]);
+        } else {
+            static_assert(sizeof(T) == 0, "structs are written field by field through a view");
+        }
+    }
+
+    template<Packing P, typename T>
+    class view;
+
+    /**
+     * @brief Typed access to a struct in a block's memory.
+     *
+     * Fields are named by string literals, e.g. `view.set<"N">(normal_matrix)`; an unknown name or a mismatched
+     * value type is a compile error.
+     */
+    template<Packing P, typename... Fields>
+    class view<P, struct_t<Fields...>> {
+    public:
+        using type = struct_t<Fields...>;
+        using info = type_info<P, type>;
+
+        explicit view(std::byte *data) : data_(data) {}
+
+        template<name_t Name>
+        static constexpr std::size_t offset() { return offset_of<P, type, Name>; }
+
+        template<name_t Name>
+        using field_type = typename info::template field_type<info::index(Name.view())>;
+
+        template<name_t Name, typename V>
+        void set(const V &value) { store<P, field_type<Name>>(data_ + offset<Name>(), value); }
+
+        // Element i of an array field.
+        template<name_t Name, typename V>
+        void set(std::size_t i, const V &value) {
+            using A = field_type<Name>;
+            static_assert(std::is_array_v<A>, "not an array");
+            store<P, std::remove_extent_t<A>>(data_ + offset<Name>() + i * type_info<P, A>::stride, value);
+        }
+
+        // Element i of an array of structs.
+        template<name_t Name>
+        auto at(std::size_t i) const {
+            using A = field_type<Name>;
+            static_assert(std::is_array_v<A>, "not an array");
+            return view<P, std::remove_extent_t<A>>(data_ + offset<Name>() + i * type_info<P, A>::stride);
+        }
+
+        // A nested struct field.
+        template<name_t Name>
+        auto member() const { return view<P, field_type<Name>>(data_ + offset<Name>()); }
+
+        std::byte *data() const { return data_; }
+
+    private:
+        std::byte *data_;
+    };
+
+    // A member as reported by program introspection, see `check_block`.
+    struct member_t {
+        std::string name;
+        std::size_t offset;
+        std::size_t array_stride;
+        std::size_t matrix_stride;
+    };
+
+    template<Packing P, typename... Fields>
+    void collect_struct_members(const std::string &name, std::size_t offset, std::vector<member_t> &members,
+                                struct_t<Fields...> *);
+
+    // Lists the members of T the way OpenGL names them: struct fields joined with '.', arrays of basic types
+    // as "name[0]", arrays of structs expanded for their first two elements so the stride is checked too.
+    template<Packing P, typename T>
+    void collect_members(const std::string &name, std::size_t offset, std::vector<member_t> &members) {
+        if constexpr (scalar<T> || glm_vector<T>) {
+            members.push_back({name, offset, 0u, 0u});
+        } else if constexpr (glm_matrix<T>) {
+            members.push_back({name, offset, 0u, type_info<P, T>::stride});
+        } else if constexpr (std::is_array_v<T>) {
+            using E = std::remove_extent_t<T>;
+            using info = type_info<P, T>;
+            if constexpr (scalar<E> || glm_vector<E> || glm_matrix<E>) {
+                std::size_t matrix_stride = 0u;
+                if constexpr (glm_matrix<E>)
+                    matrix_stride = type_info<P, E>::stride;
+                members.push_back({name + "[0]", offset, info::stride, matrix_stride});
+            } else {
+                for (std::size_t i = 0; i < std::min<std::size_t>(info::length, 2u); ++i)
+                    collect_members<P, E>(name + "[" + std::to_string(i) + "]", offset + i * info::stride, members);
+            }
+        } else {
+            collect_struct_members<P>(name, offset, members, static_cast<T *>(nullptr));
+        }
+    }
+
+    template<Packing P, typename... Fields>
+    void collect_struct_members(const std::string &name, std::size_t offset, std::vector<member_t> &members,
+                                struct_t<Fields...> *) {
+        using info = type_info<P, struct_t<Fields...>>;
+        std::size_t i = 0;
+        ((collect_members<P, typename Fields::type>(
+                name.empty() ? std::string(Fields::name()) : name + "." + std::string(Fields::name()),
+                offset + info::offsets[i++], members)), ...);
+    }
+
+    /**
+     * @brief Compares a block layout with the one the driver reports for `program`.
+     *
+     * Every mismatch is logged. A block the program does not use, and members optimised away, are not errors.
+     * Storage blocks are only checked from OpenGL 4.3.
+     */
+    bool check_block(GLuint program, const std::string &block, Interface interface, std::size_t size,
+                     std::span<const member_t> members);
+
+    // Storage of a Block, a base so it is constructed before the view pointing into it.
+    template<std::size_t N>
+    struct block_storage_t {
+        std::array<std::byte, N> storage_{};
+    };
+
+    /**
+     * @brief CPU copy of a whole block laid out by the packing rules.
+     *
+     * The fields are set through the view interface, then the block is sent with one `upload` call.
+     */
+    template<Packing P, typename... Fields>
+    class Block : private block_storage_t<type_info<P, struct_t<Fields...>>::size>,
+                  public view<P, struct_t<Fields...>> {
+    public:
+        using type = struct_t<Fields...>;
+        static constexpr std::size_t SIZE = type_info<P, type>::size;
+
+        Block() : view<P, type>(this->storage_.data()) {}
+
+        Block(const Block &other) : block_storage_t<SIZE>(other), view<P, type>(this->storage_.data()) {}
+
+        Block &operator=(const Block &other) {
+            this->storage_ = other.storage_;
+            return *this;
+        }
+
+        const std::byte *data() const { return this->storage_.data(); }
+
+        static constexpr std::size_t size() { return SIZE; }
+
+        // Writes the block to the buffer bound to `target`.
+        void upload(GLenum target, GLintptr offset = 0) const {
+            glBufferSubData(target, offset, SIZE, this->storage_.data());
+        }
+
+        static std::vector<member_t> members() {
+            std::vector<member_t> result;
+            collect_members<P, type>("", 0u, result);
+            return result;
+        }
+
+        static bool check(GLuint program, const std::string &block,
+                          Interface interface = P == Packing::STD140 ? Interface::UNIFORM : Interface::STORAGE) {
+            auto list = members();
+            return check_block(program, block, interface, SIZE, list);
+        }
+    };
+
+    template<typename... Fields>
+    using std140_block = Block<Packing::STD140, Fields...>;
+
+    template<typename... Fields>
+    using std430_block = Block<Packing::STD430, Fields...>;
+}
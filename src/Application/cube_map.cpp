@@ -0,0 +1,186 @@
+#include "cube_map.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define XE_CUBE_SSE 1
+#endif
+
+#include "glm/glm.hpp"
+#include "stb/stb_image_write.h"
+
+#include "thread_pool.h"
+
+namespace {
+    constexpr float PI = 3.14159265358979f;
+    // Taps per face texel side, reached only next to the poles.
+    constexpr int MAX_TAPS = 8;
+
+    const char *const FACE_NAMES[6] = {"px", "nx", "py", "ny", "pz", "nz"};
+
+    // Direction through the face coordinates s, t in [-1, 1], inverting the cube map face selection table of
+    // the GL specification.
+    glm::vec3 face_direction(std::size_t face, float s, float t) {
+        switch (face) {
+            case 0:
+                return {1.0f, -t, -s};
+            case 1:
+                return {-1.0f, -t, s};
+            case 2:
+                return {s, 1.0f, t};
+            case 3:
+                return {s, -1.0f, -t};
+            case 4:
+                return {s, -t, 1.0f};
+            default:
+                return {-s, -t, -1.0f};
+        }
+    }
+
+    std::uint8_t to_byte(float value) {
+        return std::uint8_t(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+    }
+
+    struct sampler_t {
+        const xe::image_t &image;
+        // Byte to [0, 1], in linear space for sRGB images.
+        std::array<float, 256> decode;
+
+        // Sum of `weight` times the bilinear tap at (u, v) in texels added to `sum`, RGBA. Wraps around in u,
+        // clamps in v.
+        void tap(float u, float v, float weight, float *sum) const {
+            auto w = image.width, h = image.height;
+            u -= 0.5f;
+            v = std::clamp(v - 0.5f, 0.0f, float(h - 1));
+            auto x0 = int(std::floor(u));
+            auto y0 = int(v);
+            auto fx = u - float(x0);
+            auto fy = v - float(y0);
+            x0 = ((x0 % w) + w) % w;
+            auto x1 = x0 + 1 == w ? 0 : x0 + 1;
+            auto y1 = std::min(y0 + 1, h - 1);
+            const std::uint8_t *p[4] = {image.pixels.data() + (std::size_t(y0) * w + x0) * 4u,
+                                        image.pixels.data() + (std::size_t(y0) * w + x1) * 4u,
+                                        image.pixels.data() + (std::size_t(y1) * w + x0) * 4u,
+                                        image.pixels.data() + (std::size_t(y1) * w + x1) * 4u};
+            const float weights[4] = {weight * (1.0f - fx) * (1.0f - fy), weight * fx * (1.0f - fy),
+                                      weight * (1.0f - fx) * fy, weight * fx * fy};
+#ifdef XE_CUBE_SSE
+            auto acc = _mm_loadu_ps(sum);
+            for (std::size_t i = 0; i < 4u; ++i) {
+                auto texel = _mm_setr_ps(decode[p[i][0]], decode[p[i][1]], decode[p[i][2]],
+                                         float(p[i][3]) * (1.0f / 255.0f));
+                acc = _mm_add_ps(acc, _mm_mul_ps(texel, _mm_set1_ps(weights[i])));
+            }
+            _mm_storeu_ps(sum, acc);
+#else
+            for (std::size_t i = 0; i < 4u; ++i) {
+                for (std::size_t c = 0; c < 3u; ++c)
+                    sum[c] += weights[i] * decode[p[i][c]];
+                sum[3] += weights[i] * float(p[i][3]) * (1.0f / 255.0f);
+            }
+#endif
+        }
+    };
+
+    void resample_row(const sampler_t &sampler, bool srgb, std::size_t face, GLsizei size, GLsizei row,
+                      std::uint8_t *out) {
+        auto w = float(sampler.image.width), h = float(sampler.image.height);
+        auto texel = 2.0f / float(size);
+        auto t = (float(row) + 0.5f) * texel - 1.0f;
+        for (GLsizei x = 0; x < size; ++x) {
+            auto s = (float(x) + 0.5f) * texel - 1.0f;
+            auto d = face_direction(face, s, t);
+            auto length = glm::length(d);
+            auto latitude = std::asin(std::clamp(d.y / length, -1.0f, 1.0f));
+
+            // Image texels across the angle a face texel subtends, the columns widen as 1 / cos(latitude).
+            auto angle = texel / length;
+            auto columns = angle * w / (2.0f * PI) / std::max(std::cos(latitude), 1.0f / w);
+            auto rows = angle * h / PI;
+            auto n = std::clamp(int(std::ceil(std::max(columns, rows))), 1, MAX_TAPS);
+
+            float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+            auto weight = 1.0f / float(n * n);
+            for (int j = 0; j < n; ++j)
+                for (int i = 0; i < n; ++i) {
+                    auto ds = texel * ((float(i) + 0.5f) / float(n) - 0.5f);
+                    auto dt = texel * ((float(j) + 0.5f) / float(n) - 0.5f);
+                    auto dir = glm::normalize(face_direction(face, s + ds, t + dt));
+                    auto u = (0.5f + std::atan2(dir.x, -dir.z) / (2.0f * PI)) * w;
+                    auto v = (0.5f + std::asin(std::clamp(dir.y, -1.0f, 1.0f)) / PI) * h;
+                    sampler.tap(u, v, weight, sum);
+                }
+
+            for (std::size_t c = 0; c < 3u; ++c)
+                out[4u * std::size_t(x) + c] = srgb ? xe::linear_to_srgb(sum[c]) : to_byte(sum[c]);
+            out[4u * std::size_t(x) + 3u] = to_byte(sum[3]);
+        }
+    }
+}
+
+namespace xe {
+
+    std::size_t cube_map_t::size() const {
+        std::size_t bytes = 0u;
+        for (auto &&face: faces)
+            bytes += face.size();
+        return bytes;
+    }
+
+    GLsizei cube_face_size(GLsizei width) {
+        return std::max(width / 4, 1);
+    }
+
+    cube_map_t equirect_to_cube(const image_t &equirect, GLsizei face_size, bool srgb) {
+        cube_map_t cube;
+        if (equirect.empty() || face_size <= 0)
+            return cube;
+
+        sampler_t sampler{equirect, {}};
+        for (std::size_t i = 0; i < 256u; ++i)
+            sampler.decode[i] = srgb ? srgb_to_linear(std::uint8_t(i)) : float(i) / 255.0f;
+
+        std::array<image_t, 6> faces;
+        for (auto &&face: faces) {
+            face.width = face.height = face_size;
+            face.pixels.resize(std::size_t(face_size) * std::size_t(face_size) * 4u);
+        }
+        auto row_bytes = std::size_t(face_size) * 4u;
+        thread_pool().parallel_for(6u * std::size_t(face_size), [&](std::size_t begin, std::size_t end) {
+            for (auto r = begin; r < end; ++r) {
+                auto face = r / std::size_t(face_size);
+                auto row = GLsizei(r % std::size_t(face_size));
+                auto out = faces[face].pixels.data() + std::size_t(row) * row_bytes;
+                resample_row(sampler, srgb, face, face_size, row, out);
+            }
+        }, 4u);
+
+        for (std::size_t f = 0; f < 6u; ++f)
+            cube.faces[f] = generate_mips(std::move(faces[f]), srgb);
+        return cube;
+    }
+
+    cube_map_t load_equirect_cube(const std::string &path, GLsizei face_size, bool srgb) {
+        auto image = load_image(path);
+        if (image.empty())
+            return {};
+        return equirect_to_cube(image, face_size > 0 ? face_size : cube_face_size(image.width), srgb);
+    }
+
+    bool write_cube_faces(const cube_map_t &cube, const std::string &prefix) {
+        if (cube.empty())
+            return false;
+        stbi_flip_vertically_on_write(0);
+        for (std::size_t f = 0; f < 6u; ++f) {
+            auto &face = cube.faces[f].levels.front();
+            auto path = prefix + "_" + FACE_NAMES[f] + ".png";
+            if (!stbi_write_png(path.c_str(), face.width, face.height, 4, face.pixels.data(), face.width * 4))
+                return false;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <string>
+
+#include "glad/gl.h"
+
+#include "mip_chain.h"
+
+namespace xe {
+
+    // Faces of a cube map in the GL order: +X, -X, +Y, -Y, +Z, -Z. Rows of a face go along t of the GL cube map
+    // face table, like the rows of image_t.
+    struct cube_map_t {
+        std::array<mip_chain_t, 6> faces;
+
+        bool empty() const { return faces[0].empty(); }
+
+        // Bytes of all the levels of all the faces.
+        std::size_t size() const;
+    };
+
+    // Face size that keeps the texel density of an equirectangular image of `width` at the equator, a quarter of
+    // the width. The faces then hold 3/8 of the texels the image has, instead of 1/2.
+    GLsizei cube_face_size(GLsizei width);
+
+    /**
+     * @brief Resamples an equirectangular image into the faces of a cube map, with mips.
+     *
+     * The image covers longitudes [-pi, pi) along its width, the middle column looks down -Z, and latitudes
+     * [-pi/2, pi/2] along its height, the last row is +Y. Every face texel averages bilinear taps spread over
+     * its footprint in the image, more of them towards the poles where a texel covers many image columns, so the
+     * poles are filtered rather than aliased. With `srgb` the taps are averaged in linear space. Rows of all faces
+     * are resampled in parallel on the thread pool, with SSE2 where it is available.
+     */
+    cube_map_t equirect_to_cube(const image_t &equirect, GLsizei face_size, bool srgb);
+
+    // Loads an equirectangular image and converts it, with cube_face_size when `face_size` is 0. Returns an empty
+    // cube map when the image cannot be read.
+    cube_map_t load_equirect_cube(const std::string &path, GLsizei face_size = 0, bool srgb = true);
+
+    // Writes the first level of every face as `<prefix>_px.png`, `_nx`, `_py`, `_ny`, `_pz` and `_nz`, for
+    // baking the conversion offline. The first row of a face is the top of its file, the usual layout of cube map
+    // face images.
+    bool write_cube_faces(const cube_map_t &cube, const std::string &prefix);
+}
@@ -0,0 +1,164 @@
+#include "Application/gl_resource.h"
+
+#include "Application/gl_state.h"
+
+#include <iomanip>
+#include <string>
+
+namespace xe {
+
+    std::string resource_name(GLResource type) {
+        switch (type) {
+            case GLResource::BUFFER:
+                return "Buffer";
+            case GLResource::VERTEX_ARRAY:
+                return "Vertex array";
+            case GLResource::TEXTURE:
+                return "Texture";
+            case GLResource::PROGRAM:
+                return "Program";
+            case GLResource::FRAMEBUFFER:
+                return "Framebuffer";
+            case GLResource::RENDERBUFFER:
+                return "Renderbuffer";
+            case GLResource::QUERY:
+                return "Query";
+            default:
+                return "Unknown";
+        }
+    }
+
+    std::size_t GPUMemoryRegistry::total_bytes() const {
+        std::size_t total = 0;
+        for (auto b: bytes_)
+            total += b;
+        return total;
+    }
+
+    void GPUMemoryRegistry::report(std::ostream &out) const {
+        for (std::size_t i = 0; i < bytes_.size(); ++i) {
+            out << std::setw(14) << std::left << resource_name(static_cast<GLResource>(i))
+                << std::setw(6) << std::right << count_[i] << " objects "
+                << std::setw(10) << bytes_[i] / 1024 << " KiB\n";
+        }
+        out << std::setw(14) << std::left << "Total" << std::setw(24) << std::right << total_bytes() / 1024
+            << " KiB\n";
+    }
+
+    // Both singletons are intentionally leaked: handles with static storage duration may still push into
+    // the queue while the program exits.
+    GPUMemoryRegistry &gpu_memory() {
+        static auto registry = new GPUMemoryRegistry;
+        return *registry;
+    }
+
+    DeletionQueue &deletion_queue() {
+        static auto queue = new DeletionQueue;
+        return *queue;
+    }
+
+    GLuint gl_create(GLResource type) {
+        GLuint name = 0u;
+        switch (type) {
+            case GLResource::BUFFER:
+                glGenBuffers(1, &name);
+                break;
+            case GLResource::VERTEX_ARRAY:
+                glGenVertexArrays(1, &name);
+                break;
+            case GLResource::TEXTURE:
+                glGenTextures(1, &name);
+                break;
+            case GLResource::PROGRAM:
+                name = glCreateProgram();
+                break;
+            case GLResource::FRAMEBUFFER:
+                glGenFramebuffers(1, &name);
+                break;
+            case GLResource::RENDERBUFFER:
+                glGenRenderbuffers(1, &name);
+                break;
+            case GLResource::QUERY:
+                glGenQueries(1, &name);
+                break;
+            default:
+                break;
+        }
+        return name;
+    }
+
+    void gl_delete(GLResource type, GLuint name) {
+        gl_state().forget(type, name);
+        switch (type) {
+            case GLResource::BUFFER:
+                glDeleteBuffers(1, &name);
+                break;
+            case GLResource::VERTEX_ARRAY:
+                glDeleteVertexArrays(1, &name);
+                break;
+            case GLResource::TEXTURE:
+                glDeleteTextures(1, &name);
+                break;
+            case GLResource::PROGRAM:
+                glDeleteProgram(name);
+                break;
+            case GLResource::FRAMEBUFFER:
+                glDeleteFramebuffers(1, &name);
+                break;
+            case GLResource::RENDERBUFFER:
+                glDeleteRenderbuffers(1, &name);
+                break;
+            case GLResource::QUERY:
+                glDeleteQueries(1, &name);
+                break;
+            default:
+                break;
+        }
+    }
+
+    void DeletionQueue::push(GLResource type, GLuint name, std::size_t bytes) {
+        current_.push_back({type, name, bytes});
+    }
+
+    void DeletionQueue::end_frame() {
+        if (!current_.empty()) {
+            auto fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            in_flight_.push_back({fence, std::move(current_)});
+            current_.clear();
+        }
+        collect();
+    }
+
+    void DeletionQueue::collect(bool wait) {
+        while (!in_flight_.empty()) {
+            auto &batch = in_flight_.front();
+            auto status = glClientWaitSync(batch.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+                                           wait ? GL_TIMEOUT_IGNORED : 0u);
+            if (status == GL_TIMEOUT_EXPIRED)
+                break;
+            glDeleteSync(batch.fence);
+            destroy(batch.entries);
+            in_flight_.pop_front();
+        }
+    }
+
+    void DeletionQueue::flush() {
+        end_frame();
+        collect(true);
+    }
+
+    std::size_t DeletionQueue::pending() const {
+        auto n = current_.size();
+        for (auto &&batch: in_flight_)
+            n += batch.entries.size();
+        return n;
+    }
+
+    void DeletionQueue::destroy(const std::vector<entry_t> &entries) {
+        for (auto &&e: entries) {
+            gl_delete(e.type, e.name);
+            gpu_memory().release(e.type, e.bytes);
+            gpu_memory().deleted(e.type);
+        }
+    }
+}
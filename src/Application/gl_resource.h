@@ -0,0 +1,163 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "glad/gl.h"
+
+namespace xe {
+
+    enum class GLResource {
+        BUFFER, VERTEX_ARRAY, TEXTURE, PROGRAM, FRAMEBUFFER, RENDERBUFFER, QUERY, COUNT
+    };
+
+    std::string resource_name(GLResource type);
+
+    /**
+     * @brief Bookkeeping of the GPU memory owned by the GL handles.
+     *
+     * Sizes are the ones requested by the engine (buffer sizes, texel data), not what the driver really allocates.
+     */
+    class GPUMemoryRegistry {
+    public:
+        void created(GLResource type) { ++count_[index(type)]; }
+
+        void deleted(GLResource type) { --count_[index(type)]; }
+
+        void allocate(GLResource type, std::size_t bytes) { bytes_[index(type)] += bytes; }
+
+        void release(GLResource type, std::size_t bytes) { bytes_[index(type)] -= bytes; }
+
+        std::size_t bytes(GLResource type) const { return bytes_[index(type)]; }
+
+        std::size_t count(GLResource type) const { return count_[index(type)]; }
+
+        std::size_t total_bytes() const;
+
+        void report(std::ostream &out) const;
+
+    private:
+        static std::size_t index(GLResource type) { return static_cast<std::size_t>(type); }
+
+        std::array<std::size_t, static_cast<std::size_t>(GLResource::COUNT)> bytes_{};
+        std::array<std::size_t, static_cast<std::size_t>(GLResource::COUNT)> count_{};
+    };
+
+    GPUMemoryRegistry &gpu_memory();
+
+    /**
+     * @brief Defers glDelete* calls until the GPU is done with the frames that could still use the object.
+     *
+     * Objects released during a frame are fenced by `end_frame` and deleted once that fence has signalled.
+     */
+    class DeletionQueue {
+    public:
+        void push(GLResource type, GLuint name, std::size_t bytes);
+
+        void end_frame();
+
+        // Deletes every batch whose fence has signalled. With wait=true blocks until all of them have.
+        void collect(bool wait = false);
+
+        void flush();
+
+        std::size_t pending() const;
+
+    private:
+        struct entry_t {
+            GLResource type;
+            GLuint name;
+            std::size_t bytes;
+        };
+
+        struct batch_t {
+            GLsync fence;
+            std::vector<entry_t> entries;
+        };
+
+        static void destroy(const std::vector<entry_t> &entries);
+
+        std::vector<entry_t> current_;
+        std::deque<batch_t> in_flight_;
+    };
+
+    DeletionQueue &deletion_queue();
+
+    GLuint gl_create(GLResource type);
+
+    void gl_delete(GLResource type, GLuint name);
+
+    /**
+     * @brief Move-only owner of an OpenGL object name.
+     *
+     * The object is not deleted immediately on destruction but handed to the `deletion_queue`.
+     */
+    template<GLResource T>
+    class GLHandle {
+    public:
+        static GLHandle create() { return GLHandle(gl_create(T)); }
+
+        GLHandle() = default;
+
+        explicit GLHandle(GLuint name) : name_(name) {
+            if (name_ != 0u)
+                gpu_memory().created(T);
+        }
+
+        GLHandle(const GLHandle &) = delete;
+
+        GLHandle &operator=(const GLHandle &) = delete;
+
+        GLHandle(GLHandle &&other) noexcept: name_(std::exchange(other.name_, 0u)),
+                                             bytes_(std::exchange(other.bytes_, 0u)) {}
+
+        GLHandle &operator=(GLHandle &&rhs) noexcept {
+            if (this != &rhs) {
+                reset();
+                name_ = std::exchange(rhs.name_, 0u);
+                bytes_ = std::exchange(rhs.bytes_, 0u);
+            }
+            return *this;
+        }
+
+        ~GLHandle() { reset(); }
+
+        GLuint get() const { return name_; }
+
+        explicit operator bool() const { return name_ != 0u; }
+
+        std::size_t size() const { return bytes_; }
+
+        // Records the number of bytes backing this object, replacing the previous value.
+        void set_size(std::size_t bytes) {
+            gpu_memory().release(T, bytes_);
+            bytes_ = bytes;
+            gpu_memory().allocate(T, bytes_);
+        }
+
+        void reset() {
+            if (name_ != 0u) {
+                deletion_queue().push(T, name_, bytes_);
+                name_ = 0u;
+                bytes_ = 0u;
+            }
+        }
+
+    private:
+        GLuint name_ = 0u;
+        std::size_t bytes_ = 0u;
+    };
+
+    using BufferHandle = GLHandle<GLResource::BUFFER>;
+    using VertexArrayHandle = GLHandle<GLResource::VERTEX_ARRAY>;
+    using TextureHandle = GLHandle<GLResource::TEXTURE>;
+    using ProgramHandle = GLHandle<GLResource::PROGRAM>;
+    using FramebufferHandle = GLHandle<GLResource::FRAMEBUFFER>;
+    using RenderbufferHandle = GLHandle<GLResource::RENDERBUFFER>;
+    using QueryHandle = GLHandle<GLResource::QUERY>;
+}
@@ -0,0 +1,263 @@
+#include "Application/gl_state.h"
+
+namespace xe {
+
+    GLStateCache &gl_state() {
+        static GLStateCache cache;
+        return cache;
+    }
+
+    GLStateCache &synced_gl_state() {
+        auto &cache = gl_state();
+        cache.invalidate();
+        return cache;
+    }
+
+    void GLStateCache::invalidate() {
+        program_ = UNKNOWN;
+        vao_ = UNKNOWN;
+        buffers_.fill(UNKNOWN);
+        for (auto &&bindings: indexed_)
+            bindings.fill({UNKNOWN, 0, 0});
+        active_unit_ = UNKNOWN;
+        for (auto &&unit: textures_)
+            unit.fill(UNKNOWN);
+        caps_.fill(UNKNOWN);
+        front_face_ = UNKNOWN;
+        cull_face_ = UNKNOWN;
+        depth_func_ = UNKNOWN;
+        depth_mask_ = UNKNOWN;
+    }
+
+    bool GLStateCache::changed(GLuint &cached, GLuint value) {
+        if (cached == value) {
+            ++stats_.skipped;
+            return false;
+        }
+        ++stats_.issued;
+        cached = value;
+        return true;
+    }
+
+    int GLStateCache::buffer_slot(GLenum target) {
+        switch (target) {
+            case GL_ARRAY_BUFFER:
+                return ARRAY;
+            case GL_ELEMENT_ARRAY_BUFFER:
+                return ELEMENT_ARRAY;
+            case GL_UNIFORM_BUFFER:
+                return UNIFORM;
+#if (MAJOR >= 4) && (MINOR >= 3)
+            case GL_SHADER_STORAGE_BUFFER:
+                return SHADER_STORAGE;
+#endif
+            case GL_PIXEL_UNPACK_BUFFER:
+                return PIXEL_UNPACK;
+            case GL_PIXEL_PACK_BUFFER:
+                return PIXEL_PACK;
+            case GL_DRAW_INDIRECT_BUFFER:
+                return DRAW_INDIRECT;
+            case GL_COPY_READ_BUFFER:
+                return COPY_READ;
+            case GL_COPY_WRITE_BUFFER:
+                return COPY_WRITE;
+            default:
+                return -1;
+        }
+    }
+
+    int GLStateCache::indexed_slot(GLenum target) {
+        switch (target) {
+            case GL_UNIFORM_BUFFER:
+                return 0;
+#if (MAJOR >= 4) && (MINOR >= 3)
+            case GL_SHADER_STORAGE_BUFFER:
+                return 1;
+#endif
+            default:
+                return -1;
+        }
+    }
+
+    int GLStateCache::texture_slot(GLenum target) {
+        switch (target) {
+            case GL_TEXTURE_2D:
+                return TEXTURE_2D;
+            case GL_TEXTURE_2D_ARRAY:
+                return TEXTURE_2D_ARRAY;
+            case GL_TEXTURE_CUBE_MAP:
+                return TEXTURE_CUBE_MAP;
+            case GL_TEXTURE_3D:
+                return TEXTURE_3D;
+            default:
+                return -1;
+        }
+    }
+
+    int GLStateCache::cap_slot(GLenum cap) {
+        switch (cap) {
+            case GL_CULL_FACE:
+                return CULL_FACE;
+            case GL_DEPTH_TEST:
+                return DEPTH_TEST;
+            case GL_BLEND:
+                return BLEND;
+            case GL_STENCIL_TEST:
+                return STENCIL_TEST;
+            case GL_SCISSOR_TEST:
+                return SCISSOR_TEST;
+            case GL_POLYGON_OFFSET_FILL:
+                return POLYGON_OFFSET_FILL;
+            case GL_FRAMEBUFFER_SRGB:
+                return FRAMEBUFFER_SRGB;
+            default:
+                return -1;
+        }
+    }
+
+    void GLStateCache::use_program(GLuint program) {
+        if (changed(program_, program))
+            glUseProgram(program);
+    }
+
+    void GLStateCache::bind_vertex_array(GLuint vao) {
+        if (changed(vao_, vao)) {
+            glBindVertexArray(vao);
+            // The element array binding is part of the vertex array object.
+            buffers_[ELEMENT_ARRAY] = UNKNOWN;
+        }
+    }
+
+    void GLStateCache::bind_buffer(GLenum target, GLuint buffer) {
+        auto slot = buffer_slot(target);
+        if (slot < 0) {
+            ++stats_.issued;
+            glBindBuffer(target, buffer);
+            return;
+        }
+        if (changed(buffers_[slot], buffer))
+            glBindBuffer(target, buffer);
+    }
+
+    void GLStateCache::bind_buffer_base(GLenum target, GLuint index, GLuint buffer) {
+        auto slot = indexed_slot(target);
+        if (slot < 0 || index >= MAX_BUFFER_BINDINGS) {
+            ++stats_.issued;
+            glBindBufferBase(target, index, buffer);
+            return;
+        }
+        range_t range{buffer, 0, 0};
+        if (indexed_[slot][index] == range) {
+            ++stats_.skipped;
+            return;
+        }
+        ++stats_.issued;
+        indexed_[slot][index] = range;
+        glBindBufferBase(target, index, buffer);
+        // glBindBufferBase also binds the buffer to the generic binding point.
+        buffers_[buffer_slot(target)] = buffer;
+    }
+
+    void GLStateCache::bind_buffer_range(GLenum target, GLuint index, GLuint buffer, GLintptr offset,
+                                         GLsizeiptr size) {
+        auto slot = indexed_slot(target);
+        if (slot < 0 || index >= MAX_BUFFER_BINDINGS) {
+            ++stats_.issued;
+            glBindBufferRange(target, index, buffer, offset, size);
+            return;
+        }
+        range_t range{buffer, offset, size};
+        if (indexed_[slot][index] == range) {
+            ++stats_.skipped;
+            return;
+        }
+        ++stats_.issued;
+        indexed_[slot][index] = range;
+        glBindBufferRange(target, index, buffer, offset, size);
+        buffers_[buffer_slot(target)] = buffer;
+    }
+
+    void GLStateCache::active_texture(GLuint unit) {
+        if (changed(active_unit_, unit))
+            glActiveTexture(GL_TEXTURE0 + unit);
+    }
+
+    void GLStateCache::bind_texture(GLuint unit, GLenum target, GLuint texture) {
+        auto slot = texture_slot(target);
+        if (slot < 0 || unit >= MAX_TEXTURE_UNITS) {
+            active_texture(unit);
+            ++stats_.issued;
+            glBindTexture(target, texture);
+            return;
+        }
+        if (textures_[unit][slot] == texture) {
+            ++stats_.skipped;
+            return;
+        }
+        active_texture(unit);
+        changed(textures_[unit][slot], texture);
+        glBindTexture(target, texture);
+    }
+
+    void GLStateCache::set(GLenum cap, bool enabled) {
+        auto slot = cap_slot(cap);
+        if (slot >= 0 && !changed(caps_[slot], enabled))
+            return;
+        if (slot < 0)
+            ++stats_.issued;
+        if (enabled)
+            glEnable(cap);
+        else
+            glDisable(cap);
+    }
+
+    void GLStateCache::front_face(GLenum mode) {
+        if (changed(front_face_, mode))
+            glFrontFace(mode);
+    }
+
+    void GLStateCache::cull_face(GLenum mode) {
+        if (changed(cull_face_, mode))
+            glCullFace(mode);
+    }
+
+    void GLStateCache::depth_func(GLenum func) {
+        if (changed(depth_func_, func))
+            glDepthFunc(func);
+    }
+
+    void GLStateCache::depth_mask(GLboolean flag) {
+        if (changed(depth_mask_, flag))
+            glDepthMask(flag);
+    }
+
+    void GLStateCache::forget(GLResource type, GLuint name) {
+        switch (type) {
+            case GLResource::PROGRAM:
+                if (program_ == name)
+                    program_ = UNKNOWN;
+                break;
+            case GLResource::VERTEX_ARRAY:
+                if (vao_ == name)
+                    vao_ = UNKNOWN;
+                break;
+            case GLResource::BUFFER:
+                for (auto &&b: buffers_)
+                    if (b == name)
+                        b = UNKNOWN;
+                for (auto &&bindings: indexed_)
+                    for (auto &&r: bindings)
+                        if (r.buffer == name)
+                            r.buffer = UNKNOWN;
+                break;
+            case GLResource::TEXTURE:
+                for (auto &&unit: textures_)
+                    for (auto &&t: unit)
+                        if (t == name)
+                            t = UNKNOWN;
+                break;
+            default:
+                break;
+        }
+    }
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+#include "glad/gl.h"
+
+#include "Application/gl_resource.h"
+
+namespace xe {
+
+    /**
+     * @brief Shadow copy of the OpenGL state touched by the engine.
+     *
+     * Calls that would not change the state are not forwarded to OpenGL but counted as skipped.
+     * All code that binds objects must go through the cache, or call `invalidate` after changing the state
+     * behind its back.
+     */
+    class GLStateCache {
+    public:
+        static constexpr GLuint MAX_TEXTURE_UNITS = 32u;
+        static constexpr GLuint MAX_BUFFER_BINDINGS = 16u;
+
+        struct stats_t {
+            std::size_t issued = 0;
+            std::size_t skipped = 0;
+        };
+
+        GLStateCache() { invalidate(); }
+
+        void use_program(GLuint program);
+
+        void bind_vertex_array(GLuint vao);
+
+        void bind_buffer(GLenum target, GLuint buffer);
+
+        void bind_buffer_base(GLenum target, GLuint index, GLuint buffer);
+
+        void bind_buffer_range(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+        void active_texture(GLuint unit);
+
+        void bind_texture(GLuint unit, GLenum target, GLuint texture);
+
+        void set(GLenum cap, bool enabled);
+
+        void enable(GLenum cap) { set(cap, true); }
+
+        void disable(GLenum cap) { set(cap, false); }
+
+        void front_face(GLenum mode);
+
+        void cull_face(GLenum mode);
+
+        void depth_func(GLenum func);
+
+        void depth_mask(GLboolean flag);
+
+        GLuint program() const { return program_; }
+
+        GLuint vertex_array() const { return vao_; }
+
+        // Forgets everything, the next call of every kind goes through to OpenGL.
+        void invalidate();
+
+        // Drops references to a deleted object, so a recycled name is not mistaken for a bound one.
+        void forget(GLResource type, GLuint name);
+
+        const stats_t &stats() const { return stats_; }
+
+        void reset_stats() { stats_ = {}; }
+
+    private:
+        static constexpr GLuint UNKNOWN = ~0u;
+
+        enum buffer_target_t {
+            ARRAY, ELEMENT_ARRAY, UNIFORM, SHADER_STORAGE, PIXEL_UNPACK, PIXEL_PACK, DRAW_INDIRECT, COPY_READ,
+            COPY_WRITE, N_BUFFER_TARGETS
+        };
+        enum texture_target_t {
+            TEXTURE_2D, TEXTURE_2D_ARRAY, TEXTURE_CUBE_MAP, TEXTURE_3D, N_TEXTURE_TARGETS
+        };
+        enum cap_t {
+            CULL_FACE, DEPTH_TEST, BLEND, STENCIL_TEST, SCISSOR_TEST, POLYGON_OFFSET_FILL, FRAMEBUFFER_SRGB,
+            N_CAPS
+        };
+
+        struct range_t {
+            GLuint buffer;
+            GLintptr offset;
+            GLsizeiptr size;
+
+            bool operator==(const range_t &) const = default;
+        };
+
+        static int buffer_slot(GLenum target);
+
+        static int indexed_slot(GLenum target);
+
+        static int texture_slot(GLenum target);
+
+        static int cap_slot(GLenum cap);
+
+        bool changed(GLuint &cached, GLuint value);
+
+        GLuint program_;
+        GLuint vao_;
+        std::array<GLuint, N_BUFFER_TARGETS> buffers_;
+        std::array<std::array<range_t, MAX_BUFFER_BINDINGS>, 2> indexed_;
+        GLuint active_unit_;
+        std::array<std::array<GLuint, N_TEXTURE_TARGETS>, MAX_TEXTURE_UNITS> textures_;
+        std::array<GLuint, N_CAPS> caps_;
+        GLuint front_face_;
+        GLuint cull_face_;
+        GLuint depth_func_;
+        GLuint depth_mask_;
+
+        stats_t stats_;
+    };
+
+    GLStateCache &gl_state();
+
+    // The cache after `invalidate`, for entry points called by code that binds objects directly, like the Engine
+    // library and the assignments built on it.
+    GLStateCache &synced_gl_state();
+}
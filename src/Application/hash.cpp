@@ -0,0 +1,28 @@
+#include "hash.h"
+
+#include <system_error>
+
+namespace xe {
+
+    std::uint64_t hash_bytes(const void *data, std::size_t size, std::uint64_t seed) {
+        auto bytes = static_cast<const unsigned char *>(data);
+        auto hash = seed;
+        for (std::size_t i = 0; i < size; ++i) {
+            hash ^= bytes[i];
+            hash *= 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    std::uint64_t hash_file_stamp(const std::filesystem::path &path, std::uint64_t seed) {
+        std::error_code ec;
+        auto size = std::filesystem::file_size(path, ec);
+        if (ec)
+            return 0u;
+        auto time = std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+        if (ec)
+            return 0u;
+        auto key = hash_bytes(&size, sizeof(size), seed);
+        return hash_bytes(&time, sizeof(time), key);
+    }
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+
+namespace xe {
+
+    // 64-bit FNV-1a, used for cache keys. Chain calls by passing the previous result as `seed`.
+    std::uint64_t hash_bytes(const void *data, std::size_t size, std::uint64_t seed = 0xcbf29ce484222325ull);
+
+    inline std::uint64_t hash_string(std::string_view str, std::uint64_t seed = 0xcbf29ce484222325ull) {
+        return hash_bytes(str.data(), str.size(), seed);
+    }
+
+    // Hash of the size and modification time of a file, for caches derived from it. 0 when it cannot be read.
+    std::uint64_t hash_file_stamp(const std::filesystem::path &path, std::uint64_t seed = 0xcbf29ce484222325ull);
+}
@@ -0,0 +1,229 @@
+#include "ktx2.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string_view>
+
+namespace {
+    const std::uint8_t IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+    struct header_t {
+        std::uint8_t identifier[12];
+        std::uint32_t vk_format;
+        std::uint32_t type_size;
+        std::uint32_t width;
+        std::uint32_t height;
+        std::uint32_t depth;
+        std::uint32_t layer_count;
+        std::uint32_t face_count;
+        std::uint32_t level_count;
+        std::uint32_t supercompression;
+        std::uint32_t dfd_offset;
+        std::uint32_t dfd_length;
+        std::uint32_t kvd_offset;
+        std::uint32_t kvd_length;
+        std::uint64_t sgd_offset;
+        std::uint64_t sgd_length;
+    };
+    static_assert(sizeof(header_t) == 80u);
+
+    struct level_index_t {
+        std::uint64_t offset;
+        std::uint64_t length;
+        std::uint64_t uncompressed_length;
+    };
+
+    // The VkFormat values of the supported formats.
+    struct format_t {
+        std::uint32_t vk_format;
+        bool compressed;
+        xe::BCFormat bc;
+        bool srgb;
+    };
+
+    const format_t FORMATS[] = {
+            {37u,  false, xe::BCFormat::BC1, false}, // R8G8B8A8_UNORM
+            {43u,  false, xe::BCFormat::BC1, true},  // R8G8B8A8_SRGB
+            {131u, true,  xe::BCFormat::BC1, false}, // BC1_RGB_UNORM_BLOCK
+            {132u, true,  xe::BCFormat::BC1, true},  // BC1_RGB_SRGB_BLOCK
+            {133u, true,  xe::BCFormat::BC1, false}, // BC1_RGBA_UNORM_BLOCK
+            {134u, true,  xe::BCFormat::BC1, true},  // BC1_RGBA_SRGB_BLOCK
+            {137u, true,  xe::BCFormat::BC3, false}, // BC3_UNORM_BLOCK
+            {138u, true,  xe::BCFormat::BC3, true},  // BC3_SRGB_BLOCK
+            {141u, true,  xe::BCFormat::BC5, false}, // BC5_UNORM_BLOCK
+            {145u, true,  xe::BCFormat::BC7, false}, // BC7_UNORM_BLOCK
+            {146u, true,  xe::BCFormat::BC7, true}}; // BC7_SRGB_BLOCK
+
+    std::optional<format_t> find_format(std::uint32_t vk_format) {
+        for (auto &&format: FORMATS)
+            if (format.vk_format == vk_format)
+                return format;
+        return std::nullopt;
+    }
+
+    // The KTXorientation value tells whether rows go down ("rd", the default) or up ("ru").
+    bool rows_go_up(const std::vector<char> &kvd) {
+        const std::string key = "KTXorientation";
+        std::size_t offset = 0u;
+        while (offset + 4u <= kvd.size()) {
+            std::uint32_t length = 0u;
+            std::memcpy(&length, kvd.data() + offset, 4u);
+            offset += 4u;
+            if (length > kvd.size() - offset)
+                break;
+            std::string_view entry(kvd.data() + offset, length);
+            if (entry.size() > key.size() + 1u && entry.substr(0, key.size()) == key && entry[key.size()] == '\0') {
+                auto value = entry.substr(key.size() + 1u);
+                return value.size() >= 2u && value[1] == 'u';
+            }
+            offset += (length + 3u) & ~3u;
+        }
+        return false;
+    }
+
+    // Reverses the order of the first `n` rows of 4 three bit indices in a BC4 block, as used by BC3 alpha and
+    // BC5.
+    void flip_bc4_block(std::uint8_t *block, std::uint32_t n) {
+        std::uint64_t indices = 0u;
+        std::memcpy(&indices, block + 2, 6u);
+        std::uint64_t flipped = indices;
+        for (std::uint32_t r = 0; r < n; ++r) {
+            auto row = (indices >> (12u * r)) & 0xfffu;
+            auto to = 12u * (n - 1u - r);
+            flipped = (flipped & ~(std::uint64_t(0xfffu) << to)) | (row << to);
+        }
+        std::memcpy(block + 2, &flipped, 6u);
+    }
+
+    // Flips a level of 4x4 blocks vertically. Rows are whole blocks unless the level has a single block row.
+    bool flip_blocks(xe::compressed_level_t &level, xe::BCFormat format) {
+        auto rows = std::uint32_t(level.height + 3) / 4u;
+        if (rows > 1u && level.height % 4 != 0)
+            return false;
+        auto n = std::min<std::uint32_t>(std::uint32_t(level.height), 4u);
+        auto block_size = xe::bc_block_size(format);
+        auto row_bytes = std::size_t(level.width + 3) / 4u * block_size;
+
+        for (std::uint32_t r = 0; r < rows / 2u; ++r)
+            std::swap_ranges(level.data.begin() + std::ptrdiff_t(r * row_bytes),
+                             level.data.begin() + std::ptrdiff_t((r + 1u) * row_bytes),
+                             level.data.begin() + std::ptrdiff_t((rows - 1u - r) * row_bytes));
+
+        for (std::size_t b = 0; b < level.data.size(); b += block_size) {
+            auto block = level.data.data() + b;
+            switch (format) {
+                case xe::BCFormat::BC1:
+                    // One byte of indices per row.
+                    std::reverse(block + 4, block + 4 + n);
+                    break;
+                case xe::BCFormat::BC3:
+                    flip_bc4_block(block, n);
+                    std::reverse(block + 12, block + 12 + n);
+                    break;
+                case xe::BCFormat::BC5:
+                    flip_bc4_block(block, n);
+                    flip_bc4_block(block + 8, n);
+                    break;
+                case xe::BCFormat::BC7:
+                    // Partition shapes and mode layouts do not survive a flip.
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    void flip_rows(xe::image_t &image) {
+        auto row_bytes = std::size_t(image.width) * 4u;
+        auto h = std::size_t(image.height);
+        for (std::size_t r = 0; r < h / 2u; ++r)
+            std::swap_ranges(image.pixels.begin() + std::ptrdiff_t(r * row_bytes),
+                             image.pixels.begin() + std::ptrdiff_t((r + 1u) * row_bytes),
+                             image.pixels.begin() + std::ptrdiff_t((h - 1u - r) * row_bytes));
+    }
+}
+
+namespace xe {
+
+    bool is_ktx2(const std::string &path) {
+        return std::filesystem::path(path).extension() == ".ktx2";
+    }
+
+    texture_data_t read_ktx2(const std::string &path, const texture_options_t &options) {
+        auto fail = [&path](const std::string &why) {
+            std::cerr << "Cannot use KTX2 file `" << path << "': " << why << std::endl;
+            return texture_data_t{};
+        };
+
+        std::ifstream file(path, std::ios::in | std::ios::binary);
+        if (!file)
+            return fail("cannot open it");
+        header_t header{};
+        file.read(reinterpret_cast<char *>(&header), sizeof(header));
+        if (!file || std::memcmp(header.identifier, IDENTIFIER, sizeof(IDENTIFIER)) != 0)
+            return fail("not a KTX2 file");
+        auto format = find_format(header.vk_format);
+        if (!format)
+            return fail("unsupported VkFormat " + std::to_string(header.vk_format));
+        if (header.supercompression != 0u)
+            return fail("supercompressed files are not supported");
+        if (header.width == 0u || header.height == 0u || header.depth > 1u || header.layer_count > 1u ||
+            header.face_count != 1u)
+            return fail("not a 2D texture");
+        if (format->compressed && !compression_supported(format->bc))
+            return fail("the format is not supported by the context");
+
+        auto n_stored = std::max(header.level_count, 1u);
+        std::vector<level_index_t> index(n_stored);
+        file.read(reinterpret_cast<char *>(index.data()), std::streamsize(n_stored * sizeof(level_index_t)));
+        std::vector<char> kvd(header.kvd_length);
+        file.seekg(header.kvd_offset);
+        file.read(kvd.data(), std::streamsize(kvd.size()));
+        if (!file)
+            return fail("truncated header");
+        auto flip = !rows_go_up(kvd);
+
+        // Levels beyond the first one are of no use without mipmaps.
+        auto n_levels = options.mipmaps ? n_stored : 1u;
+        texture_data_t data;
+        data.compressed.format = format->bc;
+        data.compressed.srgb = format->srgb;
+        data.chain.srgb = format->srgb;
+        for (std::uint32_t i = 0; i < n_levels; ++i) {
+            auto width = GLsizei(std::max(header.width >> i, 1u));
+            auto height = GLsizei(std::max(header.height >> i, 1u));
+            auto size = format->compressed
+                        ? (std::size_t(width + 3) / 4u) * (std::size_t(height + 3) / 4u) * bc_block_size(format->bc)
+                        : std::size_t(width) * std::size_t(height) * 4u;
+            if (index[i].length != size)
+                return fail("level " + std::to_string(i) + " has the wrong size");
+
+            std::vector<std::uint8_t> bytes(size);
+            file.seekg(std::streamoff(index[i].offset));
+            file.read(reinterpret_cast<char *>(bytes.data()), std::streamsize(size));
+            if (!file)
+                return fail("truncated level " + std::to_string(i));
+
+            if (format->compressed) {
+                compressed_level_t level{width, height, std::move(bytes)};
+                if (flip && !flip_blocks(level, format->bc))
+                    return fail("top down BC7 or odd sized block levels cannot be flipped, bake it with a lower "
+                                "left origin");
+                data.compressed.levels.push_back(std::move(level));
+            } else {
+                image_t level{width, height, std::move(bytes)};
+                if (flip)
+                    flip_rows(level);
+                data.chain.levels.push_back(std::move(level));
+            }
+        }
+
+        if (!format->compressed && header.level_count == 0u && options.mipmaps)
+            data.chain = generate_mips(std::move(data.chain.levels.front()), format->srgb);
+        return data;
+    }
+}
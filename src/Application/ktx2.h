@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+
+#include "texture_loader.h"
+
+namespace xe {
+
+    // Whether the path names a KTX2 file, by its extension.
+    bool is_ktx2(const std::string &path);
+
+    /**
+     * @brief Reads a KTX2 file holding a 2D texture in a GPU format, with the mip chain baked into it.
+     *
+     * The levels are read straight into the texture data, with no decoding, so they can be uploaded as they are.
+     * Supported are uncompressed RGBA8 and the BC1, BC3, BC5 and BC7 formats, without supercompression. Levels
+     * stored top row first, the KTX2 default, are flipped to the bottom row first order of the engine; BC7 and
+     * block compressed levels whose height is not a multiple of 4 cannot be flipped, such files have to be baked
+     * with the lower left origin (KTXorientation "ru"). A file without levels gets its mips generated when it is
+     * uncompressed. Makes no GL calls. Returns empty data when the file cannot be used, the reason is printed.
+     */
+    texture_data_t read_ktx2(const std::string &path, const texture_options_t &options = {});
+}
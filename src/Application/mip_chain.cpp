@@ -0,0 +1,206 @@
+#include "mip_chain.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define XE_MIPS_SSE 1
+#endif
+
+#include "stb/stb_image.h"
+
+#include "thread_pool.h"
+
+namespace {
+    constexpr std::size_t ENCODE_BITS = 14u;
+    constexpr std::size_t ENCODE_SIZE = std::size_t(1) << ENCODE_BITS;
+    // Destination pixels per parallel_for chunk, so small levels are not split into tiny tasks.
+    constexpr std::size_t CHUNK_PIXELS = 16384u;
+
+    struct srgb_tables_t {
+        // sRGB byte to linear.
+        std::array<float, 256> decode;
+        // Linear quantized to ENCODE_BITS to sRGB byte.
+        std::array<std::uint8_t, ENCODE_SIZE> encode;
+    };
+
+    const srgb_tables_t &srgb_tables() {
+        static const srgb_tables_t tables = [] {
+            srgb_tables_t t;
+            for (std::size_t i = 0; i < 256u; ++i) {
+                auto c = float(i) / 255.0f;
+                t.decode[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            }
+            for (std::size_t i = 0; i < ENCODE_SIZE; ++i) {
+                auto l = float(i) / float(ENCODE_SIZE - 1u);
+                auto c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+                t.encode[i] = std::uint8_t(std::lround(std::clamp(c, 0.0f, 1.0f) * 255.0f));
+            }
+            return t;
+        }();
+        return tables;
+    }
+
+    void downsample_rows_linear(const xe::image_t &src, xe::image_t &dst, std::size_t begin, std::size_t end) {
+        const auto src_stride = std::size_t(src.width) * 4u;
+        const auto w = std::size_t(dst.width);
+        for (auto y = begin; y < end; ++y) {
+            auto sy = std::min(2u * y, std::size_t(src.height) - 1u);
+            auto sy1 = std::min(sy + 1u, std::size_t(src.height) - 1u);
+            const auto *r0 = src.pixels.data() + sy * src_stride;
+            const auto *r1 = src.pixels.data() + sy1 * src_stride;
+            auto *out = dst.pixels.data() + y * w * 4u;
+
+            std::size_t x = 0;
+#ifdef XE_MIPS_SSE
+            // Two destination pixels from four source pixels of both rows per iteration.
+            const auto zero = _mm_setzero_si128();
+            const auto round = _mm_set1_epi16(2);
+            if (src.width > 1) {
+                for (; x + 2u <= w && 2u * x + 4u <= std::size_t(src.width); x += 2u) {
+                    auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(r0 + 8u * x));
+                    auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(r1 + 8u * x));
+                    auto lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+                    auto hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+                    lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+                    hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+                    auto sum = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(lo, hi), round), 2);
+                    _mm_storel_epi64(reinterpret_cast<__m128i *>(out + 4u * x), _mm_packus_epi16(sum, zero));
+                }
+            }
+#endif
+            for (; x < w; ++x) {
+                auto sx = std::min(2u * x, std::size_t(src.width) - 1u) * 4u;
+                auto sx1 = std::min(2u * x + 1u, std::size_t(src.width) - 1u) * 4u;
+                for (std::size_t c = 0; c < 4u; ++c)
+                    out[4u * x + c] = std::uint8_t((r0[sx + c] + r0[sx1 + c] + r1[sx + c] + r1[sx1 + c] + 2u) >> 2u);
+            }
+        }
+    }
+
+    void downsample_rows_srgb(const xe::image_t &src, xe::image_t &dst, std::size_t begin, std::size_t end) {
+        const auto &tables = srgb_tables();
+        const auto src_stride = std::size_t(src.width) * 4u;
+        const auto w = std::size_t(dst.width);
+        for (auto y = begin; y < end; ++y) {
+            auto sy = std::min(2u * y, std::size_t(src.height) - 1u);
+            auto sy1 = std::min(sy + 1u, std::size_t(src.height) - 1u);
+            const auto *r0 = src.pixels.data() + sy * src_stride;
+            const auto *r1 = src.pixels.data() + sy1 * src_stride;
+            auto *out = dst.pixels.data() + y * w * 4u;
+
+            for (std::size_t x = 0; x < w; ++x) {
+                const std::uint8_t *p[4] = {r0 + std::min(2u * x, std::size_t(src.width) - 1u) * 4u,
+                                            r0 + std::min(2u * x + 1u, std::size_t(src.width) - 1u) * 4u,
+                                            r1 + std::min(2u * x, std::size_t(src.width) - 1u) * 4u,
+                                            r1 + std::min(2u * x + 1u, std::size_t(src.width) - 1u) * 4u};
+#ifdef XE_MIPS_SSE
+                // Color in linear space scaled to the encode table, alpha scaled to a byte.
+                const auto scale = _mm_setr_ps(0.25f * float(ENCODE_SIZE - 1u), 0.25f * float(ENCODE_SIZE - 1u),
+                                               0.25f * float(ENCODE_SIZE - 1u), 0.25f);
+                auto sum = _mm_setzero_ps();
+                for (auto q: p)
+                    sum = _mm_add_ps(sum, _mm_setr_ps(tables.decode[q[0]], tables.decode[q[1]],
+                                                      tables.decode[q[2]], float(q[3])));
+                alignas(16) std::int32_t idx[4];
+                _mm_store_si128(reinterpret_cast<__m128i *>(idx), _mm_cvtps_epi32(_mm_mul_ps(sum, scale)));
+#else
+                std::int32_t idx[4];
+                for (std::size_t c = 0; c < 3u; ++c) {
+                    auto sum = 0.0f;
+                    for (auto q: p)
+                        sum += tables.decode[q[c]];
+                    idx[c] = std::int32_t(std::lround(0.25f * sum * float(ENCODE_SIZE - 1u)));
+                }
+                idx[3] = (p[0][3] + p[1][3] + p[2][3] + p[3][3] + 2) >> 2;
+#endif
+                for (std::size_t c = 0; c < 3u; ++c)
+                    out[4u * x + c] = tables.encode[std::size_t(idx[c])];
+                out[4u * x + 3u] = std::uint8_t(idx[3]);
+            }
+        }
+    }
+}
+
+namespace xe {
+
+    std::size_t mip_chain_t::size() const {
+        std::size_t bytes = 0;
+        for (auto &&level: levels)
+            bytes += level.size();
+        return bytes;
+    }
+
+    GLsizei mip_levels(GLsizei width, GLsizei height) {
+        GLsizei levels = 1;
+        for (auto size = std::max(width, height); size > 1; size /= 2)
+            ++levels;
+        return levels;
+    }
+
+    bool read_image_size(const std::string &path, GLsizei &width, GLsizei &height) {
+        int w = 0, h = 0, channels = 0;
+        if (!stbi_info(path.c_str(), &w, &h, &channels))
+            return false;
+        width = w;
+        height = h;
+        return true;
+    }
+
+    image_t load_image(const std::string &path) {
+        // The global flag is not thread safe, images may be decoded on the thread pool.
+        stbi_set_flip_vertically_on_load_thread(true);
+        int width = 0, height = 0, channels = 0;
+        auto data = stbi_load(path.c_str(), &width, &height, &channels, 4);
+        if (!data)
+            return {};
+        image_t image;
+        image.width = width;
+        image.height = height;
+        image.pixels.assign(data, data + std::size_t(width) * std::size_t(height) * 4u);
+        stbi_image_free(data);
+        return image;
+    }
+
+    image_t downsample(const image_t &src, bool srgb) {
+        image_t dst;
+        dst.width = std::max(src.width / 2, 1);
+        dst.height = std::max(src.height / 2, 1);
+        dst.pixels.resize(std::size_t(dst.width) * std::size_t(dst.height) * 4u);
+
+        auto chunk = std::max<std::size_t>(1u, CHUNK_PIXELS / std::size_t(dst.width));
+        thread_pool().parallel_for(std::size_t(dst.height), [&](std::size_t begin, std::size_t end) {
+            if (srgb)
+                downsample_rows_srgb(src, dst, begin, end);
+            else
+                downsample_rows_linear(src, dst, begin, end);
+        }, chunk);
+        return dst;
+    }
+
+    mip_chain_t generate_mips(image_t base, bool srgb) {
+        mip_chain_t chain;
+        chain.srgb = srgb;
+        if (base.empty())
+            return chain;
+        auto n = mip_levels(base.width, base.height);
+        chain.levels.reserve(std::size_t(n));
+        chain.levels.push_back(std::move(base));
+        for (GLsizei i = 1; i < n; ++i)
+            chain.levels.push_back(downsample(chain.levels.back(), srgb));
+        return chain;
+    }
+
+    float srgb_to_linear(std::uint8_t value) {
+        return srgb_tables().decode[value];
+    }
+
+    std::uint8_t linear_to_srgb(float value) {
+        auto i = std::lround(std::clamp(value, 0.0f, 1.0f) * float(ENCODE_SIZE - 1u));
+        return srgb_tables().encode[std::size_t(i)];
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "glad/gl.h"
+
+namespace xe {
+
+    // RGBA8 pixels, rows tightly packed and bottom row first as glTexImage2D expects them.
+    struct image_t {
+        GLsizei width = 0;
+        GLsizei height = 0;
+        std::vector<std::uint8_t> pixels;
+
+        bool empty() const { return pixels.empty(); }
+
+        std::size_t size() const { return pixels.size(); }
+    };
+
+    struct mip_chain_t {
+        std::vector<image_t> levels;
+        // Color channels hold sRGB encoded values.
+        bool srgb = true;
+
+        bool empty() const { return levels.empty(); }
+
+        // Bytes of all the levels.
+        std::size_t size() const;
+    };
+
+    // Number of levels of a full chain down to 1x1.
+    GLsizei mip_levels(GLsizei width, GLsizei height);
+
+    // Reads the size from the image header without decoding the pixels.
+    bool read_image_size(const std::string &path, GLsizei &width, GLsizei &height);
+
+    // Decodes an image file into RGBA8, flipped vertically. Returns an empty image when it cannot be read.
+    image_t load_image(const std::string &path);
+
+    /**
+     * @brief Halves an image with a 2x2 box filter, the last row or column of odd sizes is dropped.
+     *
+     * With `srgb` the color channels are averaged in linear space, through lookup tables, so the smaller levels
+     * do not darken. Alpha is always averaged as is. Rows are filtered in parallel on the thread pool, with SSE2
+     * where it is available.
+     */
+    image_t downsample(const image_t &src, bool srgb);
+
+    // Builds the full chain of `base` down to 1x1, level 0 is `base` itself.
+    mip_chain_t generate_mips(image_t base, bool srgb);
+
+    // sRGB byte to linear in [0, 1], through the tables used by downsample.
+    float srgb_to_linear(std::uint8_t value);
+
+    // Linear in [0, 1], clamped, to sRGB byte.
+    std::uint8_t linear_to_srgb(float value);
+}
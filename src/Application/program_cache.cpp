@@ -0,0 +1,162 @@
+#include "program_cache.h"
+
+#include <cstdlib>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+#include <vector>
+
+#include "hash.h"
+#include "utils.h"
+
+namespace {
+    constexpr std::uint32_t MAGIC = 0x42504558u; // "XEPB"
+    constexpr std::uint32_t FORMAT_VERSION = 1u;
+
+    struct header_t {
+        std::uint32_t magic;
+        std::uint32_t version;
+        std::uint64_t key;
+        std::uint32_t binary_format;
+        std::uint32_t length;
+    };
+
+    std::string gl_string(GLenum name) {
+        auto str = glGetString(name);
+        return str ? reinterpret_cast<const char *>(str) : "";
+    }
+}
+
+namespace xe {
+
+    ProgramCache &program_cache() {
+        static ProgramCache cache;
+        return cache;
+    }
+
+    ProgramCache::ProgramCache() {
+        auto env = std::getenv("XE_PROGRAM_CACHE");
+        if (env != nullptr && std::string_view(env) == "off") {
+            enabled_ = false;
+        } else if (env != nullptr && *env != '\0') {
+            directory_ = env;
+        } else {
+            std::error_code ec;
+            directory_ = std::filesystem::temp_directory_path(ec) / "xe-program-cache";
+        }
+    }
+
+    std::uint64_t ProgramCache::driver_hash() {
+        if (driver_hash_ == 0) {
+            auto hash = hash_string(gl_string(GL_VENDOR));
+            hash = hash_string(gl_string(GL_RENDERER), hash);
+            hash = hash_string(gl_string(GL_VERSION), hash);
+            driver_hash_ = hash_string(gl_string(GL_SHADING_LANGUAGE_VERSION), hash);
+        }
+        return driver_hash_;
+    }
+
+    std::uint64_t ProgramCache::begin_key(std::string_view defines) {
+        auto key = driver_hash();
+        key = hash_bytes(&FORMAT_VERSION, sizeof(FORMAT_VERSION), key);
+        return hash_string(defines, key);
+    }
+
+    std::uint64_t ProgramCache::add_stage(std::uint64_t key, GLenum type, std::string_view source) {
+        key = hash_bytes(&type, sizeof(type), key);
+        std::uint64_t length = source.size();
+        key = hash_bytes(&length, sizeof(length), key);
+        return hash_string(source, key);
+    }
+
+    std::filesystem::path ProgramCache::entry_path(std::uint64_t key) const {
+        return directory_ / std::format("{:016x}.bin", key);
+    }
+
+    bool ProgramCache::supported() {
+        if (n_binary_formats_ < 0) {
+            n_binary_formats_ = 0;
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &n_binary_formats_);
+        }
+        return enabled_ && !directory_.empty() && n_binary_formats_ > 0;
+    }
+
+    GLuint ProgramCache::load(std::uint64_t key) {
+        if (!supported())
+            return 0;
+
+        auto path = entry_path(key);
+        std::ifstream file(path, std::ios::in | std::ios::binary);
+        if (!file) {
+            ++stats_.misses;
+            return 0;
+        }
+
+        header_t header{};
+        std::vector<char> binary;
+        file.read(reinterpret_cast<char *>(&header), sizeof(header));
+        if (file && header.magic == MAGIC && header.version == FORMAT_VERSION && header.key == key) {
+            binary.resize(header.length);
+            file.read(binary.data(), header.length);
+        }
+        file.close();
+
+        GLuint program = 0;
+        if (!binary.empty() && file) {
+            program = glCreateProgram();
+            glProgramBinary(program, header.binary_format, binary.data(), static_cast<GLsizei>(binary.size()));
+            GLint link_status = GL_FALSE;
+            glGetProgramiv(program, GL_LINK_STATUS, &link_status);
+            if (!link_status) {
+                glDeleteProgram(program);
+                program = 0;
+            }
+        }
+
+        if (program == 0) {
+            // Truncated, stale or refused by the driver, it will be replaced after the program is rebuilt.
+            ++stats_.rejected;
+            std::error_code ec;
+            std::filesystem::remove(path, ec);
+            return 0;
+        }
+
+        ++stats_.hits;
+        return program;
+    }
+
+    void ProgramCache::store(std::uint64_t key, GLuint program) {
+        if (!supported() || program == 0)
+            return;
+
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+
+        std::vector<char> binary(length);
+        GLenum binary_format = 0;
+        glGetProgramBinary(program, length, &length, &binary_format, binary.data());
+        if (length <= 0)
+            return;
+
+        std::error_code ec;
+        std::filesystem::create_directories(directory_, ec);
+        if (ec) {
+            std::cerr << "Cannot create program cache directory `" << directory_.string() << "': " << ec.message()
+                      << "\n";
+            enabled_ = false;
+            return;
+        }
+
+        auto written = utils::write_file_atomic(entry_path(key), [&](std::ostream &file) {
+            header_t header{MAGIC, FORMAT_VERSION, key, binary_format, static_cast<std::uint32_t>(length)};
+            file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            file.write(binary.data(), length);
+        });
+        if (!written)
+            return;
+        ++stats_.stored;
+    }
+}
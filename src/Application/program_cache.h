@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+#include "glad/gl.h"
+
+namespace xe {
+
+    /**
+     * @brief On-disk cache of linked program binaries (glGetProgramBinary).
+     *
+     * Entries are keyed by a hash of the preprocessed stage sources, the defines and the driver
+     * vendor/renderer/version strings, so a driver update or a source change simply misses. A binary the
+     * driver refuses to load is deleted and the program is compiled from source as usual.
+     *
+     * The directory defaults to `xe-program-cache` in the system temp directory and can be changed with the
+     * XE_PROGRAM_CACHE environment variable; setting it to `off` disables the cache.
+     */
+    class ProgramCache {
+    public:
+        struct stats_t {
+            std::size_t hits = 0;
+            std::size_t misses = 0;
+            std::size_t rejected = 0;
+            std::size_t stored = 0;
+        };
+
+        ProgramCache();
+
+        bool enabled() const { return enabled_; }
+
+        void set_enabled(bool enabled) { enabled_ = enabled; }
+
+        const std::filesystem::path &directory() const { return directory_; }
+
+        void set_directory(const std::filesystem::path &directory) { directory_ = directory; }
+
+        // Hash of the vendor, renderer and version strings of the current context, queried once.
+        std::uint64_t driver_hash();
+
+        // Starts a key for a program built with `defines`, feed the stages with `add_stage`.
+        std::uint64_t begin_key(std::string_view defines);
+
+        static std::uint64_t add_stage(std::uint64_t key, GLenum type, std::string_view source);
+
+        // Returns a linked program created from the cached binary, or 0 when there is none usable.
+        GLuint load(std::uint64_t key);
+
+        // Stores the binary of a linked program. The program should have been linked with
+        // GL_PROGRAM_BINARY_RETRIEVABLE_HINT set.
+        void store(std::uint64_t key, GLuint program);
+
+        const stats_t &stats() const { return stats_; }
+
+    private:
+        std::filesystem::path entry_path(std::uint64_t key) const;
+
+        bool supported();
+
+        bool enabled_ = true;
+        std::filesystem::path directory_;
+        std::uint64_t driver_hash_ = 0;
+        int n_binary_formats_ = -1;
+        stats_t stats_;
+    };
+
+    ProgramCache &program_cache();
+}
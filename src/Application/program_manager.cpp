@@ -0,0 +1,169 @@
+#include "program_manager.h"
+
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string_view>
+
+#include "GLFW/glfw3.h"
+
+#include "Application/program_cache.h"
+#include "Application/shader_preprocessor.h"
+#include "Application/utils.h"
+
+namespace {
+    using max_shader_compiler_threads_t = void (*)(GLuint);
+
+    std::string shader_log(GLuint shader) {
+        GLint length = 0;
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+        std::string log(length > 0 ? length : 0, '\0');
+        if (length > 0)
+            glGetShaderInfoLog(shader, length, &length, log.data());
+        return log;
+    }
+
+    std::string program_log(GLuint program) {
+        GLint length = 0;
+        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+        std::string log(length > 0 ? length : 0, '\0');
+        if (length > 0)
+            glGetProgramInfoLog(program, length, &length, log.data());
+        return log;
+    }
+}
+
+namespace xe {
+
+    ProgramManager &program_manager() {
+        static ProgramManager manager;
+        return manager;
+    }
+
+    void ProgramManager::init() {
+        if (initialized_)
+            return;
+        initialized_ = true;
+        auto khr = xe::utils::has_extension("GL_KHR_parallel_shader_compile");
+        parallel_ = khr || xe::utils::has_extension("GL_ARB_parallel_shader_compile");
+        if (!parallel_)
+            return;
+        // Let the driver pick as many compiler threads as it likes, the default may be a single one.
+        auto max_threads = reinterpret_cast<max_shader_compiler_threads_t>(
+                glfwGetProcAddress(khr ? "glMaxShaderCompilerThreadsKHR" : "glMaxShaderCompilerThreadsARB"));
+        if (max_threads != nullptr)
+            max_threads(0xFFFFFFFFu);
+    }
+
+    bool ProgramManager::parallel() {
+        init();
+        return parallel_;
+    }
+
+    ProgramManager::ticket_t ProgramManager::submit(const utils::shader_source_map_t &stages,
+                                                    const std::string &defines) {
+        init();
+
+        // Ordered by stage so that the cache key does not depend on the hash map iteration order.
+        std::map<GLenum, std::string> paths(stages.begin(), stages.end());
+        std::map<GLenum, utils::preprocessed_source_t> sources;
+        auto key = program_cache().begin_key(defines);
+        for (const auto &[type, path]: paths) {
+            auto source = utils::shader_preprocessor().preprocess(path, defines, utils::TARGET_GLSL_VERSION);
+            if (source.empty())
+                return INVALID_TICKET;
+            key = ProgramCache::add_stage(key, type, source.source);
+            sources.emplace(type, std::move(source));
+        }
+
+        entry_t entry;
+        entry.cache_key = key;
+        entry.program = program_cache().load(key);
+        if (entry.program != 0u) {
+            entry.resolved = true;
+            entries_.push_back(std::move(entry));
+            return entries_.size() - 1;
+        }
+
+        entry.program = glCreateProgram();
+        for (auto &[type, source]: sources) {
+            auto shader = glCreateShader(type);
+            auto data = source.source.data();
+            auto length = static_cast<GLint>(source.source.size());
+            glShaderSource(shader, 1, &data, &length);
+            glCompileShader(shader);
+            glAttachShader(entry.program, shader);
+            entry.shaders.push_back(shader);
+            entry.types.push_back(type);
+            entry.files.push_back(std::move(source.files));
+        }
+        glProgramParameteri(entry.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(entry.program);
+
+        ++pending_;
+        entries_.push_back(std::move(entry));
+        return entries_.size() - 1;
+    }
+
+    bool ProgramManager::ready(ticket_t ticket) {
+        if (ticket >= entries_.size())
+            return true;
+        auto &entry = entries_[ticket];
+        if (entry.resolved || !parallel_)
+            return true;
+        GLint completed = GL_FALSE;
+        glGetProgramiv(entry.program, GL_COMPLETION_STATUS_KHR, &completed);
+        return completed == GL_TRUE;
+    }
+
+    void ProgramManager::resolve(entry_t &entry) {
+        entry.resolved = true;
+        --pending_;
+
+        GLint link_status = GL_FALSE;
+        glGetProgramiv(entry.program, GL_LINK_STATUS, &link_status);
+        if (!link_status) {
+            // Only now look at the stages, a failed compile shows up as a failed link.
+            for (std::size_t i = 0; i < entry.shaders.size(); ++i) {
+                GLint is_compiled = GL_FALSE;
+                glGetShaderiv(entry.shaders[i], GL_COMPILE_STATUS, &is_compiled);
+                if (is_compiled)
+                    continue;
+                std::cerr << utils::shader_type(entry.types[i]) << " shader\n"
+                          << " compilation error: " << shader_log(entry.shaders[i]) << std::endl;
+                for (std::size_t f = 0; f < entry.files[i].size(); ++f)
+                    std::cerr << "  " << f << ": " << entry.files[i][f] << "\n";
+            }
+            std::cerr << "Cannot link program\n" << program_log(entry.program) << std::endl;
+        }
+
+        for (auto shader: entry.shaders) {
+            glDetachShader(entry.program, shader);
+            glDeleteShader(shader);
+        }
+        entry.shaders.clear();
+        entry.files.clear();
+
+        if (!link_status) {
+            glDeleteProgram(entry.program);
+            entry.program = 0u;
+            return;
+        }
+        program_cache().store(entry.cache_key, entry.program);
+    }
+
+    GLuint ProgramManager::get(ticket_t ticket) {
+        if (ticket >= entries_.size())
+            return 0u;
+        auto &entry = entries_[ticket];
+        if (!entry.resolved)
+            resolve(entry);
+        return entry.program;
+    }
+
+    void ProgramManager::finish() {
+        for (auto &&entry: entries_)
+            if (!entry.resolved)
+                resolve(entry);
+    }
+}
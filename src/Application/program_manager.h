@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "glad/gl.h"
+
+#include "Application/utils.h"
+
+// KHR_parallel_shader_compile, glad is generated without extensions.
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+namespace xe {
+
+    /**
+     * @brief Compiles and links programs without waiting for the driver.
+     *
+     * `submit` issues the compile and link calls and returns at once; no status is queried until the program
+     * is first needed in `get`. When the driver exposes KHR/ARB_parallel_shader_compile the programs submitted
+     * together are built on its compiler threads and `ready` can poll them without blocking. Without it the
+     * driver is still free to compile in the background until the first status query.
+     */
+    class ProgramManager {
+    public:
+        using ticket_t = std::size_t;
+
+        static constexpr ticket_t INVALID_TICKET = ~ticket_t(0);
+
+        // Starts building the program, returns INVALID_TICKET if a stage source cannot be read.
+        ticket_t submit(const utils::shader_source_map_t &stages, const std::string &defines = "");
+
+        // True once `get` will not block. Always true without the parallel compile extension.
+        bool ready(ticket_t ticket);
+
+        // Waits for the program and checks it. Returns 0 if compiling or linking failed, errors are reported once.
+        // The program is owned by the caller.
+        GLuint get(ticket_t ticket);
+
+        // Resolves every outstanding program.
+        void finish();
+
+        bool parallel();
+
+        std::size_t pending() const { return pending_; }
+
+    private:
+        struct entry_t {
+            GLuint program = 0u;
+            std::vector<GLuint> shaders;
+            std::vector<GLenum> types;
+            std::vector<std::vector<std::string>> files;
+            std::uint64_t cache_key = 0u;
+            bool resolved = false;
+        };
+
+        void init();
+
+        void resolve(entry_t &entry);
+
+        std::vector<entry_t> entries_;
+        std::size_t pending_ = 0u;
+        bool initialized_ = false;
+        bool parallel_ = false;
+    };
+
+    ProgramManager &program_manager();
+}
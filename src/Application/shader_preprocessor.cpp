@@ -0,0 +1,173 @@
+#include "Application/shader_preprocessor.h"
+
+#include <cctype>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <unordered_set>
+
+namespace {
+    std::string_view skip_space(std::string_view str) {
+        while (!str.empty() && (str.front() == ' ' || str.front() == '\t'))
+            str.remove_prefix(1);
+        return str;
+    }
+
+    // If `line` is the `name` preprocessor directive stores the text following it in `rest`.
+    bool is_directive(std::string_view line, std::string_view name, std::string_view &rest) {
+        line = skip_space(line);
+        if (line.empty() || line.front() != '#')
+            return false;
+        line = skip_space(line.substr(1));
+        if (!line.starts_with(name))
+            return false;
+        line.remove_prefix(name.size());
+        if (!line.empty() && line.front() != ' ' && line.front() != '\t' && line.front() != '"' && line.front() != '<')
+            return false;
+        rest = line;
+        return true;
+    }
+}
+
+namespace xe {
+    namespace utils {
+
+        struct ShaderPreprocessor::context_t {
+            std::string_view defines;
+            std::string_view version;
+            bool defines_inserted = false;
+            std::unordered_set<std::string> included;
+            preprocessed_source_t out;
+        };
+
+        ShaderPreprocessor &shader_preprocessor() {
+            static ShaderPreprocessor preprocessor;
+            return preprocessor;
+        }
+
+        const std::string *ShaderPreprocessor::load_file(const std::filesystem::path &path) {
+            auto key = path.string();
+            if (auto it = files_.find(key); it != files_.end())
+                return &it->second;
+
+            std::ifstream file(path, std::ios::in | std::ios::binary | std::ios::ate);
+            if (!file) {
+                std::cerr << "Cannot load shader source from`" << key << "'\n";
+                return nullptr;
+            }
+            std::string contents;
+            contents.resize(static_cast<std::size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(contents.data(), static_cast<std::streamsize>(contents.size()));
+            if (!file) {
+                std::cerr << "Error reading shader source from`" << key << "'\n";
+                return nullptr;
+            }
+            return &files_.emplace(std::move(key), std::move(contents)).first->second;
+        }
+
+        std::filesystem::path ShaderPreprocessor::resolve(std::string_view name,
+                                                          const std::filesystem::path &parent) const {
+            auto candidate = parent / name;
+            if (std::filesystem::exists(candidate))
+                return candidate;
+            for (auto &&dir: include_dirs_) {
+                auto path = dir / name;
+                if (std::filesystem::exists(path))
+                    return path;
+            }
+            return candidate;
+        }
+
+        bool ShaderPreprocessor::expand(const std::filesystem::path &path, context_t &ctx) {
+            auto name = path.lexically_normal().string();
+            if (!ctx.included.insert(name).second)
+                return true;
+
+            auto text = load_file(path);
+            if (text == nullptr)
+                return false;
+
+            auto &out = ctx.out.source;
+            auto file_index = ctx.out.files.size();
+            ctx.out.files.push_back(name);
+            if (file_index > 0)
+                out += std::format("#line 1 {}\n", file_index);
+
+            std::string_view contents(*text);
+            std::size_t line_number = 0;
+            while (!contents.empty()) {
+                auto end = contents.find('\n');
+                auto line = contents.substr(0, end);
+                contents.remove_prefix(end == std::string_view::npos ? contents.size() : end + 1);
+                ++line_number;
+                if (line.ends_with('\r'))
+                    line.remove_suffix(1);
+
+                std::string_view rest;
+                if (is_directive(line, "version", rest)) {
+                    if (ctx.version.empty()) {
+                        out += line;
+                    } else {
+                        rest = skip_space(rest);
+                        while (!rest.empty() && std::isdigit(static_cast<unsigned char>(rest.front())))
+                            rest.remove_prefix(1);
+                        out += "#version ";
+                        out += ctx.version;
+                        out += rest;
+                    }
+                    out += '\n';
+                    if (!ctx.defines_inserted && !ctx.defines.empty()) {
+                        out += ctx.defines;
+                        if (!ctx.defines.ends_with('\n'))
+                            out += '\n';
+                        out += std::format("#line {} {}\n", line_number + 1, file_index);
+                    }
+                    ctx.defines_inserted = true;
+                    continue;
+                }
+
+                if (is_directive(line, "include", rest)) {
+                    rest = skip_space(rest);
+                    auto close = rest.empty() ? std::string_view::npos
+                                              : rest.find(rest.front() == '<' ? '>' : '"', 1);
+                    if (rest.empty() || (rest.front() != '"' && rest.front() != '<') ||
+                        close == std::string_view::npos) {
+                        std::cerr << name << ":" << line_number << ": malformed #include\n";
+                        return false;
+                    }
+                    auto include = resolve(rest.substr(1, close - 1), path.parent_path());
+                    if (!expand(include, ctx)) {
+                        std::cerr << "  included from " << name << ":" << line_number << "\n";
+                        return false;
+                    }
+                    out += std::format("#line {} {}\n", line_number + 1, file_index);
+                    continue;
+                }
+
+                out += line;
+                out += '\n';
+            }
+            return true;
+        }
+
+        preprocessed_source_t ShaderPreprocessor::preprocess(const std::string &path, std::string_view defines,
+                                                             std::string_view version) {
+            context_t ctx;
+            ctx.defines = defines;
+            ctx.version = version;
+            if (!expand(path, ctx))
+                return {};
+
+            // No #version line, the defines go first.
+            if (!ctx.defines_inserted && !defines.empty()) {
+                auto prefix = std::string(defines);
+                if (!prefix.ends_with('\n'))
+                    prefix += '\n';
+                prefix += "#line 1 0\n";
+                ctx.out.source.insert(0, prefix);
+            }
+            return std::move(ctx.out);
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace xe
+{
+    namespace utils
+    {
+#ifdef __APPLE__
+        // Shaders are written for 4.6, the 4.1 core profile is the most macOS offers.
+        inline constexpr std::string_view TARGET_GLSL_VERSION = "410";
+#else
+        inline constexpr std::string_view TARGET_GLSL_VERSION = "";
+#endif
+
+        struct preprocessed_source_t
+        {
+            // Whole stage as one string, ready for a single glShaderSource call.
+            std::string source;
+            // Files in the order they were included, the index is the source string number used in #line.
+            std::vector<std::string> files;
+
+            bool empty() const { return source.empty(); }
+        };
+
+        /**
+         * @brief Assembles shader stages from files.
+         *
+         * Files are read in one go and kept in memory, so includes shared by many stages or variants are read
+         * from disk only once. `#include "file"` is resolved relative to the including file and then to the
+         * include directories; every file is included at most once per stage. Defines are inserted right after
+         * the `#version` line, which is optionally rewritten.
+         */
+        class ShaderPreprocessor
+        {
+        public:
+            void add_include_directory(const std::filesystem::path &dir) { include_dirs_.push_back(dir); }
+
+            // Contents of `path`, read on first use. Returns nullptr when the file cannot be read.
+            const std::string *load_file(const std::filesystem::path &path);
+
+            preprocessed_source_t preprocess(const std::string &path, std::string_view defines = {},
+                                             std::string_view version = {});
+
+            // Drops the file cache, e.g. to pick up edited shaders.
+            void clear() { files_.clear(); }
+
+        private:
+            struct context_t;
+
+            bool expand(const std::filesystem::path &path, context_t &ctx);
+
+            std::filesystem::path resolve(std::string_view name, const std::filesystem::path &parent) const;
+
+            std::unordered_map<std::string, std::string> files_;
+            std::vector<std::filesystem::path> include_dirs_;
+        };
+
+        ShaderPreprocessor &shader_preprocessor();
+    }
+}
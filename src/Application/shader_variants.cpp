@@ -0,0 +1,123 @@
+#include "shader_variants.h"
+
+#include <charconv>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "Application/program_manager.h"
+
+namespace xe {
+
+    ShaderVariants::ShaderVariants(utils::shader_source_map_t stages, std::vector<shader_feature_t> features,
+                                   std::vector<std::string> uniforms, setup_t setup) :
+            stages_(std::move(stages)), features_(std::move(features)), uniforms_(std::move(uniforms)),
+            setup_(std::move(setup)) {
+        std::uint32_t shift = 0u;
+        for (auto &&feature: features_) {
+            fields_.push_back({shift, feature.bits >= 32u ? ~0u : (1u << feature.bits) - 1u});
+            shift += feature.bits;
+        }
+        if (shift > 32u)
+            std::cerr << "Shader variant features need " << shift << " bits, only 32 fit in a key\n";
+    }
+
+    const ShaderVariants::field_t *ShaderVariants::field(std::string_view feature) const {
+        for (std::size_t i = 0; i < features_.size(); ++i)
+            if (features_[i].name == feature)
+                return &fields_[i];
+        return nullptr;
+    }
+
+    variant_key_t ShaderVariants::encode(std::string_view feature, std::uint32_t value) const {
+        auto f = field(feature);
+        if (f == nullptr)
+            return 0u;
+        if (value > f->mask)
+            std::cerr << "Value " << value << " does not fit in shader feature " << feature << "\n";
+        return (value & f->mask) << f->shift;
+    }
+
+    std::uint32_t ShaderVariants::decode(variant_key_t key, std::string_view feature) const {
+        auto f = field(feature);
+        return f ? (key >> f->shift) & f->mask : 0u;
+    }
+
+    std::string ShaderVariants::defines(variant_key_t key) const {
+        std::string defines;
+        for (std::size_t i = 0; i < features_.size(); ++i) {
+            auto value = (key >> fields_[i].shift) & fields_[i].mask;
+            if (features_[i].bits == 1u && value == 0u)
+                continue;
+            defines += "#define " + features_[i].name + " " + std::to_string(value) + "\n";
+        }
+        return defines;
+    }
+
+    void ShaderVariants::request(variant_key_t key) {
+        if (variants_.contains(key))
+            return;
+        variants_[key].ticket = program_manager().submit(stages_, defines(key));
+    }
+
+    const ShaderVariants::variant_t *ShaderVariants::get(variant_key_t key) {
+        request(key);
+        auto &variant = variants_[key];
+        if (!variant.resolved) {
+            variant.resolved = true;
+            auto program = program_manager().get(variant.ticket);
+            if (program == 0u) {
+                std::cerr << "Cannot build shader variant " << key << "\n";
+                return nullptr;
+            }
+            variant.program = ProgramHandle(program);
+            variant.uniforms.reserve(uniforms_.size());
+            for (auto &&name: uniforms_)
+                variant.uniforms.push_back(glGetUniformLocation(program, name.c_str()));
+            if (setup_)
+                setup_(program);
+        }
+        return variant.program ? &variant : nullptr;
+    }
+
+    void ShaderVariants::preload(std::span<const variant_key_t> keys) {
+        for (auto key: keys)
+            request(key);
+    }
+
+    std::size_t ShaderVariants::preload_manifest(const std::string &path) {
+        std::ifstream file(path);
+        if (!file)
+            return 0;
+
+        std::vector<variant_key_t> keys;
+        std::string line;
+        while (std::getline(file, line)) {
+            std::istringstream tokens(line);
+            std::string token;
+            variant_key_t key = 0u;
+            bool listed = false;
+            while (tokens >> token) {
+                if (token.front() == '#')
+                    break;
+                listed = true;
+                if (token == "-")
+                    continue;
+                auto eq = token.find('=');
+                std::uint32_t value = 1u;
+                if (eq != std::string::npos)
+                    std::from_chars(token.data() + eq + 1, token.data() + token.size(), value);
+                auto name = std::string_view(token).substr(0, eq);
+                if (field(name) == nullptr) {
+                    std::cerr << path << ": unknown shader feature " << name << "\n";
+                    continue;
+                }
+                key |= encode(name, value);
+            }
+            if (listed)
+                keys.push_back(key);
+        }
+        preload(keys);
+        return keys.size();
+    }
+}
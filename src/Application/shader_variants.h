@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "glad/gl.h"
+
+#include "Application/gl_resource.h"
+#include "Application/utils.h"
+
+namespace xe {
+
+    using variant_key_t = std::uint32_t;
+
+    struct shader_feature_t {
+        std::string name;
+        // A one bit feature is a switch, `#define NAME 1` is emitted only when it is set. Wider features always
+        // emit `#define NAME value`.
+        std::uint32_t bits = 1u;
+    };
+
+    /**
+     * @brief Lazily built permutations of one program.
+     *
+     * Each feature occupies the next `bits` bits of the variant key, in declaration order. A variant is compiled,
+     * with the features turned into defines, the first time it is requested, or ahead of time with `preload`.
+     * Preloaded variants are only submitted to the ProgramManager, so they compile in parallel where the driver
+     * allows it and their status is checked when first used. Variants that fail to build are not retried.
+     */
+    class ShaderVariants {
+    public:
+        struct variant_t {
+            std::size_t ticket = 0u;
+            bool resolved = false;
+            ProgramHandle program;
+            // Locations of the uniforms passed to the constructor, in the same order.
+            std::vector<GLint> uniforms;
+        };
+
+        // Called once for each new program, e.g. to set the uniform block bindings.
+        using setup_t = std::function<void(GLuint program)>;
+
+        ShaderVariants(utils::shader_source_map_t stages, std::vector<shader_feature_t> features,
+                       std::vector<std::string> uniforms = {}, setup_t setup = {});
+
+        // Key with `feature` set to `value`, or 0 for an unknown feature. Keys of different features are or-ed.
+        variant_key_t encode(std::string_view feature, std::uint32_t value = 1u) const;
+
+        std::uint32_t decode(variant_key_t key, std::string_view feature) const;
+
+        std::string defines(variant_key_t key) const;
+
+        // Returns nullptr if the variant does not compile or link.
+        const variant_t *get(variant_key_t key);
+
+        GLuint program(variant_key_t key) {
+            auto variant = get(key);
+            return variant ? variant->program.get() : 0u;
+        }
+
+        // Starts building the variant without waiting for it.
+        void request(variant_key_t key);
+
+        void preload(std::span<const variant_key_t> keys);
+
+        /**
+         * @brief Builds the variants listed in a manifest file.
+         *
+         * One variant per line, given as whitespace separated `NAME` or `NAME=value` features; empty lines and
+         * lines starting with `#` are skipped, an empty variant is written as `-`. Returns the number of variants
+         * listed, a missing file is not an error.
+         */
+        std::size_t preload_manifest(const std::string &path);
+
+        std::size_t size() const { return variants_.size(); }
+
+    private:
+        struct field_t {
+            std::uint32_t shift;
+            std::uint32_t mask;
+        };
+
+        const field_t *field(std::string_view feature) const;
+
+        utils::shader_source_map_t stages_;
+        std::vector<shader_feature_t> features_;
+        std::vector<field_t> fields_;
+        std::vector<std::string> uniforms_;
+        setup_t setup_;
+        std::unordered_map<variant_key_t, variant_t> variants_;
+    };
+}
@@ -0,0 +1,321 @@
+#include "texture_loader.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <optional>
+#include <utility>
+
+#include "gl_state.h"
+#include "hash.h"
+#include "ktx2.h"
+#include "utils.h"
+
+namespace {
+    // Bump when the encoder output changes, so old cache files are replaced.
+    constexpr std::uint32_t ENCODER_VERSION = 1u;
+
+    void set_sampling(GLenum target, GLsizei n_levels, const xe::texture_options_t &options) {
+        glTexParameteri(target, GL_TEXTURE_WRAP_S, GLint(options.wrap));
+        glTexParameteri(target, GL_TEXTURE_WRAP_T, GLint(options.wrap));
+        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, n_levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+#ifdef GL_TEXTURE_MAX_ANISOTROPY
+        if (n_levels > 1)
+            glTexParameterf(target, GL_TEXTURE_MAX_ANISOTROPY,
+                            std::clamp(options.anisotropy, 1.0f, xe::max_anisotropy()));
+#endif
+    }
+
+    // Identifies the source file and everything that decides the encoding, AUTO depends on the context.
+    std::uint64_t cache_key(const std::filesystem::path &path, const xe::texture_options_t &options) {
+        auto stamp = xe::hash_file_stamp(path);
+        if (stamp == 0u)
+            return 0u;
+        std::uint32_t settings[] = {ENCODER_VERSION, std::uint32_t(options.compression), options.srgb,
+                                    options.mipmaps, xe::compression_supported(xe::BCFormat::BC1),
+                                    xe::compression_supported(xe::BCFormat::BC7)};
+        return xe::hash_bytes(settings, sizeof(settings), stamp);
+    }
+
+    std::optional<xe::BCFormat> choose_format(xe::Compression compression, const xe::image_t &image) {
+        using xe::BCFormat;
+        std::optional<BCFormat> format;
+        switch (compression) {
+            case xe::Compression::NONE:
+                break;
+            case xe::Compression::AUTO:
+                if (xe::compression_supported(BCFormat::BC7))
+                    format = BCFormat::BC7;
+                else
+                    format = xe::has_alpha(image) ? BCFormat::BC3 : BCFormat::BC1;
+                break;
+            case xe::Compression::BC1:
+                format = BCFormat::BC1;
+                break;
+            case xe::Compression::BC3:
+                format = BCFormat::BC3;
+                break;
+            case xe::Compression::BC5:
+                format = BCFormat::BC5;
+                break;
+            case xe::Compression::BC7:
+                format = BCFormat::BC7;
+                break;
+        }
+        if (format && !xe::compression_supported(*format))
+            format.reset();
+        return format;
+    }
+}
+
+namespace xe {
+
+    float max_anisotropy() {
+#ifdef GL_MAX_TEXTURE_MAX_ANISOTROPY
+        static const float max = [] {
+            GLfloat value = 1.0f;
+            glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &value);
+            return std::max(value, 1.0f);
+        }();
+        return max;
+#else
+        return 1.0f;
+#endif
+    }
+
+    std::size_t upload_texture_2d(GLuint texture, const mip_chain_t &chain, const texture_options_t &options) {
+        std::vector<level_source_t> levels;
+        for (auto &&level: chain.levels)
+            levels.push_back({level.width, level.height, level.size(), level.pixels.data()});
+        auto internal_format = chain.srgb && options.srgb_format ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+        return upload_levels_2d(texture, internal_format, false, levels, options);
+    }
+
+    std::size_t upload_compressed_2d(GLuint texture, const compressed_chain_t &chain,
+                                     const texture_options_t &options) {
+        std::vector<level_source_t> levels;
+        for (auto &&level: chain.levels)
+            levels.push_back({level.width, level.height, level.data.size(), level.data.data()});
+        auto internal_format = bc_gl_format(chain.format, chain.srgb && options.srgb_format);
+        return upload_levels_2d(texture, internal_format, true, levels, options);
+    }
+
+    std::size_t upload_texture_2d(GLuint texture, const texture_data_t &data, const texture_options_t &options) {
+        if (data.chain.empty())
+            return upload_compressed_2d(texture, data.compressed, options);
+        return upload_texture_2d(texture, data.chain, options);
+    }
+
+    std::size_t upload_levels_2d(GLuint texture, GLenum internal_format, bool compressed,
+                                 const std::vector<level_source_t> &levels, const texture_options_t &options) {
+        if (levels.empty())
+            return 0u;
+        auto n_levels = options.mipmaps ? GLsizei(levels.size()) : 1;
+
+        gl_state().bind_texture(0, GL_TEXTURE_2D, texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        std::size_t bytes = 0;
+#if (MAJOR >= 4) && (MINOR >= 2)
+        glTexStorage2D(GL_TEXTURE_2D, n_levels, internal_format, levels.front().width, levels.front().height);
+        for (GLsizei i = 0; i < n_levels; ++i) {
+            auto &level = levels[std::size_t(i)];
+            if (compressed)
+                glCompressedTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, level.width, level.height, internal_format,
+                                          GLsizei(level.size), level.data);
+            else
+                glTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, level.width, level.height, GL_RGBA, GL_UNSIGNED_BYTE,
+                                level.data);
+            bytes += level.size;
+        }
+#else
+        for (GLsizei i = 0; i < n_levels; ++i) {
+            auto &level = levels[std::size_t(i)];
+            if (compressed)
+                glCompressedTexImage2D(GL_TEXTURE_2D, i, internal_format, level.width, level.height, 0,
+                                       GLsizei(level.size), level.data);
+            else
+                glTexImage2D(GL_TEXTURE_2D, i, GLint(internal_format), level.width, level.height, 0, GL_RGBA,
+                             GL_UNSIGNED_BYTE, level.data);
+            bytes += level.size;
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, n_levels - 1);
+#endif
+        set_sampling(GL_TEXTURE_2D, n_levels, options);
+        return bytes;
+    }
+
+    std::size_t allocate_levels_array(GLuint texture, GLenum internal_format, [[maybe_unused]] bool compressed,
+                                      GLsizei n_layers, const std::vector<level_source_t> &levels,
+                                      const texture_options_t &options) {
+        if (levels.empty() || n_layers <= 0)
+            return 0u;
+        auto n_levels = options.mipmaps ? GLsizei(levels.size()) : 1;
+
+        gl_state().bind_texture(0, GL_TEXTURE_2D_ARRAY, texture);
+        std::size_t bytes = 0;
+        for (GLsizei i = 0; i < n_levels; ++i)
+            bytes += levels[std::size_t(i)].size;
+#if (MAJOR >= 4) && (MINOR >= 2)
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, n_levels, internal_format, levels.front().width, levels.front().height,
+                       n_layers);
+#else
+        // Allocated without data, the staging buffer bound for the uploads that follow must not be read here.
+        GLint unpack = 0;
+        glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &unpack);
+        gl_state().bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0u);
+        for (GLsizei i = 0; i < n_levels; ++i) {
+            auto &level = levels[std::size_t(i)];
+            if (compressed)
+                glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, i, internal_format, level.width, level.height, n_layers,
+                                       0, GLsizei(level.size), nullptr);
+            else
+                glTexImage3D(GL_TEXTURE_2D_ARRAY, i, GLint(internal_format), level.width, level.height, n_layers, 0,
+                             GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        }
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, n_levels - 1);
+        gl_state().bind_buffer(GL_PIXEL_UNPACK_BUFFER, GLuint(unpack));
+#endif
+        set_sampling(GL_TEXTURE_2D_ARRAY, n_levels, options);
+        return bytes;
+    }
+
+    void upload_level_array(GLuint texture, GLenum internal_format, bool compressed, GLint level, GLint first_layer,
+                            GLsizei n_layers, const level_source_t &source) {
+        gl_state().bind_texture(0, GL_TEXTURE_2D_ARRAY, texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        if (compressed)
+            glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, first_layer, source.width, source.height,
+                                      n_layers, internal_format, GLsizei(source.size), source.data);
+        else
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, first_layer, source.width, source.height, n_layers,
+                            GL_RGBA, GL_UNSIGNED_BYTE, source.data);
+    }
+
+    std::size_t upload_levels_array(GLuint texture, GLenum internal_format, bool compressed, GLsizei n_layers,
+                                    const std::vector<level_source_t> &levels, const texture_options_t &options) {
+        auto bytes = allocate_levels_array(texture, internal_format, compressed, n_layers, levels, options);
+        if (bytes == 0u)
+            return 0u;
+        auto n_levels = options.mipmaps ? levels.size() : 1u;
+        for (std::size_t i = 0; i < n_levels; ++i)
+            upload_level_array(texture, internal_format, compressed, GLint(i), 0, n_layers, levels[i]);
+        return bytes;
+    }
+
+    std::size_t upload_cube_map(GLuint texture, const cube_map_t &cube, const texture_options_t &options) {
+        if (cube.empty())
+            return 0u;
+        auto &first = cube.faces[0].levels;
+        auto n_levels = options.mipmaps ? GLsizei(first.size()) : 1;
+        auto format = cube.faces[0].srgb && options.srgb_format ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+
+        gl_state().bind_texture(0, GL_TEXTURE_CUBE_MAP, texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        std::size_t bytes = 0;
+#if (MAJOR >= 4) && (MINOR >= 2)
+        glTexStorage2D(GL_TEXTURE_CUBE_MAP, n_levels, format, first.front().width, first.front().height);
+#endif
+        for (GLenum f = 0; f < 6u; ++f)
+            for (GLsizei i = 0; i < n_levels; ++i) {
+                auto &level = cube.faces[f].levels[std::size_t(i)];
+#if (MAJOR >= 4) && (MINOR >= 2)
+                glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + f, i, 0, 0, level.width, level.height, GL_RGBA,
+                                GL_UNSIGNED_BYTE, level.pixels.data());
+#else
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + f, i, GLint(format), level.width, level.height, 0,
+                             GL_RGBA, GL_UNSIGNED_BYTE, level.pixels.data());
+#endif
+                bytes += level.size();
+            }
+#if !((MAJOR >= 4) && (MINOR >= 2))
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, n_levels - 1);
+#endif
+        auto clamped = options;
+        clamped.wrap = GL_CLAMP_TO_EDGE;
+        set_sampling(GL_TEXTURE_CUBE_MAP, n_levels, clamped);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        // Filtering across the face edges, without it the edges of the faces show at the coarser levels.
+        gl_state().enable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+        return bytes;
+    }
+
+    GLint max_array_layers() {
+        static const GLint max = [] {
+            GLint value = 256;
+            glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &value);
+            return std::max(value, 1);
+        }();
+        return max;
+    }
+
+    GLenum texture_format(const texture_data_t &data, const texture_options_t &options) {
+        if (data.chain.empty())
+            return bc_gl_format(data.compressed.format, data.compressed.srgb && options.srgb_format);
+        return data.chain.srgb && options.srgb_format ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+    }
+
+    bool compression_supported(BCFormat format) {
+        switch (format) {
+            case BCFormat::BC1:
+            case BCFormat::BC3: {
+                static const bool s3tc = utils::has_extension("GL_EXT_texture_compression_s3tc");
+                return s3tc;
+            }
+            case BCFormat::BC5:
+                return true;
+            case BCFormat::BC7:
+                return bc_gl_format(BCFormat::BC7, false) != GL_NONE;
+        }
+        return false;
+    }
+
+    texture_data_t prepare_texture_2d(const std::string &path, const texture_options_t &options) {
+        // Pre-baked, already in its GPU format whatever the compression asked for.
+        if (is_ktx2(path))
+            return read_ktx2(path, options);
+
+        texture_data_t data;
+        if (options.compression == Compression::NONE) {
+            data.chain = load_mip_chain(path, options);
+            return data;
+        }
+
+        auto cache_path = std::filesystem::path(path + ".xebc");
+        auto key = options.cache ? cache_key(path, options) : 0u;
+        if (key != 0u) {
+            data.compressed = read_compressed(cache_path, key);
+            if (!data.compressed.empty() && compression_supported(data.compressed.format))
+                return data;
+            data.compressed = {};
+        }
+
+        data.chain = load_mip_chain(path, options);
+        if (data.chain.empty())
+            return data;
+        auto format = choose_format(options.compression, data.chain.levels.front());
+        if (!format)
+            return data;
+
+        data.compressed = bc_compress(data.chain, *format);
+        data.chain = {};
+        if (key != 0u)
+            write_compressed(cache_path, data.compressed, key);
+        return data;
+    }
+
+    std::size_t load_texture_2d(GLuint texture, const std::string &path, const texture_options_t &options) {
+        return upload_texture_2d(texture, prepare_texture_2d(path, options), options);
+    }
+
+    mip_chain_t load_mip_chain(const std::string &path, const texture_options_t &options) {
+        auto image = load_image(path);
+        if (!options.mipmaps) {
+            mip_chain_t chain;
+            chain.srgb = options.srgb;
+            if (!image.empty())
+                chain.levels.push_back(std::move(image));
+            return chain;
+        }
+        return generate_mips(std::move(image), options.srgb);
+    }
+}
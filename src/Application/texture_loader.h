@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "glad/gl.h"
+
+#include "bc_encoder.h"
+#include "cube_map.h"
+#include "mip_chain.h"
+
+namespace xe {
+
+    enum class Compression {
+        NONE,
+        // BC7 where it is supported, otherwise BC3 for images with alpha and BC1 for the others.
+        AUTO,
+        BC1, BC3, BC5, BC7
+    };
+
+    struct texture_options_t {
+        // Color maps are sRGB encoded, data maps (normals, roughness, ...) are not. The mips of sRGB maps are
+        // filtered in linear space.
+        bool srgb = true;
+        // Stores sRGB maps as GL_SRGB8_ALPHA8, so shaders sample linear values. Only right when the shading
+        // writes to an sRGB framebuffer, the engines shade in sRGB space and leave it off.
+        bool srgb_format = false;
+        bool mipmaps = true;
+        // Clamped to what the driver supports, 1 turns anisotropic filtering off.
+        float anisotropy = 16.0f;
+        GLenum wrap = GL_REPEAT;
+        // Falls back to uncompressed when the format is not supported by the context.
+        Compression compression = Compression::NONE;
+        // Keeps the compressed chain next to the image, in `<image>.xebc`, so later runs skip decoding it.
+        bool cache = true;
+    };
+
+    // CPU side content of a texture, either an uncompressed or a compressed chain.
+    struct texture_data_t {
+        mip_chain_t chain;
+        compressed_chain_t compressed;
+
+        bool empty() const { return chain.empty() && compressed.empty(); }
+
+        std::size_t size() const { return chain.empty() ? compressed.size() : chain.size(); }
+    };
+
+    // One level for upload_levels_2d, `data` is an offset into the bound GL_PIXEL_UNPACK_BUFFER when there is one.
+    struct level_source_t {
+        GLsizei width = 0;
+        GLsizei height = 0;
+        std::size_t size = 0u;
+        const void *data = nullptr;
+    };
+
+    // Largest anisotropy the driver supports, 1 when anisotropic filtering is not available.
+    float max_anisotropy();
+
+    /**
+     * @brief Uploads `chain` into the GL_TEXTURE_2D `texture` and sets its sampling parameters.
+     *
+     * Storage is immutable (glTexStorage2D) from OpenGL 4.2, with 4.1 the levels are specified one by one and
+     * GL_TEXTURE_MAX_LEVEL limits sampling to them. The internal format is GL_RGBA8, or GL_SRGB8_ALPHA8 with
+     * `srgb_format`. Returns the number of bytes allocated. Leaves the texture bound to unit 0.
+     */
+    std::size_t upload_texture_2d(GLuint texture, const mip_chain_t &chain, const texture_options_t &options = {});
+
+    // Compressed counterpart of upload_texture_2d, from OpenGL 4.2 with immutable storage as well.
+    std::size_t upload_compressed_2d(GLuint texture, const compressed_chain_t &chain,
+                                     const texture_options_t &options = {});
+
+    // The level specification shared by both uploads above, RGBA8 texels unless `compressed`.
+    std::size_t upload_levels_2d(GLuint texture, GLenum internal_format, bool compressed,
+                                 const std::vector<level_source_t> &levels, const texture_options_t &options = {});
+
+    // Array counterpart of upload_levels_2d, each level holds the texels of all `n_layers` layers one after another.
+    std::size_t upload_levels_array(GLuint texture, GLenum internal_format, bool compressed, GLsizei n_layers,
+                                    const std::vector<level_source_t> &levels, const texture_options_t &options = {});
+
+    // The allocation part of upload_levels_array, only the sizes of `levels` are used. The content of the levels is
+    // undefined until they are specified with upload_level_array.
+    std::size_t allocate_levels_array(GLuint texture, GLenum internal_format, bool compressed, GLsizei n_layers,
+                                      const std::vector<level_source_t> &levels, const texture_options_t &options = {});
+
+    // Specifies `n_layers` layers of one level, starting at `first_layer`, from `source` holding them one after
+    // another.
+    void upload_level_array(GLuint texture, GLenum internal_format, bool compressed, GLint level, GLint first_layer,
+                            GLsizei n_layers, const level_source_t &source);
+
+    // Uploads the faces into the GL_TEXTURE_CUBE_MAP `texture`, like upload_texture_2d. The faces are clamped to
+    // their edges whatever `options.wrap` and seamless filtering is turned on. Returns the bytes allocated.
+    std::size_t upload_cube_map(GLuint texture, const cube_map_t &cube, const texture_options_t &options = {});
+
+    GLint max_array_layers();
+
+    // Internal format of the data as uploaded with `options`.
+    GLenum texture_format(const texture_data_t &data, const texture_options_t &options = {});
+
+    // Queries the context on the first call, which must then come from the GL thread.
+    bool compression_supported(BCFormat format);
+
+    /**
+     * @brief Reads the texture from the compressed cache, or decodes, mips and compresses the image file.
+     *
+     * KTX2 files are read as they are, see read_ktx2.
+     * Makes no GL calls, so it may run on the thread pool once compression_supported has been called on the GL
+     * thread. Returns empty data when the file cannot be read.
+     */
+    texture_data_t prepare_texture_2d(const std::string &path, const texture_options_t &options = {});
+
+    /**
+     * @brief Loads an image file into the GL_TEXTURE_2D `texture`, returns the bytes allocated or 0 on failure.
+     *
+     * With compression the cached chain is used when it matches the file size, modification time and options,
+     * otherwise the image is decoded, its mips built and compressed, and the cache rewritten. A cache that
+     * cannot be written, e.g. in a read only directory, is skipped.
+     */
+    std::size_t load_texture_2d(GLuint texture, const std::string &path, const texture_options_t &options = {});
+
+    std::size_t upload_texture_2d(GLuint texture, const texture_data_t &data, const texture_options_t &options = {});
+
+    // Decodes the image and builds its mip chain as asked by `options`. The chain is empty when the file cannot
+    // be read.
+    mip_chain_t load_mip_chain(const std::string &path, const texture_options_t &options = {});
+}
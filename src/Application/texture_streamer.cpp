@@ -0,0 +1,366 @@
+#include "texture_streamer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include "gl_state.h"
+#include "thread_pool.h"
+
+namespace {
+    // Bytes copied per parallel_for chunk, whole rows of a level go to the same chunk.
+    constexpr std::size_t BAND_BYTES = 256u * 1024u;
+
+    std::vector<xe::level_source_t> level_sources(const xe::texture_data_t &data) {
+        std::vector<xe::level_source_t> levels;
+        if (!data.chain.empty())
+            for (auto &&level: data.chain.levels)
+                levels.push_back({level.width, level.height, level.size(), level.pixels.data()});
+        else
+            for (auto &&level: data.compressed.levels)
+                levels.push_back({level.width, level.height, level.data.size(), level.data.data()});
+        return levels;
+    }
+
+    // Textures with equal keys can be layers of the same array.
+    struct array_key_t {
+        GLsizei width = 0;
+        GLsizei height = 0;
+        std::size_t n_levels = 0u;
+        bool compressed = false;
+        GLenum format = GL_NONE;
+        bool mipmaps = false;
+        GLenum wrap = GL_NONE;
+        float anisotropy = 0.0f;
+
+        bool operator==(const array_key_t &) const = default;
+    };
+
+    array_key_t array_key(const xe::texture_data_t &data, const xe::texture_options_t &options) {
+        auto levels = level_sources(data);
+        if (levels.empty())
+            return {};
+        return {levels.front().width, levels.front().height, levels.size(), data.chain.empty(),
+                xe::texture_format(data, options), options.mipmaps, options.wrap, options.anisotropy};
+    }
+
+    // Copies one level into the mapped buffer, compressed levels are split on rows of blocks.
+    void copy_level(const xe::level_source_t &level, bool compressed, std::uint8_t *dst) {
+        auto rows = std::size_t(compressed ? (level.height + 3) / 4 : level.height);
+        auto row_bytes = level.size / std::max<std::size_t>(rows, 1u);
+        auto src = static_cast<const std::uint8_t *>(level.data);
+        xe::thread_pool().parallel_for(rows, [=](std::size_t begin, std::size_t end) {
+            std::memcpy(dst + begin * row_bytes, src + begin * row_bytes, (end - begin) * row_bytes);
+        }, std::max<std::size_t>(1u, BAND_BYTES / std::max<std::size_t>(row_bytes, 1u)));
+    }
+}
+
+namespace xe {
+
+    TextureStreamer::ticket_t TextureStreamer::submit(const std::string &path, const texture_options_t &options) {
+        // The tasks only read what the context supports, the queries have to be made here.
+        compression_supported(BCFormat::BC1);
+
+        entry_t entry;
+        entry.options = options;
+        entry.data = std::make_shared<texture_data_t>();
+        entry.done = thread_pool().submit([data = entry.data, path, options] {
+            *data = prepare_texture_2d(path, options);
+        });
+        ++pending_;
+        entries_.push_back(std::move(entry));
+        return entries_.size() - 1;
+    }
+
+    bool TextureStreamer::ready(ticket_t ticket) const {
+        if (ticket >= entries_.size() || !entries_[ticket].done.valid())
+            return true;
+        return entries_[ticket].done.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    texture_data_t TextureStreamer::take(ticket_t ticket) {
+        if (ticket >= entries_.size() || !entries_[ticket].done.valid())
+            return {};
+        auto &entry = entries_[ticket];
+        entry.done.get();
+        --pending_;
+        auto data = std::move(entry.data);
+        return std::move(*data);
+    }
+
+    std::size_t TextureStreamer::get(ticket_t ticket, GLuint texture) {
+        if (ticket >= entries_.size())
+            return 0u;
+        return upload(texture, take(ticket), entries_[ticket].options);
+    }
+
+    std::vector<std::vector<std::size_t>> TextureStreamer::group_layers(const std::vector<ticket_t> &tickets,
+                                                                        const std::vector<texture_data_t> &data) const {
+        std::vector<array_key_t> keys;
+        for (std::size_t i = 0; i < tickets.size(); ++i)
+            keys.push_back(tickets[i] < entries_.size() ? array_key(data[i], entries_[tickets[i]].options)
+                                                        : array_key_t{});
+
+        std::vector<std::vector<std::size_t>> groups;
+        std::vector<bool> packed(tickets.size(), false);
+        auto max_layers = std::size_t(max_array_layers());
+        for (std::size_t i = 0; i < tickets.size(); ++i) {
+            if (packed[i] || data[i].empty())
+                continue;
+            std::vector<std::size_t> group;
+            for (auto j = i; j < tickets.size() && group.size() < max_layers; ++j)
+                if (!packed[j] && !data[j].empty() && keys[j] == keys[i]) {
+                    group.push_back(j);
+                    packed[j] = true;
+                }
+            groups.push_back(std::move(group));
+        }
+        return groups;
+    }
+
+    std::vector<texture_layer_t> TextureStreamer::get_layers(const std::vector<ticket_t> &tickets) {
+        std::vector<texture_data_t> data;
+        for (auto ticket: tickets)
+            data.push_back(take(ticket));
+
+        std::vector<texture_layer_t> layers(tickets.size());
+        for (auto &&group: group_layers(tickets, data)) {
+            std::vector<const texture_data_t *> group_data;
+            for (auto j: group)
+                group_data.push_back(&data[j]);
+            auto texture = std::make_shared<TextureHandle>(TextureHandle::create());
+            texture->set_size(upload_array(texture->get(), group_data, entries_[tickets[group.front()]].options));
+            for (std::uint32_t layer = 0; layer < group.size(); ++layer) {
+                layers[group[layer]] = {texture, layer};
+                data[group[layer]] = {};
+            }
+        }
+        return layers;
+    }
+
+    void TextureStreamer::get_layers_progressive(const std::vector<ticket_t> &tickets,
+                                                 std::vector<callback_t> callbacks) {
+        callbacks.resize(tickets.size());
+        batches_.push_back({tickets, std::move(callbacks)});
+    }
+
+    void TextureStreamer::update(std::size_t budget) {
+        // Packing needs the whole batch, it is started once every image of it is decoded.
+        for (auto it = batches_.begin(); it != batches_.end();) {
+            if (std::all_of(it->tickets.begin(), it->tickets.end(), [this](auto t) { return ready(t); })) {
+                start_arrays(*it);
+                it = batches_.erase(it);
+            } else
+                ++it;
+        }
+
+        // Arrays still drawn with the placeholder go first.
+        std::size_t uploaded = 0u;
+        for (auto handed_over: {false, true})
+            for (auto it = arrays_.begin(); it != arrays_.end() && uploaded < budget;) {
+                if (it->handed_over != handed_over) {
+                    ++it;
+                    continue;
+                }
+                uploaded += upload_layers(*it, budget - uploaded);
+                if (it->missing == 0u)
+                    it = arrays_.erase(it);
+                else
+                    ++it;
+            }
+    }
+
+    texture_layer_t TextureStreamer::placeholder() {
+        if (!placeholder_) {
+            static const std::uint8_t WHITE[4] = {255u, 255u, 255u, 255u};
+            texture_options_t options;
+            options.mipmaps = false;
+            placeholder_ = std::make_shared<TextureHandle>(TextureHandle::create());
+            gl_state().bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0u);
+            placeholder_->set_size(upload_levels_array(placeholder_->get(), GL_RGBA8, false, 1, {{1, 1, 4u, WHITE}},
+                                                       options));
+        }
+        return {placeholder_, 0u};
+    }
+
+    void TextureStreamer::start_arrays(batch_t &batch) {
+        std::vector<texture_data_t> data;
+        for (auto ticket: batch.tickets)
+            data.push_back(take(ticket));
+
+        std::vector<bool> packed(batch.tickets.size(), false);
+        for (auto &&group: group_layers(batch.tickets, data)) {
+            array_t array;
+            array.options = entries_[batch.tickets[group.front()]].options;
+            array.compressed = data[group.front()].chain.empty();
+            array.format = texture_format(data[group.front()], array.options);
+            for (auto j: group) {
+                array.layers.push_back(std::move(data[j]));
+                array.callbacks.push_back(std::move(batch.callbacks[j]));
+                packed[j] = true;
+            }
+
+            auto levels = level_sources(array.layers.front());
+            if (!array.options.mipmaps)
+                levels.resize(1u);
+            for (auto &&level: levels)
+                level.size *= array.layers.size();
+            array.texture = std::make_shared<TextureHandle>(TextureHandle::create());
+            array.texture->set_size(allocate_levels_array(array.texture->get(), array.format, array.compressed,
+                                                          GLsizei(array.layers.size()), levels, array.options));
+            // Only the levels uploaded so far are sampled.
+            array.missing = levels.size();
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, GLint(array.missing - 1u));
+            arrays_.push_back(std::move(array));
+        }
+
+        for (std::size_t i = 0; i < batch.tickets.size(); ++i)
+            if (!packed[i] && batch.callbacks[i])
+                batch.callbacks[i]({});
+    }
+
+    std::size_t TextureStreamer::upload_layers(array_t &array, std::size_t budget) {
+        auto level = GLint(array.missing - 1u);
+        auto source = level_sources(array.layers.front())[std::size_t(level)];
+        auto count = std::min(array.layers.size() - array.layer, std::max<std::size_t>(budget / source.size, 1u));
+        auto bytes = count * source.size;
+
+        auto stage = [&](std::uint8_t *dst) {
+            for (std::size_t i = 0; i < count; ++i)
+                copy_level(level_sources(array.layers[array.layer + i])[std::size_t(level)], array.compressed,
+                           dst + i * source.size);
+        };
+        level_source_t layers{source.width, source.height, bytes, nullptr};
+        auto mapped = map_staging(bytes);
+        if (mapped != nullptr) {
+            stage(mapped);
+            mapped = unmap_staging() ? mapped : nullptr;
+        }
+        if (mapped != nullptr) {
+            upload_level_array(array.texture->get(), array.format, array.compressed, level, GLint(array.layer),
+                               GLsizei(count), layers);
+            gl_state().bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0u);
+        } else {
+            gl_state().bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0u);
+            std::vector<std::uint8_t> pixels(bytes);
+            stage(pixels.data());
+            layers.data = pixels.data();
+            upload_level_array(array.texture->get(), array.format, array.compressed, level, GLint(array.layer),
+                               GLsizei(count), layers);
+        }
+
+        array.layer += count;
+        if (array.layer < array.layers.size())
+            return bytes;
+
+        // The level is complete, it becomes the finest one sampled.
+        gl_state().bind_texture(0, GL_TEXTURE_2D_ARRAY, array.texture->get());
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, level);
+        array.layer = 0u;
+        --array.missing;
+        if (!array.handed_over) {
+            for (std::uint32_t layer = 0; layer < array.callbacks.size(); ++layer)
+                if (array.callbacks[layer])
+                    array.callbacks[layer]({array.texture, layer});
+            array.handed_over = true;
+        }
+        return bytes;
+    }
+
+    TextureStreamer &texture_streamer() {
+        static TextureStreamer streamer;
+        return streamer;
+    }
+
+    std::uint8_t *TextureStreamer::map_staging(std::size_t bytes) {
+        if (!staging_)
+            staging_ = BufferHandle::create();
+        gl_state().bind_buffer(GL_PIXEL_UNPACK_BUFFER, staging_.get());
+        // Orphans the previous storage, which the driver may still be copying from.
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, GLsizeiptr(bytes), nullptr, GL_STREAM_DRAW);
+        staging_.set_size(bytes);
+        return static_cast<std::uint8_t *>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, GLsizeiptr(bytes),
+                                                            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    }
+
+    bool TextureStreamer::unmap_staging() {
+        // The buffer content is lost when unmapping fails, e.g. on a mode switch.
+        return glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+    }
+
+    std::size_t TextureStreamer::upload(GLuint texture, const texture_data_t &data,
+                                        const texture_options_t &options) {
+        if (data.empty())
+            return 0u;
+        auto compressed = data.chain.empty();
+        auto levels = level_sources(data);
+
+        auto mapped = map_staging(data.size());
+        auto staged = mapped != nullptr;
+        if (staged) {
+            std::size_t offset = 0u;
+            for (auto &level: levels) {
+                copy_level(level, compressed, mapped + offset);
+                level.data = reinterpret_cast<const void *>(offset);
+                offset += level.size;
+            }
+            staged = unmap_staging();
+        }
+
+        std::size_t bytes;
+        if (staged) {
+            bytes = upload_levels_2d(texture, texture_format(data, options), compressed, levels, options);
+            gl_state().bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0u);
+        } else {
+            gl_state().bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0u);
+            bytes = upload_texture_2d(texture, data, options);
+        }
+        return bytes;
+    }
+
+    std::size_t TextureStreamer::upload_array(GLuint texture, const std::vector<const texture_data_t *> &layers,
+                                              const texture_options_t &options) {
+        auto &first = *layers.front();
+        auto compressed = first.chain.empty();
+        auto n_layers = GLsizei(layers.size());
+        std::vector<std::vector<level_source_t>> sources;
+        std::size_t total = 0u;
+        for (auto layer: layers) {
+            sources.push_back(level_sources(*layer));
+            total += layer->size();
+        }
+
+        // Level by level, the layers of a level one after another.
+        auto stage = [&](std::uint8_t *dst, bool offsets) {
+            std::vector<level_source_t> levels;
+            std::size_t offset = 0u;
+            for (std::size_t i = 0; i < sources.front().size(); ++i) {
+                auto level = sources.front()[i];
+                level.data = offsets ? reinterpret_cast<const void *>(offset) : dst + offset;
+                for (auto &&layer: sources) {
+                    copy_level(layer[i], compressed, dst + offset);
+                    offset += layer[i].size;
+                }
+                level.size *= layers.size();
+                levels.push_back(level);
+            }
+            return levels;
+        };
+
+        auto format = texture_format(first, options);
+        auto mapped = map_staging(total);
+        if (mapped != nullptr) {
+            auto levels = stage(mapped, true);
+            if (unmap_staging()) {
+                auto bytes = upload_levels_array(texture, format, compressed, n_layers, levels, options);
+                gl_state().bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0u);
+                return bytes;
+            }
+        }
+        gl_state().bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0u);
+        std::vector<std::uint8_t> pixels(total);
+        return upload_levels_array(texture, format, compressed, n_layers, stage(pixels.data(), false), options);
+    }
+}
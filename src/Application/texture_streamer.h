@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "glad/gl.h"
+
+#include "gl_resource.h"
+#include "texture_loader.h"
+
+namespace xe {
+
+    // Layer of a GL_TEXTURE_2D_ARRAY holding a packed texture.
+    struct texture_layer_t {
+        std::shared_ptr<TextureHandle> texture;
+        std::uint32_t layer = 0u;
+    };
+
+    /**
+     * @brief Loads batches of textures on the thread pool and uploads them through a pixel unpack buffer.
+     *
+     * `submit` queues reading, mip generation and compression of an image as one task, so a batch costs about as
+     * much as its slowest image. `get` waits for the task, maps the staging GL_PIXEL_UNPACK_BUFFER and copies the
+     * levels into it in row bands on the thread pool, then specifies the texture from the buffer. The driver
+     * copies from the buffer on its own time, and as the buffer is orphaned for every texture the next upload
+     * does not wait for it. Submit the whole batch before the first `get`.
+     *
+     * `get_layers` packs textures of the same size, format, levels and options into the layers of shared
+     * GL_TEXTURE_2D_ARRAY textures instead, so draws that only differ in the layer need no texture change.
+     *
+     * `get_layers_progressive` does the same without waiting: the arrays are filled a few layers at a time by
+     * `update`, coarsest level first, and handed over through callbacks.
+     */
+    class TextureStreamer {
+    public:
+        using ticket_t = std::size_t;
+
+        // Receives the layer of a progressively loaded texture, empty when the image could not be read.
+        using callback_t = std::function<void(const texture_layer_t &)>;
+
+        static constexpr ticket_t INVALID_TICKET = ~ticket_t(0);
+
+        // Bytes `update` uploads per call by default.
+        static constexpr std::size_t UPDATE_BUDGET = 8u * 1024u * 1024u;
+
+        ticket_t submit(const std::string &path, const texture_options_t &options = {});
+
+        // True once `get` will not wait for the image.
+        bool ready(ticket_t ticket) const;
+
+        // Waits for the image and uploads it into `texture`. Returns the bytes allocated, 0 when the image could
+        // not be read. A ticket can be got only once.
+        std::size_t get(ticket_t ticket, GLuint texture);
+
+        /**
+         * @brief Waits for the images and uploads them as layers of texture arrays, returned in ticket order.
+         *
+         * Compatible textures share an array until GL_MAX_ARRAY_TEXTURE_LAYERS, each level of an array is staged
+         * and specified in one go. Images that could not be read get no texture.
+         */
+        std::vector<texture_layer_t> get_layers(const std::vector<ticket_t> &tickets);
+
+        // Waits for the image and returns it, for data that is edited before the upload. A ticket can be got only
+        // once, empty data when the image could not be read.
+        texture_data_t take(ticket_t ticket);
+
+        // Uploads `layers`, all of the same size, format and levels, as the layers of the GL_TEXTURE_2D_ARRAY
+        // `texture`. Returns the bytes allocated.
+        std::size_t upload_array(GLuint texture, const std::vector<const texture_data_t *> &layers,
+                                 const texture_options_t &options);
+
+        /**
+         * @brief Non-blocking counterpart of get_layers, `callbacks[i]` receives the layer of `tickets[i]`.
+         *
+         * Once the whole batch is decoded, `update` packs it into arrays as get_layers does and uploads them level
+         * by level, coarsest first, raising GL_TEXTURE_BASE_LEVEL as the finer levels arrive. The callbacks are
+         * called from `update` as soon as the coarsest level of their array is in, until then the textures can
+         * be drawn with the placeholder.
+         */
+        void get_layers_progressive(const std::vector<ticket_t> &tickets, std::vector<callback_t> callbacks);
+
+        // Uploads what the progressive batches have ready, at least one layer of a level and otherwise up to
+        // `budget` bytes, and calls their callbacks. Call once per frame.
+        void update(std::size_t budget = UPDATE_BUDGET);
+
+        // Whether progressive batches are still decoding or uploading.
+        bool loading() const { return !batches_.empty() || !arrays_.empty(); }
+
+        // Layer of a 1x1 white texture array, drawn while a texture loads.
+        texture_layer_t placeholder();
+
+        std::size_t pending() const { return pending_; }
+
+    private:
+        struct entry_t {
+            texture_options_t options;
+            std::shared_ptr<texture_data_t> data;
+            std::future<void> done;
+        };
+
+        struct batch_t {
+            std::vector<ticket_t> tickets;
+            std::vector<callback_t> callbacks;
+        };
+
+        // Array of a progressive batch, its levels are uploaded from the last one to the first.
+        struct array_t {
+            std::shared_ptr<TextureHandle> texture;
+            texture_options_t options;
+            GLenum format = GL_NONE;
+            bool compressed = false;
+            std::vector<texture_data_t> layers;
+            std::vector<callback_t> callbacks;
+            // Levels not uploaded yet, the last one of them is being uploaded starting with `layer`.
+            std::size_t missing = 0u;
+            std::size_t layer = 0u;
+            bool handed_over = false;
+        };
+
+        // Groups the textures that can share an array, in ticket order, up to GL_MAX_ARRAY_TEXTURE_LAYERS each.
+        std::vector<std::vector<std::size_t>> group_layers(const std::vector<ticket_t> &tickets,
+                                                           const std::vector<texture_data_t> &data) const;
+
+        void start_arrays(batch_t &batch);
+
+        // Uploads layers of the current level of `array` within `budget`, returns the bytes uploaded.
+        std::size_t upload_layers(array_t &array, std::size_t budget);
+
+        std::size_t upload(GLuint texture, const texture_data_t &data, const texture_options_t &options);
+
+        // Orphans and maps `bytes` of the staging buffer, leaving it bound. nullptr when it cannot be mapped.
+        std::uint8_t *map_staging(std::size_t bytes);
+
+        // False when the content was lost and the data has to be uploaded from client memory.
+        bool unmap_staging();
+
+        std::vector<entry_t> entries_;
+        std::size_t pending_ = 0u;
+        BufferHandle staging_;
+        std::list<batch_t> batches_;
+        std::list<array_t> arrays_;
+        std::shared_ptr<TextureHandle> placeholder_;
+    };
+
+    // Streamer of the textures loaded progressively, updated by the renderer every frame.
+    TextureStreamer &texture_streamer();
+}
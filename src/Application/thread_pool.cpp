@@ -0,0 +1,103 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace xe {
+
+    ThreadPool &thread_pool() {
+        // Leaked on purpose, joining workers from a static destructor races with the other static destructors.
+        static auto pool = new ThreadPool;
+        return *pool;
+    }
+
+    ThreadPool::ThreadPool(unsigned n_threads) {
+        if (n_threads == 0) {
+            auto hw = std::thread::hardware_concurrency();
+            n_threads = hw > 1 ? hw - 1 : 1;
+        }
+        threads_.reserve(n_threads);
+        for (unsigned i = 0; i < n_threads; ++i)
+            threads_.emplace_back([this] { worker(); });
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto &&thread: threads_)
+            thread.join();
+    }
+
+    void ThreadPool::worker() {
+        for (;;) {
+            std::packaged_task<void()> task;
+            {
+                std::unique_lock lock(mutex_);
+                cv_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+                if (stop_ && tasks_.empty())
+                    return;
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::future<void> ThreadPool::submit(std::function<void()> task) {
+        std::packaged_task<void()> packaged(std::move(task));
+        auto future = packaged.get_future();
+        {
+            std::lock_guard lock(mutex_);
+            tasks_.push_back(std::move(packaged));
+        }
+        cv_.notify_one();
+        return future;
+    }
+
+    void ThreadPool::parallel_for(std::size_t n, const std::function<void(std::size_t, std::size_t)> &fn,
+                                  std::size_t min_chunk) {
+        if (n == 0)
+            return;
+        min_chunk = std::max<std::size_t>(min_chunk, 1);
+        auto n_chunks = std::min<std::size_t>(size() + 1, (n + min_chunk - 1) / min_chunk);
+        if (n_chunks <= 1) {
+            fn(0, n);
+            return;
+        }
+        auto chunk = (n + n_chunks - 1) / n_chunks;
+
+        // Helpers grab chunks until none are left. A helper that starts after the caller has done all the
+        // work finds nothing to do, so the caller only waits for chunks, never for helpers to be scheduled.
+        struct state_t {
+            std::atomic<std::size_t> next{0};
+            std::atomic<std::size_t> done{0};
+            std::mutex mutex;
+            std::condition_variable cv;
+        };
+        auto state = std::make_shared<state_t>();
+        auto run = [state, &fn, n, n_chunks, chunk] {
+            for (auto i = state->next++; i < n_chunks; i = state->next++) {
+                fn(i * chunk, std::min(n, (i + 1) * chunk));
+                if (++state->done == n_chunks) {
+                    std::lock_guard lock(state->mutex);
+                    state->cv.notify_all();
+                }
+            }
+        };
+
+        {
+            std::lock_guard lock(mutex_);
+            for (std::size_t i = 1; i < n_chunks; ++i)
+                tasks_.emplace_back(run);
+        }
+        cv_.notify_all();
+
+        run();
+        std::unique_lock lock(state->mutex);
+        state->cv.wait(lock, [&] { return state->done == n_chunks; });
+    }
+}
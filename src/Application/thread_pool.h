@@ -0,0 +1,54 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace xe {
+
+    /**
+     * @brief Fixed set of worker threads for CPU side engine work (light binning, image processing, loading).
+     *
+     * No GL calls may be made from the tasks, the context is current only on the main thread.
+     */
+    class ThreadPool {
+    public:
+        // With n_threads = 0 one worker per hardware thread, minus the calling one, is started.
+        explicit ThreadPool(unsigned n_threads = 0);
+
+        ThreadPool(const ThreadPool &) = delete;
+
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        ~ThreadPool();
+
+        unsigned size() const { return static_cast<unsigned>(threads_.size()); }
+
+        std::future<void> submit(std::function<void()> task);
+
+        /**
+         * @brief Calls fn(begin, end) on consecutive ranges covering [0, n) and returns when all are done.
+         *
+         * The calling thread takes part, so it is safe to call from a task. Ranges have at least `min_chunk`
+         * elements, except the last one.
+         */
+        void parallel_for(std::size_t n, const std::function<void(std::size_t, std::size_t)> &fn,
+                          std::size_t min_chunk = 1);
+
+    private:
+        void worker();
+
+        std::vector<std::thread> threads_;
+        std::deque<std::packaged_task<void()>> tasks_;
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        bool stop_ = false;
+    };
+
+    ThreadPool &thread_pool();
+}
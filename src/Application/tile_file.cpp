@@ -0,0 +1,149 @@
+#include "tile_file.h"
+
+#include <algorithm>
+#include <cstring>
+#include <system_error>
+
+#include "hash.h"
+#include "thread_pool.h"
+#include "utils.h"
+
+namespace {
+    constexpr std::uint32_t MAGIC = 0x54564558u; // "XEVT"
+    constexpr std::uint32_t FORMAT_VERSION = 1u;
+
+    struct header_t {
+        std::uint32_t magic;
+        std::uint32_t version;
+        std::uint64_t key;
+        std::uint32_t width;
+        std::uint32_t height;
+        std::uint32_t tile_size;
+        std::uint32_t border;
+        std::uint32_t n_levels;
+        std::uint32_t padding;
+    };
+
+    // Copies the page of tile (tx, ty), the border texels outside the level repeat its edge.
+    void cut_page(const xe::image_t &level, const xe::tile_layout_t &layout, std::uint32_t tx, std::uint32_t ty,
+                  std::uint8_t *page) {
+        const auto size = std::int64_t(layout.page_size());
+        const auto x0 = std::int64_t(tx) * layout.tile_size - layout.border;
+        const auto y0 = std::int64_t(ty) * layout.tile_size - layout.border;
+        const auto w = std::int64_t(level.width);
+        const auto h = std::int64_t(level.height);
+        for (std::int64_t py = 0; py < size; ++py) {
+            auto sy = std::clamp<std::int64_t>(y0 + py, 0, h - 1);
+            const auto *row = level.pixels.data() + std::size_t(sy * w) * 4u;
+            auto *out = page + std::size_t(py * size) * 4u;
+            // The interior of the row is one copy, only the border columns can fall outside.
+            auto first = std::clamp<std::int64_t>(-x0, 0, size);
+            auto last = std::clamp<std::int64_t>(w - x0, first, size);
+            for (std::int64_t px = 0; px < first; ++px)
+                std::memcpy(out + px * 4, row, 4u);
+            std::memcpy(out + first * 4, row + (x0 + first) * 4, std::size_t(last - first) * 4u);
+            for (std::int64_t px = last; px < size; ++px)
+                std::memcpy(out + px * 4, row + (w - 1) * 4, 4u);
+        }
+    }
+}
+
+namespace xe {
+
+    tile_layout_t tile_layout_t::make(std::uint32_t width, std::uint32_t height, std::uint32_t tile_size,
+                                      std::uint32_t border) {
+        tile_layout_t layout{width, height, std::max(tile_size, 1u), border, 1u};
+        while (layout.level_width(layout.n_levels - 1u) > layout.tile_size ||
+               layout.level_height(layout.n_levels - 1u) > layout.tile_size)
+            ++layout.n_levels;
+        return layout;
+    }
+
+    std::uint32_t tile_layout_t::tile_index(std::uint32_t level, std::uint32_t x, std::uint32_t y) const {
+        std::uint32_t index = 0u;
+        for (std::uint32_t l = 0; l < level; ++l)
+            index += tiles_x(l) * tiles_y(l);
+        return index + y * tiles_x(level) + x;
+    }
+
+    bool write_tile_file(const std::filesystem::path &path, image_t base, std::uint32_t tile_size,
+                         std::uint32_t border, std::uint64_t key) {
+        if (base.empty())
+            return false;
+        auto layout = tile_layout_t::make(std::uint32_t(base.width), std::uint32_t(base.height), tile_size, border);
+
+        return utils::write_file_atomic(path, [&](std::ostream &file) {
+            header_t header{MAGIC, FORMAT_VERSION, key, layout.width, layout.height, layout.tile_size,
+                            layout.border, layout.n_levels, 0u};
+            file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+            auto level = std::move(base);
+            std::vector<std::uint8_t> pages;
+            for (std::uint32_t l = 0; l < layout.n_levels && file; ++l) {
+                if (l > 0u)
+                    level = downsample(level, true);
+                auto tiles_x = layout.tiles_x(l);
+                pages.resize(std::size_t(tiles_x) * layout.tiles_y(l) * layout.page_bytes());
+                thread_pool().parallel_for(layout.tiles_y(l), [&](std::size_t begin, std::size_t end) {
+                    for (auto ty = begin; ty < end; ++ty)
+                        for (std::uint32_t tx = 0; tx < tiles_x; ++tx)
+                            cut_page(level, layout, tx, std::uint32_t(ty),
+                                     pages.data() + (ty * tiles_x + tx) * layout.page_bytes());
+                });
+                file.write(reinterpret_cast<const char *>(pages.data()), std::streamsize(pages.size()));
+            }
+        });
+    }
+
+    bool TileFile::open(const std::filesystem::path &path, std::uint64_t key) {
+        std::lock_guard lock(mutex_);
+        layout_ = {};
+        file_.close();
+        file_.clear();
+        file_.open(path, std::ios::in | std::ios::binary);
+        if (!file_)
+            return false;
+
+        header_t header{};
+        file_.read(reinterpret_cast<char *>(&header), sizeof(header));
+        if (!file_ || header.magic != MAGIC || header.version != FORMAT_VERSION || header.key != key)
+            return false;
+        auto layout = tile_layout_t::make(header.width, header.height, header.tile_size, header.border);
+        if (layout.n_levels != header.n_levels)
+            return false;
+
+        std::error_code ec;
+        auto size = std::filesystem::file_size(path, ec);
+        if (ec || size != sizeof(header) + std::size_t(layout.n_tiles()) * layout.page_bytes())
+            return false;
+        layout_ = layout;
+        data_offset_ = sizeof(header);
+        return true;
+    }
+
+    bool TileFile::read(std::uint32_t index, std::uint8_t *page) {
+        std::lock_guard lock(mutex_);
+        if (!is_open() || index >= layout_.n_tiles())
+            return false;
+        file_.clear();
+        file_.seekg(std::streamoff(data_offset_ + std::size_t(index) * layout_.page_bytes()));
+        file_.read(reinterpret_cast<char *>(page), std::streamsize(layout_.page_bytes()));
+        return bool(file_);
+    }
+
+    bool open_tile_file(TileFile &file, const std::string &image_path, std::uint32_t tile_size,
+                        std::uint32_t border) {
+        auto stamp = hash_file_stamp(image_path);
+        if (stamp == 0u)
+            return false;
+        std::uint32_t settings[] = {tile_size, border};
+        auto key = hash_bytes(settings, sizeof(settings), stamp);
+
+        auto path = std::filesystem::path(image_path + ".xevt");
+        if (file.open(path, key))
+            return true;
+        if (!write_tile_file(path, load_image(image_path), tile_size, border, key))
+            return false;
+        return file.open(path, key);
+    }
+}
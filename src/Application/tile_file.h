@@ -0,0 +1,97 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "mip_chain.h"
+
+namespace xe {
+
+    /**
+     * @brief Tiling of the mip pyramid of a virtual texture.
+     *
+     * Every level is cut into tiles of `tile_size` texels, the last row and column may be partial. A tile is
+     * stored as a page with a `border` of texels copied from its neighbours (clamped at the edges), so bilinear
+     * filtering across the page edge in the page cache matches the full texture. The pyramid stops at the first
+     * level that fits in a single tile.
+     */
+    struct tile_layout_t {
+        std::uint32_t width = 0u;
+        std::uint32_t height = 0u;
+        std::uint32_t tile_size = 0u;
+        std::uint32_t border = 0u;
+        std::uint32_t n_levels = 0u;
+
+        static tile_layout_t make(std::uint32_t width, std::uint32_t height, std::uint32_t tile_size,
+                                  std::uint32_t border);
+
+        std::uint32_t level_width(std::uint32_t level) const { return std::max(width >> level, 1u); }
+
+        std::uint32_t level_height(std::uint32_t level) const { return std::max(height >> level, 1u); }
+
+        std::uint32_t tiles_x(std::uint32_t level) const { return (level_width(level) + tile_size - 1u) / tile_size; }
+
+        std::uint32_t tiles_y(std::uint32_t level) const {
+            return (level_height(level) + tile_size - 1u) / tile_size;
+        }
+
+        std::uint32_t page_size() const { return tile_size + 2u * border; }
+
+        // RGBA8 bytes of one page.
+        std::size_t page_bytes() const { return std::size_t(page_size()) * page_size() * 4u; }
+
+        // Position of the tile among all tiles, level 0 first and rows bottom up.
+        std::uint32_t tile_index(std::uint32_t level, std::uint32_t x, std::uint32_t y) const;
+
+        std::uint32_t n_tiles() const { return tile_index(n_levels, 0u, 0u); }
+    };
+
+    /**
+     * @brief Writes the tiled pyramid of `base` into a tile file.
+     *
+     * Levels are generated one at a time from the previous one, so besides `base` only one level is kept in
+     * memory. Tiles of a level are cut in parallel on the thread pool. `key` identifies the source, see TileFile.
+     */
+    bool write_tile_file(const std::filesystem::path &path, image_t base, std::uint32_t tile_size,
+                         std::uint32_t border, std::uint64_t key);
+
+    /**
+     * @brief Read access to the pages of a tile file, from any thread.
+     *
+     * The pages are raw RGBA8 at fixed offsets, reading one is a seek and a read with no decoding.
+     */
+    class TileFile {
+    public:
+        // Returns false when the file is missing, damaged or was written for another `key`.
+        bool open(const std::filesystem::path &path, std::uint64_t key);
+
+        bool is_open() const { return layout_.n_levels > 0u; }
+
+        const tile_layout_t &layout() const { return layout_; }
+
+        // Reads the page of tile `index` into `page`, which must hold layout().page_bytes().
+        bool read(std::uint32_t index, std::uint8_t *page);
+
+    private:
+        tile_layout_t layout_;
+        std::ifstream file_;
+        std::size_t data_offset_ = 0u;
+        std::mutex mutex_;
+    };
+
+    /**
+     * @brief Opens the tile file kept next to an image, `<image>.xevt`, building it first when it is missing or
+     * older than the image.
+     *
+     * Building decodes the whole image once, later runs only read the pages they need. Returns false when the
+     * image cannot be read.
+     */
+    bool open_tile_file(TileFile &file, const std::string &image_path, std::uint32_t tile_size = 120u,
+                        std::uint32_t border = 4u);
+}
@@ -6,15 +6,30 @@
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <format>
+#include <random>
+#include <system_error>
 #include <unordered_map>
 #include <cstring>
 
 #include "glad/gl.h"
 
-#include "Application/shader_source.h"
+#include "Application/program_manager.h"
+#include "Application/shader_preprocessor.h"
 
 namespace xe {
     namespace utils {
+        bool has_extension(std::string_view name) {
+            GLint n = 0;
+            glGetIntegerv(GL_NUM_EXTENSIONS, &n);
+            for (GLint i = 0; i < n; ++i) {
+                auto ext = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i));
+                if (ext != nullptr && name == ext)
+                    return true;
+            }
+            return false;
+        }
+
         std::string get_gl_description(void) {
             std::stringstream ss;
             auto vendor = glGetString(GL_VENDOR);
@@ -118,59 +133,20 @@ namespace xe {
             return program;
         }
 
-        void delete_shaders(shader_map_t &shaders) {
-            for (const auto &[shader_type, shader]: shaders) {
-                if (shader > 0)
-                    glDeleteShader(shader);
-            }
-        }
-
-        GLuint create_program(const shader_source_map_t &shaders_src, const std::string &version) {
-            shader_map_t shaders;
-            for (const auto &[shader_type, src]: shaders_src) {
-                auto shader = create_shader_from_file(shader_type, src);
-                if (shader > 0)
-                    shaders[shader_type] = shader;
-                else {
-                    delete_shaders(shaders);
-                    return 0;
-                }
-            }
-
-            GLuint program = glCreateProgram();
-            if (program == 0) {
-                std::cerr << "Error creating program"
-                          << "\n";
-                delete_shaders(shaders);
-                return 0;
-            }
-            for (const auto &[shader_type, shader]: shaders) {
-                glAttachShader(program, shader);
-                auto status = glGetError();
-                if (status != GL_NO_ERROR) {
-                    glDeleteProgram(program);
-                    delete_shaders(shaders);
-                    return 0;
-                }
-            }
-            if (link_program(program) == 0) {
-                std::cerr << "Cannot link program" << std::endl;
-                glDeleteProgram(program);
-                delete_shaders(shaders);
+        GLuint create_program(const shader_source_map_t &shaders_src, const std::string &defines) {
+            auto &manager = program_manager();
+            auto ticket = manager.submit(shaders_src, defines);
+            if (ticket == ProgramManager::INVALID_TICKET)
                 return 0;
-            }
-            return program;
+            return manager.get(ticket);
         }
 
         GLuint create_program(const shader_source_map_t &shaders_src) {
             return create_program(shaders_src, "");
         }
 
-        GLuint create_shader_from_source(GLenum type, source_t &shader_source) {
-
-#ifdef __APPLE__
-            shader_source.replace_version("410");
-#endif
+        GLuint create_shader_from_source(GLenum type, const preprocessed_source_t &shader_source) {
+            if (shader_source.empty()) return 0;
 
             auto shader = glCreateShader(type);
             if (shader == 0) {
@@ -179,10 +155,9 @@ namespace xe {
                 return 0;
             }
 
-            if (shader_source.size() == 0) return 0;
-
-
-            glShaderSource(shader, shader_source.size(), shader_source.data(), nullptr);
+            auto data = shader_source.source.data();
+            auto length = static_cast<GLint>(shader_source.source.size());
+            glShaderSource(shader, 1, &data, &length);
 
             glCompileShader(shader);
             GLint is_compiled = 0;
@@ -196,6 +171,9 @@ namespace xe {
                 glDeleteShader(shader);
                 std::cerr << utils::shader_type(type) << " shader\n"
                           << " compilation error: " << error_log << std::endl;
+                // Source string numbers in the log index this list.
+                for (std::size_t i = 0; i < shader_source.files.size(); ++i)
+                    std::cerr << "  " << i << ": " << shader_source.files[i] << "\n";
                 return 0;
             }
             return shader;
@@ -203,16 +181,29 @@ namespace xe {
 
 
         GLuint create_shader_from_file(GLenum type, const std::string &path) {
-            source_t shader_source;
-            shader_source.load(path);
-
-            if (shader_source.size() == 0)
-                return 0;
-#ifdef __APPLE__
-            shader_source.replace_version("410");
-#endif
+            return create_shader_from_source(type, shader_preprocessor().preprocess(path, {}, TARGET_GLSL_VERSION));
+        }
 
-            return create_shader_from_source(type, shader_source);
+        bool write_file_atomic(const std::filesystem::path &path, const std::function<void(std::ostream &)> &write) {
+            auto tmp_path = path;
+            tmp_path += std::format(".{:08x}.tmp", std::random_device{}());
+            std::error_code ec;
+            {
+                std::ofstream file(tmp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+                if (file)
+                    write(file);
+                file.close();
+                if (!file) {
+                    std::filesystem::remove(tmp_path, ec);
+                    return false;
+                }
+            }
+            std::filesystem::rename(tmp_path, path, ec);
+            if (ec) {
+                std::filesystem::remove(tmp_path, ec);
+                return false;
+            }
+            return true;
         }
     }
 }
@@ -3,8 +3,11 @@
 //
 
 #pragma once
+#include <filesystem>
+#include <functional>
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 
 #include "glad/gl.h"
@@ -20,6 +23,9 @@ namespace xe
 
         std::string get_gl_description(void);
 
+        // Whether the current context advertises the extension, glad is generated without them.
+        bool has_extension(std::string_view name);
+
         // Error reporting/debuging
 
         std::string shader_type(GLenum type);
@@ -40,6 +46,15 @@ namespace xe
 
         GLuint create_program(const shader_source_map_t &shaders_src);
 
+        // `defines` is GLSL text (e.g. "#define USE_MAP_KD 1\n") inserted after the #version line of every stage.
+        GLuint create_program(const shader_source_map_t &shaders_src, const std::string &defines);
+
+        // File utils
+
+        // Runs `write` on a temporary file next to `path` and renames it over `path`, so that a concurrent reader
+        // never sees a partial file. Returns false, leaving nothing behind, when the stream fails.
+        bool write_file_atomic(const std::filesystem::path &path, const std::function<void(std::ostream &)> &write);
+
     }
 }
 
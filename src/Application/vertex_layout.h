@@ -0,0 +1,188 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "glad/gl.h"
+#include "glm/glm.hpp"
+
+namespace xe {
+    namespace vertex {
+
+        // Attribute locations shared by the loaders and the shaders (layout(location=...) in *_vs.glsl).
+        constexpr GLuint MAX_TEXCOORDS = 4u;
+        constexpr GLuint POSITION_LOCATION = 0u;
+        constexpr GLuint TEXCOORD_LOCATION = 1u;
+        constexpr GLuint NORMAL_LOCATION = TEXCOORD_LOCATION + MAX_TEXCOORDS;
+        constexpr GLuint TANGENT_LOCATION = NORMAL_LOCATION + 1u;
+        constexpr GLuint COLOR_LOCATION = TANGENT_LOCATION + 1u;
+
+        template<typename T>
+        struct gl_type_of;
+
+        template<>
+        struct gl_type_of<float> {
+            static constexpr GLenum value = GL_FLOAT;
+        };
+
+        template<>
+        struct gl_type_of<std::int32_t> {
+            static constexpr GLenum value = GL_INT;
+        };
+
+        template<>
+        struct gl_type_of<std::uint32_t> {
+            static constexpr GLenum value = GL_UNSIGNED_INT;
+        };
+
+        template<GLuint Location, typename T>
+        struct attribute {
+            using value_type = T;
+            using component_type = typename T::value_type;
+
+            static constexpr GLuint location = Location;
+            static constexpr GLint components = T::length();
+            static constexpr GLenum gl_type = gl_type_of<component_type>::value;
+            static constexpr std::size_t size = sizeof(T);
+
+            static_assert(size == components * sizeof(component_type), "Vertex attribute must be tightly packed");
+        };
+
+        using position = attribute<POSITION_LOCATION, glm::vec3>;
+        template<GLuint I>
+        using texcoord = attribute<TEXCOORD_LOCATION + I, glm::vec2>;
+        using normal = attribute<NORMAL_LOCATION, glm::vec3>;
+        using tangent = attribute<TANGENT_LOCATION, glm::vec4>;
+        using color = attribute<COLOR_LOCATION, glm::vec4>;
+    }
+
+    /**
+     * @brief Interleaved vertex layout fixed at compile time.
+     *
+     * Stride and offsets are derived from the attribute list, so `setup` and `pack` can never disagree.
+     * Attributes are stored in the order they are listed.
+     */
+    template<typename... Attrs>
+    class VertexLayout {
+    public:
+        static_assert(sizeof...(Attrs) > 0, "Vertex layout needs at least one attribute");
+
+        static constexpr std::size_t n_attributes = sizeof...(Attrs);
+        static constexpr std::size_t stride = (Attrs::size + ...);
+        static constexpr std::array<std::size_t, n_attributes> sizes{Attrs::size...};
+        static constexpr std::array<GLuint, n_attributes> locations{Attrs::location...};
+
+        static constexpr std::size_t offset(std::size_t i) {
+            std::size_t o = 0;
+            for (std::size_t j = 0; j < i; ++j)
+                o += sizes[j];
+            return o;
+        }
+
+        template<typename Mesh>
+        static void setup(Mesh &mesh) {
+            setup(mesh, std::index_sequence_for<Attrs...>{});
+        }
+
+        // Writes vertices sequentially, which is what write-combined mapped memory wants.
+        static void pack(void *dst, std::size_t n_vertices, const typename Attrs::value_type *... src) {
+            auto out = static_cast<std::uint8_t *>(dst);
+            for (std::size_t v = 0; v < n_vertices; ++v, out += stride) {
+                pack_vertex(out, v, std::index_sequence_for<Attrs...>{}, src...);
+            }
+        }
+
+    private:
+        static constexpr bool unique_locations() {
+            for (std::size_t i = 0; i < n_attributes; ++i)
+                for (std::size_t j = i + 1; j < n_attributes; ++j)
+                    if (locations[i] == locations[j])
+                        return false;
+            return true;
+        }
+
+        static_assert(unique_locations(), "Two vertex attributes share the same location");
+
+        template<typename Mesh, std::size_t... I>
+        static void setup(Mesh &mesh, std::index_sequence<I...>) {
+            (mesh.vertex_attrib_pointer(Attrs::location, Attrs::components, Attrs::gl_type, stride, offset(I)), ...);
+        }
+
+        template<std::size_t... I>
+        static void pack_vertex(std::uint8_t *out, std::size_t v, std::index_sequence<I...>,
+                                const typename Attrs::value_type *... src) {
+            (std::memcpy(out + offset(I), src + v, Attrs::size), ...);
+        }
+    };
+
+    /**
+     * @brief Interleaved vertex layout described at run time.
+     *
+     * Fallback for meshes whose attribute set is only known after loading. Attributes are added in order
+     * with the same attribute types as `VertexLayout`.
+     */
+    class RuntimeVertexLayout {
+    public:
+        struct attribute_t {
+            GLuint location;
+            GLint components;
+            GLenum gl_type;
+            std::size_t size;
+            std::size_t offset;
+            const std::uint8_t *src;
+        };
+
+        template<typename Attr>
+        RuntimeVertexLayout &add(const typename Attr::value_type *src) {
+            attributes_.push_back({Attr::location, Attr::components, Attr::gl_type, Attr::size, stride_,
+                                   reinterpret_cast<const std::uint8_t *>(src)});
+            stride_ += Attr::size;
+            return *this;
+        }
+
+        std::size_t stride() const { return stride_; }
+
+        const std::vector<attribute_t> &attributes() const { return attributes_; }
+
+        template<typename Mesh>
+        void setup(Mesh &mesh) const {
+            for (auto &&a: attributes_)
+                mesh.vertex_attrib_pointer(a.location, a.components, a.gl_type, stride_, a.offset);
+        }
+
+        void pack(void *dst, std::size_t n_vertices) const {
+            auto out = static_cast<std::uint8_t *>(dst);
+            for (std::size_t v = 0; v < n_vertices; ++v, out += stride_) {
+                for (auto &&a: attributes_)
+                    std::memcpy(out + a.offset, a.src + v * a.size, a.size);
+            }
+        }
+
+    private:
+        std::size_t stride_ = 0;
+        std::vector<attribute_t> attributes_;
+    };
+
+    // Allocates the vertex buffer of `mesh`, sets up the attribute pointers and packs the vertices into it.
+    template<typename Layout, typename Mesh, typename... Src>
+    void upload_vertices(Mesh &mesh, std::size_t n_vertices, const Src *... src) {
+        mesh.allocate_vertex_buffer(n_vertices * Layout::stride, GL_STATIC_DRAW);
+        Layout::setup(mesh);
+        auto ptr = mesh.map_vertex_buffer();
+        Layout::pack(ptr, n_vertices, src...);
+        mesh.unmap_vertex_buffer();
+    }
+
+    template<typename Mesh>
+    void upload_vertices(Mesh &mesh, std::size_t n_vertices, const RuntimeVertexLayout &layout) {
+        mesh.allocate_vertex_buffer(n_vertices * layout.stride(), GL_STATIC_DRAW);
+        layout.setup(mesh);
+        auto ptr = mesh.map_vertex_buffer();
+        layout.pack(ptr, n_vertices);
+        mesh.unmap_vertex_buffer();
+    }
+}
@@ -9,10 +9,18 @@
 #include <vector>
 #include <tuple>
 
+#include "Application/block_layout.h"
 #include "Application/utils.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+namespace {
+    // Blocks of shaders/base_fs.glsl and shaders/base_vs.glsl.
+    using modifier_block_t = xe::layout::std140_block<
+            xe::layout::field<"strength", float>, xe::layout::field<"color", glm::vec3>>;
+    using transformations_block_t = xe::layout::std140_block<xe::layout::field<"PVM", glm::mat4>>;
+}
+
 void SimpleShapeApplication::init() {
     // A utility function that reads the shader sources, compiles them and creates the program object
     // As everything in OpenGL we reference program by an integer "handle".
@@ -55,7 +63,7 @@ void SimpleShapeApplication::init() {
     GLuint uniform_fragment_buffer_handle{};
     glGenBuffers(1, &uniform_fragment_buffer_handle);
     glBindBuffer(GL_UNIFORM_BUFFER, uniform_fragment_buffer_handle);
-    glBufferData(GL_UNIFORM_BUFFER, 8 * sizeof(GLfloat), nullptr, GL_STATIC_DRAW);
+    glBufferData(GL_UNIFORM_BUFFER, modifier_block_t::SIZE, nullptr, GL_STATIC_DRAW);
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
     glBindBufferBase(GL_UNIFORM_BUFFER, 0, uniform_fragment_buffer_handle);
 
@@ -63,7 +71,7 @@ void SimpleShapeApplication::init() {
     GLuint uniform_vertex_buffer_handle{};
     glGenBuffers(1, &uniform_vertex_buffer_handle);
     glBindBuffer(GL_UNIFORM_BUFFER, uniform_vertex_buffer_handle);
-    glBufferData(GL_UNIFORM_BUFFER,  sizeof(glm::mat4), nullptr, GL_STATIC_DRAW);
+    glBufferData(GL_UNIFORM_BUFFER, transformations_block_t::SIZE, nullptr, GL_STATIC_DRAW);
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
     glBindBufferBase(GL_UNIFORM_BUFFER, 1, uniform_vertex_buffer_handle);
     ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -91,13 +99,12 @@ void SimpleShapeApplication::init() {
     ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     ///FRAGMENT SHADER
     {
-        constexpr auto strength{ 0.5f };
-        constexpr std::array<float, 3> color = { 1.0f, 0.5f, 1.0f };
-        constexpr auto float_size = sizeof(float);
+        modifier_block_t modifier;
+        modifier.set<"strength">(0.5f);
+        modifier.set<"color">(glm::vec3(1.0f, 0.5f, 1.0f));
 
         glBindBuffer(GL_UNIFORM_BUFFER, uniform_fragment_buffer_handle);
-        glBufferSubData(GL_UNIFORM_BUFFER, 0, float_size, &strength);
-        glBufferSubData(GL_UNIFORM_BUFFER, 4 * float_size, color.size() * float_size, color.data());
+        modifier.upload(GL_UNIFORM_BUFFER);
         glBindBuffer(GL_UNIFORM_BUFFER, 0);
     }
     ///VERTEX SHADER
@@ -113,8 +120,11 @@ void SimpleShapeApplication::init() {
         const auto view = lookAt(camera_position, camera_target, camera_up);
         const auto pvm = projection * view * model;
 
+        transformations_block_t transformations;
+        transformations.set<"PVM">(pvm);
+
         glBindBuffer(GL_UNIFORM_BUFFER, uniform_vertex_buffer_handle);
-        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), value_ptr(pvm));
+        transformations.upload(GL_UNIFORM_BUFFER);
         glBindBuffer(GL_UNIFORM_BUFFER, 0);
     }
     ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -3,7 +3,9 @@
 #include <Engine/ColorMaterial.h>
 #include <Engine/PhongMaterial.h>
 #include <Engine/mesh_loader.h>
+#include <Engine/uniform_blocks.h>
 
+#include <algorithm>
 #include <array>
 #include <vector>
 #define GLM_ENABLE_EXPERIMENTAL
@@ -14,22 +16,6 @@
 
 #include <spdlog/spdlog.h>
 
-constexpr auto MAX_POINT_LIGHTS = 24;
-
-struct Lights
-{
-    glm::vec3 ambient;
-    uint32_t n_p_lights;
-    xe::PointLight p_lights[MAX_POINT_LIGHTS];
-};
-
-struct Transformations
-{
-    glm::mat4 PVM;
-    alignas(16) glm::mat4 VM;
-    alignas(16) glm::mat4 N;
-};
-
 xe::PointLight transform_point_light(const xe::PointLight& light, const glm::mat4& M)
 {
     xe::PointLight transformed_light(light);
@@ -50,21 +36,21 @@ void SimpleShapeApplication::init() {
     ///VERTEX SHADER
     glGenBuffers(1, &m_uniform_vertex_buffer);
     glBindBuffer(GL_UNIFORM_BUFFER, m_uniform_vertex_buffer);
-    glBufferData(GL_UNIFORM_BUFFER,  sizeof(Transformations), nullptr, GL_STATIC_DRAW);
+    glBufferData(GL_UNIFORM_BUFFER, xe::transformations_block_t::SIZE, nullptr, GL_STATIC_DRAW);
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
     glBindBufferBase(GL_UNIFORM_BUFFER, 1, m_uniform_vertex_buffer);
 
     ///Lights uniform
     glGenBuffers(1, &m_uniform_lights_buffer);
     glBindBuffer(GL_UNIFORM_BUFFER, m_uniform_lights_buffer);
-    glBufferData(GL_UNIFORM_BUFFER, sizeof(Lights), nullptr, GL_STATIC_DRAW);
+    glBufferData(GL_UNIFORM_BUFFER, xe::lights_block_t::SIZE, nullptr, GL_STATIC_DRAW);
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
     glBindBufferBase(GL_UNIFORM_BUFFER, 2, m_uniform_lights_buffer);
 
     ///Camera uniform
     glGenBuffers(1, &m_uniform_camera_buffer);
     glBindBuffer(GL_UNIFORM_BUFFER, m_uniform_camera_buffer);
-    glBufferData(GL_UNIFORM_BUFFER, sizeof(glm::vec3), nullptr, GL_STATIC_DRAW);
+    glBufferData(GL_UNIFORM_BUFFER, xe::camera_block_t::SIZE, nullptr, GL_STATIC_DRAW);
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
     glBindBufferBase(GL_UNIFORM_BUFFER, 3, m_uniform_camera_buffer);
     ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -111,28 +97,37 @@ void SimpleShapeApplication::frame() {
     const auto r = glm::mat3(vm);
     const auto n = glm::mat3(cross(r[1], r[2]), cross(r[2], r[0]), cross(r[0], r[1]));
 
-    Transformations transformations;
-    transformations.PVM = pvm;
-    transformations.VM = vm;
-    transformations.N = n;
+    xe::transformations_block_t transformations;
+    transformations.set<"PVM">(pvm);
+    transformations.set<"VM">(vm);
+    transformations.set<"N">(n);
 
     glBindBuffer(GL_UNIFORM_BUFFER, m_uniform_vertex_buffer);
-    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Transformations), &transformations);
+    transformations.upload(GL_UNIFORM_BUFFER);
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
-    const auto camera_position = m_camera.position();
+    xe::camera_block_t camera;
+    camera.set<"camera_position">(m_camera.position());
     glBindBuffer(GL_UNIFORM_BUFFER, m_uniform_camera_buffer);
-    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::vec3), &camera_position);
+    camera.upload(GL_UNIFORM_BUFFER);
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
     //Light uniform
-    Lights lights;
-    lights.ambient = ambient_;
-    lights.n_p_lights = p_lights_.size();
-    memcpy_s(lights.p_lights, MAX_POINT_LIGHTS * sizeof(xe::PointLight), p_lights_.data(), p_lights_.size() * sizeof(xe::PointLight));
+    const auto n_p_lights = std::min<std::size_t>(p_lights_.size(), xe::MAX_POINT_LIGHTS);
+    xe::lights_block_t lights;
+    lights.set<"ambient_color">(ambient_);
+    lights.set<"n_p_lights">(n_p_lights);
+    for (std::size_t i = 0; i < n_p_lights; ++i) {
+        auto light = lights.at<"p_light">(i);
+        light.set<"position">(p_lights_[i].position_in_vs);
+        light.set<"color">(p_lights_[i].color);
+        light.set<"intensity">(p_lights_[i].intensity);
+        light.set<"radius">(p_lights_[i].radius);
+    }
+    xe::PhongMaterial::set_point_light_count(n_p_lights);
 
     glBindBuffer(GL_UNIFORM_BUFFER, m_uniform_lights_buffer);
-    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Lights), &lights);
+    lights.upload(GL_UNIFORM_BUFFER);
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
     // Binding the VAO will setup all the required vertex buffers.
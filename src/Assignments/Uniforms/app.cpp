@@ -9,11 +9,21 @@
 #include <vector>
 #include <tuple>
 
+#include "Application/block_layout.h"
 #include "Application/utils.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+namespace {
+    // Blocks of shaders/base_fs.glsl and shaders/base_vs.glsl.
+    using modifier_block_t = xe::layout::std140_block<
+            xe::layout::field<"strength", float>, xe::layout::field<"color", glm::vec3>>;
+    using transformations_block_t = xe::layout::std140_block<
+            xe::layout::field<"scale", glm::vec2>, xe::layout::field<"translation", glm::vec2>,
+            xe::layout::field<"rotation", glm::mat2>>;
+}
+
 void SimpleShapeApplication::init() {
     // A utility function that reads the shader sources, compiles them and creates the program object
     // As everything in OpenGL we reference program by an integer "handle".
@@ -77,7 +87,7 @@ void SimpleShapeApplication::init() {
     GLuint uniform_fragment_buffer_handle{};
     glGenBuffers(1, &uniform_fragment_buffer_handle);
     glBindBuffer(GL_UNIFORM_BUFFER, uniform_fragment_buffer_handle);
-    glBufferData(GL_UNIFORM_BUFFER, 8 * sizeof(GLfloat), nullptr, GL_STATIC_DRAW);
+    glBufferData(GL_UNIFORM_BUFFER, modifier_block_t::SIZE, nullptr, GL_STATIC_DRAW);
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
     glBindBufferBase(GL_UNIFORM_BUFFER, 0, uniform_fragment_buffer_handle);
 
@@ -85,7 +95,7 @@ void SimpleShapeApplication::init() {
     GLuint uniform_vertex_buffer_handle{};
     glGenBuffers(1, &uniform_vertex_buffer_handle);
     glBindBuffer(GL_UNIFORM_BUFFER, uniform_vertex_buffer_handle);
-    glBufferData(GL_UNIFORM_BUFFER, 12 * sizeof(GLfloat), nullptr, GL_STATIC_DRAW);
+    glBufferData(GL_UNIFORM_BUFFER, transformations_block_t::SIZE, nullptr, GL_STATIC_DRAW);
     glBindBuffer(GL_UNIFORM_BUFFER, 0);
     glBindBufferBase(GL_UNIFORM_BUFFER, 1, uniform_vertex_buffer_handle);
     ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -120,21 +130,23 @@ void SimpleShapeApplication::init() {
     ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     ///FRAGMENT SHADER
     {
-        constexpr auto strength{ 0.5f };
-        constexpr std::array<float, 3> color = { 1.0f, 0.5f, 1.0f };
-        constexpr auto float_size = sizeof(float);
+        modifier_block_t modifier;
+        modifier.set<"strength">(0.5f);
+        modifier.set<"color">(glm::vec3(1.0f, 0.5f, 1.0f));
 
         glBindBuffer(GL_UNIFORM_BUFFER, uniform_fragment_buffer_handle);
-        glBufferSubData(GL_UNIFORM_BUFFER, 0, float_size, &strength);
-        glBufferSubData(GL_UNIFORM_BUFFER, 4 * float_size, color.size() * float_size, color.data());
+        modifier.upload(GL_UNIFORM_BUFFER);
         glBindBuffer(GL_UNIFORM_BUFFER, 0);
     }
     ///VERTEX SHADER
     {
-        glm::mat4 PVM(1.0f);
+        transformations_block_t transformations;
+        transformations.set<"scale">(glm::vec2(1.0f));
+        transformations.set<"translation">(glm::vec2(0.0f));
+        transformations.set<"rotation">(glm::mat2(1.0f));
 
         glBindBuffer(GL_UNIFORM_BUFFER, uniform_vertex_buffer_handle);
-        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), value_ptr(PVM));
+        transformations.upload(GL_UNIFORM_BUFFER);
         glBindBuffer(GL_UNIFORM_BUFFER, 0);
     }
     ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
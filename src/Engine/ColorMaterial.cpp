@@ -7,103 +7,72 @@
 #include "ColorMaterial.h"
 
 #include "spdlog/spdlog.h"
-#include "stb/stb_image.h"
+
+#include "Application/gl_state.h"
 
 namespace xe {
 
     GLuint ColorMaterial::color_uniform_buffer_ = 0u;
-    GLuint ColorMaterial::shader_ = 0u;
+    std::unique_ptr<xe::ShaderVariants> ColorMaterial::variants_;
+
+    xe::variant_key_t ColorMaterial::variant() const {
+        return m_texture > 0 ? variants_->encode("HAS_MAP_KD") : 0u;
+    }
 
     void ColorMaterial::bind() {
-        auto use_map_kd = false;
+        auto variant = variants_->get(this->variant());
+        if (variant == nullptr)
+            return;
+        auto &gl = synced_gl_state();
+        gl.use_program(variant->program.get());
+
+        data_.set<"use_map_Kd">(m_texture > 0);
         if (m_texture > 0) {
-            glUniform1i(m_uniform_map_Kd_location, m_texture_uint);
-            glActiveTexture(GL_TEXTURE0 + m_texture_uint);
-            glBindTexture(GL_TEXTURE_2D, m_texture);
-            use_map_kd = true;
+            glUniform1i(variant->uniforms[MAP_KD], m_texture_uint);
+            gl.bind_texture(m_texture_uint, GL_TEXTURE_2D, m_texture);
         }
 
-        glBindBufferBase(GL_UNIFORM_BUFFER, 0, color_uniform_buffer_);
-        glUseProgram(program());
-        glBindBuffer(GL_UNIFORM_BUFFER, color_uniform_buffer_);
-        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::vec4), &color_[0]);
-        glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::vec4), sizeof(bool), &use_map_kd);
-        glBindBuffer(GL_UNIFORM_BUFFER, 0u);
+        gl.bind_buffer_base(GL_UNIFORM_BUFFER, 0, color_uniform_buffer_);
+        gl.bind_buffer(GL_UNIFORM_BUFFER, color_uniform_buffer_);
+        data_.upload(GL_UNIFORM_BUFFER);
+        gl.bind_buffer(GL_UNIFORM_BUFFER, 0u);
     }
 
 
     void ColorMaterial::init() {
-        auto program = xe::utils::create_program(
-                {{GL_VERTEX_SHADER,   std::string(PROJECT_DIR) + "/shaders/color_vs.glsl"},
-                 {GL_FRAGMENT_SHADER, std::string(PROJECT_DIR) + "/shaders/color_fs.glsl"}});
-        if (!program) {
-            std::cerr << "Invalid program\n";
-            exit(-1);
-        }
-
-        shader_ = program;
-
-        glGenBuffers(1, &color_uniform_buffer_);
-
-        glBindBuffer(GL_UNIFORM_BUFFER, color_uniform_buffer_);
-        glBufferData(GL_UNIFORM_BUFFER, sizeof(glm::vec4) * 2, nullptr, GL_STATIC_DRAW);
-        glBindBuffer(GL_UNIFORM_BUFFER, 0u);
-#ifdef __APPLE__
-        auto u_modifiers_index = glGetUniformBlockIndex(program, "Color");
-        if (u_modifiers_index == -1) {
-            std::cerr << "Cannot find Color uniform block in program" << std::endl;
-        } else {
-            glUniformBlockBinding(program, u_modifiers_index, 0);
-        }
-#endif
-
+        variants_ = std::make_unique<xe::ShaderVariants>(
+                xe::utils::shader_source_map_t{
+                        {GL_VERTEX_SHADER,   std::string(PROJECT_DIR) + "/shaders/color_vs.glsl"},
+                        {GL_FRAGMENT_SHADER, std::string(PROJECT_DIR) + "/shaders/color_fs.glsl"}},
+                std::vector<xe::shader_feature_t>{{"HAS_MAP_KD", 1}},
+                std::vector<std::string>{"map_Kd"},
+                [](GLuint program) {
 #ifdef __APPLE__
-        auto u_transformations_index = glGetUniformBlockIndex(program, "Transformations");
-        if (u_transformations_index == -1) {
-            std::cerr << "Cannot find Transformations uniform block in program" << std::endl;
-        } else {
-            glUniformBlockBinding(program, u_transformations_index, 1);
-        }
+                    auto u_modifiers_index = glGetUniformBlockIndex(program, "Color");
+                    if (u_modifiers_index == -1) {
+                        std::cerr << "Cannot find Color uniform block in program" << std::endl;
+                    } else {
+                        glUniformBlockBinding(program, u_modifiers_index, 0);
+                    }
+
+                    auto u_transformations_index = glGetUniformBlockIndex(program, "Transformations");
+                    if (u_transformations_index == -1) {
+                        std::cerr << "Cannot find Transformations uniform block in program" << std::endl;
+                    } else {
+                        glUniformBlockBinding(program, u_transformations_index, 1);
+                    }
 #endif
+                    xe::check_uniform_blocks(program);
+                });
 
-        m_uniform_map_Kd_location = glGetUniformLocation(program, "map_Kd");
-        if (m_uniform_map_Kd_location == -1) {
-            std::cerr << "Cannot get uniform map_Kd location\n";
-        }
-    }
-
-    GLuint create_texture(const std::string& name)
-    {
-        stbi_set_flip_vertically_on_load(true);
-        GLint width{}, height{}, channels{};
-        const auto img = stbi_load(name.c_str(), &width, &height, &channels, 0);
-        if (!img)
-        {
-            spdlog::warn("Could not read image from file `{}'", name);
-            return 0;
-        }
-
-        GLenum format;
-        if (channels == 3)
-        {
-            format = GL_RGB;
-        }
-        else if (channels == 4)
-        {
-            format = GL_RGBA;
-        }
-
-        GLuint texture{};
-
-        glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
-
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, format, GL_UNSIGNED_BYTE, img);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        glBindTexture(GL_TEXTURE_2D, 0u);
+        // Only submitted here, the programs are checked when first used.
+        const xe::variant_key_t keys[] = {0u, variants_->encode("HAS_MAP_KD")};
+        variants_->preload(keys);
+        glGenBuffers(1, &color_uniform_buffer_);
 
-        return texture;
+        auto &gl = synced_gl_state();
+        gl.bind_buffer(GL_UNIFORM_BUFFER, color_uniform_buffer_);
+        glBufferData(GL_UNIFORM_BUFFER, xe::color_block_t::SIZE, nullptr, GL_STATIC_DRAW);
+        gl.bind_buffer(GL_UNIFORM_BUFFER, 0u);
     }
 }
@@ -4,16 +4,20 @@
 
 #pragma once
 
+#include <memory>
+
 #include <glad/gl.h>
 #include <glm/glm.hpp>
 
+#include "Application/shader_variants.h"
 #include "Application/utils.h"
 #include "Engine/Material.h"
+#include "Engine/uniform_blocks.h"
 
 namespace xe {
     class ColorMaterial : public Material {
     public:
-        ColorMaterial(const glm::vec4 color) : color_(color) {}
+        ColorMaterial(const glm::vec4 color) { data_.set<"Kd">(color); }
 
         void bind() final;
 
@@ -23,16 +27,19 @@ namespace xe {
 
         static void init();
 
-        static GLuint program() { return shader_; }
+        // Program of the untextured variant.
+        static GLuint program() { return variants_->program(0u); }
+
+        xe::variant_key_t variant() const;
 
     private:
-        static GLuint shader_;
-        static GLuint color_uniform_buffer_;
+        enum Uniforms { MAP_KD };
 
-        glm::vec4 color_;
+        static std::unique_ptr<xe::ShaderVariants> variants_;
+        static GLuint color_uniform_buffer_;
 
+        xe::color_block_t data_;
 
-        inline static GLint m_uniform_map_Kd_location{0};
         GLuint m_texture{};
         GLuint m_texture_uint{};
     };
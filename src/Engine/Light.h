@@ -1,8 +1,13 @@
 #pragma once
 
+#include <cstdint>
+
 #include <glm/glm.hpp>
 
 namespace xe {
+    // Size of the point light array in the phong shader Lights block.
+    constexpr std::uint32_t MAX_POINT_LIGHTS = 24;
+
     struct PointLight {
         PointLight() = default;
         PointLight(const glm::vec3& pos, const glm::vec3& color, float intensity, float radius)
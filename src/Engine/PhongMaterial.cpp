@@ -1,11 +1,15 @@
 //
 // Created by Piotr Białas on 02/11/2021.
 //
+#include <algorithm>
+
 #define GLM_ENABLE_EXPERIMENTAL
 #include "glm/gtx/string_cast.hpp"
 
 #include "Engine/PhongMaterial.h"
+#include "Engine/Light.h"
 
+#include "Application/gl_state.h"
 #include "Application/utils.h"
 #include "spdlog/spdlog.h"
 #include "stb/stb_image.h"
@@ -13,62 +17,74 @@
 namespace xe {
 
     GLuint PhongMaterial::color_uniform_buffer_ = 0u;
-    GLuint PhongMaterial::shader_ = 0u;
+    std::unique_ptr<xe::ShaderVariants> PhongMaterial::variants_;
 
-    void PhongMaterial::bind() {
-        m_data.use_map_diffuse = 0;
-        if (m_texture > 0) {
-            glUniform1i(m_uniform_map_Kd_location, m_texture_uint);
-            glActiveTexture(GL_TEXTURE0 + m_texture_uint);
-            glBindTexture(GL_TEXTURE_2D, m_texture);
-            m_data.use_map_diffuse = 1;
-        }
+    std::uint32_t PhongMaterial::point_light_variant(std::size_t n) {
+        // The exact count, so the loop needs no bound from the Lights block. Scenes change their light count
+        // rarely, each count used is compiled once.
+        return std::uint32_t(std::min<std::size_t>(n, MAX_POINT_LIGHTS));
+    }
 
-        glBindBufferBase(GL_UNIFORM_BUFFER, 0, color_uniform_buffer_);
-        glUseProgram(program());
-        glBindBuffer(GL_UNIFORM_BUFFER, color_uniform_buffer_);
-        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(PhongMaterialData), &m_data);
-        glBindBuffer(GL_UNIFORM_BUFFER, 0u);
+    xe::variant_key_t PhongMaterial::variant() const {
+        auto key = variants_->encode("N_POINT_LIGHTS", point_light_variant(m_point_light_count));
+        if (m_texture > 0)
+            key |= variants_->encode("HAS_MAP_KD");
+        return key;
     }
 
+    void PhongMaterial::bind() {
+        auto variant = variants_->get(this->variant());
+        if (variant == nullptr)
+            return;
+        auto &gl = synced_gl_state();
+        gl.use_program(variant->program.get());
 
-    void PhongMaterial::init() {
-        auto program = xe::utils::create_program(
-                {{GL_VERTEX_SHADER,   std::string(PROJECT_DIR) + "/shaders/phong_vs.glsl"},
-                 {GL_FRAGMENT_SHADER, std::string(PROJECT_DIR) + "/shaders/phong_fs.glsl"}});
-        if (!program) {
-            std::cerr << "Invalid program\n";
-            exit(-1);
+        m_data.set<"use_map_Kd">(m_texture > 0);
+        if (m_texture > 0) {
+            glUniform1i(variant->uniforms[MAP_KD], m_texture_uint);
+            gl.bind_texture(m_texture_uint, GL_TEXTURE_2D, m_texture);
         }
 
-        shader_ = program;
+        gl.bind_buffer_base(GL_UNIFORM_BUFFER, 0, color_uniform_buffer_);
+        gl.bind_buffer(GL_UNIFORM_BUFFER, color_uniform_buffer_);
+        m_data.upload(GL_UNIFORM_BUFFER);
+        gl.bind_buffer(GL_UNIFORM_BUFFER, 0u);
+    }
 
-        glGenBuffers(1, &color_uniform_buffer_);
 
-        glBindBuffer(GL_UNIFORM_BUFFER, color_uniform_buffer_);
-        glBufferData(GL_UNIFORM_BUFFER, sizeof(PhongMaterialData), nullptr, GL_STATIC_DRAW);
-        glBindBuffer(GL_UNIFORM_BUFFER, 0u);
+    void PhongMaterial::init() {
+        variants_ = std::make_unique<xe::ShaderVariants>(
+                xe::utils::shader_source_map_t{
+                        {GL_VERTEX_SHADER,   std::string(PROJECT_DIR) + "/shaders/phong_vs.glsl"},
+                        {GL_FRAGMENT_SHADER, std::string(PROJECT_DIR) + "/shaders/phong_fs.glsl"}},
+                std::vector<xe::shader_feature_t>{{"HAS_MAP_KD", 1}, {"N_POINT_LIGHTS", 5}},
+                std::vector<std::string>{"map_Kd"},
+                [](GLuint program) {
 #ifdef __APPLE__
-        auto u_modifiers_index = glGetUniformBlockIndex(program, "Color");
-        if (u_modifiers_index == -1) {
-            std::cerr << "Cannot find Color uniform block in program" << std::endl;
-        } else {
-            glUniformBlockBinding(program, u_modifiers_index, 0);
-        }
-#endif
+                    auto u_modifiers_index = glGetUniformBlockIndex(program, "Color");
+                    if (u_modifiers_index == -1) {
+                        std::cerr << "Cannot find Color uniform block in program" << std::endl;
+                    } else {
+                        glUniformBlockBinding(program, u_modifiers_index, 0);
+                    }
 
-#ifdef __APPLE__
-        auto u_transformations_index = glGetUniformBlockIndex(program, "Transformations");
-        if (u_transformations_index == -1) {
-            std::cerr << "Cannot find Transformations uniform block in program" << std::endl;
-        } else {
-            glUniformBlockBinding(program, u_transformations_index, 1);
-        }
+                    auto u_transformations_index = glGetUniformBlockIndex(program, "Transformations");
+                    if (u_transformations_index == -1) {
+                        std::cerr << "Cannot find Transformations uniform block in program" << std::endl;
+                    } else {
+                        glUniformBlockBinding(program, u_transformations_index, 1);
+                    }
 #endif
+                    xe::check_uniform_blocks(program);
+                });
 
-        m_uniform_map_Kd_location = glGetUniformLocation(program, "map_Kd");
-        if (m_uniform_map_Kd_location == -1) {
-            std::cerr << "Cannot get uniform map_Kd location\n";
-        }
+        // Variants listed in the manifest are submitted now, any other one is built when a material first needs it.
+        variants_->preload_manifest(std::string(PROJECT_DIR) + "/shaders/phong.variants");
+        glGenBuffers(1, &color_uniform_buffer_);
+
+        auto &gl = synced_gl_state();
+        gl.bind_buffer(GL_UNIFORM_BUFFER, color_uniform_buffer_);
+        glBufferData(GL_UNIFORM_BUFFER, xe::color_block_t::SIZE, nullptr, GL_STATIC_DRAW);
+        gl.bind_buffer(GL_UNIFORM_BUFFER, 0u);
     }
 }
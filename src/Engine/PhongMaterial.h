@@ -4,26 +4,22 @@
 
 #pragma once
 
+#include <cstddef>
+#include <memory>
+
 #include <glad/gl.h>
 #include <glm/glm.hpp>
 
+#include "Application/shader_variants.h"
 #include "Engine/Material.h"
-
-struct PhongMaterialData
-{
-    glm::vec4 diffuse_color;
-    uint32_t use_map_diffuse;
-    alignas(16) glm::vec3 ambient_color;
-    alignas(16)glm::vec3 specular_color;
-    float specular_strength;
-};
+#include "Engine/uniform_blocks.h"
 
 namespace xe {
     class PhongMaterial : public Material {
     public:
         PhongMaterial(const glm::vec4 color)
         {
-            m_data.diffuse_color = color;
+            m_data.set<"Kd">(color);
         }
 
         void bind() final;
@@ -35,27 +31,38 @@ namespace xe {
 
         void set_ambient(const glm::vec3& p_ambient_color)
         {
-            m_data.ambient_color = p_ambient_color;
+            m_data.set<"m_ambient_color">(p_ambient_color);
         }
 
         void set_specular(const glm::vec3& p_specular_color, const float p_specular_strength)
         {
-            m_data.specular_color = p_specular_color;
-            m_data.specular_strength = p_specular_strength;
+            m_data.set<"m_specular_color">(p_specular_color);
+            m_data.set<"m_specular_strength">(p_specular_strength);
         }
 
         static void init();
 
-        static GLuint program() { return shader_; }
+        // Program of the variant without a texture and lights.
+        static GLuint program() { return variants_->program(0u); }
+
+        // Number of point lights in the Lights block, selects the light loop variant.
+        static void set_point_light_count(std::size_t n) { m_point_light_count = n; }
+
+        // Light loop length compiled into the variant for `n` lights, `n` up to MAX_POINT_LIGHTS.
+        static std::uint32_t point_light_variant(std::size_t n);
+
+        xe::variant_key_t variant() const;
 
     private:
-        static GLuint shader_;
+        enum Uniforms { MAP_KD };
+
+        static std::unique_ptr<xe::ShaderVariants> variants_;
         static GLuint color_uniform_buffer_;
 
-        inline static GLint m_uniform_map_Kd_location{0};
+        inline static std::size_t m_point_light_count{0};
         GLuint m_texture{};
         GLuint m_texture_uint{};
 
-        PhongMaterialData m_data;
+        xe::color_block_t m_data;
     };
 }
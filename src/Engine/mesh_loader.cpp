@@ -4,6 +4,7 @@
 #include "Engine/ColorMaterial.h"
 #include "Engine/PhongMaterial.h"
 #include "ObjectReader/obj_reader.h"
+#include "ObjectReader/vertex_upload.h"
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/string_cast.hpp>
@@ -11,10 +12,13 @@
 
 #include <format>
 #include <iostream>
+#include <map>
 
 namespace
 {
-    xe::ColorMaterial* make_color_material(const xe::mtl_material_t& mat, std::string mtl_dir)
+    using texture_map_t = std::map<std::string, GLuint>;
+
+    xe::ColorMaterial* make_color_material(const xe::mtl_material_t& mat, const texture_map_t& textures)
     {
         glm::vec4 color;
         for (auto i{0}; i < 3; ++i)
@@ -28,7 +32,7 @@ namespace
         auto* material = new xe::ColorMaterial(color);
         if (!mat.diffuse_texname.empty())
         {
-            auto texture = xe::create_texture(mtl_dir + "/" + mat.diffuse_texname);
+            auto texture = textures.at(mat.diffuse_texname);
             std::cout << std::format("Adding Texture {} {:1d}\n", mat.diffuse_texname, texture);
             if (texture > 0)
             {
@@ -39,7 +43,7 @@ namespace
         return material;
     }
 
-    xe::PhongMaterial* make_phong_material(const xe::mtl_material_t& mat, std::string mtl_dir)
+    xe::PhongMaterial* make_phong_material(const xe::mtl_material_t& mat, const texture_map_t& textures)
     {
         glm::vec4 color;
         for (auto i{ 0 }; i < 3; ++i)
@@ -55,7 +59,7 @@ namespace
 
         if (!mat.diffuse_texname.empty())
         {
-            auto texture = xe::create_texture(mtl_dir + "/" + mat.diffuse_texname);
+            auto texture = textures.at(mat.diffuse_texname);
             std::cout << std::format("Adding Texture {} {:1d}", mat.diffuse_texname, texture);
             if (texture > 0) {
                 material->set_texture(texture);
@@ -78,83 +82,35 @@ namespace xe
             return nullptr;
         }
 
-        const auto vertices = smesh.vertex_coords.size();
         const auto indices = 3 * smesh.faces.size();
 
-        auto floats_per_vertex = 3;
-        for (auto&& t: smesh.has_texcoords)
-        {
-            if (t)
-            {
-                floats_per_vertex += 2;
-            }
-        }
-
-        if (smesh.has_normals)
-        {
-            floats_per_vertex += 3;
-        }
-
-        if (smesh.has_tangents)
-        {
-            floats_per_vertex += 4;
-        }
-
-        const auto stride = floats_per_vertex * sizeof(GLfloat);
-
         auto mesh = std::make_shared<Mesh>();
         mesh->allocate_index_buffer(indices * sizeof(uint16_t), GL_STATIC_DRAW);
         mesh->load_indices(0, indices * sizeof(uint16_t), smesh.faces.data());
 
-        mesh->allocate_vertex_buffer(vertices * floats_per_vertex * sizeof(float), GL_STATIC_DRAW);
-        mesh->vertex_attrib_pointer(0, 3, GL_FLOAT, floats_per_vertex * sizeof(GLfloat), 0);
+        upload_smesh_vertices(*mesh, smesh);
 
-        const auto vertex_pointer = static_cast<uint8_t*>(mesh->map_vertex_buffer());
-
-        size_t offset{ 0 };
-        for (auto i = 0; i < smesh.vertex_coords.size(); i++, offset += stride)
+        // All textures are decoded together before the first one is uploaded.
+        texture_map_t textures;
+        for (const auto& sub_mesh : smesh.submeshes)
         {
-            std::cout << std::format("vertex[{}] {} \n", i, to_string(smesh.vertex_coords[i]));
-            std::memcpy(vertex_pointer + offset, value_ptr(smesh.vertex_coords[i]), sizeof(glm::vec3));
-        }
-
-        offset = 3 * sizeof(GLfloat);
-
-        for (uint32_t i{0}; i < sMesh::MAX_TEXCOORDS; ++i)
-        {
-            if (smesh.has_texcoords[i])
+            if (sub_mesh.mat_idx >= 0 && !smesh.materials[sub_mesh.mat_idx].diffuse_texname.empty())
             {
-                mesh->vertex_attrib_pointer(1 + i, 2, GL_FLOAT, stride, offset);
-
-                auto vertex_offset = offset;
-                for (size_t j{0}; j < smesh.vertex_texcoords[i].size(); ++j, vertex_offset += stride)
-                {
-                    std::memcpy(vertex_pointer + vertex_offset, value_ptr(smesh.vertex_texcoords[0][j]), sizeof(glm::vec2));
-                }
-
-                offset += 2 * sizeof(GLfloat);
+                textures.emplace(smesh.materials[sub_mesh.mat_idx].diffuse_texname, 0);
             }
         }
-
-        if (smesh.has_normals)
+        std::vector<std::string> names;
+        for (const auto& [name, texture] : textures)
         {
-            mesh->vertex_attrib_pointer(sMesh::MAX_TEXCOORDS + 1, 3, GL_FLOAT, stride, offset);
-            auto v_offset = offset;
-            for (auto i = 0; i < smesh.vertex_normals.size(); i++, v_offset += stride) {
-                SPDLOG_TRACE("normal[{}] {} ", i, glm::to_string(smesh.vertex_normals[i]));
-                std::memcpy(vertex_pointer + v_offset, glm::value_ptr(smesh.vertex_normals[i]), sizeof(glm::vec3));
-            }
-            offset += 3 * sizeof(GLfloat);
+            names.push_back(mtl_dir + "/" + name);
         }
-
-        if (smesh.has_tangents)
+        auto loaded = create_textures(names);
+        std::size_t t = 0;
+        for (auto& [name, texture] : textures)
         {
-            mesh->vertex_attrib_pointer(sMesh::MAX_TEXCOORDS + 2, 4, GL_FLOAT, stride, offset);
-            offset += 4 * sizeof(GLfloat);
+            texture = loaded[t++];
         }
 
-        mesh->unmap_vertex_buffer();
-
         for (int i = 0; i < smesh.submeshes.size(); ++i)
         {
             auto sub_mesh = smesh.submeshes[i];
@@ -166,10 +122,10 @@ namespace xe
                 switch (mat.illum)
                 {
                 case 0:
-                    material = make_color_material(mat, mtl_dir);
+                    material = make_color_material(mat, textures);
                     break;
                 case 1:
-                    material = make_phong_material(mat, mtl_dir);
+                    material = make_phong_material(mat, textures);
                     break;
                 }
 
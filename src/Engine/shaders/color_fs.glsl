@@ -3,7 +3,7 @@
 layout(location=0) out vec4 vFragColor;
 
 #if __VERSION__ > 410
-layout(std140, binding=0) uniform Modifiers {
+layout(std140, binding=0) uniform Color {
 #else
     layout(std140) uniform Color {
     #endif
@@ -16,10 +16,9 @@ in vec2 vertex_texcoords;
 uniform sampler2D map_Kd;
 
 void main() {
-    if (!use_map_Kd) {
-        vFragColor = Kd;
-    }
-    else {
-        vFragColor = Kd*texture(map_Kd, vertex_texcoords);
-    }
+#ifdef HAS_MAP_KD
+    vFragColor = Kd*texture(map_Kd, vertex_texcoords);
+#else
+    vFragColor = Kd;
+#endif
 }
\ No newline at end of file
@@ -3,7 +3,7 @@
 layout(location=0) out vec4 vFragColor;
 
 #if __VERSION__ > 410
-layout(std140, binding=0) uniform Material {
+layout(std140, binding=0) uniform Color {
 #else
     layout(std140) uniform Color {
     #endif
@@ -16,6 +16,11 @@ layout(std140, binding=0) uniform Material {
 
 const int MAX_POINT_LIGHTS=24;
 
+// Set by the variant to the number of lights in the Lights block, n_p_lights is not read.
+#ifndef N_POINT_LIGHTS
+#define N_POINT_LIGHTS 24
+#endif
+
 struct PointLight {
     vec3 position;
     vec3 color;
@@ -43,30 +48,29 @@ void main() {
     // Ambient
     vec3 ambient = m_ambient_color;
 
-    vec4 color;
-    if (!use_map_Kd) {
-        color = Kd;
-    }
-    else {
-        color = Kd*texture(map_Kd, vertex_texcoords);
-    }
+    vec4 color = Kd;
+#ifdef HAS_MAP_KD
+    color *= texture(map_Kd, vertex_texcoords);
+#endif
 
     vec3 result = vec3(0.0);
-    for (uint i = 0; i < n_p_lights; i++) {
+#if N_POINT_LIGHTS > 0
+    vec3 normal = normalize(vertex_normal);
+    vec3 view_direction = normalize(-vetex_position);
+    for (uint i = 0u; i < uint(N_POINT_LIGHTS); i++) {
         // Diffuse
-        vec3 normal = normalize(vertex_normal);
         vec3 light_direction = normalize(p_light[i].position - vetex_position);
         float diff = max(dot(normal, light_direction), 0.0);
         vec3 diffuse = diff * p_light[i].color * p_light[i].intensity;
 
         // Specular
-        vec3 view_direction = normalize(-vetex_position);
         vec3 reflect_direction = reflect(-light_direction, normal);
         float spec = pow(max(dot(view_direction, reflect_direction), 0.0), 32);
         vec3 specular = m_specular_strength * spec * m_specular_color;
 
         result += (ambient + diffuse + specular) * color.rgb;
     }
+#endif
 
     vFragColor = vec4(result, 1.0);
 }
\ No newline at end of file
@@ -1,41 +1,52 @@
 #include "texture.h"
 
 #include "spdlog/spdlog.h"
-#include "stb/stb_image.h"
+
+#include "Application/gl_state.h"
+#include "Application/texture_loader.h"
+#include "Application/texture_streamer.h"
 
 namespace xe {
     GLuint create_texture(const std::string& name)
     {
-        stbi_set_flip_vertically_on_load(true);
-        GLint width{}, height{}, channels{};
-        const auto img = stbi_load(name.c_str(), &width, &height, &channels, 0);
-        if (!img)
+        GLuint texture{};
+        glGenTextures(1, &texture);
+        // The loader binds through the cache, which does not see the bindings made by the caller.
+        synced_gl_state();
+        if (load_texture_2d(texture, name, {.compression = Compression::AUTO}) == 0)
         {
             spdlog::warn("Could not read image from file `{}'", name);
+            gl_state().forget(GLResource::TEXTURE, texture);
+            glDeleteTextures(1, &texture);
             return 0;
         }
 
-        GLenum format;
-        if (channels == 3)
+        return texture;
+    }
+
+    std::vector<GLuint> create_textures(const std::vector<std::string>& names)
+    {
+        TextureStreamer streamer;
+        std::vector<TextureStreamer::ticket_t> tickets;
+        for (const auto& name : names)
         {
-            format = GL_RGB;
+            tickets.push_back(streamer.submit(name, {.compression = Compression::AUTO}));
         }
-        else if (channels == 4)
+
+        std::vector<GLuint> textures(names.size());
+        glGenTextures(GLsizei(textures.size()), textures.data());
+        synced_gl_state();
+        for (std::size_t i = 0; i < names.size(); ++i)
         {
-            format = GL_RGBA;
+            if (streamer.get(tickets[i], textures[i]) == 0)
+            {
+                spdlog::warn("Could not read image from file `{}'", names[i]);
+                gl_state().forget(GLResource::TEXTURE, textures[i]);
+                glDeleteTextures(1, &textures[i]);
+                textures[i] = 0;
+            }
         }
 
-        GLuint texture{};
-
-        glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
-
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, format, GL_UNSIGNED_BYTE, img);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        glBindTexture(GL_TEXTURE_2D, 0u);
-
-        return texture;
+        return textures;
     }
 }
@@ -3,7 +3,11 @@
 #include <glad/gl.h>
 
 #include <string>
+#include <vector>
 
 namespace xe {
     GLuint create_texture(const std::string& name);
+
+    // Loads the textures in parallel, 0 for the ones that cannot be read.
+    std::vector<GLuint> create_textures(const std::vector<std::string>& names);
 }
@@ -0,0 +1,12 @@
+#include "Engine/uniform_blocks.h"
+
+namespace xe {
+
+    bool check_uniform_blocks(GLuint program) {
+        auto ok = color_block_t::check(program, "Color");
+        ok = transformations_block_t::check(program, "Transformations") && ok;
+        ok = lights_block_t::check(program, "Lights") && ok;
+        ok = camera_block_t::check(program, "Camera") && ok;
+        return ok;
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+#include "Application/block_layout.h"
+#include "Engine/Light.h"
+
+namespace xe {
+    // Uniform blocks of shaders/phong_vs.glsl and shaders/phong_fs.glsl, in the binding order used there.
+
+    // binding 0, shaders/color_fs.glsl declares only the first two fields.
+    using color_block_t = layout::std140_block<
+            layout::field<"Kd", glm::vec4>, layout::field<"use_map_Kd", bool>,
+            layout::field<"m_ambient_color", glm::vec3>, layout::field<"m_specular_color", glm::vec3>,
+            layout::field<"m_specular_strength", float>>;
+
+    // binding 1
+    using transformations_block_t = layout::std140_block<
+            layout::field<"PVM", glm::mat4>, layout::field<"VM", glm::mat4>, layout::field<"N", glm::mat3>>;
+
+    using point_light_layout_t = layout::struct_t<
+            layout::field<"position", glm::vec3>, layout::field<"color", glm::vec3>,
+            layout::field<"intensity", float>, layout::field<"radius", float>>;
+
+    // binding 2
+    using lights_block_t = layout::std140_block<
+            layout::field<"ambient_color", glm::vec3>, layout::field<"n_p_lights", std::uint32_t>,
+            layout::field<"p_light", point_light_layout_t[MAX_POINT_LIGHTS]>>;
+
+    // binding 3
+    using camera_block_t = layout::std140_block<layout::field<"camera_position", glm::vec3>>;
+
+    // Checks the layout of every block above that `program` uses, mismatches are logged.
+    bool check_uniform_blocks(GLuint program);
+}
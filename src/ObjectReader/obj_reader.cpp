@@ -4,6 +4,7 @@
 
 #include "obj_reader.h"
 
+#include <filesystem>
 #include <tuple>
 
 #include "spdlog/spdlog.h"
@@ -143,6 +144,18 @@ namespace {
         return ret;
     }
 
+    // A texture baked into a KTX2 file next to the image, `wood.png` -> `wood.ktx2`, is loaded instead of it.
+    void prefer_ktx2(std::string &texname, const std::string &mtl_base_dir) {
+        if (texname.empty())
+            return;
+        auto baked = std::filesystem::path(texname).replace_extension(".ktx2");
+        std::error_code ec;
+        if (baked.string() != texname && std::filesystem::exists(std::filesystem::path(mtl_base_dir) / baked, ec)) {
+            spdlog::debug("Using `{}' instead of `{}'", baked.string(), texname);
+            texname = baked.string();
+        }
+    }
+
 }
 
 namespace xe {
@@ -164,6 +177,9 @@ namespace xe {
             return s_mesh;
         }
 
+        for (auto &&material: s_mesh.materials)
+            prefer_ktx2(material.diffuse_texname, mtl_base_dir);
+
         create_smesh(s_mesh, attrib, shapes);
 
         return s_mesh;
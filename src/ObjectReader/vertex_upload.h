@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Application/vertex_layout.h"
+#include "sMesh.h"
+
+namespace xe {
+
+    static_assert(sMesh::MAX_TEXCOORDS == vertex::MAX_TEXCOORDS,
+                  "sMesh and vertex layout disagree on the number of texture coordinates");
+
+    /**
+     * @brief Uploads the vertices of `smesh` into the vertex buffer of `mesh`.
+     *
+     * The common attribute combinations use a compile-time layout, anything else falls back to a layout
+     * described at run time. Attribute locations always come from `xe::vertex`.
+     */
+    template<typename Mesh>
+    void upload_smesh_vertices(Mesh &mesh, const sMesh &smesh) {
+        using namespace vertex;
+        const auto n = smesh.vertex_coords.size();
+
+        bool has_texcoords[MAX_TEXCOORDS];
+        auto n_texcoords = 0u;
+        for (auto i = 0u; i < MAX_TEXCOORDS; ++i) {
+            has_texcoords[i] = smesh.has_texcoords[i] && smesh.vertex_texcoords[i].size() == n;
+            n_texcoords += has_texcoords[i];
+        }
+        const bool has_normals = smesh.has_normals && smesh.vertex_normals.size() == n;
+        const bool has_tangents = smesh.has_tangents && smesh.vertex_tangents.size() == n;
+        const bool only_texcoords_0 = n_texcoords == 1 && has_texcoords[0];
+
+        const auto coords = smesh.vertex_coords.data();
+        const auto uv = smesh.vertex_texcoords[0].data();
+        const auto normals = smesh.vertex_normals.data();
+
+        if (!has_tangents) {
+            if (only_texcoords_0 && has_normals) {
+                upload_vertices<VertexLayout<position, texcoord<0>, normal>>(mesh, n, coords, uv, normals);
+                return;
+            }
+            if (only_texcoords_0) {
+                upload_vertices<VertexLayout<position, texcoord<0>>>(mesh, n, coords, uv);
+                return;
+            }
+            if (n_texcoords == 0 && has_normals) {
+                upload_vertices<VertexLayout<position, normal>>(mesh, n, coords, normals);
+                return;
+            }
+            if (n_texcoords == 0) {
+                upload_vertices<VertexLayout<position>>(mesh, n, coords);
+                return;
+            }
+        }
+
+        RuntimeVertexLayout layout;
+        layout.add<position>(coords);
+        if (has_texcoords[0]) layout.add<texcoord<0>>(smesh.vertex_texcoords[0].data());
+        if (has_texcoords[1]) layout.add<texcoord<1>>(smesh.vertex_texcoords[1].data());
+        if (has_texcoords[2]) layout.add<texcoord<2>>(smesh.vertex_texcoords[2].data());
+        if (has_texcoords[3]) layout.add<texcoord<3>>(smesh.vertex_texcoords[3].data());
+        if (has_normals) layout.add<normal>(normals);
+        if (has_tangents) layout.add<tangent>(smesh.vertex_tangents.data());
+        upload_vertices(mesh, n, layout);
+    }
+}
@@ -9,6 +9,7 @@
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 
+#include "XeEngine/Frustum.h"
 #include "XeEngine/rotation.h"
 
 namespace {
@@ -52,6 +53,14 @@ namespace xe {
             far_ = far;
         }
 
+        float fov() const { return fov_; }
+
+        float aspect() const { return aspect_; }
+
+        float near_plane() const { return near_; }
+
+        float far_plane() const { return far_; }
+
         void set_aspect(float aspect) {
             aspect_ = aspect;
         }
@@ -77,6 +86,9 @@ namespace xe {
 
         glm::mat4 projection() const { return glm::perspective(fov_, aspect_, near_, far_); }
 
+        // The view frustum in world space.
+        Frustum frustum() const { return Frustum(projection() * view()); }
+
         void zoom(float y_offset) {
             auto y = inverse_logistics(fov_ / glm::pi<float>());
             y += y_offset;
@@ -3,71 +3,78 @@
 //
 
 #include "ColorMaterial.h"
+#include "Scene.h"
+#include "TextureResidency.h"
 
+#include "Application/gl_state.h"
+#include "Application/texture_loader.h"
 #include "Application/utils.h"
 
 #include "spdlog/spdlog.h"
 
-#include "3rdParty/stb/stb_image.h"
-
 namespace xe {
 
-    GLuint ColorMaterial::shader_ = 0u;
-    GLuint ColorMaterial::color_uniform_buffer_ = 0u;
+    ProgramManager::ticket_t ColorMaterial::ticket_ = ProgramManager::INVALID_TICKET;
+    bool ColorMaterial::resolved_ = false;
+    ProgramHandle ColorMaterial::shader_;
     GLint  ColorMaterial::uniform_map_Kd_location_ = 0;
+    GLint  ColorMaterial::uniform_material_index_location_ = 0;
+
+    void ColorMaterial::update_params() {
+        material_params_t params;
+        params.Kd = Kd_;
+        params.flags = (virtual_Kd_ ? material_params_t::USE_VIRTUAL_KD
+                                    : texture_ ? material_params_t::USE_MAP_KD : 0u) | material_params_t::UNLIT;
+        params.map_Kd_layer = texture_layer_;
+        material_table().set(index(), params);
+    }
 
     void ColorMaterial::bind() {
-        glUseProgram(program());
-        int use_map_Kd = 0;
-        if (texture_ > 0) {
+        auto &gl = gl_state();
+        gl.use_program(program());
+        material_table().upload(0);
+        OGL_CALL(glUniform1ui(uniform_material_index_location_, index()));
+        if (virtual_Kd_) {
+            virtual_Kd_->bind();
+        } else if (texture_) {
             OGL_CALL(glUniform1i(uniform_map_Kd_location_, texture_unit_));
-            OGL_CALL(glActiveTexture(GL_TEXTURE0 + texture_unit_));
-            OGL_CALL(glBindTexture(GL_TEXTURE_2D, texture_));
-            use_map_Kd = 1;
+            gl.bind_texture(texture_unit_, GL_TEXTURE_2D_ARRAY, texture_->get());
         }
-        OGL_CALL(glBindBufferBase(GL_UNIFORM_BUFFER, 0, color_uniform_buffer_));
-
-        glBindBuffer(GL_UNIFORM_BUFFER, color_uniform_buffer_);
-        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::vec4), &Kd_[0]);
-        glBufferSubData(GL_UNIFORM_BUFFER, 4 * sizeof(float), sizeof(GLint), &use_map_Kd);
-        OGL_CALL(glBindBuffer(GL_UNIFORM_BUFFER, 0u));
-
-    }
-
-    void ColorMaterial::unbind() {
-        glBindBuffer(GL_UNIFORM_BUFFER, 0u);
-        glBindTexture(GL_TEXTURE_2D, 0u);
     }
 
     void ColorMaterial::init() {
-
-
-        auto program = xe::utils::create_program(
+        ticket_ = program_manager().submit(
                 {{GL_VERTEX_SHADER,   std::string(PROJECT_DIR) + "/shaders/color_vs.glsl"},
                  {GL_FRAGMENT_SHADER, std::string(PROJECT_DIR) + "/shaders/color_fs.glsl"}});
+        resolved_ = false;
+    }
+
+    GLuint ColorMaterial::program() {
+        if (resolved_)
+            return shader_.get();
+        resolved_ = true;
+
+        auto program = program_manager().get(ticket_);
         if (!program) {
             std::cerr << "Invalid program" << std::endl;
             exit(-1);
         }
 
-        shader_ = program;
+        shader_ = ProgramHandle(program);
+        Scene::check_block_layouts(program);
+        VirtualTexture::setup_program(program);
 
-        glGenBuffers(1, &color_uniform_buffer_);
-
-        glBindBuffer(GL_UNIFORM_BUFFER, color_uniform_buffer_);
-        glBufferData(GL_UNIFORM_BUFFER, sizeof(glm::vec4) + sizeof(GLint), nullptr, GL_STATIC_DRAW);
-        glBindBuffer(GL_UNIFORM_BUFFER, 0u);
 #if __APPLE__
-        auto u_modifiers_index = glGetUniformBlockIndex(shader_, "Color");
+        auto u_modifiers_index = glGetUniformBlockIndex(program, "Materials");
         if (u_modifiers_index == -1) {
-            spdlog::warn("Cannot find  {} uniform block in program", "Color");
+            spdlog::warn("Cannot find  {} uniform block in program", "Materials");
         } else {
             glUniformBlockBinding(program, u_modifiers_index, 0);
         }
 #endif
 
 #if __APPLE__
-        auto u_transformations_index = glGetUniformBlockIndex(shader_, "Transformations");
+        auto u_transformations_index = glGetUniformBlockIndex(program, "Transformations");
         if (u_transformations_index == -1) {
             spdlog::warn("Cannot find  {} uniform block in program", "Transformation");
         } else {
@@ -76,40 +83,55 @@ namespace xe {
 #endif
 
 
-        uniform_map_Kd_location_ = glGetUniformLocation(shader_, "map_Kd");
+        uniform_map_Kd_location_ = glGetUniformLocation(program, "map_Kd");
         if (uniform_map_Kd_location_ == -1) {
             spdlog::warn("Cannot get uniform {} location", "map_Kd");
         }
 
-    }
-
-
-    GLuint create_texture(const std::string &name) {
-
-        stbi_set_flip_vertically_on_load(true);
-        GLint width, height, channels;
-        auto img = stbi_load(name.c_str(), &width, &height, &channels, 0);
-        if (!img) {
-            spdlog::warn("Could not read image from file `{}'", name);
-            return 0;
-        }
-        GLenum format;
-        if (channels == 3)
-            format = GL_RGB;
-        else if (channels == 4) {
-            format = GL_RGBA;
+        uniform_material_index_location_ = glGetUniformLocation(program, "material_index");
+        if (uniform_material_index_location_ == -1) {
+            spdlog::warn("Cannot get uniform {} location", "material_index");
         }
 
-        GLuint texture;
-        glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
+        return program;
+    }
 
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, format, GL_UNSIGNED_BYTE, img);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-        glBindTexture(GL_TEXTURE_2D, 0u);
+    std::shared_ptr<TextureHandle> create_texture(const std::string &name) {
+        return create_textures({name}).front().texture;
+    }
 
-        return texture;
+    std::vector<texture_layer_t> create_textures(const std::vector<std::string> &names) {
+        TextureStreamer streamer;
+        std::vector<TextureStreamer::ticket_t> tickets;
+        for (auto &&name: names)
+            tickets.push_back(streamer.submit(name, {.compression = Compression::AUTO}));
+
+        auto layers = streamer.get_layers(tickets);
+        for (std::size_t i = 0; i < names.size(); ++i)
+            if (!layers[i].texture)
+                spdlog::warn("Could not read image from file `{}'", names[i]);
+            else
+                texture_residency().track(layers[i], names[i], {.compression = Compression::AUTO});
+        return layers;
+    }
+
+    void create_textures_progressive(const std::vector<std::string> &names,
+                                     const std::vector<TextureStreamer::callback_t> &callbacks) {
+        auto &streamer = texture_streamer();
+        std::vector<TextureStreamer::ticket_t> tickets;
+        std::vector<TextureStreamer::callback_t> reporting;
+        for (std::size_t i = 0; i < names.size(); ++i) {
+            tickets.push_back(streamer.submit(names[i], {.compression = Compression::AUTO}));
+            reporting.push_back([name = names[i], callback = callbacks[i]](const texture_layer_t &layer) {
+                if (!layer.texture)
+                    spdlog::warn("Could not read image from file `{}'", name);
+                else
+                    texture_residency().track(layer, name, {.compression = Compression::AUTO});
+                if (callback)
+                    callback(layer);
+            });
+        }
+        streamer.get_layers_progressive(tickets, std::move(reporting));
     }
 }
\ No newline at end of file
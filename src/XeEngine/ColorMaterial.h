@@ -6,43 +6,89 @@
 
 #include "Material.h"
 
+#include <memory>
 #include <string>
+#include <vector>
+
+#include "Application/gl_resource.h"
+#include "Application/program_manager.h"
+#include "Application/texture_streamer.h"
+
+#include "VirtualTexture.h"
 
 namespace xe {
     class ColorMaterial : public Material {
     public:
 
+        // Submits the program for compilation, it is checked and set up on the first call to program().
         static void init();
 
-        static GLuint program() { return shader_; }
+        static GLuint program();
+
+        ColorMaterial(const glm::vec4 color, std::shared_ptr<TextureHandle> texture, GLuint texture_unit) : Kd_(color), texture_(std::move(texture)),
+                                                                                    texture_unit_(texture_unit) {
+            update_params();
+        }
 
-        ColorMaterial(const glm::vec4 color, GLuint texture, GLuint texture_unit) : Kd_(color), texture_(texture),
-                                                                                    texture_unit_(texture_unit) {}
+        ColorMaterial(const glm::vec4 color, std::shared_ptr<TextureHandle> texture) : ColorMaterial(color, std::move(texture), 0) {}
 
-        ColorMaterial(const glm::vec4 color, GLuint texture) : ColorMaterial(color, texture, 0) {}
+        ColorMaterial(const glm::vec4 color) : ColorMaterial(color, nullptr) {}
 
-        ColorMaterial(const glm::vec4 color) : ColorMaterial(color, 0) {}
+        // `tex` is a GL_TEXTURE_2D_ARRAY, the material samples its `layer`.
+        void set_texture(std::shared_ptr<TextureHandle> tex, std::uint32_t layer = 0u) {
+            texture_ = std::move(tex);
+            texture_layer_ = layer;
+            update_params();
+        }
 
-        void set_texture(GLuint tex) { texture_ = tex; }
+        // The diffuse map is streamed from `texture` and replaces the one set with set_texture.
+        void set_virtual_texture(std::shared_ptr<VirtualTexture> texture) {
+            virtual_Kd_ = std::move(texture);
+            update_params();
+        }
 
         void bind() override;
 
-        void unbind() override;
+        GLuint program_id() const override { return program(); }
+
+        GLuint texture_id() const override {
+            return virtual_Kd_ ? virtual_Kd_->cache_texture() : texture_ ? texture_->get() : 0u;
+        }
+
+        bool transparent() const override { return Kd_[3] < 1.0f; }
+
+        VirtualTexture *virtual_texture() const override { return virtual_Kd_.get(); }
 
 
     private:
 
-        static GLuint shader_;
-        static GLuint color_uniform_buffer_;
+        void update_params();
+
+        static ProgramManager::ticket_t ticket_;
+        static bool resolved_;
+        static ProgramHandle shader_;
         static GLint uniform_map_Kd_location_;
+        static GLint uniform_material_index_location_;
 
         glm::vec4 Kd_;
-        GLuint texture_;
+        std::shared_ptr<TextureHandle> texture_;
+        std::uint32_t texture_layer_ = 0u;
+        std::shared_ptr<VirtualTexture> virtual_Kd_;
         GLuint texture_unit_;
     };
 
 
-    GLuint create_texture(const std::string &name);
+    // A texture array with the image as its only layer.
+    std::shared_ptr<TextureHandle> create_texture(const std::string &name);
+
+    // Loads the textures in parallel and packs those of the same size and format into shared texture arrays.
+    // The ones that cannot be read have no texture.
+    std::vector<texture_layer_t> create_textures(const std::vector<std::string> &names);
+
+    // Non-blocking create_textures on texture_streamer(): `callbacks[i]` receives the layer of `names[i]` once its
+    // coarsest mip is uploaded, the finer ones follow over the next frames. Draw with the placeholder until then.
+    void create_textures_progressive(const std::vector<std::string> &names,
+                                     const std::vector<TextureStreamer::callback_t> &callbacks);
 
 }
 
@@ -0,0 +1,198 @@
+#include "DeferredRenderer.h"
+
+#include <string>
+
+#include "glm/gtc/type_ptr.hpp"
+#include "spdlog/spdlog.h"
+
+#include "Application/gl_state.h"
+#include "Application/utils.h"
+
+#include "Camera.h"
+#include "Material.h"
+#include "MaterialTable.h"
+#include "RenderQueue.h"
+#include "Scene.h"
+
+namespace {
+    // Texture unit of map_Kd in the geometry pass.
+    constexpr GLuint MAP_KD_UNIT = 0u;
+    // First texture unit of the G-buffer in the lighting pass, the depth follows the color targets.
+    constexpr GLuint GBUFFER_UNIT = 0u;
+
+    GLint uniform_location(GLuint program, const char *name) {
+        auto location = glGetUniformLocation(program, name);
+        if (location == -1)
+            spdlog::warn("Cannot get uniform {} location", name);
+        return location;
+    }
+}
+
+namespace xe {
+
+    DeferredRenderer::DeferredRenderer() : framebuffer_(FramebufferHandle::create()),
+                                           empty_vao_(VertexArrayHandle::create()) {
+        auto &manager = program_manager();
+        geometry_ticket_ = manager.submit(
+                {{GL_VERTEX_SHADER,   std::string(PROJECT_DIR) + "/shaders/phong_vs.glsl"},
+                 {GL_FRAGMENT_SHADER, std::string(PROJECT_DIR) + "/shaders/gbuffer_fs.glsl"}});
+        lighting_ticket_ = manager.submit(
+                {{GL_VERTEX_SHADER,   std::string(PROJECT_DIR) + "/shaders/deferred_vs.glsl"},
+                 {GL_FRAGMENT_SHADER, std::string(PROJECT_DIR) + "/shaders/deferred_fs.glsl"}});
+    }
+
+    bool DeferredRenderer::resolve_programs() {
+        if (resolved_)
+            return geometry_program_ && lighting_program_;
+        resolved_ = true;
+
+        auto &manager = program_manager();
+        geometry_program_ = ProgramHandle(manager.get(geometry_ticket_));
+        lighting_program_ = ProgramHandle(manager.get(lighting_ticket_));
+        if (!geometry_program_ || !lighting_program_) {
+            spdlog::error("Deferred renderer programs failed to build, falling back to forward rendering");
+            return false;
+        }
+
+        Scene::check_block_layouts(geometry_program_.get());
+        Scene::check_block_layouts(lighting_program_.get());
+        ShadowMaps::setup_program(lighting_program_.get());
+        VirtualTexture::setup_program(geometry_program_.get());
+
+        auto geometry = geometry_program_.get();
+        u_material_index_ = uniform_location(geometry, "material_index");
+        auto &gl = gl_state();
+        gl.use_program(geometry);
+        glUniform1i(uniform_location(geometry, "map_Kd"), MAP_KD_UNIT);
+
+        auto lighting = lighting_program_.get();
+        u_inv_projection_ = uniform_location(lighting, "inv_projection");
+        u_viewport_ = uniform_location(lighting, "viewport");
+        u_ambient_light_ = uniform_location(lighting, "ambient_light");
+        gl.use_program(lighting);
+        glUniform1i(uniform_location(lighting, "gbuffer_normal"), GBUFFER_UNIT + NORMAL);
+        glUniform1i(uniform_location(lighting, "gbuffer_albedo"), GBUFFER_UNIT + ALBEDO);
+        glUniform1i(uniform_location(lighting, "gbuffer_specular"), GBUFFER_UNIT + SPECULAR);
+        glUniform1i(uniform_location(lighting, "gbuffer_ambient"), GBUFFER_UNIT + AMBIENT);
+        glUniform1i(uniform_location(lighting, "gbuffer_depth"), GBUFFER_UNIT + N_TARGETS);
+        return true;
+    }
+
+    void DeferredRenderer::resize(GLsizei width, GLsizei height) {
+        if (width == width_ && height == height_)
+            return;
+        width_ = width;
+        height_ = height;
+
+        struct format_t {
+            GLenum internal_format;
+            GLenum format;
+            GLenum type;
+            std::size_t texel_size;
+        };
+        const format_t formats[N_TARGETS] = {
+                {GL_RG16F, GL_RG,   GL_HALF_FLOAT,    4u},
+                {GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4u},
+                {GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4u},
+                {GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4u}};
+
+        auto &gl = gl_state();
+        auto allocate = [&](TextureHandle &texture, const format_t &f) {
+            texture = TextureHandle::create();
+            gl.bind_texture(0, GL_TEXTURE_2D, texture.get());
+            glTexImage2D(GL_TEXTURE_2D, 0, f.internal_format, width, height, 0, f.format, f.type, nullptr);
+            // Only ever read with texelFetch.
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+            texture.set_size(std::size_t(width) * std::size_t(height) * f.texel_size);
+        };
+
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_.get());
+        for (GLuint i = 0; i < N_TARGETS; ++i) {
+            allocate(targets_[i], formats[i]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, targets_[i].get(), 0);
+        }
+        allocate(depth_, {GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT, 4u});
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth_.get(), 0);
+
+        const GLenum buffers[N_TARGETS] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2,
+                                           GL_COLOR_ATTACHMENT3};
+        glDrawBuffers(N_TARGETS, buffers);
+        auto status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        if (status != GL_FRAMEBUFFER_COMPLETE)
+            spdlog::error("G-buffer framebuffer is incomplete: {:#x}", status);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void DeferredRenderer::render(Scene &scene, const RenderQueue &queue, const glm::ivec4 &viewport) {
+        if (!resolve_programs()) {
+            queue.submit(scene);
+            return;
+        }
+        resize(viewport[2], viewport[3]);
+
+        GLint target = 0;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+
+        auto transparent = queue.pass_begin(RenderQueue::PASS_TRANSPARENT);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_.get());
+        glViewport(0, 0, width_, height_);
+        geometry_pass(scene, queue, transparent);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, GLuint(target));
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        lighting_pass(scene, viewport);
+
+        queue.submit(scene, transparent, queue.order().size());
+    }
+
+    void DeferredRenderer::geometry_pass(Scene &scene, const RenderQueue &queue, std::size_t end) {
+        auto &gl = gl_state();
+        gl.depth_mask(GL_TRUE);
+        const GLfloat zero[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        const GLfloat one = 1.0f;
+        for (GLint i = 0; i < GLint(N_TARGETS); ++i)
+            glClearBufferfv(GL_COLOR, i, zero);
+        glClearBufferfv(GL_DEPTH, 0, &one);
+
+        gl.enable(GL_DEPTH_TEST);
+        gl.depth_func(GL_LESS);
+        gl.use_program(geometry_program_.get());
+        material_table().upload(0);
+
+        queue.submit(scene, 0, end, [&gl, this](const Material *material) {
+            glUniform1ui(u_material_index_, material != nullptr ? material->index() : NO_MATERIAL);
+            if (material != nullptr && material->virtual_texture() != nullptr)
+                material->virtual_texture()->bind();
+            else if (material != nullptr && material->texture_id() != 0u)
+                gl.bind_texture(MAP_KD_UNIT, GL_TEXTURE_2D_ARRAY, material->texture_id());
+        });
+    }
+
+    void DeferredRenderer::lighting_pass(const Scene &scene, const glm::ivec4 &viewport) {
+        auto &gl = gl_state();
+        auto lighting = lighting_program_.get();
+        gl.use_program(lighting);
+
+        auto inv_projection = glm::inverse(scene.camera()->projection());
+        glUniformMatrix4fv(u_inv_projection_, 1, GL_FALSE, glm::value_ptr(inv_projection));
+        glUniform4f(u_viewport_, float(viewport[0]), float(viewport[1]), 1.0f / float(viewport[2]),
+                    1.0f / float(viewport[3]));
+        glUniform3fv(u_ambient_light_, 1, glm::value_ptr(ambient_light_));
+
+        for (GLuint i = 0; i < N_TARGETS; ++i)
+            gl.bind_texture(GBUFFER_UNIT + i, GL_TEXTURE_2D, targets_[i].get());
+        gl.bind_texture(GBUFFER_UNIT + N_TARGETS, GL_TEXTURE_2D, depth_.get());
+
+        // The triangle writes the G-buffer depth, so the forward transparent pass is depth tested against it.
+        gl.enable(GL_DEPTH_TEST);
+        gl.depth_func(GL_ALWAYS);
+        gl.depth_mask(GL_TRUE);
+        gl.disable(GL_CULL_FACE);
+        gl.set(GL_BLEND, false);
+        gl.bind_vertex_array(empty_vao_.get());
+        OGL_CALL(glDrawArrays(GL_TRIANGLES, 0, 3));
+        gl.depth_func(GL_LESS);
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+
+#include "glad/gl.h"
+#include "glm/glm.hpp"
+
+#include "Application/gl_resource.h"
+#include "Application/program_manager.h"
+
+#include "LightClusters.h"
+
+namespace xe {
+
+    // The lighting pass reads the clustered light lists.
+    constexpr bool DEFERRED_RENDERING_SUPPORTED = CLUSTERED_LIGHTING_SUPPORTED;
+
+    class RenderQueue;
+
+    class Scene;
+
+    /**
+     * @brief Deferred shading path of the Scene, next to the forward one.
+     *
+     * The geometry pass draws the opaque part of the render queue with a single program, reading the material
+     * parameters from the material table, into a G-buffer of
+     *   0     - RG16F   octahedral encoded view space normal,
+     *   1     - RGBA8   albedo (Kd), alpha 0 marks unlit materials,
+     *   2     - RGBA8   specular color (Ks), shininess encoded logarithmically in alpha,
+     *   3     - RGBA8   ambient color (Ka), so ambient light is shaded as in the forward phong shader,
+     *   depth - DEPTH_COMPONENT32F.
+     * The lighting pass is a single full screen triangle. It reconstructs the view space position from depth and
+     * loops over the lights of the fragment's cluster, so each pixel is shaded once, by the lights that reach it.
+     * It also copies the G-buffer depth into the target framebuffer, after which the transparent part of the
+     * queue is drawn forward with its own materials.
+     */
+    class DeferredRenderer {
+    public:
+        enum Target : GLuint {
+            NORMAL = 0u, ALBEDO = 1u, SPECULAR = 2u, AMBIENT = 3u, N_TARGETS = 4u
+        };
+
+        // Submits the programs, they are checked on the first render.
+        DeferredRenderer();
+
+        // (Re)allocates the G-buffer, does nothing if the size did not change.
+        void resize(GLsizei width, GLsizei height);
+
+        // Renders the sorted queue into the currently bound framebuffer, `viewport` is x, y, width, height.
+        void render(Scene &scene, const RenderQueue &queue, const glm::ivec4 &viewport);
+
+        void set_ambient_light(const glm::vec3 &ambient) { ambient_light_ = ambient; }
+
+        GLsizei width() const { return width_; }
+
+        GLsizei height() const { return height_; }
+
+        GLuint framebuffer() const { return framebuffer_.get(); }
+
+        GLuint target(Target target) const { return targets_[target].get(); }
+
+        GLuint depth() const { return depth_.get(); }
+
+    private:
+        bool resolve_programs();
+
+        void geometry_pass(Scene &scene, const RenderQueue &queue, std::size_t end);
+
+        void lighting_pass(const Scene &scene, const glm::ivec4 &viewport);
+
+        GLsizei width_ = 0;
+        GLsizei height_ = 0;
+
+        FramebufferHandle framebuffer_;
+        TextureHandle targets_[N_TARGETS];
+        TextureHandle depth_;
+        VertexArrayHandle empty_vao_;
+
+        ProgramManager::ticket_t geometry_ticket_ = ProgramManager::INVALID_TICKET;
+        ProgramManager::ticket_t lighting_ticket_ = ProgramManager::INVALID_TICKET;
+        bool resolved_ = false;
+        ProgramHandle geometry_program_;
+        ProgramHandle lighting_program_;
+        GLint u_material_index_ = -1;
+        GLint u_inv_projection_ = -1;
+        GLint u_viewport_ = -1;
+        GLint u_ambient_light_ = -1;
+
+        glm::vec3 ambient_light_{0.0f};
+    };
+}
@@ -0,0 +1,145 @@
+#include "DepthPrepass.h"
+
+#include <algorithm>
+#include <string>
+
+#include "spdlog/spdlog.h"
+
+#include "Application/gl_state.h"
+
+#include "Mesh.h"
+#include "Scene.h"
+
+namespace xe {
+
+    DepthPrepass::DepthPrepass() {
+        ticket_ = program_manager().submit({{GL_VERTEX_SHADER, std::string(PROJECT_DIR) + "/shaders/depth_vs.glsl"}});
+        for (auto &&q: queries_)
+            q.query = QueryHandle::create();
+    }
+
+    bool DepthPrepass::resolve_program() {
+        if (resolved_)
+            return bool(program_);
+        resolved_ = true;
+
+        program_ = ProgramHandle(program_manager().get(ticket_));
+        if (!program_) {
+            spdlog::error("Depth pre-pass program failed to build, the pre-pass is disabled");
+            return false;
+        }
+        Scene::check_block_layouts(program_.get());
+        return true;
+    }
+
+    void DepthPrepass::collect_queries() {
+        for (std::size_t i = 1; i <= N_QUERIES; ++i) {
+            // Oldest first, so the average sees the frames in order.
+            auto &q = queries_[(next_query_ + i) % N_QUERIES];
+            if (!q.pending)
+                continue;
+            GLuint available = GL_FALSE;
+            glGetQueryObjectuiv(q.query.get(), GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                continue;
+            GLuint passed = 0u;
+            glGetQueryObjectuiv(q.query.get(), GL_QUERY_RESULT, &passed);
+            q.pending = false;
+
+            auto overdraw = float(double(passed) / q.samples);
+            overdraw_ = overdraw_ == 0.0f ? overdraw : overdraw_ + settings_.smoothing * (overdraw - overdraw_);
+        }
+    }
+
+    bool DepthPrepass::begin_query(const glm::ivec4 &viewport) {
+        auto &q = queries_[next_query_];
+        if (q.pending || viewport[2] <= 0 || viewport[3] <= 0)
+            return false;
+        GLint samples = 0;
+        glGetIntegerv(GL_SAMPLES, &samples);
+        q.samples = double(viewport[2]) * double(viewport[3]) * double(std::max(samples, 1));
+        q.pending = true;
+        glBeginQuery(GL_SAMPLES_PASSED, q.query.get());
+        next_query_ = (next_query_ + 1u) % N_QUERIES;
+        return true;
+    }
+
+    void DepthPrepass::render(Scene &scene, const RenderQueue &queue, std::size_t end, const glm::ivec4 &viewport) {
+        collect_queries();
+        switch (mode_) {
+            case Mode::OFF:
+                active_ = false;
+                break;
+            case Mode::ON:
+                active_ = true;
+                break;
+            case Mode::AUTO:
+                if (!active_ && overdraw_ > settings_.enable_overdraw)
+                    active_ = true;
+                else if (active_ && overdraw_ < settings_.disable_overdraw)
+                    active_ = false;
+                break;
+        }
+        if (active_ && (end == 0u || !resolve_program()))
+            active_ = false;
+
+        ++frame_;
+        if (!active_) {
+            auto measuring = begin_query(viewport);
+            queue.submit(scene, 0, end);
+            if (measuring)
+                glEndQuery(GL_SAMPLES_PASSED);
+            return;
+        }
+
+        auto measuring = frame_ % std::max(settings_.measure_interval, 1u) == 0u && begin_query(viewport);
+        depth_pass(scene, queue, end, measuring);
+        if (measuring)
+            glEndQuery(GL_SAMPLES_PASSED);
+
+        auto &gl = gl_state();
+        gl.depth_func(GL_EQUAL);
+        gl.depth_mask(GL_FALSE);
+        queue.submit(scene, 0, end);
+        gl.depth_func(GL_LESS);
+        gl.depth_mask(GL_TRUE);
+    }
+
+    void DepthPrepass::depth_pass(Scene &scene, const RenderQueue &queue, std::size_t end, bool queue_order) {
+        auto &gl = gl_state();
+        auto &items = queue.items();
+        auto &transforms = queue.transforms();
+        auto &sorted = queue.order();
+
+        // Front to back, so the pre-pass itself gets the most out of early depth testing. The queue order passes
+        // as many samples as the shading pass would without the pre-pass, for measuring.
+        order_.clear();
+        for (std::size_t i = 0; i < end; ++i) {
+            auto index = sorted[i].index;
+            order_.push_back({queue_order ? std::uint64_t(i) : RenderQueue::quantize_depth(items[index].depth),
+                              index});
+        }
+        if (!queue_order)
+            radix_sort(order_, scratch_);
+
+        gl.enable(GL_DEPTH_TEST);
+        gl.depth_func(GL_LESS);
+        gl.depth_mask(GL_TRUE);
+        gl.set(GL_BLEND, false);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        gl.use_program(program_.get());
+
+        auto current = ~std::uint32_t(0);
+        for (auto &&entry: order_) {
+            auto &item = items[entry.index];
+            if (item.transform != current) {
+                auto &t = transforms[item.transform];
+                scene.load_transform(t.PVM);
+                gl.front_face(t.orientation > 0 ? GL_CCW : GL_CW);
+                current = item.transform;
+            }
+            item.mesh->draw_submesh_positions(item.submesh);
+        }
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    }
+}
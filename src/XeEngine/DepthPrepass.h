@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "glad/gl.h"
+#include "glm/glm.hpp"
+
+#include "Application/gl_resource.h"
+#include "Application/program_manager.h"
+
+#include "RenderQueue.h"
+
+namespace xe {
+
+    class Scene;
+
+    /**
+     * @brief Optional depth only pass in front of the forward shading of the opaque part of the render queue.
+     *
+     * The pre-pass draws the opaque queue entries front to back from the packed positions of the meshes
+     * (Mesh::draw_submesh_positions) with a program that has no fragment shader and color writes off. The queue
+     * is then shaded in its usual order with GL_EQUAL depth testing and depth writes off, so every pixel runs the
+     * material fragment shader once, whatever the submission order.
+     *
+     * Overdraw is measured with a GL_SAMPLES_PASSED query around the pass that writes depth: the shading pass
+     * without pre-pass, every frame, and the pre-pass itself otherwise, every `measure_interval` frames. On those
+     * frames the pre-pass draws in the state sorted order of the queue instead of front to back, so both modes
+     * count the samples the materials would shade without it. Results are read back a few frames late, without
+     * stalling. In AUTO mode the pre-pass is switched on when the averaged overdraw exceeds `enable_overdraw` and
+     * off again below `disable_overdraw`.
+     */
+    class DepthPrepass {
+    public:
+        enum class Mode {
+            OFF, ON, AUTO
+        };
+
+        struct settings_t {
+            // Shaded samples per viewport sample.
+            float enable_overdraw = 2.0f;
+            float disable_overdraw = 1.5f;
+            // Weight of the newest measurement in the running average.
+            float smoothing = 0.1f;
+            // Frames between measurements while the pre-pass is on, the others draw it front to back.
+            std::uint32_t measure_interval = 8u;
+        };
+
+        // Submits the program, it is checked on the first render.
+        DepthPrepass();
+
+        void set_mode(Mode mode) { mode_ = mode; }
+
+        Mode mode() const { return mode_; }
+
+        void set_settings(const settings_t &settings) { settings_ = settings; }
+
+        const settings_t &settings() const { return settings_; }
+
+        // Whether the last render used the pre-pass.
+        bool active() const { return active_; }
+
+        // Running average of the measured overdraw, 0 before the first measurement.
+        float overdraw() const { return overdraw_; }
+
+        // Draws the sorted opaque entries [0, end) of the queue, with or without the pre-pass. `viewport` is x, y,
+        // width, height.
+        void render(Scene &scene, const RenderQueue &queue, std::size_t end, const glm::ivec4 &viewport);
+
+    private:
+        static constexpr std::size_t N_QUERIES = 4u;
+
+        struct query_t {
+            QueryHandle query;
+            bool pending = false;
+            // Samples of the viewport it was issued for.
+            double samples = 0.0;
+        };
+
+        bool resolve_program();
+
+        void collect_queries();
+
+        // Starts a query if one is free, returns whether it did.
+        bool begin_query(const glm::ivec4 &viewport);
+
+        // Draws the entries front to back, or in the queue order with `queue_order`.
+        void depth_pass(Scene &scene, const RenderQueue &queue, std::size_t end, bool queue_order);
+
+        Mode mode_ = Mode::AUTO;
+        settings_t settings_;
+        bool active_ = false;
+        float overdraw_ = 0.0f;
+        std::uint32_t frame_ = 0u;
+
+        ProgramManager::ticket_t ticket_ = ProgramManager::INVALID_TICKET;
+        bool resolved_ = false;
+        ProgramHandle program_;
+
+        std::array<query_t, N_QUERIES> queries_;
+        std::size_t next_query_ = 0u;
+
+        std::vector<sort_entry_t> order_;
+        std::vector<sort_entry_t> scratch_;
+    };
+}
@@ -0,0 +1,81 @@
+#include "Frustum.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define XE_FRUSTUM_SSE 1
+#endif
+
+namespace xe {
+
+    void sphere_batch_t::clear() {
+        x.clear();
+        y.clear();
+        z.clear();
+        r.clear();
+    }
+
+    void sphere_batch_t::push(const glm::vec3 &center, float radius) {
+        x.push_back(center.x);
+        y.push_back(center.y);
+        z.push_back(center.z);
+        r.push_back(radius);
+    }
+
+    Frustum::Frustum(const glm::mat4 &PV) {
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; ++i)
+            rows[i] = glm::vec4(PV[0][i], PV[1][i], PV[2][i], PV[3][i]);
+        planes_ = {rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[3] + rows[2],
+                   rows[3] - rows[2]};
+        for (auto &&plane: planes_)
+            plane /= glm::length(glm::vec3(plane));
+    }
+
+    Visibility Frustum::test(const glm::vec3 &center, float radius) const {
+        auto result = Visibility::INSIDE;
+        for (auto &&plane: planes_) {
+            auto distance = glm::dot(glm::vec3(plane), center) + plane.w;
+            if (distance < -radius)
+                return Visibility::OUTSIDE;
+            if (distance < radius)
+                result = Visibility::INTERSECTS;
+        }
+        return result;
+    }
+
+    void Frustum::test(const sphere_batch_t &spheres, std::vector<Visibility> &out) const {
+        auto n = spheres.size();
+        out.resize(n);
+        std::size_t i = 0;
+#ifdef XE_FRUSTUM_SSE
+        for (; i + 4u <= n; i += 4u) {
+            auto x = _mm_loadu_ps(&spheres.x[i]);
+            auto y = _mm_loadu_ps(&spheres.y[i]);
+            auto z = _mm_loadu_ps(&spheres.z[i]);
+            auto r = _mm_loadu_ps(&spheres.r[i]);
+            auto minus_r = _mm_sub_ps(_mm_setzero_ps(), r);
+            auto outside = _mm_setzero_ps();
+            auto crossing = _mm_setzero_ps();
+            for (auto &&plane: planes_) {
+                auto d = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), x), _mm_mul_ps(_mm_set1_ps(plane.y), y));
+                d = _mm_add_ps(d, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), z), _mm_set1_ps(plane.w)));
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(d, minus_r));
+                crossing = _mm_or_ps(crossing, _mm_cmplt_ps(d, r));
+            }
+            // An infinite radius is never outside and always crossing.
+            auto out_mask = _mm_movemask_ps(outside);
+            auto crossing_mask = _mm_movemask_ps(crossing);
+            for (std::size_t k = 0; k < 4u; ++k) {
+                if (out_mask & (1 << k))
+                    out[i + k] = Visibility::OUTSIDE;
+                else if (crossing_mask & (1 << k))
+                    out[i + k] = Visibility::INTERSECTS;
+                else
+                    out[i + k] = Visibility::INSIDE;
+            }
+        }
+#endif
+        for (; i < n; ++i)
+            out[i] = test({spheres.x[i], spheres.y[i], spheres.z[i]}, spheres.r[i]);
+    }
+}
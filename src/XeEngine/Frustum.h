@@ -0,0 +1,54 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+namespace xe {
+
+    enum class Visibility : std::uint8_t {
+        OUTSIDE, INTERSECTS, INSIDE
+    };
+
+    // Bounding spheres in structure of arrays layout, so Frustum::test can load four of them at once.
+    struct sphere_batch_t {
+        std::vector<float> x;
+        std::vector<float> y;
+        std::vector<float> z;
+        std::vector<float> r;
+
+        std::size_t size() const { return r.size(); }
+
+        void clear();
+
+        void push(const glm::vec3 &center, float radius);
+    };
+
+    /**
+     * @brief Planes bounding the view volume of a projection times view matrix, in the space it maps from.
+     *
+     * The planes are extracted from the rows of the matrix (Gribb and Hartmann) and normalized, so a plane
+     * evaluated at a point is its signed distance, positive inside.
+     */
+    class Frustum {
+    public:
+        Frustum() = default;
+
+        explicit Frustum(const glm::mat4 &PV);
+
+        // Left, right, bottom, top, near, far.
+        const std::array<glm::vec4, 6> &planes() const { return planes_; }
+
+        Visibility test(const glm::vec3 &center, float radius) const;
+
+        // Writes the visibility of every sphere of the batch into `out`, four spheres per step with SSE2 where it
+        // is available. Spheres with an infinite radius intersect.
+        void test(const sphere_batch_t &spheres, std::vector<Visibility> &out) const;
+
+    private:
+        std::array<glm::vec4, 6> planes_{};
+    };
+}
@@ -0,0 +1,218 @@
+#include "LightClusters.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define XE_CLUSTERS_SSE 1
+#endif
+
+#include "Application/gl_state.h"
+#include "Application/thread_pool.h"
+
+namespace {
+    // Lights per thread pool chunk when computing the ranges.
+    constexpr std::size_t RANGE_CHUNK = 256;
+
+    std::uint16_t tile(float ndc, std::uint32_t tiles) {
+        auto t = std::clamp((ndc * 0.5f + 0.5f) * float(tiles), 0.0f, float(tiles - 1));
+        return static_cast<std::uint16_t>(t);
+    }
+
+    // Screen space bounds of the sphere's bounding box between depths d_min and d_max, as in the SSE path.
+    void sphere_bounds(float c, float r, float inv_min, float inv_max, float p, float &lo, float &hi) {
+        auto l = c - r;
+        auto h = c + r;
+        lo = p * std::min(l * inv_min, l * inv_max);
+        hi = p * std::max(h * inv_min, h * inv_max);
+    }
+}
+
+namespace xe {
+
+    float light_radius(const glm::vec3 &color, const glm::vec3 &atn, float threshold) {
+        // Solve max(color) / (atn.x + atn.y d + atn.z d^2) = threshold for d.
+        auto intensity = std::max({color.x, color.y, color.z});
+        auto c = atn.x - intensity / threshold;
+        if (c >= 0.0f)
+            return 0.0f;
+        if (atn.z > 0.0f)
+            return (-atn.y + std::sqrt(atn.y * atn.y - 4.0f * atn.z * c)) / (2.0f * atn.z);
+        if (atn.y > 0.0f)
+            return -c / atn.y;
+        // Not attenuated, it reaches everything.
+        return INFINITY;
+    }
+
+    void LightClusters::set_projection(float fov, float aspect, float near, float far) {
+        near_ = near;
+        far_ = far;
+        p11_ = 1.0f / std::tan(0.5f * fov);
+        p00_ = p11_ / aspect;
+        // slice = log(d / near) / log(far / near) * SLICES
+        slice_scale_ = float(SLICES) / std::log(far / near);
+        slice_bias_ = -slice_scale_ * std::log(near);
+    }
+
+    std::uint32_t LightClusters::slice(float depth) const {
+        auto s = std::log(std::max(depth, near_)) * slice_scale_ + slice_bias_;
+        return static_cast<std::uint32_t>(std::clamp(s, 0.0f, float(SLICES - 1)));
+    }
+
+    void LightClusters::compute_ranges(std::span<const float> x, std::span<const float> y,
+                                       std::span<const float> z, std::span<const float> radii,
+                                       std::size_t begin, std::size_t end) {
+        const range_t culled{1, 0, 1, 0, 1, 0};
+        std::array<float, 4> d_min, d_max, x_lo, x_hi, y_lo, y_hi;
+
+        auto i = begin;
+#ifdef XE_CLUSTERS_SSE
+        const auto near = _mm_set1_ps(near_);
+        const auto far = _mm_set1_ps(far_);
+        const auto one = _mm_set1_ps(1.0f);
+        const auto minus_one = _mm_set1_ps(-1.0f);
+        const auto p00 = _mm_set1_ps(p00_);
+        const auto p11 = _mm_set1_ps(p11_);
+        for (; i + 4 <= end; i += 4) {
+            auto cx = _mm_loadu_ps(&x[i]);
+            auto cy = _mm_loadu_ps(&y[i]);
+            auto cz = _mm_loadu_ps(&z[i]);
+            auto r = _mm_loadu_ps(&radii[i]);
+
+            auto d = _mm_sub_ps(_mm_setzero_ps(), cz);
+            auto dn = _mm_max_ps(_mm_sub_ps(d, r), near);
+            auto df = _mm_min_ps(_mm_add_ps(d, r), far);
+            auto inv_n = _mm_div_ps(one, dn);
+            auto inv_f = _mm_div_ps(one, df);
+
+            auto xl = _mm_sub_ps(cx, r);
+            auto xh = _mm_add_ps(cx, r);
+            auto yl = _mm_sub_ps(cy, r);
+            auto yh = _mm_add_ps(cy, r);
+            auto nx0 = _mm_mul_ps(p00, _mm_min_ps(_mm_mul_ps(xl, inv_n), _mm_mul_ps(xl, inv_f)));
+            auto nx1 = _mm_mul_ps(p00, _mm_max_ps(_mm_mul_ps(xh, inv_n), _mm_mul_ps(xh, inv_f)));
+            auto ny0 = _mm_mul_ps(p11, _mm_min_ps(_mm_mul_ps(yl, inv_n), _mm_mul_ps(yl, inv_f)));
+            auto ny1 = _mm_mul_ps(p11, _mm_max_ps(_mm_mul_ps(yh, inv_n), _mm_mul_ps(yh, inv_f)));
+
+            auto out = _mm_or_ps(_mm_cmpgt_ps(dn, df),
+                                 _mm_or_ps(_mm_or_ps(_mm_cmplt_ps(nx1, minus_one), _mm_cmpgt_ps(nx0, one)),
+                                           _mm_or_ps(_mm_cmplt_ps(ny1, minus_one), _mm_cmpgt_ps(ny0, one))));
+
+            _mm_storeu_ps(d_min.data(), dn);
+            _mm_storeu_ps(d_max.data(), df);
+            _mm_storeu_ps(x_lo.data(), nx0);
+            _mm_storeu_ps(x_hi.data(), nx1);
+            _mm_storeu_ps(y_lo.data(), ny0);
+            _mm_storeu_ps(y_hi.data(), ny1);
+            auto outside = _mm_movemask_ps(out);
+
+            for (int k = 0; k < 4; ++k) {
+                if ((outside >> k) & 1) {
+                    ranges_[i + k] = culled;
+                    continue;
+                }
+                ranges_[i + k] = {tile(x_lo[k], TILES_X), tile(x_hi[k], TILES_X),
+                                  tile(y_lo[k], TILES_Y), tile(y_hi[k], TILES_Y),
+                                  static_cast<std::uint16_t>(slice(d_min[k])),
+                                  static_cast<std::uint16_t>(slice(d_max[k]))};
+            }
+        }
+#endif
+        for (; i < end; ++i) {
+            auto r = radii[i];
+            auto d = -z[i];
+            auto dn = std::max(d - r, near_);
+            auto df = std::min(d + r, far_);
+            auto inv_n = 1.0f / dn;
+            auto inv_f = 1.0f / df;
+            float nx0, nx1, ny0, ny1;
+            sphere_bounds(x[i], r, inv_n, inv_f, p00_, nx0, nx1);
+            sphere_bounds(y[i], r, inv_n, inv_f, p11_, ny0, ny1);
+            if (dn > df || nx1 < -1.0f || nx0 > 1.0f || ny1 < -1.0f || ny0 > 1.0f) {
+                ranges_[i] = culled;
+                continue;
+            }
+            ranges_[i] = {tile(nx0, TILES_X), tile(nx1, TILES_X), tile(ny0, TILES_Y), tile(ny1, TILES_Y),
+                          static_cast<std::uint16_t>(slice(dn)), static_cast<std::uint16_t>(slice(df))};
+        }
+    }
+
+    void LightClusters::build(std::span<const float> x, std::span<const float> y, std::span<const float> z,
+                              std::span<const float> radii) {
+        auto n = std::min({x.size(), y.size(), z.size(), radii.size()});
+        ranges_.resize(n);
+        clusters_.assign(N_CLUSTERS, {0u, 0u});
+
+        auto &pool = thread_pool();
+        pool.parallel_for(n, [&](std::size_t begin, std::size_t end) {
+            compute_ranges(x, y, z, radii, begin, end);
+        }, RANGE_CHUNK);
+
+        // Every slice is owned by one thread, so the counts and the lists need no synchronisation.
+        pool.parallel_for(SLICES, [&](std::size_t begin, std::size_t end) {
+            for (auto z = begin; z < end; ++z)
+                for (auto &&range: ranges_) {
+                    if (range.culled() || z < range.z0 || z > range.z1)
+                        continue;
+                    for (std::uint32_t y = range.y0; y <= range.y1; ++y)
+                        for (std::uint32_t x = range.x0; x <= range.x1; ++x)
+                            ++clusters_[index(x, y, z)].count;
+                }
+        });
+
+        std::uint32_t offset = 0u;
+        for (auto &&cluster: clusters_) {
+            cluster.offset = offset;
+            offset += cluster.count;
+        }
+        indices_.resize(offset);
+
+        pool.parallel_for(SLICES, [&](std::size_t begin, std::size_t end) {
+            std::array<std::uint32_t, TILES_X * TILES_Y> cursor;
+            for (auto z = begin; z < end; ++z) {
+                for (std::uint32_t c = 0; c < TILES_X * TILES_Y; ++c)
+                    cursor[c] = clusters_[index(0, 0, z) + c].offset;
+                for (std::uint32_t i = 0; i < n; ++i) {
+                    auto &range = ranges_[i];
+                    if (range.culled() || z < range.z0 || z > range.z1)
+                        continue;
+                    for (std::uint32_t y = range.y0; y <= range.y1; ++y)
+                        for (std::uint32_t x = range.x0; x <= range.x1; ++x)
+                            indices_[cursor[y * TILES_X + x]++] = i;
+                }
+            }
+        });
+    }
+
+    void LightClusters::upload(const glm::ivec4 &viewport) {
+#if (MAJOR >= 4) && (MINOR >= 3)
+        auto &gl = gl_state();
+        // Buffers are re-specified every frame so the driver can hand out fresh storage instead of waiting.
+        auto upload_buffer = [&gl](BufferHandle &buffer, GLenum target, GLuint binding, std::size_t bytes,
+                                   const void *data) {
+            if (!buffer)
+                buffer = BufferHandle::create();
+            // Zero sized storage cannot be bound.
+            bytes = std::max<std::size_t>(bytes, 16u);
+            gl.bind_buffer(target, buffer.get());
+            glBufferData(target, bytes, nullptr, GL_STREAM_DRAW);
+            buffer.set_size(bytes);
+            if (data != nullptr)
+                glBufferSubData(target, 0, bytes, data);
+            gl.bind_buffer_base(target, binding, buffer.get());
+        };
+
+        upload_buffer(grid_buffer_, GL_SHADER_STORAGE_BUFFER, GRID_BINDING, clusters_.size() * sizeof(cluster_t),
+                      clusters_.data());
+        upload_buffer(indices_buffer_, GL_SHADER_STORAGE_BUFFER, INDICES_BINDING,
+                      indices_.size() * sizeof(std::uint32_t), indices_.empty() ? nullptr : indices_.data());
+
+        params_t params{{TILES_X, TILES_Y, SLICES, 0u},
+                        {near_, far_, slice_scale_, slice_bias_},
+                        {float(viewport[0]), float(viewport[1]), 1.0f / float(viewport[2]), 1.0f / float(viewport[3])}};
+        upload_buffer(params_buffer_, GL_UNIFORM_BUFFER, PARAMS_BINDING, sizeof(params), &params);
+#endif
+    }
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "glad/gl.h"
+#include "glm/glm.hpp"
+
+#include "Application/block_layout.h"
+#include "Application/gl_resource.h"
+
+#include "lights.h"
+
+namespace xe {
+
+#if (MAJOR >= 4) && (MINOR >= 3)
+    // The clustered path needs shader storage buffers.
+    constexpr bool CLUSTERED_LIGHTING_SUPPORTED = true;
+#else
+    constexpr bool CLUSTERED_LIGHTING_SUPPORTED = false;
+#endif
+
+    // Distance at which the attenuated light intensity drops below `threshold`.
+    float light_radius(const glm::vec3 &color, const glm::vec3 &atn, float threshold = 1.0f / 256.0f);
+
+    inline float light_radius(const PointLight &light, float threshold = 1.0f / 256.0f) {
+        return light_radius(light.color, light.atn, threshold);
+    }
+
+    /**
+     * @brief Froxel grid over the view frustum with the list of point lights touching each cell.
+     *
+     * The screen is split into TILES_X x TILES_Y tiles and the depth range into SLICES exponentially spaced slices.
+     * Lights are bounded by a sphere of their radius; the screen space bounds of these spheres are computed four at
+     * a time with SSE, and the slices are filled in parallel on the thread pool. The binning is pure CPU work, so it
+     * can be run and checked without a GL context; `upload` then copies the result into the shader storage buffers
+     * read by shaders/clusters.glsl. The light indices refer to the local lights of the LightManager block.
+     */
+    class LightClusters {
+    public:
+        static constexpr std::uint32_t TILES_X = 16u;
+        static constexpr std::uint32_t TILES_Y = 9u;
+        static constexpr std::uint32_t SLICES = 24u;
+        static constexpr std::uint32_t N_CLUSTERS = TILES_X * TILES_Y * SLICES;
+
+        // Binding points, must match shaders/clusters.glsl.
+        static constexpr GLuint GRID_BINDING = 1u;
+        static constexpr GLuint INDICES_BINDING = 2u;
+        static constexpr GLuint PARAMS_BINDING = 4u;
+
+        struct cluster_t {
+            std::uint32_t offset;
+            std::uint32_t count;
+        };
+
+        // std140 ClusterParams.
+        struct params_t {
+            glm::uvec4 dims;
+            // near, far, slice scale, slice bias
+            glm::vec4 depth;
+            // x, y, 1/width, 1/height
+            glm::vec4 viewport;
+        };
+
+        // Inclusive cluster ranges covered by one light, x0 > x1 when the light is outside the frustum.
+        struct range_t {
+            std::uint16_t x0, x1, y0, y1, z0, z1;
+
+            bool culled() const { return x0 > x1; }
+        };
+
+        using params_block_t = layout::std140_block<
+                layout::field<"cluster_dims", glm::uvec4>, layout::field<"cluster_depth", glm::vec4>,
+                layout::field<"cluster_viewport", glm::vec4>>;
+
+        static_assert(sizeof(params_t) == params_block_t::SIZE);
+
+        void set_projection(float fov, float aspect, float near, float far);
+
+        // Slice containing the point at distance `depth` in front of the camera.
+        std::uint32_t slice(float depth) const;
+
+        static std::uint32_t index(std::uint32_t x, std::uint32_t y, std::uint32_t z) {
+            return (z * TILES_Y + y) * TILES_X + x;
+        }
+
+        // Bins the lights given by their view space centers and radii.
+        void build(std::span<const float> x, std::span<const float> y, std::span<const float> z,
+                   std::span<const float> radii);
+
+        const std::vector<range_t> &ranges() const { return ranges_; }
+
+        const std::vector<cluster_t> &clusters() const { return clusters_; }
+
+        const std::vector<std::uint32_t> &indices() const { return indices_; }
+
+        // Copies the result of the last `build` to the GPU and binds the buffers. `viewport` is x, y, width, height.
+        void upload(const glm::ivec4 &viewport);
+
+    private:
+        void compute_ranges(std::span<const float> x, std::span<const float> y, std::span<const float> z,
+                            std::span<const float> radii, std::size_t begin, std::size_t end);
+
+        float near_ = 0.1f;
+        float far_ = 100.0f;
+        float p00_ = 1.0f;
+        float p11_ = 1.0f;
+        float slice_scale_ = 1.0f;
+        float slice_bias_ = 0.0f;
+
+        std::vector<range_t> ranges_;
+        std::vector<cluster_t> clusters_;
+        std::vector<std::uint32_t> indices_;
+
+        BufferHandle grid_buffer_;
+        BufferHandle indices_buffer_;
+        BufferHandle params_buffer_;
+    };
+}
@@ -0,0 +1,227 @@
+#include "LightManager.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define XE_LIGHTS_SSE 1
+#endif
+
+#include "spdlog/spdlog.h"
+
+#include "Application/gl_state.h"
+
+#include "LightClusters.h"
+
+namespace {
+#if (MAJOR >= 4) && (MINOR >= 3)
+    constexpr GLenum LIGHTS_TARGET = GL_SHADER_STORAGE_BUFFER;
+    constexpr bool LIGHTS_UNLIMITED = true;
+#else
+    constexpr GLenum LIGHTS_TARGET = GL_UNIFORM_BUFFER;
+    constexpr bool LIGHTS_UNLIMITED = false;
+#endif
+
+    // (ox, oy, oz) = M * (x, y, z, w) for every element.
+    void transform(const glm::mat4 &M, float w, const std::vector<float> &x, const std::vector<float> &y,
+                   const std::vector<float> &z, std::vector<float> &ox, std::vector<float> &oy,
+                   std::vector<float> &oz) {
+        const auto n = x.size();
+        ox.resize(n);
+        oy.resize(n);
+        oz.resize(n);
+
+        std::size_t i = 0;
+#ifdef XE_LIGHTS_SSE
+        __m128 m[4][3];
+        for (int c = 0; c < 4; ++c)
+            for (int r = 0; r < 3; ++r)
+                m[c][r] = _mm_set1_ps(c == 3 ? M[c][r] * w : M[c][r]);
+        for (; i + 4 <= n; i += 4) {
+            auto vx = _mm_loadu_ps(&x[i]);
+            auto vy = _mm_loadu_ps(&y[i]);
+            auto vz = _mm_loadu_ps(&z[i]);
+            float *out[3] = {&ox[i], &oy[i], &oz[i]};
+            for (int r = 0; r < 3; ++r) {
+                auto v = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0][r], vx), _mm_mul_ps(m[1][r], vy)),
+                                    _mm_add_ps(_mm_mul_ps(m[2][r], vz), m[3][r]));
+                _mm_storeu_ps(out[r], v);
+            }
+        }
+#endif
+        for (; i < n; ++i) {
+            auto v = M * glm::vec4(x[i], y[i], z[i], w);
+            ox[i] = v.x;
+            oy[i] = v.y;
+            oz[i] = v.z;
+        }
+    }
+
+    glm::vec3 normalized(const glm::vec3 &v) {
+        auto l = glm::length(v);
+        return l > 0.0f ? v / l : glm::vec3(0.0f, 0.0f, -1.0f);
+    }
+}
+
+namespace xe {
+
+    void LightManager::set_local(std::uint32_t i, Type type, const glm::vec3 &position, const glm::vec3 &direction,
+                                 const glm::vec3 &color, const glm::vec3 &atn, float inner_angle,
+                                 float outer_angle) {
+        x_[i] = position.x;
+        y_[i] = position.y;
+        z_[i] = position.z;
+        axis_x_[i] = direction.x;
+        axis_y_[i] = direction.y;
+        axis_z_[i] = direction.z;
+        color_type_[i] = glm::vec4(color, float(type));
+        auto cos_outer = std::cos(outer_angle);
+        // The shader fades with smoothstep(cos_outer, cos_inner, .), which needs distinct edges.
+        auto cos_inner = std::max(std::cos(std::min(inner_angle, outer_angle)), cos_outer + 1e-4f);
+        atn_cos_inner_[i] = glm::vec4(atn, cos_inner);
+        cos_outer_[i] = cos_outer;
+        range_[i] = light_radius(color, atn);
+        type_[i] = type;
+        dirty_ = true;
+    }
+
+    std::uint32_t LightManager::add(const PointLight &light) {
+        auto i = static_cast<std::uint32_t>(n_local());
+        for (auto *v: {&x_, &y_, &z_, &axis_x_, &axis_y_, &axis_z_, &cos_outer_, &range_})
+            v->push_back(0.0f);
+        color_type_.emplace_back();
+        atn_cos_inner_.emplace_back();
+        type_.push_back(POINT);
+        shadow_.push_back(-1);
+        set(i, light);
+        return i;
+    }
+
+    std::uint32_t LightManager::add(const SpotLight &light) {
+        auto i = add(PointLight());
+        set(i, light);
+        return i;
+    }
+
+    std::uint32_t LightManager::add(const DirectionalLight &light) {
+        auto i = static_cast<std::uint32_t>(n_directional());
+        for (auto *v: {&dir_x_, &dir_y_, &dir_z_})
+            v->push_back(0.0f);
+        dir_color_.emplace_back();
+        dir_shadow_.push_back(-1);
+        set(i, light);
+        return i;
+    }
+
+    void LightManager::set(std::uint32_t i, const PointLight &light) {
+        set_local(i, POINT, light.position_in_world_space, glm::vec3(0.0f), light.color, light.atn, 0.0f, 0.0f);
+    }
+
+    void LightManager::set(std::uint32_t i, const SpotLight &light) {
+        set_local(i, SPOT, light.position_in_world_space, normalized(light.direction_in_world_space), light.color,
+                  light.atn, light.inner_angle, light.outer_angle);
+    }
+
+    void LightManager::set(std::uint32_t i, const DirectionalLight &light) {
+        auto direction = normalized(light.direction_in_world_space);
+        dir_x_[i] = direction.x;
+        dir_y_[i] = direction.y;
+        dir_z_[i] = direction.z;
+        dir_color_[i] = light.color;
+        dirty_ = true;
+    }
+
+    void LightManager::clear() {
+        for (auto *v: {&x_, &y_, &z_, &axis_x_, &axis_y_, &axis_z_, &cos_outer_, &range_, &dir_x_, &dir_y_,
+                       &dir_z_})
+            v->clear();
+        color_type_.clear();
+        atn_cos_inner_.clear();
+        type_.clear();
+        shadow_.clear();
+        dir_color_.clear();
+        dir_shadow_.clear();
+        dirty_ = true;
+    }
+
+    void LightManager::set_shadow(Type type, std::uint32_t i, std::int32_t slot) {
+        auto &shadow = type == DIRECTIONAL ? dir_shadow_[i] : shadow_[i];
+        if (shadow != slot) {
+            shadow = slot;
+            dirty_ = true;
+        }
+    }
+
+    bool LightManager::update(const glm::mat4 &view) {
+        if (!dirty_ && view == view_)
+            return false;
+        view_ = view;
+        dirty_ = false;
+        uploaded_ = false;
+
+        transform(view, 1.0f, x_, y_, z_, view_x_, view_y_, view_z_);
+        transform(view, 0.0f, axis_x_, axis_y_, axis_z_, view_axis_x_, view_axis_y_, view_axis_z_);
+        transform(view, 0.0f, dir_x_, dir_y_, dir_z_, view_dir_x_, view_dir_y_, view_dir_z_);
+
+        auto n = n_local();
+        auto m = n_directional();
+        if (!LIGHTS_UNLIMITED && n + m > MAX_UNIFORM_LIGHTS) {
+            static bool warned = false;
+            if (!std::exchange(warned, true))
+                spdlog::warn("Only {} of {} lights fit in the uniform buffer", MAX_UNIFORM_LIGHTS, n + m);
+            n = std::min<std::size_t>(n, MAX_UNIFORM_LIGHTS);
+            m = std::min<std::size_t>(m, MAX_UNIFORM_LIGHTS - n);
+        }
+
+        lights_.resize(n + m);
+        for (std::size_t i = 0; i < n; ++i)
+            lights_[i] = {{view_x_[i], view_y_[i], view_z_[i], range_[i]},
+                          color_type_[i],
+                          atn_cos_inner_[i],
+                          {view_axis_x_[i], view_axis_y_[i], view_axis_z_[i],
+                           type_[i] == SPOT ? cos_outer_[i] : float(shadow_[i])}};
+        for (std::size_t j = 0; j < m; ++j)
+            lights_[n + j] = {glm::vec4(0.0f, 0.0f, 0.0f, float(dir_shadow_[j])),
+                              glm::vec4(dir_color_[j], float(DIRECTIONAL)),
+                              glm::vec4(0.0f),
+                              {view_dir_x_[j], view_dir_y_[j], view_dir_z_[j], 0.0f}};
+        counts_ = glm::uvec4(n, m, 0u, 0u);
+        return true;
+    }
+
+    void LightManager::upload() {
+        auto &gl = gl_state();
+        if (!buffer_)
+            buffer_ = BufferHandle::create();
+
+        if (!uploaded_) {
+            const auto header = sizeof(counts_);
+            const auto bytes = header + lights_.size() * sizeof(gpu_light_t);
+            // A uniform block has to be backed by its full declared size.
+            auto capacity = LIGHTS_UNLIMITED ? bytes : header + MAX_UNIFORM_LIGHTS * sizeof(gpu_light_t);
+
+            gl.bind_buffer(LIGHTS_TARGET, buffer_.get());
+            if (capacity > buffer_.size()) {
+                capacity = std::max(capacity, 2 * buffer_.size());
+                glBufferData(LIGHTS_TARGET, capacity, nullptr, GL_DYNAMIC_DRAW);
+                buffer_.set_size(capacity);
+            }
+            // Invalidating lets the driver hand out fresh storage instead of waiting for the previous frame.
+            auto data = static_cast<unsigned char *>(
+                    glMapBufferRange(LIGHTS_TARGET, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+            if (data != nullptr) {
+                std::memcpy(data, &counts_, header);
+                if (!lights_.empty())
+                    std::memcpy(data + header, lights_.data(), lights_.size() * sizeof(gpu_light_t));
+                glUnmapBuffer(LIGHTS_TARGET);
+                uploaded_ = true;
+            } else {
+                spdlog::error("Cannot map the light buffer");
+            }
+        }
+        gl.bind_buffer_base(LIGHTS_TARGET, BINDING, buffer_.get());
+    }
+}
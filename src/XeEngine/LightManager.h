@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "glad/gl.h"
+#include "glm/glm.hpp"
+
+#include "Application/block_layout.h"
+#include "Application/gl_resource.h"
+
+#include "lights.h"
+
+namespace xe {
+
+    /**
+     * @brief Point, spot and directional lights of a scene, kept as structure of arrays.
+     *
+     * `update` moves all lights to view space in one batch, four at a time with SSE, and packs them into the
+     * std140 `Lights` block of shaders/lights.glsl: the light counts, then the point and spot ("local") lights in
+     * the order they were added, then the directional lights. Nothing is recomputed or uploaded unless a light or
+     * the view matrix changed, and the block is sent with a single call.
+     *
+     * From OpenGL 4.3 the block lives in a shader storage buffer and the number of lights is not limited. With
+     * OpenGL 4.1 it is a uniform buffer holding at most MAX_UNIFORM_LIGHTS lights.
+     */
+    class LightManager {
+    public:
+        static constexpr GLuint BINDING = 3u;
+        // Must match MAX_LIGHTS in shaders/lights.glsl, 16 + 255 * 64 bytes fits the minimal 16KB block size.
+        static constexpr std::uint32_t MAX_UNIFORM_LIGHTS = 255u;
+
+        // Stored in color_type.w.
+        enum Type : std::uint32_t {
+            POINT = 0u, SPOT = 1u, DIRECTIONAL = 2u
+        };
+
+        // std140 Light.
+        struct gpu_light_t {
+            // View space position and range of local lights, the shadow slot of directional lights.
+            glm::vec4 position_range;
+            glm::vec4 color_type;
+            // Attenuation, cosine of the inner cone angle.
+            glm::vec4 atn_cos_inner;
+            // View space direction, cosine of the outer cone angle of spot lights or the shadow slot of point
+            // lights.
+            glm::vec4 direction_cos_outer;
+        };
+
+        using light_layout_t = layout::struct_t<
+                layout::field<"position_range", glm::vec4>, layout::field<"color_type", glm::vec4>,
+                layout::field<"atn_cos_inner", glm::vec4>, layout::field<"direction_cos_outer", glm::vec4>>;
+
+        static_assert(sizeof(gpu_light_t) == layout::size_of<layout::Packing::STD140, light_layout_t>);
+
+#if (MAJOR >= 4) && (MINOR >= 3)
+        static constexpr layout::Interface INTERFACE = layout::Interface::STORAGE;
+        // The lights array is runtime sized, only its first element is described.
+        using lights_block_t = layout::std140_block<layout::field<"light_counts", glm::uvec4>,
+                layout::field<"lights", light_layout_t[1]>>;
+#else
+        static constexpr layout::Interface INTERFACE = layout::Interface::UNIFORM;
+        using lights_block_t = layout::std140_block<layout::field<"light_counts", glm::uvec4>,
+                layout::field<"lights", light_layout_t[MAX_UNIFORM_LIGHTS]>>;
+#endif
+
+        // Point and spot lights share one range of indices, directional lights have their own.
+        std::uint32_t add(const PointLight &light);
+
+        std::uint32_t add(const SpotLight &light);
+
+        std::uint32_t add(const DirectionalLight &light);
+
+        void set(std::uint32_t i, const PointLight &light);
+
+        void set(std::uint32_t i, const SpotLight &light);
+
+        void set(std::uint32_t i, const DirectionalLight &light);
+
+        void clear();
+
+        // Shadow map slot of light i of the given type, see ShadowMaps. -1 disables the shadow, spot lights have
+        // none.
+        void set_shadow(Type type, std::uint32_t i, std::int32_t slot);
+
+        Type type(std::uint32_t i) const { return type_[i]; }
+
+        // World space position of local light i and direction of directional light i.
+        glm::vec3 position(std::uint32_t i) const { return {x_[i], y_[i], z_[i]}; }
+
+        glm::vec3 direction(std::uint32_t i) const { return {dir_x_[i], dir_y_[i], dir_z_[i]}; }
+
+        std::size_t n_local() const { return type_.size(); }
+
+        std::size_t n_directional() const { return dir_x_.size(); }
+
+        // Transforms the lights to view space and rebuilds the block. Returns false, doing nothing, when neither
+        // the lights nor `view` changed since the last call.
+        bool update(const glm::mat4 &view);
+
+        // Sends the block to the GPU if `update` changed it, and binds it.
+        void upload();
+
+        // View space centers and ranges of the local lights, as of the last update.
+        std::span<const float> view_x() const { return view_x_; }
+
+        std::span<const float> view_y() const { return view_y_; }
+
+        std::span<const float> view_z() const { return view_z_; }
+
+        std::span<const float> ranges() const { return range_; }
+
+        std::span<const gpu_light_t> gpu_lights() const { return lights_; }
+
+    private:
+        void set_local(std::uint32_t i, Type type, const glm::vec3 &position, const glm::vec3 &direction,
+                       const glm::vec3 &color, const glm::vec3 &atn, float inner_angle, float outer_angle);
+
+        // World space, local lights.
+        std::vector<float> x_, y_, z_;
+        // Spot light axes, zero for point lights.
+        std::vector<float> axis_x_, axis_y_, axis_z_;
+        std::vector<glm::vec4> color_type_;
+        std::vector<glm::vec4> atn_cos_inner_;
+        std::vector<float> cos_outer_;
+        std::vector<float> range_;
+        std::vector<Type> type_;
+        std::vector<std::int32_t> shadow_;
+
+        // World space, directional lights.
+        std::vector<float> dir_x_, dir_y_, dir_z_;
+        std::vector<glm::vec3> dir_color_;
+        std::vector<std::int32_t> dir_shadow_;
+
+        // View space.
+        std::vector<float> view_x_, view_y_, view_z_;
+        std::vector<float> view_axis_x_, view_axis_y_, view_axis_z_;
+        std::vector<float> view_dir_x_, view_dir_y_, view_dir_z_;
+
+        glm::uvec4 counts_{0u};
+        std::vector<gpu_light_t> lights_;
+
+        glm::mat4 view_{0.0f};
+        bool dirty_ = true;
+        bool uploaded_ = false;
+        BufferHandle buffer_;
+    };
+}
@@ -4,24 +4,48 @@
 
 #pragma once
 
+#include <cstdint>
+
 #include <glad/gl.h>
 #include <glm/glm.hpp>
 
+#include "MaterialTable.h"
+
 
 namespace xe {
 
+    class VirtualTexture;
 
     class Material {
     public:
 
+        Material() : index_(material_table().allocate()) {}
+
+        Material(const Material &) = delete;
+
+        Material &operator=(const Material &) = delete;
+
+        virtual ~Material() { material_table().release(index_); }
 
         virtual void bind() = 0;
 
         virtual void unbind() {};
 
+        // Slot of this material in the material table, also used in the render queue sort keys.
+        std::uint32_t index() const { return index_; }
+
+        virtual GLuint program_id() const { return 0u; }
+
+        virtual GLuint texture_id() const { return 0u; }
+
+        virtual bool transparent() const { return false; }
+
+        // Diffuse map streamed as a virtual texture, drawn into the feedback pass by VirtualTextureFeedback.
+        virtual VirtualTexture *virtual_texture() const { return nullptr; }
 
-    protected:
 
+    private:
+        std::uint32_t index_;
     };
 
 }
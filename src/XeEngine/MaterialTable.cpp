@@ -0,0 +1,76 @@
+#include "MaterialTable.h"
+
+#include <algorithm>
+
+#include "spdlog/spdlog.h"
+
+#include "Application/gl_state.h"
+
+namespace xe {
+
+    MaterialTable &material_table() {
+        // Leaked on purpose, materials held in static objects may release their slots after main returns.
+        static auto table = new MaterialTable;
+        return *table;
+    }
+
+    std::uint32_t MaterialTable::allocate() {
+        std::uint32_t index;
+        if (!free_.empty()) {
+            index = free_.back();
+            free_.pop_back();
+        } else {
+            if (params_.size() == MAX_MATERIALS) {
+                // Sharing a slot would let two materials overwrite each other's parameters.
+                spdlog::error("Material table is full ({} materials), the material uses the default parameters",
+                              MAX_MATERIALS);
+                return NO_MATERIAL;
+            }
+            index = static_cast<std::uint32_t>(params_.size());
+            params_.emplace_back();
+        }
+        params_[index] = material_params_t{};
+        mark_dirty(index);
+        return index;
+    }
+
+    void MaterialTable::release(std::uint32_t index) {
+        if (index != NO_MATERIAL)
+            free_.push_back(index);
+    }
+
+    const material_params_t &MaterialTable::get(std::uint32_t index) const {
+        static const material_params_t defaults;
+        return index != NO_MATERIAL ? params_[index] : defaults;
+    }
+
+    void MaterialTable::set(std::uint32_t index, const material_params_t &params) {
+        if (index == NO_MATERIAL || params_[index] == params)
+            return;
+        params_[index] = params;
+        mark_dirty(index);
+    }
+
+    void MaterialTable::mark_dirty(std::uint32_t index) {
+        dirty_begin_ = std::min(dirty_begin_, index);
+        dirty_end_ = std::max(dirty_end_, index + 1);
+    }
+
+    void MaterialTable::upload(GLuint binding) {
+        auto &gl = gl_state();
+        if (!buffer_) {
+            buffer_ = BufferHandle::create();
+            gl.bind_buffer(GL_UNIFORM_BUFFER, buffer_.get());
+            glBufferData(GL_UNIFORM_BUFFER, MAX_MATERIALS * sizeof(material_params_t), nullptr, GL_DYNAMIC_DRAW);
+            buffer_.set_size(MAX_MATERIALS * sizeof(material_params_t));
+        }
+        if (dirty()) {
+            gl.bind_buffer(GL_UNIFORM_BUFFER, buffer_.get());
+            glBufferSubData(GL_UNIFORM_BUFFER, dirty_begin_ * sizeof(material_params_t),
+                            (dirty_end_ - dirty_begin_) * sizeof(material_params_t), &params_[dirty_begin_]);
+            dirty_begin_ = MAX_MATERIALS;
+            dirty_end_ = 0u;
+        }
+        gl.bind_buffer_base(GL_UNIFORM_BUFFER, binding, buffer_.get());
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "glad/gl.h"
+#include "glm/glm.hpp"
+
+#include "Application/block_layout.h"
+#include "Application/gl_resource.h"
+
+namespace xe {
+
+    // Must match MAX_MATERIALS in the color and phong shaders.
+    const std::uint32_t MAX_MATERIALS = 256u;
+    // Out of range index of materials without a slot, the shaders use the default parameters for it.
+    const std::uint32_t NO_MATERIAL = MAX_MATERIALS;
+
+    // std140 layout of the MaterialParams struct in the shaders.
+    struct material_params_t {
+        enum Flags : std::uint32_t {
+            USE_MAP_KA = 1u, USE_MAP_KD = 2u, USE_MAP_KS = 4u, USE_MAP_NS = 8u, UNLIT = 16u,
+            // map_Kd is the bound virtual texture, see VirtualTexture.
+            USE_VIRTUAL_KD = 32u
+        };
+
+        glm::vec4 Ka{0.0f};
+        glm::vec4 Kd{1.0f};
+        glm::vec4 Ks{0.0f};
+        float Ns = 0.0f;
+        float Ns_offset = 0.0f;
+        std::uint32_t flags = 0u;
+        // Layer of map_Kd in its texture array.
+        std::uint32_t map_Kd_layer = 0u;
+
+        bool operator==(const material_params_t &) const = default;
+    };
+
+    using material_layout_t = layout::struct_t<
+            layout::field<"Ka", glm::vec4>, layout::field<"Kd", glm::vec4>, layout::field<"Ks", glm::vec4>,
+            layout::field<"Ns", float>, layout::field<"Ns_offset", float>, layout::field<"flags", std::uint32_t>,
+            layout::field<"map_Kd_layer", std::uint32_t>>;
+
+    using materials_block_t = layout::std140_block<layout::field<"materials", material_layout_t[MAX_MATERIALS]>>;
+
+    // The table is uploaded in slot ranges straight from material_params_t, which must agree with the layout.
+    static_assert(sizeof(material_params_t) == layout::size_of<layout::Packing::STD140, material_layout_t>);
+    static_assert(offsetof(material_params_t, Ks) == layout::offset_of<layout::Packing::STD140, material_layout_t, "Ks">);
+    static_assert(offsetof(material_params_t, Ns) == layout::offset_of<layout::Packing::STD140, material_layout_t, "Ns">);
+    static_assert(offsetof(material_params_t, flags) ==
+                  layout::offset_of<layout::Packing::STD140, material_layout_t, "flags">);
+
+    /**
+     * @brief Parameters of all materials packed in a single uniform buffer.
+     *
+     * Each material owns one slot and selects it in the shader with the `material_index` uniform.
+     * Only the range of slots changed since the last upload is sent to the GPU.
+     */
+    class MaterialTable {
+    public:
+        // Returns NO_MATERIAL when all slots are taken.
+        std::uint32_t allocate();
+
+        // Ignores NO_MATERIAL.
+        void release(std::uint32_t index);
+
+        // The default parameters for NO_MATERIAL.
+        const material_params_t &get(std::uint32_t index) const;
+
+        // Ignored for NO_MATERIAL.
+        void set(std::uint32_t index, const material_params_t &params);
+
+        bool dirty() const { return dirty_begin_ < dirty_end_; }
+
+        // Uploads the changed slots, if any, and binds the table to `binding`.
+        void upload(GLuint binding = 0u);
+
+        GLuint buffer() const { return buffer_.get(); }
+
+    private:
+        void mark_dirty(std::uint32_t index);
+
+        BufferHandle buffer_;
+        std::vector<material_params_t> params_;
+        std::vector<std::uint32_t> free_;
+        std::uint32_t dirty_begin_ = MAX_MATERIALS;
+        std::uint32_t dirty_end_ = 0u;
+    };
+
+    MaterialTable &material_table();
+}
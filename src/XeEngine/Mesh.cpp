@@ -9,93 +9,127 @@
 
 #include "Material.h"
 
+#include "Application/gl_state.h"
+
 
 void xe::Mesh::draw() const {
-    glBindVertexArray(vao_);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, i_buffer_);
     for (auto i = 0; i < submeshes_.size(); i++) {
-        auto sm = submeshes_[i];
-        auto mtl = materials_[i];
+        auto &mtl = materials_[i];
         if (mtl != nullptr) {
             mtl->bind();
         }
-        if (sm.cull_face) {
-            glEnable(GL_CULL_FACE);
-        } else {
-            glDisable(GL_CULL_FACE);
-        }
-        glDrawElements(GL_TRIANGLES, sm.count(), GL_UNSIGNED_SHORT,
-                       reinterpret_cast<void *>(sizeof(GLushort) * sm.start));
+        draw_submesh(i);
         if (mtl != nullptr) {
             mtl->unbind();
         }
     }
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0u);
-    glBindVertexArray(0u);
+}
+
+void xe::Mesh::draw_submesh(size_t i) const {
+    auto &gl = gl_state();
+    // The element buffer is recorded in the vertex array object, there is no need to bind it here.
+    gl.bind_vertex_array(vao_.get());
+    auto &sm = submeshes_[i];
+    gl.set(GL_CULL_FACE, sm.cull_face);
+    glDrawElements(GL_TRIANGLES, sm.count(), GL_UNSIGNED_SHORT,
+                   reinterpret_cast<void *>(sizeof(GLushort) * sm.start));
+}
+
+void xe::Mesh::draw_submesh_positions(size_t i) const {
+    if (!p_vao_) {
+        draw_submesh(i);
+        return;
+    }
+    auto &gl = gl_state();
+    gl.bind_vertex_array(p_vao_.get());
+    auto &sm = submeshes_[i];
+    gl.set(GL_CULL_FACE, sm.cull_face);
+    glDrawElements(GL_TRIANGLES, sm.count(), GL_UNSIGNED_SHORT,
+                   reinterpret_cast<void *>(sizeof(GLushort) * sm.start));
+}
+
+void xe::Mesh::load_positions(const glm::vec3 *positions, size_t n) {
+    auto &gl = gl_state();
+    if (!p_vao_) {
+        p_vao_ = VertexArrayHandle::create();
+        p_buffer_ = BufferHandle::create();
+        gl.bind_vertex_array(p_vao_.get());
+        gl.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, i_buffer_.get());
+        gl.bind_buffer(GL_ARRAY_BUFFER, p_buffer_.get());
+        glEnableVertexAttribArray(COORDS);
+        glVertexAttribPointer(COORDS, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), nullptr);
+    }
+    gl.bind_buffer(GL_ARRAY_BUFFER, p_buffer_.get());
+    glBufferData(GL_ARRAY_BUFFER, n * sizeof(glm::vec3), positions, GL_STATIC_DRAW);
+    p_buffer_.set_size(n * sizeof(glm::vec3));
 }
 
 void xe::Mesh::vertex_attrib_pointer(GLuint index, GLuint size, GLenum type, GLsizei stride, GLsizeiptr offset) {
-    glBindVertexArray(vao_);
-    glBindBuffer(GL_ARRAY_BUFFER, v_buffer_);
+    auto &gl = gl_state();
+    gl.bind_vertex_array(vao_.get());
+    gl.bind_buffer(GL_ARRAY_BUFFER, v_buffer_.get());
     glEnableVertexAttribArray(index);
     glVertexAttribPointer(index, size, type, GL_FALSE, stride, reinterpret_cast<void *>(offset));
-    glBindBuffer(GL_ARRAY_BUFFER, 0u);
-    glBindVertexArray(0u);
 }
 
 
-xe::Mesh::Mesh() {
-    glGenVertexArrays(1, &vao_);
-    glGenBuffers(1, &v_buffer_);
-    glGenBuffers(1, &i_buffer_);
-    glBindVertexArray(vao_);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, i_buffer_);
-    glBindVertexArray(0u);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0u);
+xe::Mesh::Mesh() : vao_(VertexArrayHandle::create()), v_buffer_(BufferHandle::create()),
+                   i_buffer_(BufferHandle::create()) {
+    auto &gl = gl_state();
+    gl.bind_vertex_array(vao_.get());
+    gl.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, i_buffer_.get());
 }
 
+// The element buffer is always bound through our own vertex array, binding it with another one bound
+// would silently replace that one's index buffer.
 void xe::Mesh::allocate_index_buffer(size_t size, GLenum hint) {
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, i_buffer_);
+    auto &gl = gl_state();
+    gl.bind_vertex_array(vao_.get());
+    gl.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, i_buffer_.get());
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, nullptr, GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0u);
+    i_buffer_.set_size(size);
 }
 
 void xe::Mesh::load_indices(size_t offset, size_t size, const void *data) {
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, i_buffer_);
+    auto &gl = gl_state();
+    gl.bind_vertex_array(vao_.get());
+    gl.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, i_buffer_.get());
     glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, offset, size, data);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0u);
 }
 
 
 void xe::Mesh::allocate_vertex_buffer(size_t size, GLenum hint) {
-    glBindBuffer(GL_ARRAY_BUFFER, v_buffer_);
+    gl_state().bind_buffer(GL_ARRAY_BUFFER, v_buffer_.get());
     glBufferData(GL_ARRAY_BUFFER, size, nullptr, hint);
-    glBindBuffer(GL_ARRAY_BUFFER, 0u);
+    v_buffer_.set_size(size);
 }
 
 void xe::Mesh::
 load_vertices(size_t offset, size_t size, const void *data) {
-    glBindBuffer(GL_ARRAY_BUFFER, v_buffer_);
+    gl_state().bind_buffer(GL_ARRAY_BUFFER, v_buffer_.get());
     glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
-    glBindBuffer(GL_ARRAY_BUFFER, 0u);
 }
 
 void *xe::Mesh::map_vertex_buffer() {
-    glBindBuffer(GL_ARRAY_BUFFER, v_buffer_);
+    gl_state().bind_buffer(GL_ARRAY_BUFFER, v_buffer_.get());
     return glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
 }
 
 void xe::Mesh::unmap_vertex_buffer() {
-    glBindBuffer(GL_ARRAY_BUFFER, v_buffer_);
+    gl_state().bind_buffer(GL_ARRAY_BUFFER, v_buffer_.get());
     glUnmapBuffer(GL_ARRAY_BUFFER);
 }
 
 void *xe::Mesh::map_index_buffer() {
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, i_buffer_);
+    auto &gl = gl_state();
+    gl.bind_vertex_array(vao_.get());
+    gl.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, i_buffer_.get());
     return glMapBuffer(GL_ELEMENT_ARRAY_BUFFER, GL_WRITE_ONLY);
 }
 
 void xe::Mesh::unmap_index_buffer() {
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, i_buffer_);
+    auto &gl = gl_state();
+    gl.bind_vertex_array(vao_.get());
+    gl.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, i_buffer_.get());
     glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
 }
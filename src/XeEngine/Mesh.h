@@ -4,8 +4,14 @@
 
 #pragma once
 
+#include <limits>
+#include <memory>
 #include <vector>
 #include "glad/gl.h"
+#include "glm/glm.hpp"
+
+#include "Application/gl_resource.h"
+#include "Application/vertex_layout.h"
 
 
 namespace xe {
@@ -26,7 +32,10 @@ namespace xe {
     public:
 
         enum Attributes {
-            COORDS = 0, TEX_COORDS = 1, NORMALS = 2, TANGENTS = 3
+            COORDS = vertex::POSITION_LOCATION,
+            TEX_COORDS = vertex::TEXCOORD_LOCATION,
+            NORMALS = vertex::NORMAL_LOCATION,
+            TANGENTS = vertex::TANGENT_LOCATION
         };
 
 
@@ -42,7 +51,7 @@ namespace xe {
 
         void vertex_attrib_pointer(GLuint index, GLuint size, GLenum type, GLsizei stride, GLsizeiptr offset);
 
-        void add_submesh(GLuint start, GLuint end, Material *mtl = nullptr, bool cull_face = false) {
+        void add_submesh(GLuint start, GLuint end, std::shared_ptr<Material> mtl = nullptr, bool cull_face = false) {
             submeshes_.push_back({start, end, cull_face});
             materials_.push_back(mtl);
 
@@ -60,14 +69,44 @@ namespace xe {
 
         void draw() const;
 
+        size_t n_submeshes() const { return submeshes_.size(); }
+
+        const SubMesh &submesh(size_t i) const { return submeshes_[i]; }
+
+        Material *material(size_t i) const { return materials_[i].get(); }
+
+        // Draws a single submesh without binding its material.
+        void draw_submesh(size_t i) const;
+
+        // Keeps a tightly packed copy of the n vertex positions for the depth only passes.
+        void load_positions(const glm::vec3 *positions, size_t n);
+
+        // Draws a single submesh reading only the positions, from the packed copy if there is one.
+        void draw_submesh_positions(size_t i) const;
+
+        // Bounding sphere in model space, the default one contains everything.
+        void set_bounds(const glm::vec3 &center, float radius) {
+            bounds_center_ = center;
+            bounds_radius_ = radius;
+        }
+
+        const glm::vec3 &bounds_center() const { return bounds_center_; }
+
+        float bounds_radius() const { return bounds_radius_; }
+
     private:
 
-        GLuint vao_;
-        GLuint v_buffer_;
-        GLuint i_buffer_;
+        VertexArrayHandle vao_;
+        BufferHandle v_buffer_;
+        BufferHandle i_buffer_;
+        VertexArrayHandle p_vao_;
+        BufferHandle p_buffer_;
 
         std::vector<SubMesh> submeshes_;
-        std::vector<Material *> materials_;
+        std::vector<std::shared_ptr<Material>> materials_;
+
+        glm::vec3 bounds_center_{0.0f};
+        float bounds_radius_ = std::numeric_limits<float>::infinity();
 
     };
 
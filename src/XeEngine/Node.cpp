@@ -4,15 +4,42 @@
 
 #include "Node.h"
 
+#include <algorithm>
+#include <cmath>
+
 #include "glm/gtc/type_ptr.hpp"
 #include "glm/gtx/string_cast.hpp"
 #include "spdlog/spdlog.h"
 
-#include "Camera.h"
-#include "Scene.h"
-
 #include "Mesh.h"
-
+#include "RenderQueue.h"
+
+
+namespace {
+    // Grows the sphere (c, r) to hold (c2, r2). A negative radius is an empty sphere.
+    void merge_sphere(glm::vec3 &c, float &r, const glm::vec3 &c2, float r2) {
+        if (r2 < 0.0f)
+            return;
+        if (r < 0.0f || std::isinf(r2)) {
+            c = c2;
+            r = r2;
+            return;
+        }
+        if (std::isinf(r))
+            return;
+        auto d = glm::length(c2 - c);
+        if (d + r2 <= r)
+            return;
+        if (d + r <= r2) {
+            c = c2;
+            r = r2;
+            return;
+        }
+        auto merged = 0.5f * (d + r + r2);
+        c += (c2 - c) * ((merged - r) / d);
+        r = merged;
+    }
+}
 
 namespace xe {
 
@@ -34,46 +61,108 @@ namespace xe {
             global_orientation_(1),
             local_(node.local_),
             local_orientation_(node.local_orientation_),
+            static_(node.static_),
             meshes_(node.meshes_) {
         name_ = node.name_;
         parent_ = nullptr;
     }
 
-    void Node::draw(Scene *scene) {
+    void Node::mark_moved() {
+        moved_ = true;
+        bounds_dirty_ = true;
+        // The ancestors of a dirty node are dirty as well.
+        for (auto node = parent_; node != nullptr && !node->bounds_dirty_; node = node->parent_)
+            node->bounds_dirty_ = true;
+    }
+
+    void Node::update() {
+        update(false);
+    }
 
-        if (parent_ != nullptr) {
-            global_ = parent_->global_ * local_;
-            global_orientation_ = parent_->global_orientation_ * local_orientation_;
-            spdlog::debug("Drawing node {} {} {}", parent_->name_, name_, global_orientation_);
-        } else {
-            global_ = local_;
-            global_orientation_ = local_orientation_;
-            spdlog::debug("Drawing node {}", name_, global_orientation_);
+    void Node::update(bool moved) {
+        moved = moved || moved_;
+        if (!moved && !bounds_dirty_)
+            return;
+
+        if (moved) {
+            if (parent_ != nullptr) {
+                global_ = parent_->global_ * local_;
+                global_orientation_ = parent_->global_orientation_ * local_orientation_;
+                global_static_ = static_ || parent_->global_static_;
+                spdlog::debug("Updating node {} {} {}", parent_->name_, name_, global_orientation_);
+            } else {
+                global_ = local_;
+                global_orientation_ = local_orientation_;
+                global_static_ = static_;
+                spdlog::debug("Updating node {}", name_, global_orientation_);
+            }
+            moved_ = false;
         }
-        if (global_orientation_ > 0) {
-            glFrontFace(GL_CCW);
-        } else {
-            glFrontFace(GL_CW);
+
+        parts_.clear();
+        auto scale = std::max({glm::length(glm::vec3(global_[0])), glm::length(glm::vec3(global_[1])),
+                               glm::length(glm::vec3(global_[2]))});
+        for (auto &&m: meshes_)
+            parts_.push(glm::vec3(global_ * glm::vec4(m->bounds_center(), 1.0f)), scale * m->bounds_radius());
+        for (auto &&ch: children_) {
+            ch->update(moved);
+            parts_.push(ch->bounds_center_, ch->bounds_radius_);
         }
 
-        auto VM = scene->camera()->view() * global_;
-        auto PVM = scene->camera()->projection() *VM;
-        auto R = glm::mat3(VM);
-        auto N = glm::mat3(glm::cross(R[1], R[2]), glm::cross(R[2], R[0]), glm::cross(R[0], R[1]));
-        scene->load_transform(glm::value_ptr(PVM));
-        scene->load_matrices(VM,N);
+        bounds_radius_ = -1.0f;
+        for (std::size_t i = 0; i < parts_.size(); ++i)
+            merge_sphere(bounds_center_, bounds_radius_, {parts_.x[i], parts_.y[i], parts_.z[i]}, parts_.r[i]);
+        bounds_dirty_ = false;
+    }
 
-        for (auto &&m: meshes_) {
-            m->draw();
-        }
+    void Node::collect(RenderQueue &queue, const glm::mat4 &V, const glm::mat4 &P) {
+        update();
+        collect(queue, V, P, Frustum(), Visibility::INSIDE, false);
+    }
 
+    void Node::collect(RenderQueue &queue, const glm::mat4 &V, const glm::mat4 &P, const Frustum &frustum,
+                       bool keep_hidden) {
+        update();
+        if (bounds_radius_ >= 0.0f)
+            collect(queue, V, P, frustum, frustum.test(bounds_center_, bounds_radius_), keep_hidden);
+    }
 
-        for (auto &&ch: children_) {
-            ch->draw(scene);
+    void Node::collect(RenderQueue &queue, const glm::mat4 &V, const glm::mat4 &P, const Frustum &frustum,
+                       Visibility visibility, bool keep_hidden) {
+        if (visibility == Visibility::OUTSIDE && !keep_hidden)
+            return;
+        if (visibility == Visibility::INTERSECTS)
+            frustum.test(parts_, visibility_);
+        else
+            visibility_.assign(parts_.size(), visibility);
+
+        auto n_visible = std::count_if(visibility_.begin(), visibility_.begin() + std::ptrdiff_t(meshes_.size()),
+                                       [](Visibility v) { return v != Visibility::OUTSIDE; });
+        if (n_visible > 0 || (keep_hidden && !meshes_.empty())) {
+            auto VM = V * global_;
+            auto PVM = P * VM;
+            auto R = glm::mat3(VM);
+            auto N = glm::mat3(glm::cross(R[1], R[2]), glm::cross(R[2], R[0]), glm::cross(R[0], R[1]));
+            auto transform = queue.push_transform(global_, PVM, VM, N, global_orientation_, global_static_);
+            // Distance of the node origin along the viewing direction.
+            auto depth = -VM[3].z;
+
+            for (std::size_t i = 0; i < meshes_.size(); ++i) {
+                auto visible = visibility_[i] != Visibility::OUTSIDE;
+                if (visible || keep_hidden)
+                    queue.push_mesh(meshes_[i].get(), transform, depth, visible);
+            }
+        }
+
+        for (std::size_t i = 0; i < children_.size(); ++i) {
+            auto child = children_[i];
+            if (child->bounds_radius_ >= 0.0f)
+                child->collect(queue, V, P, frustum, visibility_[meshes_.size() + i], keep_hidden);
         }
     }
 
     void Node::add_mesh(std::shared_ptr<xe::Mesh> pMesh) {
         meshes_.push_back(pMesh);
+        mark_moved();
     }
 }
\ No newline at end of file
@@ -10,13 +10,15 @@
 
 #include "glm/glm.hpp"
 
+#include "Frustum.h"
 
-namespace xe {
 
-    class Scene;
+namespace xe {
 
     class Mesh;
 
+    class RenderQueue;
+
     class Node {
     public:
 
@@ -39,18 +41,59 @@ namespace xe {
         void set_local(const glm::mat4 &M, int orientation = 1) {
             local_ = M;
             local_orientation_ = orientation;
+            mark_moved();
         }
 
+        // A static subtree is assumed not to move, its meshes are cached in the shadow maps. See
+        // ShadowMaps::invalidate_static when it does move.
+        void set_static(bool is_static) {
+            static_ = is_static;
+            mark_moved();
+        }
+
+        bool is_static() const { return static_; }
+
         void add_node(Node *node) {
             node->set_parent(this);
             children_.push_back(node);
+            node->mark_moved();
         }
 
-        void draw(Scene *scene);
+        // Brings the global transforms and the bounds of this subtree up to date. Only the nodes that moved, and
+        // the bounds above them, are visited.
+        void update();
+
+        // World space bounding sphere of the meshes of this subtree, as of the last update. The radius is negative
+        // when the subtree has no meshes and infinite when one of them has no bounds.
+        const glm::vec3 &bounds_center() const { return bounds_center_; }
+
+        float bounds_radius() const { return bounds_radius_; }
+
+        // Updates the global transforms of this subtree and enqueues its meshes.
+        void collect(RenderQueue &queue, const glm::mat4 &V, const glm::mat4 &P);
+
+        /**
+         * @brief Updates this subtree and enqueues the meshes that may be visible in the world space `frustum`.
+         *
+         * Subtrees whose bounds are outside are skipped as a whole and the ones inside are enqueued without
+         * further tests; only the nodes crossing the frustum test their meshes and children, four bounds at a
+         * time. With `keep_hidden` the meshes outside are enqueued hidden instead, so the shadow maps still see
+         * casters out of view.
+         */
+        void collect(RenderQueue &queue, const glm::mat4 &V, const glm::mat4 &P, const Frustum &frustum,
+                     bool keep_hidden);
 
         void add_mesh(std::shared_ptr<xe::Mesh> pMesh);
 
     private:
+        // The global transform of this subtree and the bounds of its ancestors are out of date.
+        void mark_moved();
+
+        void update(bool moved);
+
+        void collect(RenderQueue &queue, const glm::mat4 &V, const glm::mat4 &P, const Frustum &frustum,
+                     Visibility visibility, bool keep_hidden);
+
         std::string name_;
         Node *parent_;
         std::vector<Node *> children_;
@@ -58,7 +101,17 @@ namespace xe {
         int global_orientation_;
         glm::mat4 local_;
         int local_orientation_;
+        bool static_ = false;
+        // Set by collect, this node or one of its ancestors is static.
+        bool global_static_ = false;
         std::vector<std::shared_ptr<xe::Mesh> > meshes_;
+        // World space bounds of the meshes followed by those of the children.
+        sphere_batch_t parts_;
+        std::vector<Visibility> visibility_;
+        glm::vec3 bounds_center_{0.0f};
+        float bounds_radius_ = -1.0f;
+        bool moved_ = true;
+        bool bounds_dirty_ = true;
     };
 }
 
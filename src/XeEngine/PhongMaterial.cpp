@@ -4,79 +4,95 @@
 
 #include "PhongMaterial.h"
 
+#include "LightClusters.h"
+#include "Scene.h"
+
+#include "Application/gl_state.h"
 #include "Application/utils.h"
 #include "XeEngine/utils.h"
 #include "spdlog/spdlog.h"
 
 namespace xe {
 
-    GLuint PhongMaterial::shader_ = 0u;
-    GLuint PhongMaterial::material_uniform_buffer_ = 0u;
+    ProgramManager::ticket_t PhongMaterial::ticket_ = ProgramManager::INVALID_TICKET;
+    bool PhongMaterial::resolved_ = false;
+    ProgramHandle PhongMaterial::shader_;
     GLint  PhongMaterial::uniform_map_Kd_location_ = 0;
+    GLint  PhongMaterial::uniform_material_index_location_ = 0;
+
+    void PhongMaterial::update_params() {
+        material_params_t params;
+        params.Kd = Kd_;
+        params.flags = virtual_Kd_ ? material_params_t::USE_VIRTUAL_KD : map_Kd_ ? material_params_t::USE_MAP_KD : 0u;
+        params.map_Kd_layer = map_Kd_layer_;
+        material_table().set(index(), params);
+    }
 
     void PhongMaterial::bind() {
-        glUseProgram(program());
-        int use_map_Kd = 0;
-        if (map_Kd_ > 0) {
+        auto &gl = gl_state();
+        gl.use_program(program());
+        material_table().upload(0);
+        OGL_CALL(glUniform1ui(uniform_material_index_location_, index()));
+        if (virtual_Kd_) {
+            virtual_Kd_->bind();
+        } else if (map_Kd_) {
             OGL_CALL(glUniform1i(uniform_map_Kd_location_, map_Kd_unit_));
-            OGL_CALL(glActiveTexture(GL_TEXTURE0 + map_Kd_unit_));
-            OGL_CALL(glBindTexture(GL_TEXTURE_2D, map_Kd_));
-            use_map_Kd = 1;
+            gl.bind_texture(map_Kd_unit_, GL_TEXTURE_2D_ARRAY, map_Kd_->get());
         }
-        OGL_CALL(glBindBufferBase(GL_UNIFORM_BUFFER, 0, material_uniform_buffer_));
-
-        glBindBuffer(GL_UNIFORM_BUFFER, material_uniform_buffer_);
-        glBufferSubData(GL_UNIFORM_BUFFER, 4* sizeof(float), sizeof(glm::vec4), &Kd_[0]);
-        glBufferSubData(GL_UNIFORM_BUFFER, 15 * sizeof(float), sizeof(GLint), &use_map_Kd);
-        OGL_CALL(glBindBuffer(GL_UNIFORM_BUFFER, 0u));
-
-    }
-
-    void PhongMaterial::unbind() {
-        glBindBuffer(GL_UNIFORM_BUFFER, 0u);
-        glBindTexture(GL_TEXTURE_2D, 0u);
     }
 
     void PhongMaterial::init() {
+        ticket_ = program_manager().submit(
+                {{GL_VERTEX_SHADER,   std::string(PROJECT_DIR) + "/shaders/phong_vs.glsl"},
+                 {GL_FRAGMENT_SHADER, std::string(PROJECT_DIR) + "/shaders/phong_fs.glsl"}},
+                CLUSTERED_LIGHTING_SUPPORTED ? "#define CLUSTERED_LIGHTING 1\n" : "");
+        resolved_ = false;
+    }
 
+    GLuint PhongMaterial::program() {
+        if (resolved_)
+            return shader_.get();
+        resolved_ = true;
 
-        auto program = xe::utils::create_program(
-                {{GL_VERTEX_SHADER,   std::string(PROJECT_DIR) + "/shaders/phong_vs.glsl"},
-                 {GL_FRAGMENT_SHADER, std::string(PROJECT_DIR) + "/shaders/phong_fs.glsl"}});
+        auto program = program_manager().get(ticket_);
         if (!program) {
             std::cerr << "Invalid program" << std::endl;
             exit(-1);
         }
 
-        shader_ = program;
+        shader_ = ProgramHandle(program);
+        Scene::check_block_layouts(program);
+        ShadowMaps::setup_program(program);
+        VirtualTexture::setup_program(program);
 
-        glGenBuffers(1, &material_uniform_buffer_);
-
-        glBindBuffer(GL_UNIFORM_BUFFER, material_uniform_buffer_);
-        glBufferData(GL_UNIFORM_BUFFER, 18* sizeof(float), nullptr, GL_STATIC_DRAW);
-        glBindBuffer(GL_UNIFORM_BUFFER, 0u);
 #if __APPLE__
-        uniform_block_binding(shader_, "Material",0);
+        uniform_block_binding(program, "Materials",0);
 #endif
 
 #if __APPLE__
-        uniform_block_binding(shader_, "Transformations",1);
+        uniform_block_binding(program, "Transformations",1);
 #endif
 
 #if __APPLE__
-        uniform_block_binding(shader_, "Matrices",2);
+        uniform_block_binding(program, "Matrices",2);
 #endif
 
 #if __APPLE__
-        uniform_block_binding(shader_, "Lights",3);
+        uniform_block_binding(program, "Lights",3);
 #endif
 
 
-        uniform_map_Kd_location_ = glGetUniformLocation(shader_, "map_Kd");
+        uniform_map_Kd_location_ = glGetUniformLocation(program, "map_Kd");
         if (uniform_map_Kd_location_ == -1) {
             spdlog::warn("Cannot get uniform {} location", "map_Kd");
         }
 
+        uniform_material_index_location_ = glGetUniformLocation(program, "material_index");
+        if (uniform_material_index_location_ == -1) {
+            spdlog::warn("Cannot get uniform {} location", "material_index");
+        }
+
+        return program;
     }
 
 
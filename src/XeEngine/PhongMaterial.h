@@ -6,44 +6,77 @@
 
 #include "Material.h"
 
+#include <memory>
 #include <string>
 
+#include "Application/gl_resource.h"
+#include "Application/program_manager.h"
+
+#include "VirtualTexture.h"
+
 namespace xe {
     class PhongMaterial : public Material {
     public:
 
+        // Submits the program for compilation, it is checked and set up on the first call to program().
         static void init();
 
-        static GLuint program() { return shader_; }
+        static GLuint program();
 
-        PhongMaterial(const glm::vec4 color, GLuint texture, GLuint texture_unit) : Kd_(color), map_Kd_(texture),
-                                                                                    map_Kd_unit_(texture_unit) {}
+        PhongMaterial(const glm::vec4 color, std::shared_ptr<TextureHandle> texture, GLuint texture_unit) : Kd_(color), map_Kd_(std::move(texture)),
+                                                                                    map_Kd_unit_(texture_unit) {
+            update_params();
+        }
 
-        PhongMaterial(const glm::vec4 color, GLuint texture) : PhongMaterial(color, texture, 0) {}
+        PhongMaterial(const glm::vec4 color, std::shared_ptr<TextureHandle> texture) : PhongMaterial(color, std::move(texture), 0) {}
 
-        PhongMaterial(const glm::vec4 color) : PhongMaterial(color, 0) {}
+        PhongMaterial(const glm::vec4 color) : PhongMaterial(color, nullptr) {}
 
-        void set_texture(GLuint tex) { map_Kd_ = tex; }
+        // `tex` is a GL_TEXTURE_2D_ARRAY, the material samples its `layer`.
+        void set_texture(std::shared_ptr<TextureHandle> tex, std::uint32_t layer = 0u) {
+            map_Kd_ = std::move(tex);
+            map_Kd_layer_ = layer;
+            update_params();
+        }
+
+        // The diffuse map is streamed from `texture` and replaces the one set with set_texture.
+        void set_virtual_texture(std::shared_ptr<VirtualTexture> texture) {
+            virtual_Kd_ = std::move(texture);
+            update_params();
+        }
 
         void bind() override;
 
-        void unbind() override;
+        GLuint program_id() const override { return program(); }
+
+        GLuint texture_id() const override {
+            return virtual_Kd_ ? virtual_Kd_->cache_texture() : map_Kd_ ? map_Kd_->get() : 0u;
+        }
+
+        bool transparent() const override { return Kd_[3] < 1.0f; }
+
+        VirtualTexture *virtual_texture() const override { return virtual_Kd_.get(); }
 
 
     private:
 
-        static GLuint shader_;
-        static GLuint material_uniform_buffer_;
+        void update_params();
+
+        static ProgramManager::ticket_t ticket_;
+        static bool resolved_;
+        static ProgramHandle shader_;
         static GLint uniform_map_Kd_location_;
+        static GLint uniform_material_index_location_;
 
         glm::vec4 Kd_;
-        GLuint map_Kd_;
-        GLboolean use_map_Kd_;
+        std::shared_ptr<TextureHandle> map_Kd_;
+        std::uint32_t map_Kd_layer_ = 0u;
+        std::shared_ptr<VirtualTexture> virtual_Kd_;
         GLuint map_Kd_unit_;
     };
 
 
-    GLuint create_texture(const std::string &name);
+    std::shared_ptr<TextureHandle> create_texture(const std::string &name);
 
 }
 
@@ -0,0 +1,192 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <utility>
+
+#include "glm/gtc/type_ptr.hpp"
+
+#include "Application/gl_state.h"
+
+#include "Material.h"
+#include "Mesh.h"
+#include "Scene.h"
+
+namespace {
+    constexpr std::uint64_t PASS_SHIFT = 62u;
+
+    constexpr std::uint64_t PROGRAM_BITS = 8u;
+    constexpr std::uint64_t MATERIAL_BITS = 14u;
+    constexpr std::uint64_t TEXTURE_BITS = 16u;
+    constexpr std::uint64_t DEPTH_BITS = 24u;
+
+    constexpr std::uint64_t mask(std::uint64_t bits) { return (std::uint64_t(1) << bits) - 1u; }
+}
+
+namespace xe {
+
+    void radix_sort(std::vector<sort_entry_t> &entries, std::vector<sort_entry_t> &scratch) {
+        const auto n = entries.size();
+        if (n < 2)
+            return;
+        scratch.resize(n);
+
+        std::array<std::array<std::uint32_t, 256>, 8> histograms{};
+        for (auto &&e: entries)
+            for (auto byte = 0u; byte < 8u; ++byte)
+                ++histograms[byte][(e.key >> (8u * byte)) & 0xffu];
+
+        auto *src = &entries;
+        auto *dst = &scratch;
+        for (auto byte = 0u; byte < 8u; ++byte) {
+            auto &histogram = histograms[byte];
+            const auto shift = 8u * byte;
+            // All keys share this byte, the pass would not move anything.
+            if (histogram[((*src)[0].key >> shift) & 0xffu] == n)
+                continue;
+
+            std::uint32_t offset = 0;
+            for (auto &&count: histogram)
+                offset += std::exchange(count, offset);
+
+            for (auto &&e: *src)
+                (*dst)[histogram[(e.key >> shift) & 0xffu]++] = e;
+            std::swap(src, dst);
+        }
+        if (src != &entries)
+            std::swap(entries, scratch);
+    }
+
+    std::uint32_t RenderQueue::quantize_depth(float depth) {
+        // The bit patterns of non-negative floats are ordered like the floats themselves.
+        auto bits = std::bit_cast<std::uint32_t>(std::max(depth, 0.0f));
+        return bits >> (32u - DEPTH_BITS);
+    }
+
+    std::uint64_t RenderQueue::make_key(Pass pass, GLuint program, std::uint32_t material, GLuint texture,
+                                        float depth) {
+        std::uint64_t p = program & mask(PROGRAM_BITS);
+        std::uint64_t m = material & mask(MATERIAL_BITS);
+        std::uint64_t t = texture & mask(TEXTURE_BITS);
+        std::uint64_t d = quantize_depth(depth);
+
+        std::uint64_t key = std::uint64_t(pass) << PASS_SHIFT;
+        if (pass == PASS_TRANSPARENT) {
+            d = mask(DEPTH_BITS) - d;
+            key |= d << (PROGRAM_BITS + MATERIAL_BITS + TEXTURE_BITS);
+            key |= p << (MATERIAL_BITS + TEXTURE_BITS);
+            key |= m << TEXTURE_BITS;
+            key |= t;
+        } else {
+            // Materials packed into the same texture array follow each other, only their index changes.
+            key |= p << (MATERIAL_BITS + TEXTURE_BITS + DEPTH_BITS);
+            key |= t << (MATERIAL_BITS + DEPTH_BITS);
+            key |= m << DEPTH_BITS;
+            key |= d;
+        }
+        return key;
+    }
+
+    void RenderQueue::clear() {
+        transforms_.clear();
+        items_.clear();
+        order_.clear();
+    }
+
+    std::uint32_t RenderQueue::push_transform(const glm::mat4 &M, const glm::mat4 &PVM, const glm::mat4 &VM,
+                                              const glm::mat3 &N, int orientation, bool is_static) {
+        transforms_.push_back({M, PVM, VM, N, orientation, is_static});
+        return static_cast<std::uint32_t>(transforms_.size() - 1);
+    }
+
+    void RenderQueue::push(const Mesh *mesh, std::uint32_t submesh, std::uint32_t transform, float depth,
+                           bool visible) {
+        if (!visible) {
+            items_.push_back({mesh, submesh, transform, depth});
+            return;
+        }
+        auto material = mesh->material(submesh);
+        std::uint64_t key;
+        if (material != nullptr) {
+            auto pass = material->transparent() ? PASS_TRANSPARENT : PASS_OPAQUE;
+            key = make_key(pass, material->program_id(), material->index(), material->texture_id(), depth);
+        } else {
+            key = make_key(PASS_OPAQUE, 0u, 0u, 0u, depth);
+        }
+        order_.push_back({key, static_cast<std::uint32_t>(items_.size())});
+        items_.push_back({mesh, submesh, transform, depth});
+    }
+
+    void RenderQueue::push_mesh(const Mesh *mesh, std::uint32_t transform, float depth, bool visible) {
+        for (std::uint32_t i = 0; i < mesh->n_submeshes(); ++i)
+            push(mesh, i, transform, depth, visible);
+    }
+
+    void RenderQueue::sort() {
+        radix_sort(order_, scratch_);
+    }
+
+    std::size_t RenderQueue::pass_begin(Pass pass) const {
+        auto it = std::lower_bound(order_.begin(), order_.end(), std::uint64_t(pass) << PASS_SHIFT,
+                                   [](const sort_entry_t &e, std::uint64_t key) { return e.key < key; });
+        return static_cast<std::size_t>(it - order_.begin());
+    }
+
+    void RenderQueue::submit(Scene &scene) const {
+        submit(scene, 0, order_.size());
+    }
+
+    void RenderQueue::submit(Scene &scene, std::size_t first, std::size_t last, const binder_t &bind) const {
+        auto &gl = gl_state();
+        auto current_transform = ~std::uint32_t(0);
+        Material *current_material = nullptr;
+        bool first_material = true;
+        bool blending = false;
+
+        last = std::min(last, order_.size());
+        for (auto i = first; i < last; ++i) {
+            auto &entry = order_[i];
+            auto &item = items_[entry.index];
+
+            bool transparent = (entry.key >> PASS_SHIFT) == PASS_TRANSPARENT;
+            if (transparent != blending) {
+                gl.set(GL_BLEND, transparent);
+                gl.depth_mask(transparent ? GL_FALSE : GL_TRUE);
+                if (transparent)
+                    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                blending = transparent;
+            }
+
+            if (item.transform != current_transform) {
+                auto &t = transforms_[item.transform];
+                scene.load_transform(t.PVM);
+                scene.load_matrices(t.VM, t.N);
+                gl.front_face(t.orientation > 0 ? GL_CCW : GL_CW);
+                current_transform = item.transform;
+            }
+
+            auto material = item.mesh->material(item.submesh);
+            if (bind) {
+                if (material != current_material || first_material)
+                    bind(material);
+            } else if (material != current_material) {
+                if (current_material != nullptr)
+                    current_material->unbind();
+                if (material != nullptr)
+                    material->bind();
+            }
+            current_material = material;
+            first_material = false;
+
+            item.mesh->draw_submesh(item.submesh);
+        }
+
+        if (current_material != nullptr && !bind)
+            current_material->unbind();
+        if (blending) {
+            gl.set(GL_BLEND, false);
+            gl.depth_mask(GL_TRUE);
+        }
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "glad/gl.h"
+#include "glm/glm.hpp"
+
+namespace xe {
+
+    class Mesh;
+
+    class Material;
+
+    class Scene;
+
+    struct sort_entry_t {
+        std::uint64_t key;
+        std::uint32_t index;
+    };
+
+    // LSD radix sort on the 64-bit keys, stable. Byte positions on which all keys agree are skipped.
+    void radix_sort(std::vector<sort_entry_t> &entries, std::vector<sort_entry_t> &scratch);
+
+    /**
+     * @brief List of submesh draws collected from the scene graph and submitted in sort key order.
+     *
+     * Opaque keys are ordered by program, texture, material and then front to back, transparent keys
+     * are ordered back to front first.
+     */
+    class RenderQueue {
+    public:
+        enum Pass : std::uint64_t {
+            PASS_OPAQUE = 0u, PASS_TRANSPARENT = 1u
+        };
+
+        struct transform_t {
+            // Model to world.
+            glm::mat4 M;
+            glm::mat4 PVM;
+            glm::mat4 VM;
+            glm::mat3 N;
+            int orientation;
+            bool is_static;
+        };
+
+        struct item_t {
+            const Mesh *mesh;
+            std::uint32_t submesh;
+            std::uint32_t transform;
+            float depth;
+        };
+
+        static std::uint64_t make_key(Pass pass, GLuint program, std::uint32_t material, GLuint texture, float depth);
+
+        static std::uint32_t quantize_depth(float depth);
+
+        void clear();
+
+        std::uint32_t push_transform(const glm::mat4 &M, const glm::mat4 &PVM, const glm::mat4 &VM, const glm::mat3 &N,
+                                     int orientation, bool is_static = false);
+
+        // Hidden items are not sorted nor submitted, they are only listed in items() for the shadow maps.
+        void push(const Mesh *mesh, std::uint32_t submesh, std::uint32_t transform, float depth, bool visible = true);
+
+        // Enqueues every submesh of `mesh` with the given transform.
+        void push_mesh(const Mesh *mesh, std::uint32_t transform, float depth, bool visible = true);
+
+        void sort();
+
+        // Called instead of Material::bind/unbind when a queue is submitted with a replacement program.
+        // The material is nullptr for submeshes without one.
+        using binder_t = std::function<void(const Material *)>;
+
+        void submit(Scene &scene) const;
+
+        // Submits the sorted entries [first, last). With `bind` the materials are not bound, `bind` is called
+        // whenever the material changes instead.
+        void submit(Scene &scene, std::size_t first, std::size_t last, const binder_t &bind = {}) const;
+
+        // Index of the first sorted entry of `pass`, or size() if there are none.
+        std::size_t pass_begin(Pass pass) const;
+
+        size_t size() const { return items_.size(); }
+
+        // All items, the hidden ones included.
+        const std::vector<item_t> &items() const { return items_; }
+
+        const std::vector<transform_t> &transforms() const { return transforms_; }
+
+        const std::vector<sort_entry_t> &order() const { return order_; }
+
+    private:
+        std::vector<transform_t> transforms_;
+        std::vector<item_t> items_;
+        std::vector<sort_entry_t> order_;
+        std::vector<sort_entry_t> scratch_;
+    };
+}
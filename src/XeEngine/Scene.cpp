@@ -4,64 +4,117 @@
 
 #include "Scene.h"
 
+#include <algorithm>
+
 #include "glm/gtc/type_ptr.hpp"
+#include "spdlog/spdlog.h"
 
+#include "Application/gl_state.h"
+#include "Application/texture_streamer.h"
 #include "Application/utils.h"
 #include "Camera.h"
+#include "MaterialTable.h"
+#include "TextureResidency.h"
 
 namespace xe {
 
-    Scene::Scene() : n_lights_(0) {
-        glGenBuffers(1, &u_transform_buffer_);
-        glBindBuffer(GL_UNIFORM_BUFFER, u_transform_buffer_);
-        glBufferData(GL_UNIFORM_BUFFER, 16 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
-        glBindBuffer(GL_UNIFORM_BUFFER, 0u);
-        glBindBufferBase(GL_UNIFORM_BUFFER, 1, u_transform_buffer_);
-
-
-        glGenBuffers(1, &u_lights_buffer_);
-        glBindBuffer(GL_UNIFORM_BUFFER, u_lights_buffer_);
-        glBufferData(GL_UNIFORM_BUFFER, MAX_POINT_LIGHT * P_LIGHT_SIZE, nullptr, GL_DYNAMIC_DRAW);
-        glBindBuffer(GL_UNIFORM_BUFFER, 0u);
-        glBindBufferBase(GL_UNIFORM_BUFFER, 3, u_lights_buffer_);
+    Scene::Scene() : root_(nullptr), camera_(nullptr), shadows_(lights_) {
+        auto &gl = gl_state();
+        u_transform_buffer_ = BufferHandle::create();
+        gl.bind_buffer(GL_UNIFORM_BUFFER, u_transform_buffer_.get());
+        glBufferData(GL_UNIFORM_BUFFER, transformations_block_t::SIZE, nullptr, GL_DYNAMIC_DRAW);
+        u_transform_buffer_.set_size(transformations_block_t::SIZE);
+        gl.bind_buffer_base(GL_UNIFORM_BUFFER, 1, u_transform_buffer_.get());
 
-        glGenBuffers(1, &u_matrices_buffer_);
-        glBindBuffer(GL_UNIFORM_BUFFER, u_matrices_buffer_);
-        glBufferData(GL_UNIFORM_BUFFER, 32 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
-        glBindBuffer(GL_UNIFORM_BUFFER, 0u);
-        glBindBufferBase(GL_UNIFORM_BUFFER, 2, u_matrices_buffer_);
+        u_matrices_buffer_ = BufferHandle::create();
+        gl.bind_buffer(GL_UNIFORM_BUFFER, u_matrices_buffer_.get());
+        glBufferData(GL_UNIFORM_BUFFER, matrices_block_t::SIZE, nullptr, GL_DYNAMIC_DRAW);
+        u_matrices_buffer_.set_size(matrices_block_t::SIZE);
+        gl.bind_buffer_base(GL_UNIFORM_BUFFER, 2, u_matrices_buffer_.get());
 
     }
 
-    void Scene::load_transform(const GLfloat *M) {
-        glBindBuffer(GL_UNIFORM_BUFFER, u_transform_buffer_);
-        OGL_CALL(glBufferSubData(GL_UNIFORM_BUFFER, 0, 16 * sizeof(float), M));
-        glBindBuffer(GL_UNIFORM_BUFFER, 0u);
+    bool Scene::check_block_layouts(GLuint program) {
+        bool ok = transformations_block_t::check(program, "Transformations");
+        ok = matrices_block_t::check(program, "Matrices") && ok;
+        ok = materials_block_t::check(program, "Materials") && ok;
+        ok = LightManager::lights_block_t::check(program, "Lights", LightManager::INTERFACE) && ok;
+        ok = LightClusters::params_block_t::check(program, "ClusterParams") && ok;
+        ok = ShadowMaps::shadows_block_t::check(program, "Shadows") && ok;
+        ok = VirtualTexture::block_t::check(program, "VirtualTexture") && ok;
+        return ok;
     }
 
-    void Scene::draw() {
-        // send lights;
+    void Scene::load_transform(const glm::mat4 &PVM) {
+        auto &gl = gl_state();
+        transformations_.set<"PVM">(PVM);
+        gl.bind_buffer(GL_UNIFORM_BUFFER, u_transform_buffer_.get());
+        OGL_CALL(transformations_.upload(GL_UNIFORM_BUFFER));
+    }
 
-        glBindBuffer(GL_UNIFORM_BUFFER, u_lights_buffer_);
-        size_t offset = 0;
-        for (int i = 0; i < n_lights_; i++) {
-            auto pos = glm::vec4(p_lights_[i].position_in_world_space, 1.0f);
-            p_lights_[i].position_in_view_space = glm::vec3(camera()->view() * pos);
+    void Scene::upload_lights(const glm::mat4 &V) {
+        auto changed = lights_.update(V);
+        lights_.upload();
+        if constexpr (!CLUSTERED_LIGHTING_SUPPORTED)
+            return;
+
+        glm::vec4 projection(camera()->fov(), camera()->aspect(), camera()->near_plane(), camera()->far_plane());
+        if (!changed && projection == cluster_projection_ && viewport_ == cluster_viewport_)
+            return;
+        cluster_projection_ = projection;
+        cluster_viewport_ = viewport_;
+
+        clusters_.set_projection(projection[0], projection[1], projection[2], projection[3]);
+        clusters_.build(lights_.view_x(), lights_.view_y(), lights_.view_z(), lights_.ranges());
+        clusters_.upload(viewport_);
+    }
 
-            OGL_CALL(glBufferSubData(GL_UNIFORM_BUFFER, offset, P_LIGHT_SIZE, &p_lights_[i].position_in_view_space));
-            offset += P_LIGHT_SIZE;
+    void Scene::set_pipeline(Pipeline pipeline) {
+        if (pipeline == Pipeline::DEFERRED && !DEFERRED_RENDERING_SUPPORTED) {
+            spdlog::warn("Deferred rendering is not supported with OpenGL {}.{}, using forward rendering",
+                         MAJOR, MINOR);
+            pipeline = Pipeline::FORWARD;
         }
+        if (pipeline == Pipeline::DEFERRED && !deferred_)
+            deferred_ = std::make_unique<DeferredRenderer>();
+        pipeline_ = pipeline;
+    }
+
+    void Scene::draw() {
+        // Textures loaded progressively get their next mips before anything samples them.
+        texture_streamer().update();
+        glGetIntegerv(GL_VIEWPORT, glm::value_ptr(viewport_));
+        auto V = camera()->view();
+        upload_lights(V);
 
+        queue_.clear();
         if (root_ != nullptr)
-            root_->draw(this);
+            // Casters out of view still shadow what is in view.
+            root_->collect(queue_, V, camera()->projection(), camera()->frustum(), shadows_.enabled());
+        queue_.sort();
+        texture_residency().update(queue_, camera()->projection(), viewport_[3]);
+        vt_feedback_.render(*this, queue_, queue_.pass_begin(RenderQueue::PASS_TRANSPARENT), viewport_);
+        glViewport(viewport_[0], viewport_[1], viewport_[2], viewport_[3]);
+        if (shadows_.enabled()) {
+            shadows_.render(queue_, *camera());
+            glViewport(viewport_[0], viewport_[1], viewport_[2], viewport_[3]);
+        }
+        shadows_.bind();
+        if (pipeline_ == Pipeline::DEFERRED) {
+            deferred_->render(*this, queue_, viewport_);
+        } else {
+            auto transparent = queue_.pass_begin(RenderQueue::PASS_TRANSPARENT);
+            prepass_.render(*this, queue_, transparent, viewport_);
+            queue_.submit(*this, transparent, queue_.order().size());
+        }
     }
 
-    void Scene::load_matrices(const glm::mat4& VM, const glm::mat3&N ) {
-        glBindBuffer(GL_UNIFORM_BUFFER, u_matrices_buffer_);
-        OGL_CALL(glBufferSubData(GL_UNIFORM_BUFFER, 0, 16 * sizeof(float), glm::value_ptr(VM)));
-        for(int i=0;i<3;i++)
-            OGL_CALL(glBufferSubData(GL_UNIFORM_BUFFER, 16 * sizeof(float)+i*4* sizeof(float), 3 * sizeof(float), glm::value_ptr(N[i])));
-        glBindBuffer(GL_UNIFORM_BUFFER, 0u);
+    void Scene::load_matrices(const glm::mat4 &VM, const glm::mat3 &N) {
+        auto &gl = gl_state();
+        matrices_.set<"VM">(VM);
+        matrices_.set<"N">(N);
+        gl.bind_buffer(GL_UNIFORM_BUFFER, u_matrices_buffer_.get());
+        OGL_CALL(matrices_.upload(GL_UNIFORM_BUFFER));
     }
 
 }
\ No newline at end of file
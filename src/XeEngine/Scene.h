@@ -4,25 +4,44 @@
 
 #pragma once
 
+#include <memory>
 #include <string>
-#include <array>
+#include <vector>
 
 #include "glad/gl.h"
 #include "glm/glm.hpp"
 
+#include "Application/block_layout.h"
+#include "Application/gl_resource.h"
+
+#include "DeferredRenderer.h"
+#include "DepthPrepass.h"
+#include "LightClusters.h"
+#include "LightManager.h"
 #include "Node.h"
+#include "RenderQueue.h"
+#include "ShadowMaps.h"
+#include "VirtualTexture.h"
 #include "lights.h"
 
 namespace xe {
 
-    const int MAX_POINT_LIGHT = 16;
-    const int P_LIGHT_SIZE = 12 * sizeof(float);
-
     class Camera;
 
 
     class Scene {
     public:
+        // Per draw blocks of the material vertex shaders.
+        using transformations_block_t = layout::std140_block<layout::field<"PVM", glm::mat4>>;
+        using matrices_block_t = layout::std140_block<layout::field<"VM", glm::mat4>, layout::field<"N", glm::mat3>>;
+
+        // Compares the C++ layouts of the engine blocks with those reported for `program`, logging the mismatches.
+        static bool check_block_layouts(GLuint program);
+
+        enum class Pipeline {
+            FORWARD, DEFERRED
+        };
+
         Scene();
 
         void set_root(Node *node) { root_ = node; }
@@ -31,25 +50,69 @@ namespace xe {
 
         void set_camera(Camera *camera) { camera_ = camera; }
 
-        void add_light(const PointLight &p_light) {
-            p_lights_[n_lights_++] = p_light;
-        }
+        // Returns the index of the light in the LightManager, see LightManager::set.
+        std::uint32_t add_light(const PointLight &light) { return lights_.add(light); }
+
+        std::uint32_t add_light(const SpotLight &light) { return lights_.add(light); }
+
+        std::uint32_t add_light(const DirectionalLight &light) { return lights_.add(light); }
+
+        std::size_t n_lights() const { return lights_.n_local() + lights_.n_directional(); }
+
+        LightManager &lights() { return lights_; }
+
+        // Lights get shadows through ShadowMaps::add.
+        ShadowMaps &shadows() { return shadows_; }
 
-        void load_transform(const GLfloat *M);
-        void load_matrices(const glm::mat4& VM, const glm::mat3& N);
+        void load_transform(const glm::mat4 &PVM);
+
+        void load_matrices(const glm::mat4 &VM, const glm::mat3 &N);
 
         void draw();
 
+        // DEFERRED falls back to FORWARD where it is not supported, see DeferredRenderer.
+        void set_pipeline(Pipeline pipeline);
+
+        Pipeline pipeline() const { return pipeline_; }
+
+        DeferredRenderer *deferred_renderer() const { return deferred_.get(); }
+
+        // Depth pre-pass of the forward pipeline, on AUTO by default.
+        DepthPrepass &depth_prepass() { return prepass_; }
+
+        const RenderQueue &render_queue() const { return queue_; }
+
+        const LightClusters &light_clusters() const { return clusters_; }
+
+        // Finds the tiles the virtual textures need, runs before the shadows every frame.
+        VirtualTextureFeedback &virtual_texture_feedback() { return vt_feedback_; }
+
     private:
-        GLuint u_transform_buffer_;
-        GLuint u_matrices_buffer_;
-        GLuint u_lights_buffer_;
+        void upload_lights(const glm::mat4 &V);
+
+        BufferHandle u_transform_buffer_;
+        BufferHandle u_matrices_buffer_;
+        transformations_block_t transformations_;
+        matrices_block_t matrices_;
 
         Node *root_;
         Camera *camera_;
 
-        unsigned int n_lights_;
-        std::array<PointLight, MAX_POINT_LIGHT> p_lights_;
+        RenderQueue queue_;
+
+        Pipeline pipeline_ = Pipeline::FORWARD;
+        std::unique_ptr<DeferredRenderer> deferred_;
+        DepthPrepass prepass_;
+        VirtualTextureFeedback vt_feedback_;
+        // x, y, width, height
+        glm::ivec4 viewport_{0};
+
+        LightManager lights_;
+        ShadowMaps shadows_;
+        LightClusters clusters_;
+        // fov, aspect, near, far and the viewport size the clusters were last built for.
+        glm::vec4 cluster_projection_{0.0f};
+        glm::ivec4 cluster_viewport_{0};
 
 
     };
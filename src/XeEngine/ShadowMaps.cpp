@@ -0,0 +1,464 @@
+#include "ShadowMaps.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+
+#include "glm/gtc/constants.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/type_ptr.hpp"
+#include "spdlog/spdlog.h"
+
+#include "Application/gl_state.h"
+
+#include "Camera.h"
+#include "Material.h"
+#include "Mesh.h"
+#include "RenderQueue.h"
+
+namespace {
+    constexpr float SQRT_2 = 1.41421356f;
+
+    // Cube map faces in the GL layer order and their up vectors.
+    const glm::vec3 FACE_AXES[6] = {{1.0f, 0.0f, 0.0f}, {-1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f},
+                                    {0.0f, -1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, -1.0f}};
+    const glm::vec3 FACE_UPS[6] = {{0.0f, -1.0f, 0.0f}, {0.0f, -1.0f, 0.0f}, {0.0f, 0.0f, 1.0f},
+                                   {0.0f, 0.0f, -1.0f}, {0.0f, -1.0f, 0.0f}, {0.0f, -1.0f, 0.0f}};
+
+    // Clip space to shadow map texture coordinates and depth.
+    glm::mat4 clip_to_texture() {
+        glm::mat4 B(0.5f);
+        B[3] = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);
+        return B;
+    }
+
+    void allocate_depth(xe::TextureHandle &texture, GLenum target, GLsizei size, GLsizei layers, bool compare) {
+        texture = xe::TextureHandle::create();
+        xe::gl_state().bind_texture(0, target, texture.get());
+        glTexImage3D(target, 0, GL_DEPTH_COMPONENT32F, size, size, layers, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, 0);
+        glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        // Comparing maps are filtered, each lookup is a 2x2 PCF.
+        auto filter = compare ? GL_LINEAR : GL_NEAREST;
+        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, filter);
+        if (compare) {
+            glTexParameteri(target, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+            glTexParameteri(target, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        }
+        texture.set_size(std::size_t(size) * std::size_t(size) * std::size_t(layers) * 4u);
+    }
+}
+
+namespace xe {
+
+    std::array<float, ShadowMaps::MAX_CASCADES + 1> ShadowMaps::split_distances(float near, float far,
+                                                                                std::uint32_t n, float lambda) {
+        n = std::clamp(n, 1u, MAX_CASCADES);
+        std::array<float, MAX_CASCADES + 1> d{};
+        for (std::uint32_t i = 0; i <= MAX_CASCADES; ++i) {
+            auto f = float(std::min(i, n)) / float(n);
+            d[i] = lambda * near * std::pow(far / near, f) + (1.0f - lambda) * (near + (far - near) * f);
+        }
+        return d;
+    }
+
+    bool ShadowMaps::add(LightManager::Type type, std::uint32_t i) {
+        auto directional = type == LightManager::DIRECTIONAL;
+        if (!directional && lights_.type(i) == LightManager::SPOT) {
+            spdlog::warn("Spot light {} cannot cast shadows", i);
+            return false;
+        }
+        auto &shadows = directional ? directional_ : point_;
+        for (auto &&s: shadows)
+            if (s.light == i)
+                return true;
+        if (shadows.size() == (directional ? MAX_DIRECTIONAL_SHADOWS : MAX_POINT_SHADOWS)) {
+            spdlog::warn("No shadow slot left for light {}", i);
+            return false;
+        }
+
+        if (depth_ticket_ == ProgramManager::INVALID_TICKET) {
+            const utils::shader_source_map_t stages = {
+                    {GL_VERTEX_SHADER, std::string(PROJECT_DIR) + "/shaders/shadow_vs.glsl"}};
+            depth_ticket_ = program_manager().submit(stages);
+            paraboloid_ticket_ = program_manager().submit(stages, "#define PARABOLOID 1\n");
+        }
+
+        if (!directional && !(lights_.ranges()[i] <= settings_.point_far))
+            spdlog::info("Point light {} reaches beyond {}, its shadow ends there", i, settings_.point_far);
+
+        lights_.set_shadow(type, i, std::int32_t(shadows.size()));
+        shadows.push_back({i, {}});
+        allocated_ = false;
+        return true;
+    }
+
+    void ShadowMaps::clear() {
+        for (auto &&s: directional_)
+            if (s.light < lights_.n_directional())
+                lights_.set_shadow(LightManager::DIRECTIONAL, s.light, -1);
+        for (auto &&s: point_)
+            if (s.light < lights_.n_local())
+                lights_.set_shadow(LightManager::POINT, s.light, -1);
+        directional_.clear();
+        point_.clear();
+        allocated_ = false;
+    }
+
+    void ShadowMaps::set_settings(const settings_t &settings) {
+        settings_ = settings;
+        settings_.n_cascades = std::clamp(settings_.n_cascades, 1u, MAX_CASCADES);
+        allocated_ = false;
+    }
+
+    bool ShadowMaps::resolve_programs() {
+        if (resolved_)
+            return depth_program_ && paraboloid_program_;
+        resolved_ = true;
+
+        auto &manager = program_manager();
+        depth_program_ = ProgramHandle(manager.get(depth_ticket_));
+        paraboloid_program_ = ProgramHandle(manager.get(paraboloid_ticket_));
+        if (!depth_program_ || !paraboloid_program_) {
+            spdlog::error("Shadow map programs failed to build, shadows are disabled");
+            return false;
+        }
+        u_shadow_PVM_ = glGetUniformLocation(depth_program_.get(), "shadow_PVM");
+        u_shadow_VM_ = glGetUniformLocation(paraboloid_program_.get(), "shadow_VM");
+        u_shadow_depth_range_ = glGetUniformLocation(paraboloid_program_.get(), "shadow_depth_range");
+        return true;
+    }
+
+    void ShadowMaps::allocate() {
+        allocated_ = true;
+        for (auto &&s: directional_)
+            s.views.assign(settings_.n_cascades, view_t{});
+        auto point_layers = settings_.point_mode == PointMode::CUBE ? 6u : 2u;
+        for (auto &&s: point_)
+            s.views.assign(point_layers, view_t{});
+
+        directional_maps_.reset();
+        directional_cache_.reset();
+        if (!directional_.empty()) {
+            auto layers = GLsizei(directional_.size() * settings_.n_cascades);
+            allocate_depth(directional_maps_, GL_TEXTURE_2D_ARRAY, settings_.cascade_size, layers, true);
+            allocate_depth(directional_cache_, GL_TEXTURE_2D_ARRAY, settings_.cascade_size, layers, false);
+        }
+
+        point_maps_.reset();
+        point_cache_.reset();
+        if (!point_.empty()) {
+            auto target = settings_.point_mode == PointMode::CUBE ? GL_TEXTURE_CUBE_MAP_ARRAY : GL_TEXTURE_2D_ARRAY;
+            auto layers = GLsizei(point_.size() * point_layers);
+            allocate_depth(point_maps_, target, settings_.point_size, layers, true);
+            allocate_depth(point_cache_, target, settings_.point_size, layers, false);
+        }
+
+        if (!framebuffer_) {
+            framebuffer_ = FramebufferHandle::create();
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_.get());
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+#if !((MAJOR >= 4) && (MINOR >= 3))
+            // Without glCopyImageSubData the cached layers are blitted.
+            read_framebuffer_ = FramebufferHandle::create();
+            glBindFramebuffer(GL_FRAMEBUFFER, read_framebuffer_.get());
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+#endif
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        }
+    }
+
+    void ShadowMaps::collect_casters(const RenderQueue &queue) {
+        casters_.clear();
+        auto &items = queue.items();
+        auto &transforms = queue.transforms();
+        for (std::uint32_t i = 0; i < items.size(); ++i) {
+            auto &item = items[i];
+            auto material = item.mesh->material(item.submesh);
+            if (material != nullptr && material->transparent())
+                continue;
+            auto &M = transforms[item.transform].M;
+            auto center = glm::vec3(M * glm::vec4(item.mesh->bounds_center(), 1.0f));
+            auto scale = std::max({glm::length(glm::vec3(M[0])), glm::length(glm::vec3(M[1])),
+                                   glm::length(glm::vec3(M[2]))});
+            casters_.push_back({i, center, scale * item.mesh->bounds_radius(),
+                                transforms[item.transform].is_static});
+        }
+    }
+
+    void ShadowMaps::render(const RenderQueue &queue, const Camera &camera) {
+        stats_ = {};
+        block_.set<"shadow_inv_view">(glm::inverse(camera.view()));
+        if (!enabled() || !resolve_programs())
+            return;
+        if (!allocated_)
+            allocate();
+        collect_casters(queue);
+
+        GLint target = 0;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_.get());
+
+        auto &gl = gl_state();
+        gl.enable(GL_DEPTH_TEST);
+        gl.depth_func(GL_LESS);
+        gl.depth_mask(GL_TRUE);
+        gl.set(GL_BLEND, false);
+        gl.enable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(settings_.slope_bias, settings_.constant_bias);
+
+        for (std::uint32_t slot = 0; slot < directional_.size(); ++slot)
+            render_directional(queue, camera, slot);
+        if (settings_.point_mode == PointMode::DUAL_PARABOLOID)
+            gl.enable(GL_CLIP_DISTANCE0);
+        for (std::uint32_t slot = 0; slot < point_.size(); ++slot)
+            render_point(queue, slot);
+        if (settings_.point_mode == PointMode::DUAL_PARABOLOID)
+            gl.disable(GL_CLIP_DISTANCE0);
+
+        gl.disable(GL_POLYGON_OFFSET_FILL);
+        glBindFramebuffer(GL_FRAMEBUFFER, GLuint(target));
+        static_dirty_ = false;
+    }
+
+    void ShadowMaps::render_directional(const RenderQueue &queue, const Camera &camera, std::uint32_t slot) {
+        auto &shadow = directional_[slot];
+        const auto n = settings_.n_cascades;
+        const auto size = settings_.cascade_size;
+
+        auto direction = glm::normalize(lights_.direction(shadow.light));
+        auto up = std::abs(direction.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+        // Light space only depends on the direction, so snapping to its texel grid is stable.
+        auto L = glm::lookAt(glm::vec3(0.0f), direction, up);
+        auto inv_view = glm::inverse(camera.view());
+
+        auto far = std::min(camera.far_plane(), settings_.max_distance);
+        auto splits = split_distances(camera.near_plane(), far, n, settings_.split_lambda);
+        auto t = std::tan(0.5f * camera.fov());
+        auto a = camera.aspect();
+
+        std::vector<glm::vec3> centers(casters_.size());
+        for (std::size_t i = 0; i < casters_.size(); ++i)
+            centers[i] = glm::vec3(L * glm::vec4(casters_[i].center, 1.0f));
+
+        glm::vec4 far_splits(std::numeric_limits<float>::max());
+        glm::vec4 texels(0.0f);
+        for (std::uint32_t c = 0; c < n; ++c) {
+            auto dn = splits[c];
+            auto df = splits[c + 1];
+            // Sphere around the frustum slice, its radius does not depend on the camera orientation. Rounded so it
+            // does not flicker with float noise.
+            auto half = 0.5f * (df - dn);
+            auto r = std::sqrt(df * t * a * df * t * a + df * t * df * t + half * half);
+            r = std::ceil(r * 16.0f) / 16.0f;
+            auto lc = glm::vec3(L * (inv_view * glm::vec4(0.0f, 0.0f, -0.5f * (dn + df), 1.0f)));
+            auto texel = 2.0f * r / float(size);
+            lc.x = std::floor(lc.x / texel) * texel;
+            lc.y = std::floor(lc.y / texel) * texel;
+
+            auto covers = [&](std::size_t i) {
+                auto &p = centers[i];
+                auto reach = r + casters_[i].radius;
+                return std::abs(p.x - lc.x) <= reach && std::abs(p.y - lc.y) <= reach &&
+                       p.z + casters_[i].radius >= lc.z - r;
+            };
+            // Casters between the light and the slice still throw shadows into it. The extension is quantized so
+            // the matrix does not change with every move of a caster.
+            float extension = 0.0f;
+            for (std::size_t i = 0; i < casters_.size(); ++i)
+                if (std::isfinite(casters_[i].radius) && covers(i))
+                    extension = std::max(extension, centers[i].z + casters_[i].radius - (lc.z + r));
+            extension = std::ceil(extension / r) * r;
+
+            auto P = glm::ortho(lc.x - r, lc.x + r, lc.y - r, lc.y + r, -(lc.z + r + extension), -(lc.z - r));
+            auto VP = P * L;
+            auto layer = GLint(slot * n + c);
+            update_view(queue, shadow.views[c], VP, 0.0f, GL_TEXTURE_2D_ARRAY, directional_maps_.get(),
+                        directional_cache_.get(), layer, size, false,
+                        [&](const caster_t &caster) { return covers(&caster - casters_.data()); });
+
+            block_.set<"shadow_cascades">(std::size_t(layer), clip_to_texture() * VP * inv_view);
+            far_splits[c] = df;
+            texels[c] = texel;
+        }
+        block_.set<"cascade_splits">(far_splits);
+        block_.set<"cascade_texel">(texels);
+    }
+
+    float ShadowMaps::point_far(std::uint32_t i) const {
+        // Also catches an infinite or NaN range.
+        auto range = lights_.ranges()[i];
+        return range <= settings_.point_far ? std::max(range, 2.0f * settings_.point_near) : settings_.point_far;
+    }
+
+    void ShadowMaps::render_point(const RenderQueue &queue, std::uint32_t slot) {
+        auto &shadow = point_[slot];
+        auto position = lights_.position(shadow.light);
+        auto range = point_far(shadow.light);
+        point_far_[slot / 4u][slot % 4u] = range;
+        auto size = settings_.point_size;
+        auto in_range = [&](const caster_t &caster) {
+            return glm::length(caster.center - position) - caster.radius <= range;
+        };
+
+        if (settings_.point_mode == PointMode::CUBE) {
+            auto P = glm::perspective(glm::half_pi<float>(), 1.0f, settings_.point_near, range);
+            for (std::uint32_t f = 0; f < 6u; ++f) {
+                auto VP = P * glm::lookAt(position, position + FACE_AXES[f], FACE_UPS[f]);
+                auto axis = f / 2u;
+                update_view(queue, shadow.views[f], VP, range, GL_TEXTURE_CUBE_MAP_ARRAY, point_maps_.get(),
+                            point_cache_.get(), GLint(6u * slot + f), size, false, [&](const caster_t &caster) {
+                            auto v = caster.center - position;
+                            auto along = glm::dot(v, FACE_AXES[f]);
+                            if (along < -caster.radius || !in_range(caster))
+                                return false;
+                            // The sides of the face pyramid are at 45 degrees to its axis.
+                            auto slack = caster.radius * SQRT_2;
+                            return std::abs(v[(axis + 1u) % 3u]) - along <= slack &&
+                                   std::abs(v[(axis + 2u) % 3u]) - along <= slack;
+                        });
+            }
+        } else {
+            for (std::uint32_t h = 0; h < 2u; ++h) {
+                // The first hemisphere looks down -z, the second one is turned around y to look down +z.
+                glm::mat4 VM(1.0f);
+                auto s = h == 0u ? 1.0f : -1.0f;
+                VM[0][0] = s;
+                VM[2][2] = s;
+                VM[3] = glm::vec4(-s * position.x, -position.y, -s * position.z, 1.0f);
+                update_view(queue, shadow.views[h], VM, range, GL_TEXTURE_2D_ARRAY, point_maps_.get(),
+                            point_cache_.get(), GLint(2u * slot + h), size, true, [&](const caster_t &caster) {
+                            auto forward = -s * (caster.center.z - position.z);
+                            return forward >= -caster.radius && in_range(caster);
+                        });
+            }
+        }
+    }
+
+    template<typename Visible>
+    void ShadowMaps::update_view(const RenderQueue &queue, view_t &view, const glm::mat4 &VP, float range,
+                                 GLenum target, GLuint texture, GLuint cache, GLint layer, GLsizei size,
+                                 bool paraboloid, Visible visible) {
+        static_casters_.clear();
+        dynamic_casters_.clear();
+        for (std::uint32_t i = 0; i < casters_.size(); ++i) {
+            if (!visible(casters_[i])) {
+                ++stats_.casters_culled;
+                continue;
+            }
+            (casters_[i].is_static ? static_casters_ : dynamic_casters_).push_back(i);
+        }
+
+        bool moved = VP != view.VP || range != view.range;
+        bool redraw_static = moved || static_dirty_ || !view.static_valid || static_casters_.size() != view.n_static;
+        if (!redraw_static && dynamic_casters_.empty() && !view.had_dynamic) {
+            ++stats_.views_cached;
+            return;
+        }
+        ++stats_.views_rendered;
+
+        glViewport(0, 0, size, size);
+        if (redraw_static) {
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cache, 0, layer);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            draw_casters(queue, static_casters_, VP, range, paraboloid);
+            view.VP = VP;
+            view.range = range;
+            view.static_valid = true;
+            view.n_static = static_casters_.size();
+        }
+        copy_layer(target, cache, texture, layer, size);
+        if (!dynamic_casters_.empty()) {
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, layer);
+            draw_casters(queue, dynamic_casters_, VP, range, paraboloid);
+        }
+        view.had_dynamic = !dynamic_casters_.empty();
+    }
+
+    void ShadowMaps::draw_casters(const RenderQueue &queue, const std::vector<std::uint32_t> &casters,
+                                  const glm::mat4 &VP, float range, bool paraboloid) {
+        auto &gl = gl_state();
+        auto &items = queue.items();
+        auto &transforms = queue.transforms();
+        gl.use_program(paraboloid ? paraboloid_program_.get() : depth_program_.get());
+        if (paraboloid)
+            glUniform2f(u_shadow_depth_range_, settings_.point_near, range);
+        auto location = paraboloid ? u_shadow_VM_ : u_shadow_PVM_;
+
+        auto current = ~std::uint32_t(0);
+        for (auto c: casters) {
+            auto &item = items[casters_[c].item];
+            if (item.transform != current) {
+                auto &t = transforms[item.transform];
+                auto M = VP * t.M;
+                glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(M));
+                gl.front_face(t.orientation > 0 ? GL_CCW : GL_CW);
+                current = item.transform;
+            }
+            item.mesh->draw_submesh_positions(item.submesh);
+            ++stats_.casters_drawn;
+        }
+    }
+
+    void ShadowMaps::copy_layer([[maybe_unused]] GLenum target, GLuint src, GLuint dst, GLint layer, GLsizei size) {
+#if (MAJOR >= 4) && (MINOR >= 3)
+        glCopyImageSubData(src, target, 0, 0, 0, layer, dst, target, 0, 0, 0, layer, size, size, 1);
+#else
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, read_framebuffer_.get());
+        glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, src, 0, layer);
+        glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, dst, 0, layer);
+        glBlitFramebuffer(0, 0, size, size, 0, 0, size, size, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_.get());
+#endif
+    }
+
+    void ShadowMaps::bind() {
+        auto &gl = gl_state();
+        if (!buffer_) {
+            buffer_ = BufferHandle::create();
+            gl.bind_buffer(GL_UNIFORM_BUFFER, buffer_.get());
+            glBufferData(GL_UNIFORM_BUFFER, shadows_block_t::SIZE, nullptr, GL_DYNAMIC_DRAW);
+            buffer_.set_size(shadows_block_t::SIZE);
+        }
+        block_.set<"shadow_params">(glm::uvec4(settings_.n_cascades, std::uint32_t(settings_.filter),
+                                               std::uint32_t(settings_.point_mode), 0u));
+        block_.set<"shadow_bias">(glm::vec4(settings_.normal_offset, settings_.point_near,
+                                            1.0f / float(settings_.cascade_size),
+                                            1.0f / float(settings_.point_size)));
+        for (std::size_t i = 0; i < point_far_.size(); ++i)
+            block_.set<"point_shadow_far">(i, point_far_[i]);
+        gl.bind_buffer(GL_UNIFORM_BUFFER, buffer_.get());
+        block_.upload(GL_UNIFORM_BUFFER);
+        gl.bind_buffer_base(GL_UNIFORM_BUFFER, BINDING, buffer_.get());
+
+        if (directional_maps_)
+            gl.bind_texture(DIRECTIONAL_UNIT, GL_TEXTURE_2D_ARRAY, directional_maps_.get());
+        if (point_maps_) {
+            if (settings_.point_mode == PointMode::CUBE)
+                gl.bind_texture(POINT_UNIT, GL_TEXTURE_CUBE_MAP_ARRAY, point_maps_.get());
+            else
+                gl.bind_texture(PARABOLOID_UNIT, GL_TEXTURE_2D_ARRAY, point_maps_.get());
+        }
+    }
+
+    void ShadowMaps::setup_program(GLuint program) {
+        gl_state().use_program(program);
+        auto sampler = [program](const char *name, GLuint unit) {
+            auto location = glGetUniformLocation(program, name);
+            if (location != -1)
+                glUniform1i(location, GLint(unit));
+        };
+        sampler("directional_shadows", DIRECTIONAL_UNIT);
+        sampler("point_shadows", POINT_UNIT);
+        sampler("paraboloid_shadows", PARABOLOID_UNIT);
+
+        auto index = glGetUniformBlockIndex(program, "Shadows");
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(program, index, BINDING);
+    }
+}
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "glad/gl.h"
+#include "glm/glm.hpp"
+
+#include "Application/block_layout.h"
+#include "Application/gl_resource.h"
+#include "Application/program_manager.h"
+
+#include "LightManager.h"
+
+namespace xe {
+
+    class Camera;
+
+    class RenderQueue;
+
+    /**
+     * @brief Shadow maps of the directional and point lights of a LightManager.
+     *
+     * Directional lights get cascaded shadow maps. The view frustum up to `max_distance` is split into cascades, each
+     * covered by an orthographic map fitted to the bounding sphere of its slice and snapped to whole texels, so the
+     * map of a cascade only changes when the camera has moved by at least a texel. Point lights get a cube map, or a
+     * dual-paraboloid map which takes two passes instead of six but needs finely tessellated casters.
+     *
+     * Every map layer keeps a copy holding only the static casters (Node::set_static). A layer is redrawn only when
+     * its matrix, its static casters or its dynamic casters changed; the static copy is then refreshed if needed,
+     * copied into the layer, and the dynamic casters are drawn on top. Casters are culled by their bounding spheres
+     * against every cascade and cube face. Transparent submeshes cast no shadows.
+     */
+    class ShadowMaps {
+    public:
+        static constexpr std::uint32_t MAX_CASCADES = 4u;
+        static constexpr std::uint32_t MAX_DIRECTIONAL_SHADOWS = 2u;
+        static constexpr std::uint32_t MAX_POINT_SHADOWS = 8u;
+
+        // Must match shaders/shadows.glsl.
+        static constexpr GLuint BINDING = 5u;
+        static constexpr GLuint DIRECTIONAL_UNIT = 13u;
+        static constexpr GLuint POINT_UNIT = 14u;
+        static constexpr GLuint PARABOLOID_UNIT = 15u;
+
+        enum class PointMode : std::uint32_t {
+            CUBE = 0u, DUAL_PARABOLOID = 1u
+        };
+
+        // Lookups per shadowed light and fragment, each a hardware filtered 2x2 comparison.
+        enum class Filter : std::uint32_t {
+            PCF_1 = 0u, PCF_9 = 1u, PCF_25 = 2u
+        };
+
+        struct settings_t {
+            GLsizei cascade_size = 1024;
+            std::uint32_t n_cascades = 4u;
+            // Shadows end here or at the far plane, whichever is nearer.
+            float max_distance = 100.0f;
+            // Blend between uniform (0) and logarithmic (1) cascade splits.
+            float split_lambda = 0.75f;
+            GLsizei point_size = 512;
+            float point_near = 0.05f;
+            // Point shadows end at the range of their light or here, whichever is nearer. Unattenuated lights have
+            // an infinite range, which cannot be a far plane.
+            float point_far = 100.0f;
+            PointMode point_mode = PointMode::CUBE;
+            Filter filter = Filter::PCF_9;
+            // glPolygonOffset while drawing the maps.
+            float slope_bias = 2.0f;
+            float constant_bias = 4.0f;
+            // The lookup position is moved along the normal by this many texels.
+            float normal_offset = 1.5f;
+        };
+
+        struct stats_t {
+            std::uint32_t views_rendered;
+            std::uint32_t views_cached;
+            std::uint32_t casters_drawn;
+            std::uint32_t casters_culled;
+        };
+
+        using shadows_block_t = layout::std140_block<
+                layout::field<"shadow_cascades", glm::mat4[MAX_DIRECTIONAL_SHADOWS * MAX_CASCADES]>,
+                layout::field<"shadow_inv_view", glm::mat4>,
+                layout::field<"cascade_splits", glm::vec4>,
+                layout::field<"cascade_texel", glm::vec4>,
+                layout::field<"shadow_params", glm::uvec4>,
+                layout::field<"shadow_bias", glm::vec4>,
+                layout::field<"point_shadow_far", glm::vec4[MAX_POINT_SHADOWS / 4u]>>;
+
+        explicit ShadowMaps(LightManager &lights) : lights_(lights) {}
+
+        // Gives light i of the given type a shadow. Returns false when all slots of its kind are taken or for spot
+        // lights, which have no shadows.
+        bool add(LightManager::Type type, std::uint32_t i);
+
+        // Removes every shadow, must be called when the lights are cleared.
+        void clear();
+
+        bool enabled() const { return !directional_.empty() || !point_.empty(); }
+
+        void set_settings(const settings_t &settings);
+
+        const settings_t &settings() const { return settings_; }
+
+        // The static casters moved, every cached layer is redrawn.
+        void invalidate_static() { static_dirty_ = true; }
+
+        // Brings the maps up to date for this frame. Restores the bound draw framebuffer but not the viewport.
+        void render(const RenderQueue &queue, const Camera &camera);
+
+        // Uploads the Shadows block and binds the maps.
+        void bind();
+
+        // Points the shadow samplers of `program` to their units, needed before drawing with it.
+        static void setup_program(GLuint program);
+
+        const stats_t &stats() const { return stats_; }
+
+        // View space distances of the cascade boundaries, `n` + 1 values from `near` to `far`.
+        static std::array<float, MAX_CASCADES + 1> split_distances(float near, float far, std::uint32_t n,
+                                                                   float lambda);
+
+    private:
+        // One layer of a map.
+        struct view_t {
+            // World to clip space, or world to light space for a paraboloid.
+            glm::mat4 VP{0.0f};
+            float range = 0.0f;
+            bool static_valid = false;
+            bool had_dynamic = false;
+            std::uint32_t n_static = 0u;
+        };
+
+        struct shadow_t {
+            std::uint32_t light;
+            std::vector<view_t> views;
+        };
+
+        struct caster_t {
+            std::uint32_t item;
+            glm::vec3 center;
+            float radius;
+            bool is_static;
+        };
+
+        void allocate();
+
+        bool resolve_programs();
+
+        void collect_casters(const RenderQueue &queue);
+
+        void render_directional(const RenderQueue &queue, const Camera &camera, std::uint32_t slot);
+
+        void render_point(const RenderQueue &queue, std::uint32_t slot);
+
+        // Far plane of the shadow of point light i, always finite.
+        float point_far(std::uint32_t i) const;
+
+        // Brings one layer up to date, `visible` tells whether a caster may touch the layer.
+        template<typename Visible>
+        void update_view(const RenderQueue &queue, view_t &view, const glm::mat4 &VP, float range, GLenum target,
+                         GLuint texture, GLuint cache, GLint layer, GLsizei size, bool paraboloid,
+                         Visible visible);
+
+        void draw_casters(const RenderQueue &queue, const std::vector<std::uint32_t> &casters, const glm::mat4 &VP,
+                          float range, bool paraboloid);
+
+        void copy_layer(GLenum target, GLuint src, GLuint dst, GLint layer, GLsizei size);
+
+        LightManager &lights_;
+        settings_t settings_;
+        std::vector<shadow_t> directional_;
+        std::vector<shadow_t> point_;
+        bool allocated_ = false;
+        bool static_dirty_ = true;
+
+        TextureHandle directional_maps_;
+        TextureHandle directional_cache_;
+        TextureHandle point_maps_;
+        TextureHandle point_cache_;
+        FramebufferHandle framebuffer_;
+        FramebufferHandle read_framebuffer_;
+
+        ProgramManager::ticket_t depth_ticket_ = ProgramManager::INVALID_TICKET;
+        ProgramManager::ticket_t paraboloid_ticket_ = ProgramManager::INVALID_TICKET;
+        bool resolved_ = false;
+        ProgramHandle depth_program_;
+        ProgramHandle paraboloid_program_;
+        GLint u_shadow_PVM_ = -1;
+        GLint u_shadow_VM_ = -1;
+        GLint u_shadow_depth_range_ = -1;
+
+        std::vector<caster_t> casters_;
+        std::vector<std::uint32_t> static_casters_;
+        std::vector<std::uint32_t> dynamic_casters_;
+
+        // Far planes of the point shadows by slot, as laid out in the Shadows block.
+        std::array<glm::vec4, MAX_POINT_SHADOWS / 4u> point_far_{};
+        shadows_block_t block_;
+        BufferHandle buffer_;
+        stats_t stats_{};
+    };
+}
@@ -0,0 +1,243 @@
+#include "TextureResidency.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "spdlog/spdlog.h"
+
+#include "Application/gl_state.h"
+#include "Application/mip_chain.h"
+
+#include "Material.h"
+#include "Mesh.h"
+
+namespace {
+    // Drops the `n` finest levels of the data, keeping at least one.
+    void drop_levels(xe::texture_data_t &data, std::size_t n) {
+        auto drop = [n](auto &levels) {
+            auto k = std::min(n, levels.size() - 1u);
+            levels.erase(levels.begin(), levels.begin() + std::ptrdiff_t(k));
+        };
+        if (!data.chain.empty())
+            drop(data.chain.levels);
+        else
+            drop(data.compressed.levels);
+    }
+
+    std::size_t n_levels(const xe::texture_data_t &data) {
+        return data.chain.empty() ? data.compressed.levels.size() : data.chain.levels.size();
+    }
+}
+
+namespace xe {
+
+    TextureResidency &texture_residency() {
+        static TextureResidency residency;
+        return residency;
+    }
+
+    void TextureResidency::track(const texture_layer_t &layer, const std::string &path,
+                                 const texture_options_t &options) {
+        if (!layer.texture)
+            return;
+        auto it = by_name_.find(layer.texture->get());
+        if (it == by_name_.end() || arrays_[it->second].texture.lock() != layer.texture) {
+            array_t array;
+            array.texture = layer.texture;
+            array.options = options;
+            gl_state().bind_texture(0, GL_TEXTURE_2D_ARRAY, layer.texture->get());
+            glGetTexLevelParameteriv(GL_TEXTURE_2D_ARRAY, 0, GL_TEXTURE_WIDTH, &array.width);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D_ARRAY, 0, GL_TEXTURE_HEIGHT, &array.height);
+            // Pre-baked chains may be shorter, corrected once the array is read again.
+            array.n_levels = options.mipmaps ? std::uint32_t(mip_levels(array.width, array.height)) : 1u;
+            array.wanted = array.target = array.n_levels - 1u;
+            array.last_used = frame_;
+            arrays_.push_back(std::move(array));
+            it = by_name_.insert_or_assign(layer.texture->get(), arrays_.size() - 1u).first;
+        }
+        auto &paths = arrays_[it->second].paths;
+        if (paths.size() <= layer.layer)
+            paths.resize(layer.layer + 1u);
+        paths[layer.layer] = path;
+    }
+
+    std::size_t TextureResidency::resident_bytes() const {
+        std::size_t bytes = 0u;
+        for (auto &&array: arrays_)
+            if (auto texture = array.texture.lock())
+                bytes += texture->size();
+        return bytes;
+    }
+
+    std::size_t TextureResidency::n_restreaming() const {
+        return std::size_t(std::count_if(arrays_.begin(), arrays_.end(),
+                                         [](const array_t &array) { return !array.tickets.empty(); }));
+    }
+
+    std::uint32_t TextureResidency::needed_level(const array_t &array, const RenderQueue &queue,
+                                                 const RenderQueue::item_t &item, const glm::mat4 &P,
+                                                 GLsizei viewport_height) {
+        auto radius = item.mesh->bounds_radius();
+        if (!std::isfinite(radius))
+            return 0u;
+        auto &t = queue.transforms()[item.transform];
+        auto scale = std::max({glm::length(glm::vec3(t.M[0])), glm::length(glm::vec3(t.M[1])),
+                               glm::length(glm::vec3(t.M[2]))});
+        radius *= scale;
+
+        // Pixels covered by the diameter of the bounding sphere.
+        auto pixels = radius * P[1][1] * float(viewport_height);
+        if (P[2][3] != 0.0f) {
+            auto distance = -(t.VM * glm::vec4(item.mesh->bounds_center(), 1.0f)).z;
+            if (distance <= radius)
+                return 0u;
+            pixels /= distance;
+        }
+        auto texels = float(std::max(array.width, array.height));
+        if (pixels >= texels)
+            return 0u;
+        auto level = std::uint32_t(std::floor(std::log2(texels / std::max(pixels, 1.0f))));
+        return std::min(level, array.n_levels - 1u);
+    }
+
+    std::uint32_t TextureResidency::floor_level(const array_t &array) const {
+        std::uint32_t level = 0u;
+        while (level + 1u < array.n_levels && std::max(array.width, array.height) >> level > settings_.min_size)
+            ++level;
+        return level;
+    }
+
+    std::size_t TextureResidency::level_bytes(const array_t &array, std::uint32_t level) {
+        auto texture = array.texture.lock();
+        if (!texture)
+            return 0u;
+        auto shift = 2 * (int(array.resident) - int(level));
+        return std::size_t(std::ldexp(double(texture->size()), shift));
+    }
+
+    void TextureResidency::update(const RenderQueue &queue, const glm::mat4 &P, GLsizei viewport_height) {
+        ++frame_;
+        finish_restreams();
+        // Also picks up the names of the arrays just restreamed.
+        remove_expired();
+
+        for (auto &&array: arrays_)
+            array.wanted = array.n_levels - 1u;
+        for (auto &&entry: queue.order()) {
+            auto &item = queue.items()[entry.index];
+            auto material = item.mesh->material(item.submesh);
+            if (material == nullptr)
+                continue;
+            auto it = by_name_.find(material->texture_id());
+            if (it == by_name_.end())
+                continue;
+            auto &array = arrays_[it->second];
+            array.wanted = std::min(array.wanted, needed_level(array, queue, item, P, viewport_height));
+            array.last_used = frame_;
+        }
+
+        choose_targets();
+        start_restreams();
+    }
+
+    void TextureResidency::choose_targets() {
+        std::size_t total = 0u;
+        for (auto &&array: arrays_) {
+            auto floor = floor_level(array);
+            if (frame_ - array.last_used > settings_.unused_frames)
+                array.target = floor;
+            else if (array.wanted > array.resident && array.wanted < array.resident + 2u)
+                // A level of slack, so a texture at the edge between two levels is not restreamed back and forth.
+                array.target = array.resident;
+            else
+                array.target = std::min(array.wanted, floor);
+            total += level_bytes(array, array.target);
+        }
+
+        while (total > settings_.budget) {
+            array_t *victim = nullptr;
+            for (auto &&array: arrays_) {
+                if (array.target + 1u >= array.n_levels)
+                    continue;
+                if (victim == nullptr || array.last_used < victim->last_used ||
+                    (array.last_used == victim->last_used &&
+                     level_bytes(array, array.target) > level_bytes(*victim, victim->target)))
+                    victim = &array;
+            }
+            if (victim == nullptr)
+                break;
+            total -= level_bytes(*victim, victim->target) - level_bytes(*victim, victim->target + 1u);
+            ++victim->target;
+        }
+    }
+
+    void TextureResidency::start_restreams() {
+        // Arrays still loading progressively are owned by the streamer.
+        if (texture_streamer().loading())
+            return;
+        auto in_flight = n_restreaming();
+        // Drops first, they make room for the others.
+        for (auto drops: {true, false})
+            for (auto &&array: arrays_) {
+                if (in_flight >= settings_.max_restreams)
+                    return;
+                if (!array.tickets.empty() || array.target == array.resident ||
+                    (array.target > array.resident) != drops)
+                    continue;
+                if (std::any_of(array.paths.begin(), array.paths.end(), [](auto &&path) { return path.empty(); }))
+                    continue;
+                for (auto &&path: array.paths)
+                    array.tickets.push_back(streamer_.submit(path, array.options));
+                array.restream_level = array.target;
+                ++in_flight;
+            }
+    }
+
+    void TextureResidency::finish_restreams() {
+        for (auto &&array: arrays_) {
+            if (array.tickets.empty() || !std::all_of(array.tickets.begin(), array.tickets.end(),
+                                                      [this](auto t) { return streamer_.ready(t); }))
+                continue;
+            std::vector<texture_data_t> layers;
+            for (auto ticket: array.tickets)
+                layers.push_back(streamer_.take(ticket));
+            array.tickets.clear();
+
+            auto texture = array.texture.lock();
+            if (!texture)
+                continue;
+            if (std::any_of(layers.begin(), layers.end(), [](auto &&data) { return data.empty(); })) {
+                spdlog::warn("Cannot read the images of texture array {} again, its levels are kept",
+                             texture->get());
+                // Not tried again.
+                array.paths.clear();
+                array.paths.resize(layers.size());
+                continue;
+            }
+
+            auto stored = std::uint32_t(n_levels(layers.front()));
+            auto level = std::min(array.restream_level, stored - 1u);
+            std::vector<const texture_data_t *> data;
+            for (auto &&layer: layers) {
+                drop_levels(layer, level);
+                data.push_back(&layer);
+            }
+            auto fresh = TextureHandle::create();
+            fresh.set_size(streamer_.upload_array(fresh.get(), data, array.options));
+            spdlog::debug("Texture array {} restreamed from level {} to {}, {} bytes", texture->get(), array.resident,
+                          level, fresh.size());
+            *texture = std::move(fresh);
+            array.n_levels = stored;
+            array.resident = level;
+        }
+    }
+
+    void TextureResidency::remove_expired() {
+        // Arrays with reads in flight stay until their tickets are taken.
+        std::erase_if(arrays_, [](const array_t &array) { return array.texture.expired() && array.tickets.empty(); });
+        by_name_.clear();
+        for (std::size_t i = 0; i < arrays_.size(); ++i)
+            if (auto texture = arrays_[i].texture.lock())
+                by_name_[texture->get()] = i;
+    }
+}
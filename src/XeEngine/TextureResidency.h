@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "glad/gl.h"
+#include "glm/glm.hpp"
+
+#include "Application/gl_resource.h"
+#include "Application/texture_loader.h"
+#include "Application/texture_streamer.h"
+
+#include "RenderQueue.h"
+
+namespace xe {
+
+    /**
+     * @brief Keeps the material texture arrays within a GPU memory budget by dropping and restoring their finest
+     * mip levels.
+     *
+     * Every frame the finest level each array needs is estimated from the draws of the render queue: the bounding
+     * sphere of the mesh is projected on the screen and the texture is assumed to be mapped once across it, so a
+     * level is needed while it has fewer texels than the sphere has pixels. Arrays not drawn for `unused_frames`
+     * only keep their levels up to `min_size`. When the wanted levels do not fit the budget, the arrays drawn
+     * least recently, and then the largest ones, lose their finest level until they do.
+     *
+     * An array whose resident levels change is read again from its images on the thread pool (the compressed
+     * chains cached next to them make this cheap), reallocated with only the levels kept and swapped into the
+     * same TextureHandle, so the materials sharing it need no update. The old storage is freed by the deletion
+     * queue. Nothing is restreamed while texture_streamer() still loads arrays.
+     */
+    class TextureResidency {
+    public:
+        struct settings_t {
+            // Bytes of all the levels of the tracked arrays.
+            std::size_t budget = std::size_t(1u) << 30;
+            std::uint32_t unused_frames = 300u;
+            // Unused arrays keep the levels of at most this size, unless the budget needs them dropped as well.
+            GLsizei min_size = 64;
+            // Arrays read again at the same time.
+            std::size_t max_restreams = 2u;
+        };
+
+        void set_settings(const settings_t &settings) { settings_ = settings; }
+
+        const settings_t &settings() const { return settings_; }
+
+        // Tracks the array of `layer`, read from `path` with `options` with all its levels resident. Called once
+        // for every layer of the array.
+        void track(const texture_layer_t &layer, const std::string &path, const texture_options_t &options);
+
+        // Estimates the levels needed by the entries of `queue`, seen with the projection `P` on a viewport
+        // `viewport_height` pixels high, and restreams the arrays whose resident levels have to change.
+        void update(const RenderQueue &queue, const glm::mat4 &P, GLsizei viewport_height);
+
+        // GPU bytes of the tracked arrays.
+        std::size_t resident_bytes() const;
+
+        std::size_t n_restreaming() const;
+
+    private:
+        struct array_t {
+            std::weak_ptr<TextureHandle> texture;
+            std::vector<std::string> paths;
+            texture_options_t options;
+            GLsizei width = 0;
+            GLsizei height = 0;
+            std::uint32_t n_levels = 1u;
+            // Finest resident level, finest level needed in this frame and the one chosen for the budget.
+            std::uint32_t resident = 0u;
+            std::uint32_t wanted = 0u;
+            std::uint32_t target = 0u;
+            std::uint32_t last_used = 0u;
+            std::vector<TextureStreamer::ticket_t> tickets;
+            std::uint32_t restream_level = 0u;
+        };
+
+        // Finest level of `array` needed by the draw of `item`.
+        static std::uint32_t needed_level(const array_t &array, const RenderQueue &queue,
+                                          const RenderQueue::item_t &item, const glm::mat4 &P,
+                                          GLsizei viewport_height);
+
+        // Coarsest level of `array` kept while it is not drawn.
+        std::uint32_t floor_level(const array_t &array) const;
+
+        // Estimated bytes of the levels from `level` on, each level is a quarter of the previous one.
+        static std::size_t level_bytes(const array_t &array, std::uint32_t level);
+
+        void choose_targets();
+
+        void start_restreams();
+
+        void finish_restreams();
+
+        void remove_expired();
+
+        settings_t settings_;
+        std::vector<array_t> arrays_;
+        std::unordered_map<GLuint, std::size_t> by_name_;
+        TextureStreamer streamer_;
+        // Frames start at 1, so arrays never drawn have an older stamp than the current frame.
+        std::uint32_t frame_ = 1u;
+    };
+
+    TextureResidency &texture_residency();
+}
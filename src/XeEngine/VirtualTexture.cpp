@@ -0,0 +1,463 @@
+#include "VirtualTexture.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+
+#include "spdlog/spdlog.h"
+
+#include "Application/gl_state.h"
+#include "Application/thread_pool.h"
+
+#include "Material.h"
+#include "Scene.h"
+
+namespace {
+    std::array<xe::VirtualTexture *, xe::VirtualTexture::MAX_TEXTURES> registry{};
+
+    // Feedback values, see vt_feedback in shaders/virtual_texture.glsl. 0 is a pixel without a virtual texture.
+    constexpr std::uint32_t FEEDBACK_VALID = 0x80000000u;
+
+    bool is_ready(const std::future<void> &future) {
+        return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+}
+
+namespace xe {
+
+    const std::array<VirtualTexture *, VirtualTexture::MAX_TEXTURES> &virtual_textures() {
+        return registry;
+    }
+
+    std::shared_ptr<VirtualTexture> VirtualTexture::load(const std::string &image_path, const settings_t &settings) {
+        auto free = std::find(registry.begin(), registry.end(), nullptr);
+        if (free == registry.end()) {
+            spdlog::warn("All {} virtual texture ids are taken, {} is not loaded", MAX_TEXTURES, image_path);
+            return nullptr;
+        }
+        auto id = std::uint32_t(free - registry.begin());
+        // The constructor is private.
+        std::shared_ptr<VirtualTexture> texture(new VirtualTexture(id, settings));
+        if (!open_tile_file(texture->file_, image_path)) {
+            spdlog::error("Cannot build the tile file of {}", image_path);
+            return nullptr;
+        }
+        if (!texture->allocate())
+            return nullptr;
+        registry[id] = texture.get();
+
+        auto &layout = texture->layout();
+        spdlog::info("Virtual texture {}: {}x{}, {} levels, {} tiles", image_path, layout.width, layout.height,
+                     layout.n_levels, layout.n_tiles());
+        return texture;
+    }
+
+    VirtualTexture::VirtualTexture(std::uint32_t id, const settings_t &settings) : id_(id), settings_(settings) {}
+
+    VirtualTexture::~VirtualTexture() {
+        // The read tasks write into loads_ and read from file_.
+        for (auto &&load: loads_)
+            if (load.done.valid())
+                load.done.wait();
+        if (registry[id_] == this)
+            registry[id_] = nullptr;
+    }
+
+    bool VirtualTexture::allocate() {
+        auto &layout = file_.layout();
+        if (layout.n_levels > MAX_LEVELS || layout.tiles_x(0) > MAX_TILES || layout.tiles_y(0) > MAX_TILES) {
+            spdlog::error("A {}x{} image has too many tiles for a virtual texture", layout.width, layout.height);
+            return false;
+        }
+        auto page_size = layout.page_size();
+        GLint max_size = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+        // The coarsest level takes one page and never leaves the cache.
+        settings_.cache_pages = std::clamp(settings_.cache_pages, 2u,
+                                           std::min(255u, std::uint32_t(max_size) / page_size));
+        auto cache_size = settings_.cache_pages * page_size;
+
+        level_offsets_.clear();
+        level_rows_.clear();
+        std::uint32_t rows = 0u;
+        for (std::uint32_t l = 0; l < layout.n_levels; ++l) {
+            level_offsets_.push_back(layout.tile_index(l, 0u, 0u));
+            level_rows_.push_back(rows);
+            rows += layout.tiles_y(l);
+        }
+        auto columns = layout.tiles_x(0);
+        tiles_.assign(layout.n_tiles(), tile_t{});
+        indirection_data_.assign(std::size_t(columns) * rows, {0u, 0u, 0u, 0u});
+
+        auto &gl = gl_state();
+        cache_ = TextureHandle::create();
+        gl.bind_texture(CACHE_UNIT, GL_TEXTURE_2D, cache_.get());
+#if (MAJOR >= 4) && (MINOR >= 2)
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, GLsizei(cache_size), GLsizei(cache_size));
+#else
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, GLsizei(cache_size), GLsizei(cache_size), 0, GL_RGBA,
+                     GL_UNSIGNED_BYTE, nullptr);
+#endif
+        // Pages are sampled at level 0 only, their borders make bilinear filtering seamless.
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        cache_.set_size(std::size_t(cache_size) * cache_size * 4u);
+
+        indirection_ = TextureHandle::create();
+        gl.bind_texture(INDIRECTION_UNIT, GL_TEXTURE_2D, indirection_.get());
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8UI, GLsizei(columns), GLsizei(rows), 0, GL_RGBA_INTEGER,
+                     GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        indirection_.set_size(indirection_data_.size() * 4u);
+
+        block_.set<"vt_size">(glm::uvec4(layout.width, layout.height, layout.tile_size, layout.border));
+        block_.set<"vt_cache">(glm::uvec4(page_size, cache_size, layout.n_levels, id_));
+        for (std::uint32_t i = 0; i < MAX_LEVELS / 4u; ++i) {
+            glm::uvec4 level_rows(0u);
+            for (std::uint32_t j = 0; j < 4u && 4u * i + j < layout.n_levels; ++j)
+                level_rows[j] = level_rows_[4u * i + j];
+            block_.set<"vt_level_rows">(i, level_rows);
+        }
+        buffer_ = BufferHandle::create();
+        gl.bind_buffer(GL_UNIFORM_BUFFER, buffer_.get());
+        glBufferData(GL_UNIFORM_BUFFER, block_t::SIZE, nullptr, GL_STATIC_DRAW);
+        buffer_.set_size(block_t::SIZE);
+        block_.upload(GL_UNIFORM_BUFFER);
+
+        pages_.assign(std::size_t(settings_.cache_pages) * settings_.cache_pages, page_t{});
+        free_pages_.clear();
+        for (auto p = std::int32_t(pages_.size()); p-- > 0;)
+            free_pages_.push_back(p);
+
+        // The coarsest level is the fallback of every lookup.
+        std::vector<std::uint8_t> data(layout.page_bytes());
+        auto coarsest = layout.n_levels - 1u;
+        for (auto index = level_offsets_[coarsest]; index < layout.n_tiles(); ++index) {
+            auto page = acquire_page();
+            if (page == NO_PAGE || !file_.read(index, data.data())) {
+                spdlog::error("Cannot load the coarsest level of a virtual texture");
+                return false;
+            }
+            upload_page(page, data.data());
+            tiles_[index].page = page;
+            pages_[page] = {index, 0u, true};
+        }
+        update_indirection();
+        return true;
+    }
+
+    void VirtualTexture::request(std::uint32_t level, std::uint32_t x, std::uint32_t y) {
+        auto &layout = file_.layout();
+        // Stamped with the frame the next update starts, a tile already stamped has its ancestors stamped too.
+        auto stamp = frame_ + 1u;
+        for (; level < layout.n_levels; ++level, x /= 2u, y /= 2u) {
+            x = std::min(x, layout.tiles_x(level) - 1u);
+            y = std::min(y, layout.tiles_y(level) - 1u);
+            auto index = level_offsets_[level] + y * layout.tiles_x(level) + x;
+            if (tiles_[index].requested == stamp)
+                break;
+            tiles_[index].requested = stamp;
+            requests_.push_back(index);
+        }
+    }
+
+    void VirtualTexture::update() {
+        stats_.uploaded = 0u;
+        stats_.evicted = 0u;
+        // Without new feedback the frame does not advance, so the pages needed last stay protected.
+        if (!requests_.empty()) {
+            ++frame_;
+            stats_.requested = std::uint32_t(requests_.size());
+            // Coarser levels have higher indices and are loaded first, they are what finer tiles fall back to.
+            std::sort(requests_.begin(), requests_.end(), std::greater<>());
+            for (auto index: requests_) {
+                auto &tile = tiles_[index];
+                if (tile.page != NO_PAGE) {
+                    pages_[tile.page].used = frame_;
+                } else if (!tile.loading && loads_.size() < settings_.max_loads) {
+                    tile.loading = true;
+                    auto &load = loads_.emplace_back();
+                    load.tile = index;
+                    load.data.resize(layout().page_bytes());
+                    load.done = thread_pool().submit([this, &load] {
+                        load.ok = file_.read(load.tile, load.data.data());
+                    });
+                }
+            }
+            requests_.clear();
+        }
+
+        for (auto it = loads_.begin(); it != loads_.end() && stats_.uploaded < settings_.max_uploads;) {
+            if (!is_ready(it->done)) {
+                ++it;
+                continue;
+            }
+            it->done.get();
+            auto &tile = tiles_[it->tile];
+            tile.loading = false;
+            auto page = it->ok ? acquire_page() : NO_PAGE;
+            if (page != NO_PAGE) {
+                upload_page(page, it->data.data());
+                tile.page = page;
+                pages_[page] = {it->tile, tile.requested, false};
+                indirection_dirty_ = true;
+                ++stats_.uploaded;
+            }
+            it = loads_.erase(it);
+        }
+
+        stats_.resident = std::uint32_t(pages_.size() - free_pages_.size());
+        if (indirection_dirty_)
+            update_indirection();
+    }
+
+    std::int32_t VirtualTexture::acquire_page() {
+        if (!free_pages_.empty()) {
+            auto page = free_pages_.back();
+            free_pages_.pop_back();
+            return page;
+        }
+        auto oldest = NO_PAGE;
+        for (std::int32_t p = 0; p < std::int32_t(pages_.size()); ++p) {
+            auto &page = pages_[p];
+            if (page.pinned || page.used >= frame_)
+                continue;
+            if (oldest == NO_PAGE || page.used < pages_[oldest].used)
+                oldest = p;
+        }
+        if (oldest != NO_PAGE) {
+            tiles_[pages_[oldest].tile].page = NO_PAGE;
+            indirection_dirty_ = true;
+            ++stats_.evicted;
+        }
+        return oldest;
+    }
+
+    void VirtualTexture::upload_page(std::int32_t page, const std::uint8_t *data) {
+        auto size = GLint(layout().page_size());
+        auto x = GLint(std::uint32_t(page) % settings_.cache_pages) * size;
+        auto y = GLint(std::uint32_t(page) / settings_.cache_pages) * size;
+        auto &gl = gl_state();
+        gl.bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0u);
+        gl.bind_texture(CACHE_UNIT, GL_TEXTURE_2D, cache_.get());
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, size, size, GL_RGBA, GL_UNSIGNED_BYTE, data);
+    }
+
+    void VirtualTexture::update_indirection() {
+        auto &layout = file_.layout();
+        auto columns = layout.tiles_x(0);
+        // Coarse to fine, a tile without a page takes the entry of its parent.
+        for (auto level = layout.n_levels; level-- > 0u;) {
+            auto tiles_x = layout.tiles_x(level);
+            auto tiles_y = layout.tiles_y(level);
+            for (std::uint32_t y = 0; y < tiles_y; ++y) {
+                for (std::uint32_t x = 0; x < tiles_x; ++x) {
+                    auto &entry = indirection_data_[std::size_t(level_rows_[level] + y) * columns + x];
+                    auto page = tiles_[level_offsets_[level] + y * tiles_x + x].page;
+                    if (page != NO_PAGE) {
+                        entry = {std::uint8_t(std::uint32_t(page) % settings_.cache_pages),
+                                 std::uint8_t(std::uint32_t(page) / settings_.cache_pages), std::uint8_t(level),
+                                 255u};
+                    } else if (level + 1u < layout.n_levels) {
+                        auto px = std::min(x / 2u, layout.tiles_x(level + 1u) - 1u);
+                        auto py = std::min(y / 2u, layout.tiles_y(level + 1u) - 1u);
+                        entry = indirection_data_[std::size_t(level_rows_[level + 1u] + py) * columns + px];
+                    }
+                }
+            }
+        }
+
+        auto &gl = gl_state();
+        gl.bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0u);
+        gl.bind_texture(INDIRECTION_UNIT, GL_TEXTURE_2D, indirection_.get());
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, GLsizei(columns), GLsizei(indirection_data_.size() / columns),
+                        GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, indirection_data_.data());
+        indirection_dirty_ = false;
+    }
+
+    void VirtualTexture::bind() const {
+        auto &gl = gl_state();
+        gl.bind_buffer_base(GL_UNIFORM_BUFFER, BINDING, buffer_.get());
+        gl.bind_texture(CACHE_UNIT, GL_TEXTURE_2D, cache_.get());
+        gl.bind_texture(INDIRECTION_UNIT, GL_TEXTURE_2D, indirection_.get());
+    }
+
+    void VirtualTexture::setup_program(GLuint program) {
+        gl_state().use_program(program);
+        auto sampler = [program](const char *name, GLuint unit) {
+            auto location = glGetUniformLocation(program, name);
+            if (location != -1)
+                glUniform1i(location, GLint(unit));
+        };
+        sampler("vt_pages", CACHE_UNIT);
+        sampler("vt_indirection", INDIRECTION_UNIT);
+
+        auto index = glGetUniformBlockIndex(program, "VirtualTexture");
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(program, index, BINDING);
+    }
+
+    VirtualTextureFeedback::VirtualTextureFeedback() {
+        ticket_ = program_manager().submit({{GL_VERTEX_SHADER, std::string(PROJECT_DIR) + "/shaders/color_vs.glsl"},
+                                            {GL_FRAGMENT_SHADER,
+                                             std::string(PROJECT_DIR) + "/shaders/vt_feedback_fs.glsl"}});
+    }
+
+    VirtualTextureFeedback::~VirtualTextureFeedback() {
+        for (auto &&readback: readbacks_)
+            if (readback.fence != nullptr)
+                glDeleteSync(readback.fence);
+    }
+
+    bool VirtualTextureFeedback::resolve_program() {
+        if (resolved_)
+            return bool(program_);
+        resolved_ = true;
+
+        program_ = ProgramHandle(program_manager().get(ticket_));
+        if (!program_) {
+            spdlog::error("Virtual texture feedback program failed to build, virtual textures stay at their "
+                          "coarsest level");
+            return false;
+        }
+        Scene::check_block_layouts(program_.get());
+        VirtualTexture::setup_program(program_.get());
+        u_enabled_ = glGetUniformLocation(program_.get(), "vt_enabled");
+        u_lod_bias_ = glGetUniformLocation(program_.get(), "vt_lod_bias");
+        return true;
+    }
+
+    void VirtualTextureFeedback::resize(GLsizei width, GLsizei height) {
+        if (width == width_ && height == height_)
+            return;
+        width_ = width;
+        height_ = height;
+
+        auto &gl = gl_state();
+        if (!framebuffer_)
+            framebuffer_ = FramebufferHandle::create();
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_.get());
+
+        target_ = TextureHandle::create();
+        gl.bind_texture(0, GL_TEXTURE_2D, target_.get());
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, width, height, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        target_.set_size(std::size_t(width) * std::size_t(height) * 4u);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target_.get(), 0);
+
+        depth_ = RenderbufferHandle::create();
+        glBindRenderbuffer(GL_RENDERBUFFER, depth_.get());
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        depth_.set_size(std::size_t(width) * std::size_t(height) * 4u);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_.get());
+
+        glDrawBuffer(GL_COLOR_ATTACHMENT0);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        auto status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        if (status != GL_FRAMEBUFFER_COMPLETE)
+            spdlog::error("Virtual texture feedback framebuffer is incomplete: {:#x}", status);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void VirtualTextureFeedback::collect_readbacks() {
+        auto &gl = gl_state();
+        auto &textures = virtual_textures();
+        for (std::size_t i = 1; i <= N_READBACKS; ++i) {
+            // Oldest first.
+            auto &readback = readbacks_[(next_readback_ + i) % N_READBACKS];
+            if (readback.fence == nullptr || glClientWaitSync(readback.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+                continue;
+            glDeleteSync(readback.fence);
+            readback.fence = nullptr;
+
+            auto n = std::size_t(readback.width) * std::size_t(readback.height);
+            gl.bind_buffer(GL_PIXEL_PACK_BUFFER, readback.buffer.get());
+            auto values = static_cast<const std::uint32_t *>(
+                    glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, GLsizeiptr(n * 4u), GL_MAP_READ_BIT));
+            if (values != nullptr) {
+                // Neighbouring pixels mostly sample the same tile.
+                auto previous = 0u;
+                for (std::size_t k = 0; k < n; ++k) {
+                    auto v = values[k];
+                    if (v == previous || (v & FEEDBACK_VALID) == 0u)
+                        continue;
+                    previous = v;
+                    if (auto texture = textures[(v >> 28u) & 7u]; texture != nullptr)
+                        texture->request((v >> 24u) & 15u, v & 0xfffu, (v >> 12u) & 0xfffu);
+                }
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            }
+            gl.bind_buffer(GL_PIXEL_PACK_BUFFER, 0u);
+        }
+    }
+
+    void VirtualTextureFeedback::render(Scene &scene, const RenderQueue &queue, std::size_t end,
+                                        const glm::ivec4 &viewport) {
+        auto &textures = virtual_textures();
+        if (std::none_of(textures.begin(), textures.end(), [](auto texture) { return texture != nullptr; }))
+            return;
+        collect_readbacks();
+
+        auto &readback = readbacks_[next_readback_];
+        auto scale = std::max(settings_.scale, 1);
+        if (readback.fence == nullptr && end > 0u && viewport[2] > 0 && viewport[3] > 0 && resolve_program()) {
+            auto width = std::max(viewport[2] / scale, 1);
+            auto height = std::max(viewport[3] / scale, 1);
+            resize(width, height);
+
+            GLint target = 0;
+            glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_.get());
+            glViewport(0, 0, width, height);
+
+            auto &gl = gl_state();
+            gl.enable(GL_DEPTH_TEST);
+            gl.depth_func(GL_LESS);
+            gl.depth_mask(GL_TRUE);
+            gl.set(GL_BLEND, false);
+            const GLuint none[4] = {0u, 0u, 0u, 0u};
+            const GLfloat far = 1.0f;
+            glClearBufferuiv(GL_COLOR, 0, none);
+            glClearBufferfv(GL_DEPTH, 0, &far);
+
+            gl.use_program(program_.get());
+            // Derivatives at 1/scale of the resolution are scale times larger.
+            glUniform1f(u_lod_bias_, -std::log2(float(scale)));
+            queue.submit(scene, 0, end, [this](const Material *material) {
+                auto texture = material != nullptr ? material->virtual_texture() : nullptr;
+                if (texture != nullptr)
+                    texture->bind();
+                glUniform1ui(u_enabled_, texture != nullptr ? 1u : 0u);
+            });
+
+            if (!readback.buffer)
+                readback.buffer = BufferHandle::create();
+            auto bytes = std::size_t(width) * std::size_t(height) * 4u;
+            gl.bind_buffer(GL_PIXEL_PACK_BUFFER, readback.buffer.get());
+            if (readback.buffer.size() != bytes) {
+                glBufferData(GL_PIXEL_PACK_BUFFER, GLsizeiptr(bytes), nullptr, GL_STREAM_READ);
+                readback.buffer.set_size(bytes);
+            }
+            glReadPixels(0, 0, width, height, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+            gl.bind_buffer(GL_PIXEL_PACK_BUFFER, 0u);
+            readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            readback.width = width;
+            readback.height = height;
+            next_readback_ = (next_readback_ + 1u) % N_READBACKS;
+
+            glBindFramebuffer(GL_FRAMEBUFFER, GLuint(target));
+        }
+
+        for (auto texture: textures)
+            if (texture != nullptr)
+                texture->update();
+    }
+}
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "glad/gl.h"
+#include "glm/glm.hpp"
+
+#include "Application/block_layout.h"
+#include "Application/gl_resource.h"
+#include "Application/program_manager.h"
+#include "Application/tile_file.h"
+
+#include "RenderQueue.h"
+
+namespace xe {
+
+    class Scene;
+
+    /**
+     * @brief Texture too large to keep resident, streamed in tiles into a fixed size page cache.
+     *
+     * The tiled mip pyramid lives in a tile file next to the image (see open_tile_file). The page cache is one
+     * RGBA8 texture of `cache_pages` x `cache_pages` pages, the indirection texture holds for every tile of every
+     * level the page of the finest resident tile covering it. Shaders (shaders/virtual_texture.glsl) pick the
+     * level from the texel footprint, look up the page and sample it bilinearly.
+     *
+     * Which tiles are needed comes from VirtualTextureFeedback. Missing tiles are read on the thread pool, coarse
+     * levels first, and at most `max_uploads` pages are uploaded per frame. When the cache is full the least
+     * recently used page that was not needed this frame is replaced. The coarsest level is loaded up front and
+     * never evicted, so every lookup has a fallback. GPU memory is the cache and the indirection texture, whatever
+     * the size of the image.
+     */
+    class VirtualTexture {
+    public:
+        static constexpr std::uint32_t MAX_TEXTURES = 8u;
+        static constexpr std::uint32_t MAX_LEVELS = 16u;
+        // Feedback packs tile coordinates in 12 bits.
+        static constexpr std::uint32_t MAX_TILES = 4096u;
+        // Images larger than this in either dimension are loaded as virtual textures by load_mesh_from_obj.
+        static constexpr GLsizei MIN_SIZE = 4096;
+
+        // Must match shaders/virtual_texture.glsl.
+        static constexpr GLuint BINDING = 6u;
+        static constexpr GLuint CACHE_UNIT = 11u;
+        static constexpr GLuint INDIRECTION_UNIT = 12u;
+
+        using block_t = layout::std140_block<
+                // width, height, tile size, border
+                layout::field<"vt_size", glm::uvec4>,
+                // page size, cache size in texels, number of levels, id
+                layout::field<"vt_cache", glm::uvec4>,
+                // First row of each level in the indirection texture.
+                layout::field<"vt_level_rows", glm::uvec4[MAX_LEVELS / 4]>>;
+
+        struct settings_t {
+            // At most 255, the indirection texture stores page coordinates in bytes.
+            std::uint32_t cache_pages = 24u;
+            std::uint32_t max_uploads = 16u;
+            // Tile reads queued on the thread pool.
+            std::uint32_t max_loads = 32u;
+        };
+
+        struct stats_t {
+            std::uint32_t requested;
+            std::uint32_t uploaded;
+            std::uint32_t evicted;
+            std::uint32_t resident;
+        };
+
+        // Returns nullptr when the image cannot be read, its tile file cannot be written or all ids are taken.
+        static std::shared_ptr<VirtualTexture> load(const std::string &image_path, const settings_t &settings);
+
+        static std::shared_ptr<VirtualTexture> load(const std::string &image_path) { return load(image_path, {}); }
+
+        // Sets the sampler units and the block binding, for every program that includes virtual_texture.glsl.
+        static void setup_program(GLuint program);
+
+        VirtualTexture(const VirtualTexture &) = delete;
+
+        VirtualTexture &operator=(const VirtualTexture &) = delete;
+
+        ~VirtualTexture();
+
+        std::uint32_t id() const { return id_; }
+
+        const tile_layout_t &layout() const { return file_.layout(); }
+
+        // Marks the tile and its ancestors as needed in this frame.
+        void request(std::uint32_t level, std::uint32_t x, std::uint32_t y);
+
+        // Starts loading the requested tiles, uploads finished ones and updates the indirection texture.
+        void update();
+
+        void bind() const;
+
+        GLuint cache_texture() const { return cache_.get(); }
+
+        const stats_t &stats() const { return stats_; }
+
+    private:
+        static constexpr std::int32_t NO_PAGE = -1;
+
+        struct tile_t {
+            std::int32_t page = NO_PAGE;
+            std::uint32_t requested = 0u;
+            bool loading = false;
+        };
+
+        struct page_t {
+            std::uint32_t tile = 0u;
+            std::uint32_t used = 0u;
+            bool pinned = false;
+        };
+
+        struct load_t {
+            std::uint32_t tile;
+            std::vector<std::uint8_t> data;
+            bool ok = false;
+            std::future<void> done;
+        };
+
+        VirtualTexture(std::uint32_t id, const settings_t &settings);
+
+        bool allocate();
+
+        // A free page, or the least recently used one not needed in this frame. NO_PAGE when all are in use.
+        std::int32_t acquire_page();
+
+        void upload_page(std::int32_t page, const std::uint8_t *data);
+
+        void update_indirection();
+
+        std::uint32_t id_;
+        settings_t settings_;
+        TileFile file_;
+
+        TextureHandle cache_;
+        TextureHandle indirection_;
+        BufferHandle buffer_;
+        block_t block_;
+
+        std::vector<tile_t> tiles_;
+        std::vector<page_t> pages_;
+        std::vector<std::int32_t> free_pages_;
+        std::vector<std::uint32_t> requests_;
+        // A list, the read tasks hold on to their entry until they are done.
+        std::list<load_t> loads_;
+        // Index of the first tile of each level.
+        std::vector<std::uint32_t> level_offsets_;
+        // First row of each level in the indirection texture.
+        std::vector<std::uint32_t> level_rows_;
+        // Page x, page y, level of the page, 255; one texel per tile of every level.
+        std::vector<std::array<std::uint8_t, 4>> indirection_data_;
+        bool indirection_dirty_ = true;
+        // Frames start at 1, so a tile never requested has an older stamp than the current frame.
+        std::uint32_t frame_ = 1u;
+        stats_t stats_{};
+    };
+
+    // Live virtual textures by id, nullptr for free ids.
+    const std::array<VirtualTexture *, VirtualTexture::MAX_TEXTURES> &virtual_textures();
+
+    /**
+     * @brief Low resolution pass that finds the virtual texture tiles the view needs.
+     *
+     * The opaque queue entries are drawn at 1/`scale` of the viewport into an R32UI target; fragments of materials
+     * with a virtual texture write the texture id, level and tile they sample, the others 0. The target is read
+     * into a pixel pack buffer and mapped a few frames later, once its fence has signalled, so the pass never
+     * stalls. The level is computed with the derivatives of the full resolution image.
+     */
+    class VirtualTextureFeedback {
+    public:
+        struct settings_t {
+            GLsizei scale = 8;
+        };
+
+        VirtualTextureFeedback();
+
+        ~VirtualTextureFeedback();
+
+        void set_settings(const settings_t &settings) { settings_ = settings; }
+
+        const settings_t &settings() const { return settings_; }
+
+        // Draws the entries [0, end) of the queue when any virtual texture is alive and a read back buffer is
+        // free, passes finished read backs to the textures and updates them. `viewport` is x, y, width, height.
+        // Restores the bound draw framebuffer but not the viewport.
+        void render(Scene &scene, const RenderQueue &queue, std::size_t end, const glm::ivec4 &viewport);
+
+    private:
+        static constexpr std::size_t N_READBACKS = 3u;
+
+        struct readback_t {
+            BufferHandle buffer;
+            GLsync fence = nullptr;
+            GLsizei width = 0;
+            GLsizei height = 0;
+        };
+
+        bool resolve_program();
+
+        void collect_readbacks();
+
+        void resize(GLsizei width, GLsizei height);
+
+        settings_t settings_;
+
+        ProgramManager::ticket_t ticket_ = ProgramManager::INVALID_TICKET;
+        bool resolved_ = false;
+        ProgramHandle program_;
+        GLint u_enabled_ = -1;
+        GLint u_lod_bias_ = -1;
+
+        FramebufferHandle framebuffer_;
+        TextureHandle target_;
+        RenderbufferHandle depth_;
+        GLsizei width_ = 0;
+        GLsizei height_ = 0;
+
+        std::array<readback_t, N_READBACKS> readbacks_;
+        std::size_t next_readback_ = 0u;
+    };
+}
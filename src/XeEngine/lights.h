@@ -6,14 +6,45 @@
 
 #include "glm/glm.hpp"
 
+// Light descriptions in world space, see LightManager for their GPU form.
+
 struct PointLight {
     PointLight() = default;
 
     PointLight(const glm::vec3 &pos, const glm::vec3 &color, const glm::vec3 &atn) : position_in_world_space(pos),
                                                                                      color(color), atn(atn) {}
 
-    alignas(16) glm::vec3 position_in_world_space;
-    alignas(16) glm::vec3 position_in_view_space;
-    alignas(16) glm::vec3 color;
-    alignas(16) glm::vec3 atn;
-};
\ No newline at end of file
+    glm::vec3 position_in_world_space{0.0f};
+    glm::vec3 color{1.0f};
+    // Constant, linear and quadratic attenuation.
+    glm::vec3 atn{1.0f, 0.0f, 0.0f};
+};
+
+struct SpotLight {
+    SpotLight() = default;
+
+    // The angles are measured from the axis, in radians. The light fades out between them.
+    SpotLight(const glm::vec3 &pos, const glm::vec3 &direction, const glm::vec3 &color, const glm::vec3 &atn,
+              float inner_angle, float outer_angle) : position_in_world_space(pos),
+                                                      direction_in_world_space(direction), color(color), atn(atn),
+                                                      inner_angle(inner_angle), outer_angle(outer_angle) {}
+
+    glm::vec3 position_in_world_space{0.0f};
+    // Direction the light shines in.
+    glm::vec3 direction_in_world_space{0.0f, 0.0f, -1.0f};
+    glm::vec3 color{1.0f};
+    glm::vec3 atn{1.0f, 0.0f, 0.0f};
+    float inner_angle = 0.0f;
+    float outer_angle = 0.5f;
+};
+
+struct DirectionalLight {
+    DirectionalLight() = default;
+
+    DirectionalLight(const glm::vec3 &direction, const glm::vec3 &color) : direction_in_world_space(direction),
+                                                                           color(color) {}
+
+    // Direction the light shines in.
+    glm::vec3 direction_in_world_space{0.0f, -1.0f, 0.0f};
+    glm::vec3 color{1.0f};
+};
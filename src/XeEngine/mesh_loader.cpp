@@ -6,6 +6,9 @@
 
 #include "mesh_loader.h"
 
+#include <algorithm>
+#include <functional>
+#include <map>
 #include <memory>
 
 
@@ -14,15 +17,37 @@
 #include "glm/gtx/string_cast.hpp"
 #include "glm/gtc/type_ptr.hpp"
 
+#include "Application/mip_chain.h"
 #include "ObjectReader/obj_reader.h"
+#include "ObjectReader/vertex_upload.h"
 #include "XeEngine/ColorMaterial.h"
 #include "XeEngine/PhongMaterial.h"
 #include "XeEngine/Mesh.h"
+#include "XeEngine/VirtualTexture.h"
 
 
 namespace {
-    xe::ColorMaterial *make_color_material(const xe::mtl_material_t &mat, std::string mtl_dir);
-    xe::PhongMaterial *make_phong_material(const xe::mtl_material_t &mat, std::string mtl_dir);
+    // Images larger than VirtualTexture::MIN_SIZE are streamed as virtual textures, the others are array layers.
+    // Layers start as the placeholder, the materials using them are told when the image is uploaded.
+    struct diffuse_map_t {
+        xe::texture_layer_t layer;
+        std::shared_ptr<xe::VirtualTexture> virtual_texture;
+        std::vector<xe::TextureStreamer::callback_t> listeners;
+    };
+
+    using texture_map_t = std::map<std::string, diffuse_map_t>;
+
+    std::shared_ptr<xe::ColorMaterial> make_color_material(const xe::mtl_material_t &mat, texture_map_t &textures);
+    std::shared_ptr<xe::PhongMaterial> make_phong_material(const xe::mtl_material_t &mat, texture_map_t &textures);
+
+    // Swaps the texture of the material once it is loaded. The material may be gone by then.
+    template<typename M>
+    xe::TextureStreamer::callback_t texture_listener(const std::shared_ptr<M> &material) {
+        return [weak = std::weak_ptr<M>(material)](const xe::texture_layer_t &layer) {
+            if (auto material = weak.lock())
+                material->set_texture(layer.texture, layer.layer);
+        };
+    }
 }
 
 namespace xe {
@@ -36,81 +61,53 @@ namespace xe {
 
 
         auto mesh = new Mesh;
-        auto n_vertices = smesh.vertex_coords.size();
         auto n_indices = 3 * smesh.faces.size();
 
-
-        uint n_floats_per_vertex = 3;
-        for (auto &&t: smesh.has_texcoords) {
-            if (t)
-                n_floats_per_vertex += 2;
-        }
-        if (smesh.has_normals)
-            n_floats_per_vertex += 3;
-        if (smesh.has_normals)
-            n_floats_per_vertex += 4;
-
-
-        size_t stride = n_floats_per_vertex * sizeof(GLfloat);
-
-
         mesh->allocate_index_buffer(n_indices * sizeof(uint16_t), GL_STATIC_DRAW);
         mesh->load_indices(0, n_indices * sizeof(uint16_t), smesh.faces.data());
 
-        mesh->allocate_vertex_buffer(n_vertices * n_floats_per_vertex * sizeof(float), GL_STATIC_DRAW);
-        mesh->vertex_attrib_pointer(0, 3, GL_FLOAT, n_floats_per_vertex * sizeof(GLfloat), 0);
-
-
-        auto v_ptr = reinterpret_cast<uint8_t *>(mesh->map_vertex_buffer());
-
-        size_t offset = 0;
-
-        {
+        xe::upload_smesh_vertices(*mesh, smesh);
+        mesh->load_positions(smesh.vertex_coords.data(), smesh.vertex_coords.size());
 
-            auto v_offset = offset;
-            for (auto i = 0; i < smesh.vertex_coords.size(); i++, v_offset += stride) {
-                spdlog::debug("vertex[{}] {} ", i, glm::to_string(smesh.vertex_coords[i]));
-                std::memcpy(v_ptr + v_offset, glm::value_ptr(smesh.vertex_coords[i]), sizeof(glm::vec3));
-            }
-        }
-        offset += 3 * sizeof(GLfloat);
-
-        for (int it = 0; it < xe::sMesh::MAX_TEXCOORDS; it++) {
-            if (smesh.has_texcoords[it]) {
-                mesh->vertex_attrib_pointer(1 + it, 2, GL_FLOAT, stride, offset);
-
-                auto v_offset = offset;
-                for (auto i = 0; i < smesh.vertex_texcoords[it].size(); i++, v_offset += stride) {
-                    std::memcpy(v_ptr + v_offset, glm::value_ptr(smesh.vertex_texcoords[0][i]), sizeof(glm::vec2));
-                }
-                offset += 2 * sizeof(GLfloat);
-            }
+        glm::vec3 lo(smesh.vertex_coords[0]), hi(lo);
+        for (auto &&v: smesh.vertex_coords) {
+            lo = glm::min(lo, v);
+            hi = glm::max(hi, v);
         }
-        if (smesh.has_normals) {
-            mesh->vertex_attrib_pointer(xe::sMesh::MAX_TEXCOORDS + 1, 3, GL_FLOAT, stride, offset);
-            offset += 3 * sizeof(GLfloat);
+        auto center = 0.5f * (lo + hi);
+        float radius = 0.0f;
+        for (auto &&v: smesh.vertex_coords)
+            radius = std::max(radius, glm::length(v - center));
+        mesh->set_bounds(center, radius);
+
+        // The mesh is returned with placeholder textures. The images are decoded in the background, packed into
+        // shared arrays and uploaded by the scene, coarsest mip first.
+        texture_map_t textures;
+        for (auto &&sm: smesh.submeshes)
+            if (sm.mat_idx >= 0 && !smesh.materials[sm.mat_idx].diffuse_texname.empty())
+                textures.emplace(smesh.materials[sm.mat_idx].diffuse_texname, diffuse_map_t{});
+        for (auto &&[name, texture]: textures) {
+            auto texture_path = mtl_dir + "/" + name;
+            GLsizei width = 0, height = 0;
+            if (read_image_size(texture_path, width, height) && std::max(width, height) > VirtualTexture::MIN_SIZE)
+                texture.virtual_texture = VirtualTexture::load(texture_path);
+            if (!texture.virtual_texture)
+                texture.layer = texture_streamer().placeholder();
         }
 
-        if (smesh.has_tangents) {
-            mesh->vertex_attrib_pointer(xe::sMesh::MAX_TEXCOORDS + 2, 4, GL_FLOAT, stride, offset);
-            offset += 4 * sizeof(GLfloat);
-        }
-
-        mesh->unmap_vertex_buffer();
-
 
         for (int i = 0; i < smesh.submeshes.size(); i++) {
             auto sm = smesh.submeshes[i];
             spdlog::debug("Adding submesh {:4d} {:4d} {:4d}", i, sm.start, sm.end);
-            Material* material = new xe::ColorMaterial(glm::vec4{1.0, 1.0, 1.0, 1.0});
+            std::shared_ptr<Material> material = std::make_shared<xe::ColorMaterial>(glm::vec4{1.0, 1.0, 1.0, 1.0});
             if (sm.mat_idx >= 0) {
                 auto mat = smesh.materials[sm.mat_idx];
                 switch (mat.illum) {
                     case 0:
-                        material = make_color_material(mat, mtl_dir);
+                        material = make_color_material(mat, textures);
                         break;
                     case 1:
-                        material = make_phong_material(mat, mtl_dir);
+                        material = make_phong_material(mat, textures);
                         break;
                 }
 
@@ -118,6 +115,18 @@ namespace xe {
             }
 
         }
+
+        std::vector<std::string> names;
+        std::vector<TextureStreamer::callback_t> callbacks;
+        for (auto &&[name, texture]: textures)
+            if (!texture.virtual_texture) {
+                names.push_back(mtl_dir + "/" + name);
+                callbacks.push_back([listeners = std::move(texture.listeners)](const texture_layer_t &layer) {
+                    for (auto &&listener: listeners)
+                        listener(layer);
+                });
+            }
+        xe::create_textures_progressive(names, callbacks);
         return std::shared_ptr<Mesh>(mesh);
 
 
@@ -126,38 +135,58 @@ namespace xe {
 
     namespace {
 
-        xe::ColorMaterial *make_color_material(const xe::mtl_material_t &mat, std::string mtl_dir) {
+        std::shared_ptr<xe::ColorMaterial> make_color_material(const xe::mtl_material_t &mat,
+                                                               texture_map_t &textures) {
 
             glm::vec4 color;
             for (int i = 0; i < 3; i++)
                 color[i] = mat.diffuse[i];
             color[3] = 1.0;
             spdlog::debug("Adding ColorMaterial {}", glm::to_string(color));
-            auto material = new xe::ColorMaterial(color);
+            auto material = std::make_shared<xe::ColorMaterial>(color);
             if (!mat.diffuse_texname.empty()) {
-                auto texture = xe::create_texture(mtl_dir + "/" + mat.diffuse_texname);
-                spdlog::debug("Adding Texture {} {:1d}", mat.diffuse_texname, texture);
-                if (texture > 0) {
-                    material->set_texture(texture);
+                auto &diffuse = textures.at(mat.diffuse_texname);
+                auto &texture = diffuse.layer;
+                if (diffuse.virtual_texture) {
+                    spdlog::debug("Adding virtual texture {} {:1d}", mat.diffuse_texname,
+                                  diffuse.virtual_texture->id());
+                    material->set_virtual_texture(diffuse.virtual_texture);
+                } else {
+                    spdlog::debug("Adding Texture {} {:1d} layer {}", mat.diffuse_texname,
+                                  texture.texture ? texture.texture->get() : 0u, texture.layer);
+                    if (texture.texture) {
+                        material->set_texture(texture.texture, texture.layer);
+                        diffuse.listeners.push_back(texture_listener(material));
+                    }
                 }
             }
 
             return material;
         }
 
-        xe::PhongMaterial *make_phong_material(const xe::mtl_material_t &mat, std::string mtl_dir) {
+        std::shared_ptr<xe::PhongMaterial> make_phong_material(const xe::mtl_material_t &mat,
+                                                               texture_map_t &textures) {
 
             glm::vec4 color;
             for (int i = 0; i < 3; i++)
                 color[i] = mat.diffuse[i];
             color[3] = 1.0;
             spdlog::debug("Adding ColorMaterial {}", glm::to_string(color));
-            auto material = new xe::PhongMaterial(color);
+            auto material = std::make_shared<xe::PhongMaterial>(color);
             if (!mat.diffuse_texname.empty()) {
-                auto texture = xe::create_texture(mtl_dir + "/" + mat.diffuse_texname);
-                spdlog::debug("Adding Texture {} {:1d}", mat.diffuse_texname, texture);
-                if (texture > 0) {
-                    material->set_texture(texture);
+                auto &diffuse = textures.at(mat.diffuse_texname);
+                auto &texture = diffuse.layer;
+                if (diffuse.virtual_texture) {
+                    spdlog::debug("Adding virtual texture {} {:1d}", mat.diffuse_texname,
+                                  diffuse.virtual_texture->id());
+                    material->set_virtual_texture(diffuse.virtual_texture);
+                } else {
+                    spdlog::debug("Adding Texture {} {:1d} layer {}", mat.diffuse_texname,
+                                  texture.texture ? texture.texture->get() : 0u, texture.layer);
+                    if (texture.texture) {
+                        material->set_texture(texture.texture, texture.layer);
+                        diffuse.listeners.push_back(texture_listener(material));
+                    }
                 }
             }
 
@@ -0,0 +1,37 @@
+// Clustered point and spot light lists, see LightClusters.h. Needs lights.glsl.
+
+// x - offset into cluster_light_indices, y - number of lights.
+layout(std430, binding=1) readonly buffer ClusterGrid {
+    uvec2 clusters[];
+};
+
+layout(std430, binding=2) readonly buffer ClusterIndices {
+    uint cluster_light_indices[];
+};
+
+layout(std140, binding=4) uniform ClusterParams {
+    uvec4 cluster_dims;
+    vec4  cluster_depth; // near, far, slice scale, slice bias
+    vec4  cluster_viewport; // x, y, 1/width, 1/height
+};
+
+// Cluster of the fragment at the window coordinates `frag_coord`, gl_FragCoord.xy, relative to the viewport origin
+// like the tiles of LightClusters.
+uint cluster_index(vec2 frag_coord, float depth) {
+    vec2 uv = (frag_coord - cluster_viewport.xy) * cluster_viewport.zw;
+    uvec2 tile = min(uvec2(max(uv, 0.0) * vec2(cluster_dims.xy)), cluster_dims.xy - 1u);
+    float s = log(max(depth, cluster_depth.x)) * cluster_depth.z + cluster_depth.w;
+    uint slice = uint(clamp(s, 0.0, float(cluster_dims.z - 1u)));
+    return (slice * cluster_dims.y + tile.y) * cluster_dims.x + tile.x;
+}
+
+// Phong sum over the local lights of the cluster containing the fragment at window coordinates `frag_coord`,
+// position and normal in view space.
+vec3 shade_cluster_lights(vec2 frag_coord, vec3 position, vec3 normal, vec3 Kd, vec3 Ks, float Ns) {
+    vec3 view_dir = normalize(-position);
+    vec3 color = vec3(0.0);
+    uvec2 cluster = clusters[cluster_index(frag_coord, -position.z)];
+    for (uint i = 0u; i < cluster.y; ++i)
+        color += shade_local_light(cluster_light_indices[cluster.x + i], position, normal, view_dir, Kd, Ks, Ns);
+    return color;
+}
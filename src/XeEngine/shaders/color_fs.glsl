@@ -2,22 +2,20 @@
 
 layout(location=0) out vec4 vFragColor;
 
-#if __VERSION__ > 410
-layout(std140, binding=0) uniform Color {
-#else
-    layout(std140) uniform Color {
-    #endif
-    vec4  Kd;
-    bool use_map_Kd;
-};
+#include "material.glsl"
+#include "virtual_texture.glsl"
 
 in vec2 vertex_texcoords_0;
 
-uniform sampler2D map_Kd;
+uniform sampler2DArray map_Kd;
 
 void main() {
-    if (use_map_Kd)
-    vFragColor = Kd*texture(map_Kd, vertex_texcoords_0);
+    MaterialParams material = current_material();
+    vec4 Kd = material.Kd;
+    if ((material.flags & USE_VIRTUAL_KD) != 0u)
+    vFragColor = Kd*sample_virtual(vertex_texcoords_0);
+    else if ((material.flags & USE_MAP_KD) != 0u)
+    vFragColor = Kd*texture(map_Kd, vec3(vertex_texcoords_0, material.map_Kd_layer));
     else
     vFragColor = Kd;
     //vFragColor = vec4(1.0, 0.0, 0.0, 1.0);
@@ -14,6 +14,9 @@ layout(std140, binding=1) uniform Transformations {
     mat4 PVM;
 };
 
+// Must match shaders/depth_vs.glsl for the GL_EQUAL test after the depth pre-pass.
+invariant gl_Position;
+
 out vec2 vertex_texcoords_0;
 
 void main() {
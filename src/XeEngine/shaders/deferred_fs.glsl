@@ -0,0 +1,50 @@
+#version 460
+
+// Lighting pass of the deferred renderer, see DeferredRenderer.h.
+
+layout(location=0) out vec4 vFragColor;
+
+#include "gbuffer.glsl"
+#include "lights.glsl"
+#include "clusters.glsl"
+
+uniform sampler2D gbuffer_normal;
+uniform sampler2D gbuffer_albedo;
+uniform sampler2D gbuffer_specular;
+uniform sampler2D gbuffer_ambient;
+uniform sampler2D gbuffer_depth;
+
+uniform mat4 inv_projection;
+// x, y, 1/width, 1/height of the viewport.
+uniform vec4 viewport;
+uniform vec3 ambient_light;
+
+void main() {
+    vec2 frag_coord = gl_FragCoord.xy - viewport.xy;
+    ivec2 texel = ivec2(frag_coord);
+    float depth = texelFetch(gbuffer_depth, texel, 0).r;
+    // Nothing was drawn here, keep the background.
+    if (depth == 1.0)
+        discard;
+    gl_FragDepth = depth;
+
+    vec4 albedo = texelFetch(gbuffer_albedo, texel, 0);
+    if (albedo.a == 0.0) {
+        vFragColor = vec4(albedo.rgb, 1.0);
+        return;
+    }
+
+    vec4 ndc = vec4(frag_coord * viewport.zw * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    vec4 position = inv_projection * ndc;
+    position /= position.w;
+
+    vec3 normal = decode_normal(texelFetch(gbuffer_normal, texel, 0).xy);
+    vec4 specular = texelFetch(gbuffer_specular, texel, 0);
+    vec3 Ka = texelFetch(gbuffer_ambient, texel, 0).rgb;
+
+    float Ns = decode_shininess(specular.a);
+    vec3 color = Ka * ambient_light +
+                 shade_directional_lights(position.xyz, normal, albedo.rgb, specular.rgb, Ns) +
+                 shade_cluster_lights(gl_FragCoord.xy, position.xyz, normal, albedo.rgb, specular.rgb, Ns);
+    vFragColor = vec4(color, 1.0);
+}
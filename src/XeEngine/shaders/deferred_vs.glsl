@@ -0,0 +1,8 @@
+#version 460
+
+// Full screen triangle, drawn without vertex attributes.
+
+void main() {
+    vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,20 @@
+#version 460
+
+// Depth pre-pass, see DepthPrepass.h. The program has no fragment shader.
+
+layout(location=0) in vec4 a_vertex_position;
+
+#if __VERSION__ > 410
+layout(std140, binding=1) uniform Transformations {
+#else
+    layout(std140) uniform Transformations {
+#endif
+    mat4 PVM;
+};
+
+// The shading pass tests with GL_EQUAL, its vertex shaders must compute the same depth.
+invariant gl_Position;
+
+void main() {
+    gl_Position = PVM * a_vertex_position;
+}
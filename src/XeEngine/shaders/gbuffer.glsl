@@ -0,0 +1,27 @@
+// G-buffer encoding shared by the geometry and lighting passes, see DeferredRenderer.h.
+
+vec2 sign_not_zero(vec2 v) {
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// Octahedral mapping of a unit vector onto [-1,1]^2.
+vec2 encode_normal(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    return n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * sign_not_zero(n.xy);
+}
+
+vec3 decode_normal(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * sign_not_zero(n.xy);
+    return normalize(n);
+}
+
+// Shininess up to 1023 stored logarithmically in eight bits.
+float encode_shininess(float Ns) {
+    return clamp(log2(Ns + 1.0) / 10.0, 0.0, 1.0);
+}
+
+float decode_shininess(float e) {
+    return exp2(e * 10.0) - 1.0;
+}
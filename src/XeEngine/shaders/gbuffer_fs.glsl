@@ -0,0 +1,40 @@
+#version 460
+
+// Geometry pass of the deferred renderer, used with phong_vs.glsl.
+
+layout(location=0) out vec2 gNormal;
+layout(location=1) out vec4 gAlbedo;
+layout(location=2) out vec4 gSpecular;
+layout(location=3) out vec4 gAmbient;
+
+#include "material.glsl"
+#include "gbuffer.glsl"
+#include "virtual_texture.glsl"
+
+in vec2 vertex_texcoords_0;
+in vec3 vertex_coords_in_viewspace;
+in vec3 vertex_normal_in_viewspace;
+
+uniform sampler2DArray map_Kd;
+
+void main() {
+    MaterialParams material = current_material();
+    vec4 Ka = material.Ka;
+    vec4 Kd = material.Kd;
+    vec3 Ks = material.Ks.rgb;
+    float Ns = material.Ns;
+    uint flags = material.flags;
+    uint layer = material.map_Kd_layer;
+    // map_Ka shares the array and layer of map_Kd, as in phong_fs.glsl.
+    if ((flags & USE_MAP_KA) != 0u)
+        Ka *= texture(map_Kd, vec3(vertex_texcoords_0, layer));
+    if ((flags & USE_VIRTUAL_KD) != 0u)
+        Kd *= sample_virtual(vertex_texcoords_0);
+    else if ((flags & USE_MAP_KD) != 0u)
+        Kd *= texture(map_Kd, vec3(vertex_texcoords_0, layer));
+
+    gNormal = encode_normal(normalize(vertex_normal_in_viewspace));
+    gAlbedo = vec4(Kd.rgb, (flags & UNLIT) != 0u ? 0.0 : 1.0);
+    gSpecular = vec4(Ks, encode_shininess(Ns));
+    gAmbient = vec4(Ka.rgb, 1.0);
+}
@@ -0,0 +1,74 @@
+// Lights in view space, written by LightManager, see LightManager.h.
+
+#define LIGHT_POINT 0.0
+#define LIGHT_SPOT 1.0
+#define LIGHT_DIRECTIONAL 2.0
+
+// The shadow slot, -1 for none, is in position_range.w of directional lights and direction_cos_outer.w of point
+// lights.
+struct Light {
+    vec4 position_range;
+    vec4 color_type;
+    vec4 atn_cos_inner;
+    vec4 direction_cos_outer;
+};
+
+// light_counts.x point and spot lights come first, followed by light_counts.y directional lights.
+#if __VERSION__ >= 430
+layout(std140, binding=3) readonly buffer Lights {
+    uvec4 light_counts;
+    Light lights[];
+};
+#else
+#define MAX_LIGHTS 255
+layout(std140) uniform Lights {
+    uvec4 light_counts;
+    Light lights[MAX_LIGHTS];
+};
+#endif
+
+#include "shadows.glsl"
+
+vec3 phong(vec3 l, vec3 normal, vec3 view_dir, vec3 radiance, vec3 Kd, vec3 Ks, float Ns) {
+    float diffuse = max(dot(normal, l), 0.0);
+    float specular = Ns > 0.0 ? pow(max(dot(reflect(-l, normal), view_dir), 0.0), Ns) : 0.0;
+    return radiance * (diffuse * Kd + specular * Ks);
+}
+
+// Point or spot light i.
+vec3 shade_local_light(uint i, vec3 position, vec3 normal, vec3 view_dir, vec3 Kd, vec3 Ks, float Ns) {
+    Light light = lights[i];
+    vec3 to_light = light.position_range.xyz - position;
+    float d = length(to_light);
+    if (d > light.position_range.w)
+        return vec3(0.0);
+    vec3 l = to_light / d;
+    float attenuation = 1.0 / (light.atn_cos_inner.x + light.atn_cos_inner.y * d + light.atn_cos_inner.z * d * d);
+    if (light.color_type.w == LIGHT_SPOT)
+        attenuation *= smoothstep(light.direction_cos_outer.w, light.atn_cos_inner.w,
+                                  dot(-l, light.direction_cos_outer.xyz));
+    else if (light.direction_cos_outer.w >= 0.0)
+        attenuation *= point_shadow(int(light.direction_cos_outer.w), light, position, normal);
+    return phong(l, normal, view_dir, attenuation * light.color_type.rgb, Kd, Ks, Ns);
+}
+
+vec3 shade_directional_lights(vec3 position, vec3 normal, vec3 Kd, vec3 Ks, float Ns) {
+    vec3 view_dir = normalize(-position);
+    vec3 color = vec3(0.0);
+    for (uint i = light_counts.x; i < light_counts.x + light_counts.y; ++i) {
+        float shadow = lights[i].position_range.w >= 0.0 ?
+                       directional_shadow(int(lights[i].position_range.w), position, normal) : 1.0;
+        color += shadow * phong(-lights[i].direction_cos_outer.xyz, normal, view_dir, lights[i].color_type.rgb,
+                                Kd, Ks, Ns);
+    }
+    return color;
+}
+
+// Every point and spot light, for when there are no light clusters.
+vec3 shade_local_lights(vec3 position, vec3 normal, vec3 Kd, vec3 Ks, float Ns) {
+    vec3 view_dir = normalize(-position);
+    vec3 color = vec3(0.0);
+    for (uint i = 0u; i < light_counts.x; ++i)
+        color += shade_local_light(i, position, normal, view_dir, Kd, Ks, Ns);
+    return color;
+}
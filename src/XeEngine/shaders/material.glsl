@@ -0,0 +1,40 @@
+// Material table shared by all material shaders, see MaterialTable.h.
+
+#define MAX_MATERIALS 256
+
+#define USE_MAP_KA 1u
+#define USE_MAP_KD 2u
+#define USE_MAP_KS 4u
+#define USE_MAP_NS 8u
+// Not lit by the deferred lighting pass, Kd is written out as is.
+#define UNLIT 16u
+// map_Kd is the virtual texture of virtual_texture.glsl.
+#define USE_VIRTUAL_KD 32u
+
+struct MaterialParams {
+    vec4  Ka; //0
+    vec4  Kd; //4
+    vec4  Ks; //8
+    float Ns; //12
+    float Ns_offset; //13
+    uint  flags; //14
+    uint  map_Kd_layer; //15
+};
+
+#if __VERSION__ > 410
+layout(std140, binding=0) uniform Materials {
+#else
+    layout(std140) uniform Materials {
+#endif
+    MaterialParams materials[MAX_MATERIALS];
+};
+
+uniform uint material_index;
+
+// Parameters of material_index, the defaults of material_params_t when it is out of range: submeshes without a
+// material and materials that did not get a slot.
+MaterialParams current_material() {
+    if (material_index < uint(MAX_MATERIALS))
+        return materials[material_index];
+    return MaterialParams(vec4(0.0), vec4(1.0), vec4(0.0), 0.0, 0.0, 0u, 0u);
+}
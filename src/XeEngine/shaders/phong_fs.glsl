@@ -1,44 +1,19 @@
 #version 460
 
-#define MAX_POINT_LIGHTS 16
-
 layout(location=0) out vec4 vFragColor;
 
 
-#if __VERSION__ > 410
-layout(std140, binding=0) uniform Material {
-#else
-    layout(std140) uniform Material {
-#endif
-    vec4  Ka; //0
-    vec4  Kd; //4
-    vec4  Ks; //8
-    float Ns; //12
-    float Ns_offset; //13
-    bool use_map_Ka; //14
-    bool use_map_Kd; //15
-    bool use_map_Ks; //16
-    bool use_map_Ns; //17
-} material;
-
-
+#include "material.glsl"
+#include "virtual_texture.glsl"
 
 uniform vec3 ambient_light;
 
 
-struct PointLight {
-    vec3 position_in_view_space;
-    vec3 color;
-    vec3 atn;
-};
+#include "lights.glsl"
 
-#if __VERSION__ > 410
-layout(std140, binding=3) uniform Light {
-#else
-layout(std140) uniform Lights {
+#ifdef CLUSTERED_LIGHTING
+#include "clusters.glsl"
 #endif
-    PointLight light[MAX_POINT_LIGHTS];
-} p_light;
 
 
 in vec2 vertex_texcoords_0;
@@ -46,26 +21,39 @@ in vec3 vertex_coords_in_viewspace;
 in vec3 vertex_normal_in_viewspace;
 
 
-uniform sampler2D map_Ka;
-uniform sampler2D map_Kd;
-uniform sampler2D map_Ks;
+// The maps are layers of texture arrays, all samplers default to unit 0 and must have the same type.
+uniform sampler2DArray map_Ka;
+uniform sampler2DArray map_Kd;
+uniform sampler2DArray map_Ks;
 
-uniform sampler2D maps[3];
 
 void main() {
+MaterialParams material = current_material();
 vec4 Ka = material.Ka;
 vec4 Kd = material.Kd;
 vec4 Ks = material.Ks;
 float Ns = material.Ns;
-
-if(material.use_map_Ka)
-    Ka *= texture(map_Ka, vertex_texcoords_0);
-if (material.use_map_Kd)
-    Kd *= texture(map_Kd, vertex_texcoords_0);
-if(material.use_map_Ks)
-    Ks.rgb *= texture(map_Ks, vertex_texcoords_0).rgb;
-if(material.use_map_Ns)
-    Ns *= texture(map_Ks, vertex_texcoords_0).a;
-
-vFragColor = Kd;
+// Only map_Kd is set by the engine, the other maps share its layer.
+vec3 uv = vec3(vertex_texcoords_0, material.map_Kd_layer);
+
+if((material.flags & USE_MAP_KA) != 0u)
+    Ka *= texture(map_Ka, uv);
+if ((material.flags & USE_VIRTUAL_KD) != 0u)
+    Kd *= sample_virtual(vertex_texcoords_0);
+else if ((material.flags & USE_MAP_KD) != 0u)
+    Kd *= texture(map_Kd, uv);
+if((material.flags & USE_MAP_KS) != 0u)
+    Ks.rgb *= texture(map_Ks, uv).rgb;
+if((material.flags & USE_MAP_NS) != 0u)
+    Ns *= texture(map_Ks, uv).a;
+
+vec3 normal = normalize(vertex_normal_in_viewspace);
+vec3 color = Ka.rgb * ambient_light +
+             shade_directional_lights(vertex_coords_in_viewspace, normal, Kd.rgb, Ks.rgb, Ns);
+#ifdef CLUSTERED_LIGHTING
+color += shade_cluster_lights(gl_FragCoord.xy, vertex_coords_in_viewspace, normal, Kd.rgb, Ks.rgb, Ns);
+#else
+color += shade_local_lights(vertex_coords_in_viewspace, normal, Kd.rgb, Ks.rgb, Ns);
+#endif
+vFragColor = vec4(color, Kd.a);
 }
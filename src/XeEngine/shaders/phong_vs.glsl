@@ -27,6 +27,9 @@ layout(std140, binding=2) uniform Matrices {
 };
 
 
+// Must match shaders/depth_vs.glsl for the GL_EQUAL test after the depth pre-pass.
+invariant gl_Position;
+
 out vec2 vertex_texcoords_0;
 out vec3 vertex_coords_in_viewspace;
 out vec3 vertex_normal_in_viewspace;
@@ -0,0 +1,30 @@
+#version 460
+
+// Depth only pass of the shadow maps, see ShadowMaps.h. The program has no fragment shader.
+
+layout(location=0) in vec4 a_vertex_position;
+
+#ifdef PARABOLOID
+// Model to light space, looking down -z.
+uniform mat4 shadow_VM;
+// Near plane and light range.
+uniform vec2 shadow_depth_range;
+
+out float gl_ClipDistance[1];
+
+void main() {
+    vec4 q = shadow_VM * a_vertex_position;
+    float d = length(q.xyz);
+    vec3 dir = q.xyz / d;
+    // Only the hemisphere in front of the light is kept.
+    gl_ClipDistance[0] = -q.z;
+    float depth = (d - shadow_depth_range.x) / (shadow_depth_range.y - shadow_depth_range.x);
+    gl_Position = vec4(dir.xy / max(1.0 - dir.z, 1e-4), depth * 2.0 - 1.0, 1.0);
+}
+#else
+uniform mat4 shadow_PVM;
+
+void main() {
+    gl_Position = shadow_PVM * a_vertex_position;
+}
+#endif
@@ -0,0 +1,91 @@
+// Shadow maps, see ShadowMaps.h. Needs the Light struct of lights.glsl.
+
+#define MAX_DIRECTIONAL_SHADOWS 2
+#define MAX_CASCADES 4
+#define MAX_POINT_SHADOWS 8
+#define POINT_SHADOWS_CUBE 0u
+
+#if __VERSION__ > 410
+layout(std140, binding=5) uniform Shadows {
+#else
+layout(std140) uniform Shadows {
+#endif
+    // View space to shadow map coordinates and depth, per cascade of every directional shadow.
+    mat4 shadow_cascades[MAX_DIRECTIONAL_SHADOWS * MAX_CASCADES];
+    mat4 shadow_inv_view;
+    // Far distance and world size of a texel of each cascade.
+    vec4 cascade_splits;
+    vec4 cascade_texel;
+    // Cascades, PCF radius, point shadow mode.
+    uvec4 shadow_params;
+    // Normal offset in texels, point shadow near plane, 1/cascade size, 1/point map size.
+    vec4 shadow_bias;
+    // Far plane of each point shadow, the light range clamped to a finite distance.
+    vec4 point_shadow_far[MAX_POINT_SHADOWS / 4];
+};
+
+uniform sampler2DArrayShadow directional_shadows;
+uniform samplerCubeArrayShadow point_shadows;
+uniform sampler2DArrayShadow paraboloid_shadows;
+
+// Average of (2r+1)^2 hardware 2x2 comparisons around uv.
+float filter_shadow_2d(sampler2DArrayShadow map, vec2 uv, float layer, float depth, float texel) {
+    int r = int(shadow_params.y);
+    float sum = 0.0;
+    for (int y = -r; y <= r; ++y)
+        for (int x = -r; x <= r; ++x)
+            sum += texture(map, vec4(uv + vec2(x, y) * texel, layer, depth));
+    float n = float(2 * r + 1);
+    return sum / (n * n);
+}
+
+// Fraction of directional shadow `slot` reaching the view space position.
+float directional_shadow(int slot, vec3 position, vec3 normal) {
+    float depth = -position.z;
+    uint cascade = 0u;
+    while (cascade < shadow_params.x && depth > cascade_splits[cascade])
+        ++cascade;
+    if (cascade == shadow_params.x)
+        return 1.0;
+    int layer = slot * int(shadow_params.x) + int(cascade);
+    vec3 p = position + normal * (shadow_bias.x * cascade_texel[cascade]);
+    vec4 s = shadow_cascades[layer] * vec4(p, 1.0);
+    return filter_shadow_2d(directional_shadows, s.xy, float(layer), s.z, shadow_bias.z);
+}
+
+// Fraction of the point light reaching the view space position.
+float point_shadow(int slot, Light light, vec3 position, vec3 normal) {
+    vec3 to_fragment = position - light.position_range.xyz;
+    float texel = 2.0 * length(to_fragment) * shadow_bias.w;
+    // The maps are laid out along the world axes.
+    vec3 v = mat3(shadow_inv_view) * (to_fragment + normal * (shadow_bias.x * texel));
+    float n = shadow_bias.y;
+    float f = point_shadow_far[slot / 4][slot % 4];
+
+    if (shadow_params.z == POINT_SHADOWS_CUBE) {
+        // Depth the face projection gave the fragment.
+        float z = max(abs(v.x), max(abs(v.y), abs(v.z)));
+        // Past the far plane nothing was drawn into the map.
+        if (z >= f)
+            return 1.0;
+        float depth = 0.5 * ((f + n) / (f - n) - 2.0 * f * n / ((f - n) * z)) + 0.5;
+        vec3 t1 = normalize(cross(v, abs(v.y) < 0.9 * length(v) ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0)));
+        vec3 t2 = normalize(cross(v, t1));
+        int r = int(shadow_params.y);
+        float sum = 0.0;
+        for (int y = -r; y <= r; ++y)
+            for (int x = -r; x <= r; ++x)
+                sum += texture(point_shadows, vec4(v + (float(x) * t1 + float(y) * t2) * texel, float(slot)), depth);
+        float k = float(2 * r + 1);
+        return sum / (k * k);
+    }
+
+    int h = v.z <= 0.0 ? 0 : 1;
+    vec3 q = h == 0 ? v : vec3(-v.x, v.y, -v.z);
+    float d = length(q);
+    if (d >= f)
+        return 1.0;
+    vec3 dir = q / d;
+    vec2 uv = dir.xy / max(1.0 - dir.z, 1e-4) * 0.5 + 0.5;
+    return filter_shadow_2d(paraboloid_shadows, uv, float(2 * slot + h), (d - n) / (f - n), shadow_bias.w);
+}
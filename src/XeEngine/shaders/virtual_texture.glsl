@@ -0,0 +1,61 @@
+// Virtual texture, see VirtualTexture.h.
+
+#define VT_MAX_LEVELS 16
+
+#if __VERSION__ > 410
+layout(std140, binding=6) uniform VirtualTexture {
+#else
+layout(std140) uniform VirtualTexture {
+#endif
+    // Width, height, tile size, border.
+    uvec4 vt_size;
+    // Page size, cache size in texels, number of levels, id.
+    uvec4 vt_cache;
+    // First row of each level in the indirection texture.
+    uvec4 vt_level_rows[VT_MAX_LEVELS / 4];
+};
+
+uniform sampler2D vt_pages;
+// Page x, page y and level of the finest resident tile covering each tile.
+uniform usampler2D vt_indirection;
+
+// Level whose texels match the footprint of the fragment, the derivatives are taken before wrapping.
+uint vt_level(vec2 uv, float bias) {
+    vec2 dx = dFdx(uv * vec2(vt_size.xy));
+    vec2 dy = dFdy(uv * vec2(vt_size.xy));
+    float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8)) + bias;
+    return uint(clamp(floor(lod), 0.0, float(vt_cache.z - 1u)));
+}
+
+uvec2 vt_level_size(uint level) {
+    return max(vt_size.xy >> level, uvec2(1u));
+}
+
+// Tile of the level containing the wrapped coordinates.
+uvec2 vt_tile(vec2 st, uint level) {
+    uvec2 size = vt_level_size(level);
+    return min(uvec2(st * vec2(size)), size - 1u) / vt_size.z;
+}
+
+vec4 sample_virtual(vec2 uv) {
+    uint level = vt_level(uv, 0.0);
+    vec2 st = fract(uv);
+    uvec2 tile = vt_tile(st, level);
+    uvec4 entry = texelFetch(vt_indirection, ivec2(tile.x, vt_level_rows[level / 4u][level % 4u] + tile.y), 0);
+
+    // The page may hold an ancestor of the tile, its texels are looked up at that level.
+    uint resident = entry.z;
+    uvec2 resident_tile = tile >> (resident - level);
+    vec2 local = st * vec2(vt_level_size(resident)) - vec2(resident_tile * vt_size.z);
+    // Rounding at odd level sizes can step slightly outside the tile, the border covers it.
+    local = clamp(local, -float(vt_size.w) + 0.5, float(vt_size.z + vt_size.w) - 0.5);
+    vec2 texel = vec2(entry.xy * vt_cache.x + vt_size.w) + local;
+    return textureLod(vt_pages, texel / float(vt_cache.y), 0.0);
+}
+
+// Value written by the feedback pass, see VirtualTextureFeedback.
+uint vt_feedback(vec2 uv, float bias) {
+    uint level = vt_level(uv, bias);
+    uvec2 tile = vt_tile(fract(uv), level);
+    return 0x80000000u | (vt_cache.w << 28) | (level << 24) | (tile.y << 12) | tile.x;
+}
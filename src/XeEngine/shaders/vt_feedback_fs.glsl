@@ -0,0 +1,18 @@
+#version 460
+
+// Virtual texture feedback pass, used with color_vs.glsl. See VirtualTextureFeedback.
+
+layout(location=0) out uint vFeedback;
+
+#include "virtual_texture.glsl"
+
+in vec2 vertex_texcoords_0;
+
+// Whether the material of the draw has a virtual texture.
+uniform uint vt_enabled;
+// Compensates the lower resolution of the pass, so the levels match the full resolution image.
+uniform float vt_lod_bias;
+
+void main() {
+    vFeedback = vt_enabled != 0u ? vt_feedback(vertex_texcoords_0, vt_lod_bias) : 0u;
+}
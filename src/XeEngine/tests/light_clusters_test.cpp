@@ -0,0 +1,142 @@
+// Headless check of the LightClusters binning against the cluster indexing of shaders/clusters.glsl.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <numbers>
+#include <vector>
+
+#include "XeEngine/LightClusters.h"
+
+namespace {
+    using xe::LightClusters;
+
+    constexpr float FOV = 0.5f * std::numbers::pi_v<float>;
+    constexpr float WIDTH = 1280.0f;
+    constexpr float HEIGHT = 720.0f;
+    constexpr float ASPECT = WIDTH / HEIGHT;
+    constexpr float NEAR = 0.1f;
+    constexpr float FAR = 100.0f;
+    // Viewport origin, tiles are counted from it as in cluster_index.
+    constexpr float VIEWPORT_X = 64.0f;
+    constexpr float VIEWPORT_Y = 32.0f;
+
+    int failures = 0;
+
+    void check(bool condition, const char *what) {
+        if (!condition) {
+            std::printf("FAILED: %s\n", what);
+            ++failures;
+        }
+    }
+
+    bool contains(const LightClusters &clusters, std::uint32_t cluster, std::uint32_t light) {
+        auto &c = clusters.clusters()[cluster];
+        auto begin = clusters.indices().begin() + c.offset;
+        return std::find(begin, begin + c.count, light) != begin + c.count;
+    }
+
+    // cluster_index of shaders/clusters.glsl for the fragment of the view space point p. The slice uses the same
+    // log(max(depth, near)) * scale + bias as the shader.
+    std::uint32_t shader_cluster_index(const LightClusters &clusters, float x, float y, float z) {
+        auto p11 = 1.0f / std::tan(0.5f * FOV);
+        auto p00 = p11 / ASPECT;
+        auto depth = -z;
+        auto frag_x = VIEWPORT_X + (p00 * x / depth * 0.5f + 0.5f) * WIDTH;
+        auto frag_y = VIEWPORT_Y + (p11 * y / depth * 0.5f + 0.5f) * HEIGHT;
+        auto u = (frag_x - VIEWPORT_X) / WIDTH;
+        auto v = (frag_y - VIEWPORT_Y) / HEIGHT;
+        auto tile_x = std::min(std::uint32_t(std::max(u, 0.0f) * float(LightClusters::TILES_X)),
+                               LightClusters::TILES_X - 1u);
+        auto tile_y = std::min(std::uint32_t(std::max(v, 0.0f) * float(LightClusters::TILES_Y)),
+                               LightClusters::TILES_Y - 1u);
+        return (clusters.slice(depth) * LightClusters::TILES_Y + tile_y) * LightClusters::TILES_X + tile_x;
+    }
+
+    // Every visible point inside the sphere of `light` must shade with a cluster listing it.
+    void check_covered(const LightClusters &clusters, std::uint32_t light, float cx, float cy, float cz, float r) {
+        constexpr int N = 12;
+        auto p11 = 1.0f / std::tan(0.5f * FOV);
+        auto p00 = p11 / ASPECT;
+        auto missing = 0;
+        for (int i = 0; i <= N; ++i)
+            for (int j = 0; j <= N; ++j)
+                for (int k = 0; k <= N; ++k) {
+                    auto dx = r * (2.0f * float(i) / N - 1.0f);
+                    auto dy = r * (2.0f * float(j) / N - 1.0f);
+                    auto dz = r * (2.0f * float(k) / N - 1.0f);
+                    if (dx * dx + dy * dy + dz * dz >= r * r)
+                        continue;
+                    auto x = cx + dx, y = cy + dy, z = cz + dz;
+                    auto depth = -z;
+                    if (depth <= NEAR || depth >= FAR || std::abs(p00 * x / depth) >= 1.0f ||
+                        std::abs(p11 * y / depth) >= 1.0f)
+                        continue;
+                    if (!contains(clusters, shader_cluster_index(clusters, x, y, z), light))
+                        ++missing;
+                }
+        if (missing > 0)
+            std::printf("light %u is missing from %d shaded clusters\n", light, missing);
+        check(missing == 0, "every fragment inside a light finds it in its cluster");
+    }
+}
+
+int main() {
+    LightClusters clusters;
+    clusters.set_projection(FOV, ASPECT, NEAR, FAR);
+
+    check(clusters.slice(NEAR) == 0u, "the near plane is in the first slice");
+    check(clusters.slice(FAR) == LightClusters::SLICES - 1u, "the far plane is in the last slice");
+    check(clusters.slice(0.0f) == 0u, "depths in front of the near plane clamp to the first slice");
+
+    // 0: small sphere on the view axis, 1: behind the camera, 2: right of the frustum, 3: spanning several tiles
+    // and slices in the top left, 4: crossing the near plane.
+    std::vector<float> x = {0.0f, 0.0f, 50.0f, -6.0f, 0.3f};
+    std::vector<float> y = {0.0f, 0.0f, 0.0f, 3.0f, -0.2f};
+    std::vector<float> z = {-10.0f, 5.0f, -10.0f, -8.0f, -0.5f};
+    std::vector<float> r = {0.5f, 1.0f, 1.0f, 2.5f, 1.0f};
+    clusters.build(x, y, z, r);
+
+    auto &ranges = clusters.ranges();
+    check(ranges.size() == x.size(), "one range per light");
+    check(ranges[1].culled(), "a light behind the camera is culled");
+    check(ranges[2].culled(), "a light outside the frustum is culled");
+    check(!ranges[3].culled() && !ranges[4].culled(), "lights inside the frustum are kept");
+
+    // With a 90 degree fov and 16:9, light 0 spans x in [-0.0296, 0.0296] and y in [-0.0526, 0.0526] in NDC and
+    // depths 9.5 to 10.5, i.e. tiles 7-8 by 4 and slices 15-16.
+    auto &r0 = ranges[0];
+    check(r0.x0 == 7u && r0.x1 == 8u && r0.y0 == 4u && r0.y1 == 4u && r0.z0 == 15u && r0.z1 == 16u,
+          "light 0 covers tiles 7-8 x 4 in slices 15-16");
+    for (auto cluster: {LightClusters::index(7, 4, 15), LightClusters::index(8, 4, 15),
+                        LightClusters::index(7, 4, 16), LightClusters::index(8, 4, 16)})
+        check(contains(clusters, cluster, 0u), "light 0 is listed in its clusters");
+    check(std::count(clusters.indices().begin(), clusters.indices().end(), 0u) == 4,
+          "light 0 is listed in no other cluster");
+    check(shader_cluster_index(clusters, 0.0f, 0.0f, -10.2f) == LightClusters::index(8, 4, 16),
+          "the shader indexes the center of light 0 as tile 8 x 4, slice 16");
+    check(std::count(clusters.indices().begin(), clusters.indices().end(), 1u) == 0 &&
+          std::count(clusters.indices().begin(), clusters.indices().end(), 2u) == 0,
+          "culled lights are listed nowhere");
+
+    // Offsets are the prefix sums of the counts and every list is in light order.
+    std::uint32_t offset = 0u;
+    auto sorted = true;
+    for (auto &&cluster: clusters.clusters()) {
+        sorted = sorted && cluster.offset == offset &&
+                 std::is_sorted(clusters.indices().begin() + cluster.offset,
+                                clusters.indices().begin() + cluster.offset + cluster.count);
+        offset += cluster.count;
+    }
+    check(sorted, "cluster lists are contiguous and sorted");
+    check(offset == clusters.indices().size(), "the counts add up to the index list");
+
+    for (std::uint32_t i = 0; i < x.size(); ++i)
+        if (!ranges[i].culled())
+            check_covered(clusters, i, x[i], y[i], z[i], r[i]);
+
+    if (failures == 0)
+        std::printf("light clusters: all checks passed\n");
+    return failures == 0 ? 0 : 1;
+}